@@ -1086,6 +1086,7 @@ if __name__ == '__main__':
 		#'GL_ARB_ES2_compatibility',
 		#'GL_ARB_texture_buffer_range',
 		'GL_ARB_texture_storage',
+		'GL_ARB_get_program_binary',
 		#'GL_ARB_vertex_attrib_binding',
 		#'GL_ARB_viewport_array',
 	]
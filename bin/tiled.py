@@ -128,9 +128,14 @@ class Tileset:
         self.properties = read_properties(elem, base_path, loader = loader)
         self.image      = parse_image(elem.find('image'), base_path, loader = loader)
         # self.terraintypes
-        # self.tiles
         # self.wangsets
 
+        # Properties of individual tiles, by local tile id.
+        self.tile_properties = {}
+        for tile in children(elem, 'tile'):
+            self.tile_properties[attr(tile, int, 'id')] = \
+                read_properties(tile, base_path, loader = loader)
+
 
 class Image:
     """A Tiled image."""
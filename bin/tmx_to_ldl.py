@@ -141,6 +141,14 @@ class TiledMapConverter:
         d['v_tiles'] = tileset.tilecount // max(1, tileset.columns)
         d['image'] = self.path(tileset.image.source)
 
+        # Collision flags of each tile, from its `collision` property (a
+        # mask, or a boolean for mask 1). Read by TileCollisionLayer.
+        flags = [ 0 ] * tileset.tilecount
+        for id, properties in tileset.tile_properties.items():
+            flags[id] = int(properties.get('collision', 0))
+        if any(flags):
+            d['tile_flags'] = TypedList(None, flags).inline()
+
         return d
 
     def tile_layer(self, tile_layer):
@@ -21,6 +21,8 @@
 
 #include <functional>
 
+#include <lair/core/profiler.h>
+
 #include <lair/ldl/ldl_variant_loader.h>
 #include <lair/ldl/write.h>
 
@@ -68,6 +70,7 @@ MainState::MainState(Game* game)
       _fpsCount(0),
 
       _quitInput(nullptr),
+      _profileInput(nullptr),
 
       _scene() {
 
@@ -148,6 +151,9 @@ void MainState::initialize() {
 	_quitInput = _inputs.addInput("quit");
 	_inputs.mapScanCode(_quitInput, SDL_SCANCODE_ESCAPE);
 
+	_profileInput = _inputs.addInput("profile");
+	_inputs.mapScanCode(_profileInput, SDL_SCANCODE_F10);
+
 	AssetSP whiteAsset = loader()->load<ImageLoader>("white.png")->asset();
 
 	for(auto&& pair: _sceneMap) {
@@ -201,6 +207,7 @@ void MainState::shutdown() {
 
 void MainState::run() {
 	lairAssert(_initialized);
+	LAIR_PROFILE_THREAD("main");
 
 	log().log("Starting main state...");
 	_running = true;
@@ -212,13 +219,17 @@ void MainState::run() {
 
 	do {
 		switch(_loop.nextEvent()) {
-		case InterpLoop::Tick:
+		case InterpLoop::Tick: {
+			LAIR_PROFILE_SCOPE("tick");
 			updateTick();
 			break;
-		case InterpLoop::Frame:
+		}
+		case InterpLoop::Frame: {
+			LAIR_PROFILE_SCOPE("frame");
 			updateFrame();
 			break;
 		}
+		}
 	} while (_running);
 	_loop.stop();
 }
@@ -260,6 +271,23 @@ void MainState::updateTick() {
 		quit();
 	}
 
+	// F10 starts a profiler capture and saves it on the next press.
+	if(_profileInput->justPressed()) {
+		Profiler& profiler = Profiler::instance();
+		if(!profiler.isCapturing()) {
+			log().info("Start profiler capture.");
+			profiler.start();
+		}
+		else {
+			profiler.stop();
+			renderer()->gpuProfiler().update();
+			if(profiler.writeChromeTrace(Path("profile.json")))
+				log().info("Profiler capture saved in \"profile.json\".");
+			else
+				log().error("Failed to save profiler capture.");
+		}
+	}
+
 	if(_scene) {
 		_scene->updateTick();
 	}
@@ -306,6 +334,7 @@ void MainState::updateFrame() {
 	_mainPass.render();
 
 	window()->swapBuffers();
+	renderer()->gpuProfiler().update();
 	glc->setLogCalls(false);
 
 	uint64 now = sys()->getTimeNs();
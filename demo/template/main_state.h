@@ -112,6 +112,7 @@ protected:
 	unsigned    _fpsCount;
 
 	Input*      _quitInput;
+	Input*      _profileInput;
 
 	SceneMap _sceneMap;
 	SceneSP  _scene;
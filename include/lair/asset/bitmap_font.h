@@ -23,11 +23,11 @@
 #define _LAIR_ASSET_BITMAP_FONT_H
 
 
-#include <unordered_map>
+#include <vector>
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
-#include <lair/core/hash.h>
+#include <lair/core/text.h>
 
 #include <lair/asset/asset_manager.h>
 
@@ -98,8 +98,12 @@ public:
 	inline void setBaselineToTop(int     baselineToTop) { _baselineToTop = baselineToTop; }
 	inline void setImage        (AssetSP image)         { _image = image; }
 
-	const Glyph& glyph(int cp) const;
+	/// Return the glyph of cp, or the glyph of codepoint -1 if there is none.
+	inline const Glyph& glyph(int cp) const {
+		return _glyphs[_glyphRef(cp).index];
+	}
 	void setGlyph(int cp, const Glyph& glyph);
+	inline unsigned nGlyphs() const { return _glyphs.size() - 1; }
 
 	int kerning(int cp0, int cp1) const;
 	void setKerning(int cp0, int cp1, int kern);
@@ -108,12 +112,53 @@ public:
 	TextLayout layoutText(const std::string& msg, unsigned maxWidth = 999999) const;
 
 protected:
-	typedef std::unordered_map<int, Glyph, std::hash<int>, std::equal_to<int>,
-	                           Eigen::aligned_allocator<std::pair<const int, Glyph>>> GlyphMap;
-	typedef std::pair<int, int> CharPair;
-	typedef std::unordered_map<CharPair, int, Hash<CharPair>> KerningMap;
+	/// Codepoints below this are looked up in a direct-indexed table.
+	static constexpr int    DIRECT_RANGE   = 0x10000;
+	static constexpr uint16 INDEX_MASK     = 0x7fff;
+	static constexpr uint16 KERNING_FLAG   = 0x8000;
+	static constexpr uint16 NO_GLYPH       = INDEX_MASK;
+
+	struct GlyphRef {
+		unsigned index;
+		bool     kerning; ///< False if cp never appear first in a kerning pair.
+	};
+
+	struct SparseGlyph {
+		int      cp;
+		unsigned index;
+	};
+
+	struct KerningPair {
+		uint64   key;
+		int      kern;
+	};
+
+	typedef std::vector<Glyph, Eigen::aligned_allocator<Glyph>> GlyphList;
+	typedef std::vector<uint16>      DirectIndex;
+	typedef std::vector<SparseGlyph> SparseIndex;
+	typedef std::vector<KerningPair> KerningList;
 
 protected:
+	inline GlyphRef _glyphRef(int cp) const {
+		if(cp >= 0 && cp < int(_directIndex.size())) {
+			uint16 entry = _directIndex[cp];
+			unsigned index = entry & INDEX_MASK;
+			return GlyphRef{ (index != NO_GLYPH)? index: _defaultGlyph,
+			                 bool(entry & KERNING_FLAG) };
+		}
+		if(cp >= 0 && cp < DIRECT_RANGE) {
+			return GlyphRef{ _defaultGlyph, false };
+		}
+		return GlyphRef{ _sparseGlyph(cp), true };
+	}
+
+	unsigned _sparseGlyph(int cp) const;
+	void _growDirectIndex(int cp);
+
+	static inline uint64 _kerningKey(int cp0, int cp1) {
+		return (uint64(uint32(cp0)) << 32) | uint32(cp1);
+	}
+
 	unsigned wordWidth(const std::string& msg, unsigned i, unsigned* ci = nullptr) const;
 
 protected:
@@ -123,8 +168,12 @@ protected:
 	int        _height;
 	int        _baselineToTop;
 
-	GlyphMap   _glyphMap;
-	KerningMap _kerning;
+	// _glyphs[0] is an empty glyph, used if there is no default glyph.
+	GlyphList   _glyphs;
+	DirectIndex _directIndex;
+	SparseIndex _sparseIndex;
+	unsigned    _defaultGlyph;
+	KerningList _kerning;
 };
 
 
@@ -59,6 +59,7 @@ public:
 	unsigned height() const;
 	Format format() const;
 	const void* data() const;
+	void* data();
 	size_t sizeInBytes() const;
 
 private:
@@ -0,0 +1,163 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_ASSET_IMAGE_ATLAS_H
+#define _LAIR_ASSET_IMAGE_ATLAS_H
+
+
+#include <vector>
+#include <unordered_map>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+#include <lair/core/path.h>
+
+#include <lair/asset/image.h>
+
+
+namespace lair {
+
+
+class LdlWriter;
+
+
+/**
+ * \brief Pack rectangles in a fixed size area using the skyline bottom-left
+ * heuristic.
+ */
+class SkylinePacker {
+public:
+	SkylinePacker(const Vector2i& size = Vector2i(0, 0));
+	SkylinePacker(const SkylinePacker&) = default;
+	SkylinePacker(SkylinePacker&&)      = default;
+	~SkylinePacker() = default;
+
+	SkylinePacker& operator=(const SkylinePacker&) = default;
+	SkylinePacker& operator=(SkylinePacker&&)      = default;
+
+	inline const Vector2i& size() const { return _size; }
+	inline Size usedArea() const { return _usedArea; }
+	float occupancy() const;
+
+	void reset(const Vector2i& size);
+
+	/// Find a place for a rectangle of size `size`. Return false if it does not fit.
+	bool pack(const Vector2i& size, Vector2i& pos);
+
+protected:
+	struct Node {
+		int x;
+		int y;
+		int width;
+	};
+	typedef std::vector<Node> Skyline;
+
+protected:
+	int _fit(unsigned index, const Vector2i& size) const;
+	void _addNode(unsigned index, const Vector2i& pos, const Vector2i& size);
+
+protected:
+	Vector2i _size;
+	Skyline  _skyline;
+	Size     _usedArea;
+};
+
+
+/**
+ * \brief Pack images in RGBA8 pages.
+ *
+ * Entries are separated by `padding` pixels on each side, filled by
+ * extruding the image borders to avoid bleeding with linear filtering.
+ */
+class ImageAtlas {
+public:
+	static constexpr unsigned DEFAULT_PAGE_SIZE = 2048;
+	static constexpr unsigned DEFAULT_PADDING   = 1;
+
+	struct Entry {
+		unsigned page;
+		Box2i    rect;
+	};
+
+public:
+	ImageAtlas(unsigned pageSize = DEFAULT_PAGE_SIZE,
+	           unsigned padding  = DEFAULT_PADDING);
+	ImageAtlas(const ImageAtlas&) = delete;
+	ImageAtlas(ImageAtlas&&)      = default;
+	~ImageAtlas() = default;
+
+	ImageAtlas& operator=(const ImageAtlas&) = delete;
+	ImageAtlas& operator=(ImageAtlas&&)      = default;
+
+	inline unsigned pageSize() const { return _pageSize; }
+	inline unsigned padding()  const { return _padding; }
+
+	bool canPack(const Image& image) const;
+
+	/**
+	 * \brief Pack `image` under the name `name`.
+	 *
+	 * Return the existing entry if `name` is already packed and nullptr if
+	 * the image can not be packed.
+	 */
+	const Entry* add(const String& name, const Image& image);
+	const Entry* find(const String& name) const;
+
+	inline unsigned nPages() const { return _pages.size(); }
+	inline unsigned nEntries() const { return _entries.size(); }
+	const Image& pageImage(unsigned page) const;
+
+	/// The part of the page modified since the last call to _clearDirty().
+	const Box2i& dirtyRect(unsigned page) const;
+	void _clearDirty(unsigned page);
+
+	/**
+	 * \brief Write an index of the atlas that can be used to load it back.
+	 *
+	 * `pageFiles` contains the path of each page image, relative to the
+	 * index file.
+	 */
+	bool writeIndex(LdlWriter& writer, const std::vector<Path>& pageFiles) const;
+
+protected:
+	struct Page {
+		Image         image;
+		SkylinePacker packer;
+		Box2i         dirty;
+	};
+	typedef std::vector<Page> PageList;
+	typedef std::unordered_map<String, Entry> EntryMap;
+
+protected:
+	void _blit(Page& page, const Box2i& rect, const Image& image);
+
+protected:
+	unsigned _pageSize;
+	unsigned _padding;
+	PageList _pages;
+	EntryMap _entries;
+};
+
+
+}
+
+
+#endif
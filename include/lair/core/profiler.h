@@ -0,0 +1,194 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_CORE_PROFILER_H
+#define _LAIR_CORE_PROFILER_H
+
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/path.h>
+
+
+/**
+ * \brief Instrumentation macros.
+ *
+ * They expand to nothing unless LAIR_PROFILER is defined (see the
+ * LAIR_ENABLE_PROFILER CMake option), so zones can be left in hot code.
+ * Zone names must be string literals.
+ */
+#define _LAIR_PROFILE_CONCAT2(_a, _b) _a ## _b
+#define _LAIR_PROFILE_CONCAT(_a, _b) _LAIR_PROFILE_CONCAT2(_a, _b)
+
+#ifdef LAIR_PROFILER
+#define LAIR_PROFILE_SCOPE(_name) \
+	::lair::ProfileZone _LAIR_PROFILE_CONCAT(_lairProfileZone, __LINE__)(_name)
+#define LAIR_PROFILE_THREAD(_name) \
+	::lair::Profiler::instance().setThreadName(_name)
+#else
+#define LAIR_PROFILE_SCOPE(_name)  ((void)0)
+#define LAIR_PROFILE_THREAD(_name) ((void)0)
+#endif
+
+
+namespace lair
+{
+
+
+/// A zone recorded by the Profiler. Times are in nanoseconds.
+struct ProfileEvent {
+	const char* name;
+	uint64      begin;
+	uint64      end;
+	unsigned    track;
+	unsigned    depth;
+};
+typedef std::vector<ProfileEvent> ProfileEventList;
+
+
+/**
+ * \brief Collect timed zones from any thread during a capture.
+ *
+ * Each thread records completed zones in its own ring buffer, so recording
+ * does not contend between threads; only the most recent bufferSize events
+ * of each thread are kept. Other timelines, like the GPU, can be added as
+ * named tracks. Zone names are not copied.
+ */
+class Profiler {
+public:
+	static constexpr unsigned DEFAULT_BUFFER_SIZE = 1 << 14;
+
+public:
+	Profiler(unsigned bufferSize = DEFAULT_BUFFER_SIZE);
+	Profiler(const Profiler&) = delete;
+	Profiler(Profiler&&)      = delete;
+	~Profiler();
+
+	Profiler& operator=(const Profiler&) = delete;
+	Profiler& operator=(Profiler&&)      = delete;
+
+	static Profiler& instance();
+
+	/// Monotonic time in nanoseconds, used for all events.
+	static uint64 now();
+
+	inline bool isCapturing() const {
+		return _capturing.load(std::memory_order_relaxed);
+	}
+
+	/// Clear previous events and start recording.
+	void start();
+	void stop();
+	void clear();
+
+	/// Name the calling thread in exported traces.
+	void setThreadName(const String& name);
+
+	/// Track index of the calling thread. Register the thread if needed.
+	unsigned currentTrack();
+	/// Track index of a named timeline, created on first use.
+	unsigned track(const String& name);
+	inline unsigned nTracks() const { return _tracks.size(); }
+
+	unsigned _enterZone();
+	void _leaveZone(const char* name, uint64 begin, uint64 end);
+	void addEvent(unsigned track, const char* name, uint64 begin, uint64 end,
+	              unsigned depth = 0);
+
+	/// All recorded events, sorted by track and begin time.
+	ProfileEventList events() const;
+
+	/// Write recorded events in the Chrome trace event format (JSON).
+	bool writeChromeTrace(std::ostream& out) const;
+	bool writeChromeTrace(const Path& path) const;
+
+protected:
+	struct Track {
+		mutable std::mutex mutex;
+		String             name;
+		std::thread::id    thread;  // Default-constructed for named tracks.
+		unsigned           index;
+		unsigned           depth;
+		uint64             count;   // Events pushed since the last clear.
+		ProfileEventList   events;  // Ring buffer.
+	};
+	typedef std::unique_ptr<Track>  TrackPtr;
+	typedef std::vector<TrackPtr>   TrackList;
+
+protected:
+	Track* _threadTrack();
+	// _tracksMutex must be locked.
+	Track* _findOrCreateTrack(const String& name, std::thread::id thread);
+	void   _push(Track* track, const ProfileEvent& event);
+
+protected:
+	unsigned            _id;
+	unsigned            _bufferSize;
+	std::atomic<bool>   _capturing;
+	uint64              _startTime;
+
+	mutable std::mutex  _tracksMutex;
+	TrackList           _tracks;
+};
+
+
+/// Record the lifetime of the zone if a capture is running when it begins.
+class ProfileZone {
+public:
+	inline ProfileZone(const char* name)
+	    : _name(nullptr),
+	      _begin(0) {
+		Profiler& profiler = Profiler::instance();
+		if(profiler.isCapturing()) {
+			_name = name;
+			profiler._enterZone();
+			_begin = Profiler::now();
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone(ProfileZone&&)      = delete;
+
+	inline ~ProfileZone() {
+		if(_name) {
+			Profiler::instance()._leaveZone(_name, _begin, Profiler::now());
+		}
+	}
+
+	ProfileZone& operator=(const ProfileZone&) = delete;
+	ProfileZone& operator=(ProfileZone&&)      = delete;
+
+protected:
+	const char* _name;
+	uint64      _begin;
+};
+
+
+}
+
+
+#endif
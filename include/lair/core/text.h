@@ -49,6 +49,11 @@ public:
 		return _begin < _end;
 	}
 
+	/// Pointer to the first byte of the next codepoint.
+	inline const char* pos() const {
+		return _begin;
+	}
+
 	inline Codepoint next() {
 		assert(hasNext());
 
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_CORE_THREAD_POOL_H
+#define _LAIR_CORE_THREAD_POOL_H
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief A fixed set of worker threads to run data-parallel jobs.
+ *
+ * run() executes task(i) for each i in [0, nTasks), distributing tasks
+ * between the workers and the calling thread, and returns when all of them
+ * are done. Tasks must not call run() themselves.
+ */
+class ThreadPool {
+public:
+	typedef std::function<void(unsigned task)> Task;
+
+public:
+	/// nWorkers == -1 means one worker per hardware thread, minus the caller.
+	ThreadPool(int nWorkers = -1);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&)      = delete;
+	~ThreadPool();
+
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&)      = delete;
+
+	/// Number of threads running tasks, including the caller of run().
+	inline unsigned nThreads() const { return _workers.size() + 1; }
+
+	void run(unsigned nTasks, const Task& task);
+
+protected:
+	void _work();
+	void _runTasks();
+
+protected:
+	std::vector<std::thread> _workers;
+
+	std::mutex               _mutex;
+	std::condition_variable  _start;
+	std::condition_variable  _done;
+	uint64                   _generation;
+	unsigned                 _running;
+	bool                     _stop;
+
+	const Task*              _task;
+	unsigned                 _nTasks;
+	std::atomic<unsigned>    _nextTask;
+};
+
+
+/// Number of chunks parallelFor() splits count items into.
+inline unsigned parallelChunkCount(const ThreadPool* pool, unsigned count,
+                                   unsigned grainSize) {
+	if(!pool || !count)
+		return count? 1: 0;
+	grainSize = std::max(grainSize, 1u);
+	return std::max(std::min(pool->nThreads() * 4, (count + grainSize - 1) / grainSize), 1u);
+}
+
+/**
+ * \brief Call func(chunk, begin, end) on contiguous chunks of [0, count).
+ *
+ * Chunks are numbered in order, so per-chunk results can be merged
+ * deterministically. Without a pool, everything runs in the calling thread
+ * as a single chunk.
+ */
+template<typename F>
+void parallelFor(ThreadPool* pool, unsigned count, unsigned grainSize, F&& func) {
+	unsigned nChunks = parallelChunkCount(pool, count, grainSize);
+	if(nChunks <= 1) {
+		if(count)
+			func(0u, 0u, count);
+		return;
+	}
+
+	unsigned chunkSize = (count + nChunks - 1) / nChunks;
+	pool->run(nChunks, [&](unsigned chunk) {
+		unsigned begin = std::min(chunk * chunkSize, count);
+		unsigned end   = std::min(begin + chunkSize, count);
+		func(chunk, begin, end);
+	});
+}
+
+}
+
+
+#endif
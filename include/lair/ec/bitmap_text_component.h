@@ -53,6 +53,14 @@ class SpriteRenderer;
 class BitmapTextComponentManager;
 
 
+struct BitmapGlyphQuad {
+	Box2 coords;
+	Box2 texCoords;
+};
+
+typedef std::vector<BitmapGlyphQuad> BitmapGlyphQuadList;
+
+
 bool parseJson(Json::Value& value, std::istream& in, const Path& localPath, Logger& log);
 bool parseJson(Json::Value& value, const Path& realPath, const Path& localPath, Logger& log);
 bool parseJson(Json::Value& value, const VirtualFile& file, const Path& localPath, Logger& log);
@@ -108,22 +116,33 @@ public:
 	inline void _setTexture(TextureAspectSP texture);
 
 	inline const std::string& text() const { return _text; }
-	inline void setText(const std::string& text) { _text = text; }
+	inline void setText(const std::string& text) {
+		if(text != _text) {
+			_text = text;
+			_layoutDirty = true;
+		}
+	}
 
 	inline const Vector4& color() const { return _color; }
 	inline void setColor(const Vector4& color) { _color = color; }
 
 	inline const Vector2& size() const { return _size; }
-	inline void setSize(const Vector2& size) { _size = size; }
+	inline void setSize(const Vector2& size) { _size = size; _layoutDirty = true; }
 
 	inline const Vector2& anchor() const { return _anchor; }
-	inline void setAnchor(const Vector2& anchor) { _anchor = anchor; }
+	inline void setAnchor(const Vector2& anchor) { _anchor = anchor; _layoutDirty = true; }
 
 	inline BlendingMode blendingMode() const { return _blendingMode; }
 	inline void setBlendingMode(BlendingMode bm) { _blendingMode = bm; }
 
 	static const PropertyList& properties();
 
+	/**
+	 * \brief Update the cached layout and glyph quads if the text, size,
+	 * anchor or font changed.
+	 */
+	void _updateLayout(const BitmapFont& font);
+
 public:
 	BitmapFontAspectWP _font;
 	TextureSetCSP      _textureSet;
@@ -132,6 +151,12 @@ public:
 	Vector2            _size;
 	Vector2            _anchor;
 	BlendingMode       _blendingMode;
+
+	const BitmapFont*   _layoutFont;
+	bool                _layoutDirty;
+	TextLayout          _layout;
+	BitmapGlyphQuadList _glyphQuads; ///< In local coordinates.
+	Box2                _layoutBox;  ///< Bounding box of _glyphQuads.
 };
 
 
@@ -168,12 +193,33 @@ private:
 };
 
 
+/// Returns the bounding box of the text in local coordinates.
+Box2 bitmapTextBox(const BitmapFont& font, const TextLayout& layout,
+                   const Vector2& anchor);
+
+/// Computes the quad of each glyph of layout in local coordinates.
+void bitmapGlyphQuads(BitmapGlyphQuadList& quads, const BitmapFont& font,
+                      const TextLayout& layout, const Vector2& anchor);
+
 void renderBitmapText(RenderPass* pass, SpriteRenderer* renderer,
                       const BitmapFont& font, const TextureSetCSP& textureSet,
                       const Matrix4& transform, float depth,
                       const TextLayout& layout, const Vector2& anchor,
                       const Vector4& color, const Matrix4& viewTransform,
                       BlendingMode blendingMode);
+
+/**
+ * \brief Render glyph quads precomputed with bitmapGlyphQuads().
+ *
+ * transform is passed as the model matrix of the sprite shader, so the quads
+ * are not transformed on the CPU.
+ */
+void renderBitmapText(RenderPass* pass, SpriteRenderer* renderer,
+                      const TextureSetCSP& textureSet,
+                      const Matrix4& transform, float depth,
+                      const BitmapGlyphQuadList& quads,
+                      const Vector4& color, const Matrix4& viewTransform,
+                      BlendingMode blendingMode);
 }
 
 #endif
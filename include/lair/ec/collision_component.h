@@ -24,6 +24,7 @@
 
 
 #include <deque>
+#include <unordered_set>
 
 #include <lair/core/lair.h>
 
@@ -32,10 +33,12 @@
 #include <lair/meta/with_properties.h>
 
 #include <lair/geometry/shape_2d.h>
-#include <lair/geometry/octree.h>
+#include <lair/geometry/intersection.h>
+#include <lair/geometry/broadphase.h>
 
 #include <lair/ec/component.h>
 #include <lair/ec/dense_component_manager.h>
+#include <lair/ec/debug_renderer.h>
 
 
 namespace lair
@@ -47,6 +50,8 @@ class RenderPass;
 class TextureSet;
 typedef std::shared_ptr<const TextureSet> TextureSetCSP;
 class SpriteRenderer;
+class ThreadPool;
+class TileCollisionLayer;
 
 
 enum Direction {
@@ -58,6 +63,14 @@ enum Direction {
 };
 
 
+enum BroadphaseType {
+	BROADPHASE_QUADTREE,
+	BROADPHASE_LOOSE_QUADTREE,
+	BROADPHASE_HASH_GRID,
+	BROADPHASE_SWEEP_AND_PRUNE,
+};
+
+
 class CollisionComponent;
 class CollisionComponentManager;
 
@@ -68,12 +81,16 @@ struct _CollisionComponentElement {
 		Dim = 2,
 	};
 
-	inline const AlignedBox2& boundingBox() { return box; }
+	inline const AlignedBox2& boundingBox() const { return box; }
 
 	EntityRef           entity;
 	Shape2D             shape;
 	AlignedBox2         box;
 	_CollisionComponentElement* next;
+	/// 0, or 1 + the position of the element among the ones inserted by the
+	/// running findCollisions(). A new element is only tested against older
+	/// elements, so each new pair is tested once.
+	unsigned            order;
 };
 
 
@@ -103,6 +120,9 @@ public:
 	inline unsigned ignoreMask() const             { return _ignoreMask; }
 	inline void setIgnoreMask(unsigned ignoreMask) { _ignoreMask = ignoreMask; }
 
+	/// Unique id of this collider, never reused by the manager.
+	inline unsigned id() const { return _id; }
+
 	inline bool isDirty() const { return _dirty; }
 	inline void setDirty(bool dirty = true) { _dirty= dirty; }
 
@@ -113,10 +133,14 @@ protected:
 	Vector4       _debugColor;
 	unsigned      _hitMask;
 	unsigned      _ignoreMask;
+	unsigned      _id;
 	bool          _dirty;
 
 public:
 	_CollisionComponentElement* _firstElem;
+	// Transform version of the entity when the elements were computed.
+	uint32                      _transformVersion;
+	bool                        _moved;
 };
 
 
@@ -124,10 +148,26 @@ class HitEvent {
 public:
 	EntityRef entities[2];
 	Vector2   position;
+	/// Identifies the pair of colliders, see CollisionComponentManager::pairId().
+	uint64    pairId;
 };
 typedef std::vector<HitEvent> HitEventVector;
 typedef std::deque<HitEvent> HitEventQueue;
 
+class RaycastHit {
+public:
+	EntityRef entity;
+	/// The hit point is `origin + t * direction` for a raycast. For a shape
+	/// cast, the shape touches `entity` when moved by `t * motion`.
+	float     t;
+};
+
+class NearestHit {
+public:
+	EntityRef entity;
+	float     distance;
+};
+
 class CollisionComponentManager : public DenseComponentManager<CollisionComponent> {
 public:
 
@@ -140,26 +180,96 @@ public:
 	CollisionComponentManager& operator=(const CollisionComponentManager&)  = delete;
 	CollisionComponentManager& operator=(      CollisionComponentManager&&) = delete;
 
-	inline AlignedBox2 bounds() const { return _quadTree.bounds(); }
+	inline AlignedBox2 bounds() const { return _bounds; }
 	void setBounds(const AlignedBox2& bounds);
 
+	/// The spatial structure used to find collisions. `cellSize` is only
+	/// used by the hash grid and should be close to the size of most shapes.
+	inline BroadphaseType broadphaseType() const { return _broadphaseType; }
+	void setBroadphase(BroadphaseType type, float cellSize = 64);
+
+	/// Pairs of colliders currently touching, one event per pair. Pairs where
+	/// neither collider is dirty are kept from the previous call to
+	/// findCollisions() without being tested again.
 	inline const HitEventVector& hitEvents() const { return _hitEvents; }
+	/// Pairs that started touching during the last findCollisions().
+	inline const HitEventVector& contactBegins() const { return _contactBegins; }
+	/// Pairs that stopped touching during the last findCollisions(). The
+	/// entities may have been destroyed since.
+	inline const HitEventVector& contactEnds() const { return _contactEnds; }
 	void findCollisions();
 
+	/**
+	 * \brief Use pool to find collisions in parallel.
+	 *
+	 * Colliders are tested in chunks whose hits are merged in order, so the
+	 * events are the same whatever the number of threads. nullptr (the
+	 * default) does everything in the calling thread.
+	 */
+	inline void setThreadPool(ThreadPool* pool) { _threadPool = pool; }
+	inline ThreadPool* threadPool() const { return _threadPool; }
+
+	static inline uint64 pairId(unsigned id0, unsigned id1) {
+		return (id0 < id1)? (uint64(id0) << 32) | id1:
+		                    (uint64(id1) << 32) | id0;
+	}
+
+	inline unsigned _allocateId() { return _nextId++; }
+
+	/// Find the entities whose shapes or tile layers overlap `box`.
 	bool hitTest(std::deque<EntityRef>& hits, const AlignedBox2& box,
 	             unsigned hitMask = 0x01, EntityRef dontPick = EntityRef());
 	bool hitTest(std::deque<EntityRef>& hits, const Vector2& p,
 	             unsigned hitMask = 0x01, EntityRef dontPick = EntityRef());
 
+	/// Find the closest shape hit by the ray `origin + t * direction`, with t
+	/// in [0, maxT]. The index is traversed front to back and the traversal
+	/// stops once no closer hit is possible. `maxT` must be finite with the
+	/// hash grid and sweep and prune broadphases.
+	bool raycast(RaycastHit& hit, const Vector2& origin, const Vector2& direction,
+	             float maxT, unsigned hitMask = 0x01, EntityRef dontPick = EntityRef());
+	/// Find the first shape touched by `shape` (in world coordinates) when it
+	/// moves by `t * motion`, with t in [0, 1]. Useful for fast movers that
+	/// would go through thin colliders between two frames.
+	bool shapeCast(RaycastHit& hit, const Shape2D& shape, const Vector2& motion,
+	               unsigned hitMask = 0x01, EntityRef dontPick = EntityRef());
+	/// Write in `hits` the at most `k` entities closest to `p` within
+	/// `maxDist`, sorted by distance, and return their number. `maxDist` must
+	/// be finite with the hash grid and sweep and prune broadphases.
+	unsigned nearest(NearestHit* hits, unsigned k, const Vector2& p, float maxDist,
+	                 unsigned hitMask = 0x01, EntityRef dontPick = EntityRef());
+
+	/// Add a tile layer to the queries of hitTest(). `entity` is reported on
+	/// hits and its world position places the layer; rotation and scale are
+	/// ignored. Tiles are not indexed: queries look them up in the grid.
+	/// `layer` must stay alive until removeTileLayer() is called.
+	void addTileLayer(EntityRef entity, const TileCollisionLayer* layer);
+	void removeTileLayer(const TileCollisionLayer* layer);
+
+	/// Re-index the shapes of `entity` immediately. Not required for moved
+	/// entities: findCollisions() refits colliders whose world transform
+	/// changed since the last call.
 	void update(EntityRef entity);
 
+	/// Render the shapes of enabled components, in a single batch.
 	void render(SpriteRenderer* spriteRenderer, RenderPass* renderPass,
 	            TextureSetCSP texture, const OrthographicCamera& camera);
 
+	/// If true, render() draws shape outlines instead of filled shapes.
+	inline bool debugOutlines() const { return _debugOutlines; }
+	inline void setDebugOutlines(bool outlines) { _debugOutlines = outlines; }
+
 
 protected:
 	typedef _CollisionComponentElement _Element;
-	typedef Octree<_Element> QuadTree;
+	typedef Broadphase<_Element> _Broadphase;
+	typedef std::unique_ptr<_Broadphase> _BroadphaseUP;
+
+	struct _TileLayer {
+		EntityRef                 entity;
+		const TileCollisionLayer* layer;
+	};
+	typedef std::vector<_TileLayer> _TileLayerVector;
 
 	struct _FilterDirtyElement {
 		inline _FilterDirtyElement(CollisionComponentManager* self)
@@ -185,15 +295,73 @@ protected:
 			    || !hit.entities[0].isValid()
 			    || !hit.entities[1].isValid()
 			    || comp0->isDirty()
-			    || comp1->isDirty();
+			    || comp1->isDirty()
+			    || comp0->_moved
+			    || comp1->_moved;
 		}
 
 		CollisionComponentManager* _self;
 	};
 
 protected:
-	QuadTree       _quadTree;
+	inline bool _isPickable(const _Element& e, unsigned hitMask, EntityRef dontPick) {
+		CollisionComponent* comp = get(e.entity);
+		return comp
+		    && e.entity != dontPick
+		    && (hitMask & comp->hitMask())    != 0
+		    && (hitMask & comp->ignoreMask()) == 0;
+	}
+
+	typedef std::vector<_Element*> _ElementVector;
+	typedef std::vector<unsigned>  _IndexVector;
+
+	/// A hit found by a worker thread. EntityRefs are only copied when hits
+	/// are merged, in the calling thread.
+	struct _Hit {
+		const _Element* elements[2];
+		uint64          pairId;
+	};
+	typedef std::vector<_Hit> _HitVector;
+
+	/// Temporaries and hits of a chunk of the elements tested in parallel.
+	struct _Chunk {
+		_ElementVector   candidates;
+		_ElementVector   batchElements;
+		AlignedBox2Batch boxBatch;
+		Sphere2Batch     sphereBatch;
+		_IndexVector     batchHits;
+		_HitVector       hits;
+	};
+	typedef std::vector<_Chunk> _ChunkVector;
+
+	/// Test the elements of _queryElements in parallel, then add their hit
+	/// events in order.
+	void _findAllHits();
+	/// Find the elements hitting `e0` and append the hits to `chunk`.
+	void _findHits(_Chunk& chunk, const _Element& e0);
+	void _pushHit(_Chunk& chunk, const _Element& e0, const _Element& e1);
+
+protected:
+	AlignedBox2    _bounds;
+	BroadphaseType _broadphaseType;
+	_BroadphaseUP  _broadphase;
+	_TileLayerVector _tileLayers;
 	HitEventVector _hitEvents;
+	HitEventVector _contactBegins;
+	HitEventVector _contactEnds;
+	unsigned       _nextId;
+	ThreadPool*    _threadPool;
+
+	// Temporaries for findCollisions, kept to reuse memory.
+	typedef std::unordered_set<uint64> _PairSet;
+	HitEventVector _staleContacts;
+	_PairSet       _staleIds;
+	_PairSet       _foundIds;
+	_ElementVector _queryElements;
+	_ChunkVector   _chunks;
+
+	DebugRenderer  _debugRenderer;
+	bool           _debugOutlines;
 };
 
 
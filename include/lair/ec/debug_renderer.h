@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_EC_DEBUG_RENDERER_H
+#define _LAIR_EC_DEBUG_RENDERER_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/geometry/shape_2d.h>
+
+#include <lair/render_gl3/render_pass.h>
+
+#include <lair/ec/sprite_renderer.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief Accumulate debug shapes and lines and render them in bulk.
+ *
+ * Shapes are buffered on the CPU and written in the SpriteRenderer buffers
+ * by render(), which adds a single draw call per blending mode and primitive
+ * type. Circles use a precomputed unit circle.
+ */
+class DebugRenderer {
+public:
+	static constexpr unsigned DEFAULT_CIRCLE_SEGMENTS = 64;
+
+public:
+	DebugRenderer(unsigned circleSegments = DEFAULT_CIRCLE_SEGMENTS);
+	DebugRenderer(const DebugRenderer&) = delete;
+	DebugRenderer(DebugRenderer&&)      = delete;
+	~DebugRenderer() = default;
+
+	DebugRenderer& operator=(const DebugRenderer&) = delete;
+	DebugRenderer& operator=(DebugRenderer&&)      = delete;
+
+	inline unsigned circleSegments() const { return _unitCircle.size(); }
+	inline bool isEmpty() const { return _vertexCount == 0; }
+
+	void addShape(const Matrix4& trans, const Sphere2& sphere, const Vector4& color,
+	              BlendingMode blendingMode = BLEND_ALPHA);
+	void addShape(const Matrix4& trans, const AlignedBox2& box, const Vector4& color,
+	              BlendingMode blendingMode = BLEND_ALPHA);
+	void addShape(const Matrix4& trans, const OrientedBox2& box, const Vector4& color,
+	              BlendingMode blendingMode = BLEND_ALPHA);
+	void addShape(const Matrix4& trans, const Shape2D& shape, const Vector4& color,
+	              BlendingMode blendingMode = BLEND_ALPHA);
+
+	void addOutline(const Matrix4& trans, const Sphere2& sphere, const Vector4& color,
+	                BlendingMode blendingMode = BLEND_ALPHA);
+	void addOutline(const Matrix4& trans, const AlignedBox2& box, const Vector4& color,
+	                BlendingMode blendingMode = BLEND_ALPHA);
+	void addOutline(const Matrix4& trans, const OrientedBox2& box, const Vector4& color,
+	                BlendingMode blendingMode = BLEND_ALPHA);
+	void addOutline(const Matrix4& trans, const Shape2D& shape, const Vector4& color,
+	                BlendingMode blendingMode = BLEND_ALPHA);
+
+	void addLine(const Vector3& p0, const Vector3& p1, const Vector4& color,
+	             BlendingMode blendingMode = BLEND_ALPHA);
+
+	/**
+	 * \brief Write the buffered shapes in spriteRenderer, add the draw calls
+	 * to pass and clear the buffers.
+	 *
+	 * Must be called between SpriteRenderer::beginRender() and
+	 * SpriteRenderer::endRender().
+	 */
+	void render(RenderPass* pass, SpriteRenderer* spriteRenderer,
+	            TextureSetCSP textureSet, const Matrix4& viewTransform,
+	            float depth);
+
+	void clear();
+
+protected:
+	enum {
+		N_BLENDING_MODES = BLEND_MULTIPLY + 1,
+	};
+
+	struct Batch {
+		std::vector<SpriteVertex> vertices;
+		std::vector<unsigned>     indices;
+	};
+
+protected:
+	Batch& _triangles(BlendingMode blendingMode);
+	Batch& _lines(BlendingMode blendingMode);
+
+	void _addQuad(Batch& batch, const Matrix4& trans, const Vector2* corners,
+	              const Vector4& color);
+	void _addLoop(Batch& batch, const Matrix4& trans, const Vector2* points,
+	              unsigned count, const Vector4& color);
+	void _flush(RenderPass* pass, SpriteRenderer* spriteRenderer,
+	            const RenderPass::DrawStates& states, const ShaderParameter* params,
+	            float depth, Batch& batch, GLenum primitive);
+
+protected:
+	std::vector<Vector2> _unitCircle;
+	std::vector<Vector2> _points;
+	Batch                _batches[2 * N_BLENDING_MODES];
+	unsigned             _vertexCount;
+};
+
+
+}
+
+
+#endif
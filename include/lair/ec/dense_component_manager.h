@@ -136,13 +136,19 @@ public:
 	}
 
 	virtual Component* get(EntityRef entity) {
+		return _get(entity._get());
+	}
+
+	/// Same as get(), without copying an EntityRef. Entity reference counts
+	/// are not atomic, so worker threads must use this one.
+	Component* _get(_Entity* entity) const {
 		lairAssert(_index >= 0);
 
 		if(_index < LAIR_EC_MAX_DENSE_COMPONENTS) {
-			return reinterpret_cast<Component*>(entity._get()->components[_index]);
+			return reinterpret_cast<Component*>(entity->components[_index]);
 		}
 
-		auto it = _componentMap.find(entity._get());
+		auto it = _componentMap.find(entity);
 		if(it == _componentMap.end()) {
 			return nullptr;
 		}
@@ -50,6 +50,7 @@ public:
 	enum {
 		Alive   = 1 << 0,
 		Enabled = 1 << 1,
+		Cached  = 1 << 2,
 	};
 
 public:
@@ -78,6 +79,23 @@ public:
 		flags = setBits(flags, Enabled, enabled);
 	}
 
+	/// Cached entities are rendered by a LayerCache, not with their parent.
+	inline bool isCached() const {
+		return bitsEnabled(flags, Cached);
+	}
+
+	inline void setCached(bool cached) {
+		flags = setBits(flags, Cached, cached);
+	}
+
+	/// Set worldTransform and bump worldTransformVersion if it changed.
+	inline void setWorldTransform(const Transform& wt) {
+		if(wt.matrix() != worldTransform.matrix()) {
+			worldTransform = wt;
+			++worldTransformVersion;
+		}
+	}
+
 	inline void reset() {
 		// Erase everything from the field flags
 		std::memset(&flags, 0,
@@ -116,6 +134,9 @@ public:
 	Transform      transform;
 	Transform      worldTransform;
 	Transform      prevWorldTransform;
+	// Incremented each time worldTransform changes, so that component
+	// managers can detect moved entities.
+	uint32         worldTransformVersion;
 //	Transform*     transform;
 //	Transform*     worldTransform;
 
@@ -185,6 +206,16 @@ public:
 		_entity->setEnabled(enabled);
 	}
 
+	inline bool isCached() const {
+		lairAssert(isValid());
+		return _entity->isCached();
+	}
+
+	inline void setCached(bool cached) {
+		lairAssert(isValid());
+		_entity->setCached(cached);
+	}
+
 	void release();
 	void destroy();
 
@@ -274,8 +305,12 @@ public:
 		}
 	}
 
+	inline uint32 worldTransformVersion() const {
+		return _entity->worldTransformVersion;
+	}
+
 	inline void updateWorldTransform() {
-		_entity->worldTransform = computeWorldTransform();
+		_entity->setWorldTransform(computeWorldTransform());
 	}
 
 	void updateWorldTransformRec();
@@ -349,7 +384,7 @@ public:
 
 	EntityRef clone(EntityRef newParent, const char* newName = nullptr) const;
 
-	inline _Entity* _get() {
+	inline _Entity* _get() const {
 		return _entity;
 	}
 
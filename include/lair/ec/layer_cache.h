@@ -0,0 +1,155 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_EC_LAYER_CACHE_H
+#define _LAIR_EC_LAYER_CACHE_H
+
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/render_gl3/framebuffer.h>
+#include <lair/render_gl3/orthographic_camera.h>
+#include <lair/render_gl3/render_pass.h>
+
+#include <lair/ec/entity.h>
+#include <lair/ec/sprite_renderer.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief Render a static subtree once in offscreen textures and draw it as a
+ * few textured quads until it is invalidated.
+ *
+ * The root entity is marked as cached, so component managers skip it when
+ * rendering its ancestors. The layer covers bounds, expressed relative to the
+ * root position, and is split in tiles of tileSize texels. Only the
+ * translation of the root is taken into account: moving it does not require
+ * to rebuild the cache.
+ *
+ * Note that semi-transparent pixels are blended against a transparent
+ * background, so they may look slightly different than when rendered
+ * directly.
+ */
+class LayerCache {
+public:
+	/**
+	 * \brief Render root in the render pass given to the constructor.
+	 *
+	 * Typically calls the render() method of the relevant component
+	 * managers.
+	 */
+	typedef std::function<void(EntityRef root, float interp,
+	                           const OrthographicCamera& camera)> RenderFunction;
+
+	static constexpr unsigned DEFAULT_TILE_SIZE = 1024;
+
+public:
+	LayerCache(Renderer* renderer, RenderPass* renderPass, SpriteRenderer* spriteRenderer);
+	LayerCache(const LayerCache&) = delete;
+	LayerCache(LayerCache&&)      = delete;
+	~LayerCache();
+
+	LayerCache& operator=(const LayerCache&) = delete;
+	LayerCache& operator=(LayerCache&&)      = delete;
+
+	inline EntityRef root() const { return _root; }
+	void setRoot(EntityRef root);
+
+	inline const Box2& bounds() const { return _bounds; }
+	void setBounds(const Box2& bounds);
+
+	/// Number of texels per unit.
+	inline Scalar scale() const { return _scale; }
+	void setScale(Scalar scale);
+
+	inline unsigned tileSize() const { return _tileSize; }
+	void setTileSize(unsigned tileSize);
+
+	inline void setRenderFunction(const RenderFunction& func) { _renderFunction = func; }
+
+	inline bool isValid() const { return _valid; }
+	inline void invalidate() { _valid = false; }
+
+	inline unsigned nTiles() const { return _tiles.size(); }
+	inline unsigned rebuildCount() const { return _rebuildCount; }
+
+	/**
+	 * \brief Render the layer in its tiles if the cache is invalid.
+	 *
+	 * This uses the render pass and the sprite renderer, so it must be
+	 * called before filling them for the frame, outside of
+	 * SpriteRenderer::beginRender() / endRender(). camera is only used for
+	 * its depth range. Return true if the cache has been rebuilt.
+	 */
+	bool update(const OrthographicCamera& camera);
+
+	/**
+	 * \brief Add the visible tiles to the render pass.
+	 *
+	 * Must be called between SpriteRenderer::beginRender() and
+	 * SpriteRenderer::endRender().
+	 */
+	void render(float interp, const OrthographicCamera& camera);
+
+protected:
+	struct Tile {
+		Box2                         box;
+		TextureSetCSP                textureSet;
+		std::unique_ptr<Framebuffer> framebuffer;
+	};
+	typedef std::vector<Tile> TileList;
+
+protected:
+	void _createTiles();
+	void _renderTile(Tile& tile, const Vector3& origin, const OrthographicCamera& camera);
+
+protected:
+	Renderer*        _renderer;
+	RenderPass*      _renderPass;
+	SpriteRenderer*  _spriteRenderer;
+	unsigned         _id;
+
+	EntityRef        _root;
+	Box2             _bounds;
+	Scalar           _scale;
+	unsigned         _tileSize;
+	RenderFunction   _renderFunction;
+
+	bool             _valid;
+	bool             _tilesDirty;
+	TileList         _tiles;
+	unsigned         _rebuildCount;
+
+	RenderPass::DrawStates _states;
+};
+
+
+}
+
+
+#endif
@@ -54,6 +54,7 @@ namespace lair
 
 class OrthographicCamera;
 class Texture;
+class ThreadPool;
 
 class _Entity;
 class EntityManager;
@@ -77,7 +78,7 @@ public:
 	Manager* manager();
 
 	inline TextureSetCSP textureSet() const { return _textureSet; }
-	inline void setTextureSet(TextureSetCSP textureSet) { _textureSet = textureSet; }
+	void setTextureSet(TextureSetCSP textureSet);
 	void setTextureSet(const TextureSet& textureSet);
 
 	TextureAspectSP texture() const;
@@ -112,6 +113,9 @@ public:
 
 	Box2 _texCoords() const;
 
+	/// The texture set binding the atlas page of the texture, if it is packed.
+	TextureSetCSP _atlasTextureSet(const Texture* texColor);
+
 	static bool _renderCompare(SpriteComponent* c0, SpriteComponent* c1);
 
 protected:
@@ -122,6 +126,9 @@ protected:
 	unsigned        _tileIndex;
 	Box2            _view;
 	BlendingMode    _blendingMode;
+
+	TextureSetCSP   _atlasSource;
+	TextureSetCSP   _atlasSet;
 };
 
 
@@ -148,16 +155,55 @@ public:
 	LoaderManager* loader();
 	SpriteRenderer* spriteRenderer();
 
+	/**
+	 * \brief Use pool to generate sprite vertices in parallel.
+	 *
+	 * nullptr (the default) renders everything in the calling thread.
+	 */
+	inline void setThreadPool(ThreadPool* pool) { _threadPool = pool; }
+	inline ThreadPool* threadPool() const { return _threadPool; }
+
 protected:
-	void _render(EntityRef entity, float interp, const OrthographicCamera& camera);
+	struct _RenderItem {
+		SpriteComponent* sprite;
+		TextureSetCSP    textureSet;
+		const Texture*   texColor;
+		Matrix4          transform;
+		Box2             coords;
+		Box2             texCoords;
+		Vector4i         tileInfo;
+		float            depth;
+		bool             visible;
+	};
+
+	/// Consecutive visible items of a chunk that can share a draw call.
+	struct _Batch {
+		unsigned item;
+		unsigned first;
+		unsigned count;
+	};
+
+	struct _Chunk {
+		unsigned            visibleCount;
+		unsigned            firstSprite;
+		std::vector<_Batch> batches;
+	};
+
+	void _gather(EntityRef entity);
+	void _computeItem(_RenderItem& item, float interp, const OrthographicCamera& camera) const;
+	bool _canMerge(const _RenderItem& item0, const _RenderItem& item1) const;
 
 protected:
 	AssetManager*    _assets;
 	LoaderManager*   _loader;
 	SpriteRenderer*  _spriteRenderer;
 	RenderPass*      _renderPass;
+	ThreadPool*      _threadPool;
 
 	RenderPass::DrawStates _states;
+
+	std::vector<_RenderItem> _renderItems;
+	std::vector<_Chunk>      _chunks;
 };
 
 
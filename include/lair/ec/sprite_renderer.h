@@ -23,6 +23,8 @@
 #define _LAIR_EC_SPRITE_RENDERER_H
 
 #include <list>
+#include <memory>
+#include <vector>
 
 #include <lair/core/lair.h>
 
@@ -56,16 +58,82 @@ struct SpriteVertex {
 	Vector2 texCoord;
 };
 
+enum SpriteInstanceAttrib {
+	IxCorner,
+	IxTransform,
+	IxOffset,
+	IxCoords,
+	IxTexCoords,
+	IxColor
+};
+
+/**
+ * \brief Per-sprite data used in instanced mode.
+ *
+ * Each instance stretches a static unit quad to coords, then applies the 2D
+ * affine transform in the vertex shader.
+ */
+struct SpriteInstance {
+	Vector4 transform; // 2x2 linear part, column-major
+	Vector4 offset;    // Translation (x, y, z), w is unused
+	Vector4 coords;    // Local box (min, max)
+	Vector4 texCoords; // Texture box (min, max)
+	Vector4 color;
+};
+
+/**
+ * \brief Room for sprites reserved by SpriteRenderer::reserveSprites().
+ *
+ * Pointers are null on overflow, and only one of vertices / instances is set
+ * depending on the mode.
+ */
+struct SpriteRange {
+	SpriteVertex*   vertices;
+	unsigned*       indices;
+	SpriteInstance* instances;
+	unsigned        firstVertex;
+	unsigned        firstSprite; // spriteIndex() of the first sprite.
+	unsigned        count;
+};
+
 extern const TextureUnit* TexColor;
 
-struct SpriteShaderParams {
-	SpriteShaderParams(const Matrix4& viewMatrix = Matrix4::Identity(),
-	                   int texUnit = 0, const Vector4i& tileInfo = Vector4i(1, 1, 65536, 65536));
+/// Uniform block binding points used by sprite shaders.
+enum SpriteUniformBlock {
+	UbView,
+	UbSprite
+};
+
+/// Per-view data, std140 layout of the ViewBlock uniform block.
+struct SpriteViewBlock {
+	Matrix4 viewMatrix;
+};
 
-	ShaderParameter params[4];
-	Matrix4         viewMatrix;
-	int             texUnit;
-	Vector4         tileInfo;
+/// Per-material data, std140 layout of the SpriteBlock uniform block.
+struct SpriteMaterialBlock {
+	Matrix4 modelMatrix;
+	Vector4 tileInfo;
+};
+
+class SpriteShader;
+
+/**
+ * \brief Parameters of a sprite draw call.
+ *
+ * Shaders declaring the ViewBlock and SpriteBlock uniform blocks get ranges of
+ * the per-frame uniform buffer. Shaders using plain uniforms get the values
+ * stored here.
+ */
+struct SpriteShaderParams {
+	const SpriteShader* shader;
+	ShaderParameter     params[6];
+	UniformBufferRange  viewBlock;
+	UniformBufferRange  materialBlock;
+	Matrix4             viewMatrix;
+	Matrix4             modelMatrix;
+	Matrix4             modelViewMatrix;
+	int                 texUnit;
+	Vector4             tileInfo;
 };
 
 class SpriteShader {
@@ -77,12 +145,17 @@ public:
 
 	ProgramObject* get();
 
+	inline bool useViewBlock()     const { return viewBlockIndex     != gl::INVALID_INDEX; }
+	inline bool useMaterialBlock() const { return materialBlockIndex != gl::INVALID_INDEX; }
+
 public:
 	ShaderAspectSP shader;
 	bool           finalized;
 	GLint          viewMatrixLoc;
 	GLint          textureLoc;
 	GLint          tileInfoLoc;
+	GLuint         viewBlockIndex;
+	GLuint         materialBlockIndex;
 };
 
 typedef std::shared_ptr<SpriteShader> SpriteShaderSP;
@@ -104,8 +177,20 @@ inline Box2 boxView(const Box2& box, const Box2& view) {
 	            box.min() + view.max().cwiseProduct(sizes));
 }
 
+/// Returns the 2D bounding box of box transformed by trans (z is ignored).
+inline Box2 transformedBox(const Matrix4& trans, const Box2& box) {
+	Vector2 center = trans.topLeftCorner<2, 2>() * box.center()
+	               + trans.block<2, 1>(0, 3);
+	Vector2 half   = trans.topLeftCorner<2, 2>().cwiseAbs() * (box.sizes() / 2);
+	return Box2(center - half, center + half);
+}
+
 
 class SpriteRenderer {
+public:
+	/// Number of frames worth of streaming buffers, see BufferObject.
+	static constexpr unsigned STREAM_SEGMENT_COUNT = 3;
+
 public:
 	SpriteRenderer(LoaderManager* manager,
 	               Renderer* renderer,
@@ -118,8 +203,12 @@ public:
 	SpriteRenderer& operator=(const SpriteRenderer&) = delete;
 	SpriteRenderer& operator=(SpriteRenderer&&)      = delete;
 
-	unsigned vertexCount() const;
-	unsigned indexCount()  const;
+	unsigned vertexCount()   const;
+	unsigned indexCount()    const;
+	unsigned instanceCount() const;
+
+	/// Number of bytes streamed to the GPU by the last beginRender() / endRender().
+	Size streamedBytes() const;
 
 	SpriteShaderSP   shader();
 	VertexAttribSet* attribSet();
@@ -127,15 +216,63 @@ public:
 	BufferObject*    vertexBuffer();
 	BufferObject*    indexBuffer();
 
+	/**
+	 * \brief Enable or disable instanced mode.
+	 *
+	 * In instanced mode, addSprite() writes a single SpriteInstance record
+	 * instead of 4 vertices and 6 indices. Shapes are not affected. Must not
+	 * be called between beginRender() and endRender().
+	 */
+	void setInstanced(bool instanced);
+	inline bool isInstanced() const { return _instanced; }
+
+	/// The shader / vertex array used to render sprites in the current mode.
+	SpriteShaderSP spriteShader();
+	VertexArray*   spriteVertexArray();
+
+	/// Index of the next sprite, to be passed to addSpriteDrawCall().
+	unsigned spriteIndex() const;
+
 	void beginRender();
 	bool endRender();
 
 	void addVertex(const Vector4& pos, const Vector4& color, const Vector2& texCoord);
 	void addVertex(const Vector3& pos, const Vector4& color, const Vector2& texCoord);
 	void addIndex(unsigned index);
+	void addVertices(const SpriteVertex* vertices, unsigned count);
+	void addIndices(const unsigned* indices, unsigned count);
 	void addSprite(const Matrix4& trans, const Box2& coords,
 	               const Vector4& color, const Box2& texCoords);
 
+	/**
+	 * \brief Reserve room for count sprites in the streamed buffers.
+	 *
+	 * The sprites can then be written with fillSprite(), from any thread,
+	 * until endRender().
+	 */
+	SpriteRange reserveSprites(unsigned count);
+	/// Write the sprite i of range. Thread-safe for different sprites.
+	static void fillSprite(const SpriteRange& range, unsigned i, const Matrix4& trans,
+	                       const Box2& coords, const Vector4& color, const Box2& texCoords);
+	/// Add a sprite with coordinates already in the space of the view matrix.
+	/// `linearColor` must be in linear space.
+	void addSprite(const Box2& coords, const Vector4& linearColor,
+	               const Box2& texCoords);
+
+	/**
+	 * \brief Add a draw call for the sprites added since firstSprite.
+	 *
+	 * The shader and vertices of states are overridden to match the current
+	 * mode. Does nothing if no sprite has been added.
+	 */
+	void addSpriteDrawCall(RenderPass* pass, const RenderPass::DrawStates& states,
+	                       const ShaderParameter* params, float depth,
+	                       unsigned firstSprite);
+	/// Add a draw call for count sprites of range, starting at first.
+	void addSpriteDrawCall(RenderPass* pass, const RenderPass::DrawStates& states,
+	                       const ShaderParameter* params, float depth,
+	                       const SpriteRange& range, unsigned first, unsigned count);
+
 	void addShape(const Matrix4& trans, const Sphere2& sphere, const Vector4& color);
 	void addShape(const Matrix4& trans, const AlignedBox2& box, const Vector4& color);
 	void addShape(const Matrix4& trans, const OrientedBox2& box, const Vector4& color);
@@ -144,8 +281,19 @@ public:
 	SpriteShaderSP loadShader(const Path& logicPath);
 	void finalizeShaders();
 
+
+	/**
+	 * \brief Return shader parameters valid until the next beginRender().
+	 *
+	 * Parameters are allocated in a per-frame arena and their uniform blocks
+	 * are written in a streamed uniform buffer. Calls with the same view
+	 * share the same ViewBlock range, so it is bound once per pass.
+	 */
 	const ShaderParameter* addShaderParameters(
 	        const SpriteShaderSP shader, const Matrix4& viewTransform, int texUnit, const Vector4i& tileInfo);
+	const ShaderParameter* addShaderParameters(
+	        const SpriteShaderSP shader, const Matrix4& viewTransform, const Matrix4& modelTransform,
+	        int texUnit, const Vector4i& tileInfo);
 
 	TextureAspectSP createTexture(AssetSP asset);
 	TextureAspectSP defaultTexture() const;
@@ -160,9 +308,23 @@ public:
 	Renderer* renderer();
 
 protected:
-	typedef std::list<SpriteShaderParams> ShaderParamList;
 	typedef std::list<SpriteShaderSP> ShaderList;
 
+	/// Chunked so that pointers stay valid, kept allocated between frames.
+	typedef std::unique_ptr<SpriteShaderParams[]> ShaderParamChunk;
+	typedef std::vector<ShaderParamChunk>         ShaderParamChunkList;
+
+	enum {
+		SHADER_PARAM_CHUNK_SIZE = 256,
+		SHADER_PARAM_CACHE_SIZE = 64
+	};
+
+protected:
+	SpriteShaderSP _loadShader(const Path& logicPath, VertexAttribSet* attribSet);
+
+	SpriteShaderParams* _allocShaderParams();
+	UniformBufferRange _writeUniformBlock(const void* data, Size size);
+
 protected:
 	LoaderManager*   _loader;
 	Renderer*        _renderer;
@@ -177,7 +339,25 @@ protected:
 	Size             _indexBufferSize;
 	BufferObject     _vertexBuffer;
 	BufferObject     _indexBuffer;
-	ShaderParamList  _shaderParams;
+
+	Size                 _uniformBufferSize;
+	Size                 _uniformAlignment;
+	BufferObject         _uniformBuffer;
+	ShaderParamChunkList _shaderParamChunks;
+	unsigned             _shaderParamCount;
+	SpriteShaderParams*  _lastShaderParams;
+	SpriteShaderParams*  _shaderParamCache[SHADER_PARAM_CACHE_SIZE];
+	UniformBufferRange   _lastViewBlock;
+	Matrix4              _lastViewMatrix;
+
+	bool             _instanced;
+	VertexAttribSet  _instanceAttribSet;
+	VertexArraySP    _instanceArray;
+	SpriteShaderSP   _instancedShader;
+	Size             _instanceBufferSize;
+	BufferObject     _instanceBuffer;
+	BufferObject     _quadBuffer;
+	bool             _quadBufferReady;
 
 	SamplerSP        _defaultSampler;
 	TextureSetCSP    _defaultTextureSet;
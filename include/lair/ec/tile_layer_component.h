@@ -87,8 +87,28 @@ public:
 	inline BlendingMode blendingMode() const { return _blendingMode; }
 	inline void setBlendingMode(BlendingMode bm) { _blendingMode = bm; }
 
+	/// Request the chunk containing the tile (x, y) to be rebuilt. Must be
+	/// called when the tiles of the layer are modified.
+	void setTileDirty(unsigned x, unsigned y);
+
 	static const PropertyList& properties();
 
+public:
+	/// Size of the chunks in tiles.
+	static constexpr unsigned CHUNK_SIZE = 32;
+
+	/// A part of the layer with its own buffers, culled and rebuilt
+	/// independently.
+	struct Chunk {
+		Box2i    tiles;       // Tiles covered, max excluded
+		Box2     box;         // Bounds in local space
+		bool     dirty;
+		unsigned indexCount;
+		std::shared_ptr<VertexArray>  vertexArray;
+		std::unique_ptr<BufferObject> vBuffer;
+		std::unique_ptr<BufferObject> iBuffer;
+	};
+	typedef std::vector<Chunk> ChunkVector;
 
 protected:
 	TileMapAspectSP _tileMap;
@@ -97,11 +117,9 @@ protected:
 	BlendingMode    _blendingMode;
 
 public:
-	bool         _bufferDirty;
-	unsigned     _vertexCount;
-	std::shared_ptr<VertexArray>  _vertexArray;
-	std::unique_ptr<BufferObject> _vBuffer;
-	std::unique_ptr<BufferObject> _iBuffer;
+	bool        _bufferDirty;
+	Vector2i    _chunkCount;
+	ChunkVector _chunks;
 };
 
 
@@ -128,9 +146,11 @@ public:
 	LoaderManager* loader();
 
 protected:
-	unsigned _fillBuffer(BufferObject& vBuffer, BufferObject& iBuffer,
-	                     const TileMap& tileMap, unsigned layerIndex,
-	                     const Matrix4& wt) const;
+	typedef TileLayerComponent::Chunk Chunk;
+
+protected:
+	void _setupChunks(TileLayerComponent& comp, const TileLayer& layer);
+	unsigned _fillChunk(Chunk& chunk, const TileMap& tileMap, const TileLayer& layer) const;
 	void _render(EntityRef entity, float interp, const OrthographicCamera& camera);
 
 protected:
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_GEOMETRY_BROADPHASE_H
+#define _LAIR_GEOMETRY_BROADPHASE_H
+
+
+#include <functional>
+
+#include <lair/core/lair.h>
+
+#include <lair/geometry/aligned_box.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief Runtime interface over the spatial structures (Octree, HashGrid,
+ * SweepAndPrune) so the implementation can be chosen per user.
+ *
+ * Callbacks are wrapped in a std::reference_wrapper before being passed to
+ * the implementation, so queries never allocate.
+ */
+template<typename _Object>
+class Broadphase {
+public:
+	typedef _Object Object;
+
+	typedef typename Object::Scalar Scalar;
+
+	enum {
+		Dim = Object::Dim,
+	};
+
+	typedef Eigen::Matrix<Scalar, Dim, 1> Vector;
+	typedef AlignedBox<Scalar, Dim>       Box;
+
+	typedef std::function<bool(Object&)>          Callback;
+	typedef std::function<bool(Object&, Scalar&)> DistanceCallback;
+	typedef std::function<bool(const Object&)>    Predicate;
+
+public:
+	Broadphase() = default;
+	Broadphase(const Broadphase& ) = delete;
+	Broadphase(      Broadphase&&) = delete;
+	virtual ~Broadphase() = default;
+
+	Broadphase& operator=(const Broadphase& ) = delete;
+	Broadphase& operator=(      Broadphase&&) = delete;
+
+	virtual Object* insert(const Object& object) = 0;
+	virtual void remove(Object* object) = 0;
+	/// Must be called when the bounding box of `object` changed. Returns true
+	/// if the object was refit in place.
+	virtual bool update(Object* object) = 0;
+
+	template<typename P>
+	inline void filterIf(const P& predicate) {
+		_filterIf(Predicate(std::cref(predicate)));
+	}
+
+	virtual void reset(const Box& box) = 0;
+	virtual void clear() = 0;
+
+	template<typename C>
+	inline bool hitTest(const Box& box, const C& callback) const {
+		return _hitTest(box, Callback(std::cref(callback)));
+	}
+
+	/// See Octree::raycast(). Only the quadtrees visit items front to back;
+	/// other implementations require a finite `maxT`.
+	template<typename C>
+	inline bool raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	                    const Vector& extent, const C& callback) const {
+		return _raycast(origin, direction, maxT, extent,
+		                DistanceCallback(std::cref(callback)));
+	}
+
+	/// See Octree::nearest(). Only the quadtrees visit items nearest first;
+	/// other implementations require a finite `maxDist`.
+	template<typename C>
+	inline bool nearest(const Vector& p, Scalar maxDist, const C& callback) const {
+		return _nearest(p, maxDist, DistanceCallback(std::cref(callback)));
+	}
+
+protected:
+	virtual void _filterIf(const Predicate& predicate) = 0;
+	virtual bool _hitTest(const Box& box, const Callback& callback) const = 0;
+	virtual bool _raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	                      const Vector& extent, const DistanceCallback& callback) const = 0;
+	virtual bool _nearest(const Vector& p, Scalar maxDist,
+	                      const DistanceCallback& callback) const = 0;
+};
+
+
+template<typename _Impl>
+class BroadphaseAdapter : public Broadphase<typename _Impl::Object> {
+public:
+	typedef _Impl                             Impl;
+	typedef Broadphase<typename Impl::Object> Base;
+
+	typedef typename Base::Object           Object;
+	typedef typename Base::Scalar           Scalar;
+	typedef typename Base::Vector           Vector;
+	typedef typename Base::Box              Box;
+	typedef typename Base::Callback         Callback;
+	typedef typename Base::DistanceCallback DistanceCallback;
+	typedef typename Base::Predicate        Predicate;
+
+public:
+	template<typename... Args>
+	inline BroadphaseAdapter(Args&&... args)
+	    : _impl(std::forward<Args>(args)...)
+	{}
+
+	virtual ~BroadphaseAdapter() = default;
+
+	inline const Impl& impl() const { return _impl; }
+	inline Impl& impl() { return _impl; }
+
+	virtual Object* insert(const Object& object) override {
+		return _impl.insert(object);
+	}
+
+	virtual void remove(Object* object) override {
+		_impl.remove(object);
+	}
+
+	virtual bool update(Object* object) override {
+		return _impl.update(object);
+	}
+
+	virtual void reset(const Box& box) override {
+		_impl.reset(box);
+	}
+
+	virtual void clear() override {
+		_impl.clear();
+	}
+
+protected:
+	virtual void _filterIf(const Predicate& predicate) override {
+		_impl.filterIf(predicate);
+	}
+
+	virtual bool _hitTest(const Box& box, const Callback& callback) const override {
+		return _impl.hitTest(box, callback);
+	}
+
+	virtual bool _raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	                      const Vector& extent, const DistanceCallback& callback) const override {
+		return _impl.raycast(origin, direction, maxT, extent, callback);
+	}
+
+	virtual bool _nearest(const Vector& p, Scalar maxDist,
+	                      const DistanceCallback& callback) const override {
+		return _impl.nearest(p, maxDist, callback);
+	}
+
+protected:
+	Impl _impl;
+};
+
+
+}
+
+
+#endif
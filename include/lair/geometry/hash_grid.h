@@ -0,0 +1,384 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_GEOMETRY_HASH_GRID_H
+#define _LAIR_GEOMETRY_HASH_GRID_H
+
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <lair/core/lair.h>
+#include <lair/core/memory_pool.h>
+
+#include <lair/geometry/aligned_box.h>
+#include <lair/geometry/intersection.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief A uniform grid hashed into a fixed number of buckets.
+ *
+ * Objects are inserted in every cell their bounding box overlaps. Objects
+ * that cover more than `maxCellsPerItem` cells are kept aside and tested
+ * against every query. Works best when most objects have a size similar to
+ * the cell size.
+ *
+ * Provides the same interface as Octree.
+ */
+template<typename _Object>
+class HashGrid {
+public:
+	typedef _Object          Object;
+	typedef HashGrid<Object> Self;
+
+	typedef typename Object::Scalar Scalar;
+
+	enum {
+		Dim = Object::Dim,
+	};
+
+	static_assert(Dim <= 3, "HashGrid only supports up to 3 dimensions");
+
+	typedef Eigen::Matrix<Scalar, Dim, 1> Vector;
+	typedef Eigen::Matrix<int,    Dim, 1> Index;
+	typedef AlignedBox   <Scalar, Dim>    Box;
+
+public:
+	inline HashGrid(Scalar cellSize = 64, unsigned nBuckets = 4096,
+	                unsigned maxCellsPerItem = 16, size_t blockSize = 1024)
+	    : _items(blockSize)
+	    , _buckets(nBuckets)
+	    , _cellSize(cellSize)
+	    , _invCellSize(1 / cellSize)
+	    , _maxCellsPerItem(maxCellsPerItem)
+	{
+		lairAssert(cellSize > 0);
+		lairAssert(nBuckets && (nBuckets & (nBuckets - 1)) == 0);
+	}
+
+	HashGrid(const HashGrid& ) = delete;
+	HashGrid(      HashGrid&&) = delete;
+
+	inline ~HashGrid() {
+		clear();
+	}
+
+	HashGrid& operator=(const HashGrid& ) = delete;
+	HashGrid& operator=(      HashGrid&&) = delete;
+
+	inline Scalar cellSize() const {
+		return _cellSize;
+	}
+
+	inline unsigned nBuckets() const {
+		return _buckets.size();
+	}
+
+	inline unsigned size() const {
+		return _all.size();
+	}
+
+	template<typename... Args>
+	inline Object* insert(Args... args) {
+		Item* item = _items.construct(std::forward<Args>(args)...);
+		item->bounds = item->boundingBox();
+		item->index  = _all.size();
+		_all.push_back(item);
+
+		_link(item);
+
+		return item;
+	}
+
+	void remove(Object* object) {
+		Item* item = static_cast<Item*>(object);
+		lairAssert(item->index < _all.size() && _all[item->index] == item);
+
+		_unlink(item);
+
+		_all.back()->index = item->index;
+		_all[item->index]  = _all.back();
+		_all.pop_back();
+
+		_items.destroy(item);
+	}
+
+	/// Must be called when the bounding box of `object` changed. If the
+	/// object still covers the same cells, only its box is updated. Returns
+	/// true if the object kept its cells.
+	bool update(Object* object) {
+		Item* item = static_cast<Item*>(object);
+		Box   box  = item->boundingBox();
+
+		Index minCell = _cell(box.min());
+		Index maxCell = _cell(box.max());
+		if(minCell != _cell(item->bounds.min()) || maxCell != _cell(item->bounds.max())) {
+			_unlink(item);
+			item->bounds = box;
+			_link(item);
+			return false;
+		}
+
+		item->bounds = box;
+		if(_nCells(minCell, maxCell) > _maxCellsPerItem) {
+			_find(_large, item)->box = box;
+		}
+		else {
+			_forEachCell(minCell, maxCell, [this, item, &box](const Index& cell) {
+				Bucket& bucket = _buckets[_hash(cell)];
+				auto it = _find(bucket, item);
+				if(it != bucket.end())
+					it->box = box;
+				return false;
+			});
+		}
+
+		return true;
+	}
+
+	template<typename Predicate>
+	void filterIf(const Predicate& predicate) {
+		// remove() moves the last item in place of the removed one, so
+		// iterate backward to visit everything exactly once.
+		for(unsigned i = _all.size(); i--; ) {
+			if(predicate(*_all[i]))
+				remove(_all[i]);
+		}
+	}
+
+	void reset(const Box& /*box*/) {
+		clear();
+	}
+
+	void clear() {
+		for(Bucket& bucket: _buckets)
+			bucket.clear();
+		_large.clear();
+
+		for(Item* item: _all)
+			_items.destroy(item);
+		_all.clear();
+	}
+
+	template<typename Callback>
+	bool hitTest(const Box& box, const Callback& callback = Callback()) const {
+		for(const Entry& entry: _large) {
+			if(box.intersects(entry.box)
+			&& callback(*entry.item))
+				return true;
+		}
+
+		// An object overlapping the query is reported only from the first
+		// cell of the intersection, so objects spanning several cells are
+		// never reported twice.
+		Index qMin = _cell(box.min());
+		Index qMax = _cell(box.max());
+		if(_nCells(qMin, qMax) > _buckets.size()) {
+			// The query covers more cells than there are buckets: walk the
+			// buckets instead.
+			for(unsigned bi = 0; bi < _buckets.size(); ++bi) {
+				for(const Entry& entry: _buckets[bi]) {
+					if(box.intersects(entry.box)
+					&& _hash(entry.minCell.cwiseMax(qMin)) == bi
+					&& callback(*entry.item))
+						return true;
+				}
+			}
+			return false;
+		}
+
+		return _forEachCell(qMin, qMax, [this, &box, &qMin, &callback](const Index& cell) {
+			for(const Entry& entry: _buckets[_hash(cell)]) {
+				if(box.intersects(entry.box)
+				&& entry.minCell.cwiseMax(qMin) == cell
+				&& callback(*entry.item))
+					return true;
+			}
+			return false;
+		});
+	}
+
+	/// Same as Octree::raycast(), but items are not visited in order. `maxT`
+	/// must be finite.
+	template<typename Callback>
+	bool raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	             const Vector& extent, const Callback& callback) const {
+		lairAssert(std::isfinite(maxT));
+		Vector end = origin + maxT * direction;
+		Box box(origin.cwiseMin(end) - extent, origin.cwiseMax(end) + extent);
+		return hitTest(box, [&](Object& object) {
+			const Box& objBox = object.boundingBox();
+			return lair::raycast(Box(objBox.min() - extent, objBox.max() + extent),
+			                     origin, direction, maxT)
+			    && callback(object, maxT);
+		});
+	}
+
+	/// Same as Octree::nearest(), but items are not visited in order.
+	/// `maxDist` must be finite.
+	template<typename Callback>
+	bool nearest(const Vector& p, Scalar maxDist, const Callback& callback) const {
+		lairAssert(std::isfinite(maxDist));
+		Vector margin = Vector::Constant(maxDist);
+		return hitTest(Box(p - margin, p + margin), [&](Object& object) {
+			return squaredDistance(object.boundingBox(), p) <= maxDist * maxDist
+			    && callback(object, maxDist);
+		});
+	}
+
+protected:
+	class Item : public Object {
+	public:
+		template<typename... Args>
+		inline Item(Args... args)
+		    : Object(std::forward<Args>(args)...)
+		    , index(0)
+		{}
+
+		Box      bounds;
+		unsigned index;
+	};
+
+	struct Entry {
+		Box   box;
+		Index minCell;
+		Item* item;
+	};
+
+	typedef std::vector<Entry> Bucket;
+	typedef std::vector<Bucket> BucketVector;
+	typedef std::vector<Item*> ItemVector;
+
+	typedef MemoryPool<Item> ObjectPool;
+
+protected:
+	void _link(Item* item) {
+		Entry entry;
+		entry.box     = item->bounds;
+		entry.minCell = _cell(entry.box.min());
+		entry.item    = item;
+
+		Index maxCell = _cell(entry.box.max());
+		Size  nCells  = _nCells(entry.minCell, maxCell);
+		if(nCells > _maxCellsPerItem) {
+			_large.push_back(entry);
+		}
+		else {
+			_forEachCell(entry.minCell, maxCell, [this, &entry, nCells](const Index& cell) {
+				Bucket& bucket = _buckets[_hash(cell)];
+				// Different cells may share a bucket: store each item only once.
+				if(nCells == 1 || _find(bucket, entry.item) == bucket.end())
+					bucket.push_back(entry);
+				return false;
+			});
+		}
+	}
+
+	void _unlink(Item* item) {
+		Index minCell = _cell(item->bounds.min());
+		Index maxCell = _cell(item->bounds.max());
+		if(_nCells(minCell, maxCell) > _maxCellsPerItem) {
+			_erase(_large, item);
+		}
+		else {
+			_forEachCell(minCell, maxCell, [this, item](const Index& cell) {
+				_erase(_buckets[_hash(cell)], item);
+				return false;
+			});
+		}
+	}
+
+	inline Index _cell(const Vector& p) const {
+		Index cell;
+		for(unsigned axis = 0; axis < Dim; ++axis)
+			cell(axis) = int(std::floor(p(axis) * _invCellSize));
+		return cell;
+	}
+
+	inline unsigned _hash(const Index& cell) const {
+		static const unsigned primes[3] = { 73856093u, 19349663u, 83492791u };
+		unsigned h = 0;
+		for(unsigned axis = 0; axis < Dim; ++axis)
+			h ^= unsigned(cell(axis)) * primes[axis];
+		return h & (_buckets.size() - 1);
+	}
+
+	static inline Size _nCells(const Index& min, const Index& max) {
+		Size count = 1;
+		for(unsigned axis = 0; axis < Dim; ++axis)
+			count *= Size(max(axis) - min(axis) + 1);
+		return count;
+	}
+
+	/// Call `f` for each cell in [min, max] until it returns true.
+	template<typename F>
+	static inline bool _forEachCell(const Index& min, const Index& max, const F& f) {
+		Index cell = min;
+		while(true) {
+			if(f(cell))
+				return true;
+
+			unsigned axis = 0;
+			for(; axis < Dim; ++axis) {
+				if(cell(axis) < max(axis)) {
+					cell(axis) += 1;
+					break;
+				}
+				cell(axis) = min(axis);
+			}
+			if(axis == Dim)
+				return false;
+		}
+	}
+
+	static inline typename Bucket::iterator _find(Bucket& bucket, const Item* item) {
+		return std::find_if(bucket.begin(), bucket.end(),
+		                    [item](const Entry& e) { return e.item == item; });
+	}
+
+	static inline void _erase(Bucket& bucket, const Item* item) {
+		auto it = _find(bucket, item);
+		if(it != bucket.end()) {
+			*it = bucket.back();
+			bucket.pop_back();
+		}
+	}
+
+protected:
+	ObjectPool   _items;
+	BucketVector _buckets;
+	Bucket       _large;
+	ItemVector   _all;
+	Scalar       _cellSize;
+	Scalar       _invCellSize;
+	unsigned     _maxCellsPerItem;
+};
+
+
+}
+
+
+#endif
@@ -23,6 +23,8 @@
 #define LAIR_GEOMETRY_INTERSECTION_H
 
 
+#include <vector>
+
 #include <lair/core/lair.h>
 
 #include <lair/geometry/sphere.h>
@@ -110,6 +112,101 @@ float distance(const AlignedBox2& box0, const OrientedBox2& box1);
 float distance(const OrientedBox2& box0, const OrientedBox2& box1);
 
 
+// Ray casts
+//
+// Intersect the ray `origin + t * direction`, with t in [0, maxT], with an
+// object. On success, `t` is set to the smallest such t inside the object,
+// which is 0 if `origin` is inside.
+
+template<typename Scalar, int Dim>
+bool raycast(const Sphere<Scalar, Dim>& sphere,
+             const Eigen::Matrix<Scalar, Dim, 1>& origin,
+             const Eigen::Matrix<Scalar, Dim, 1>& direction,
+             Scalar maxT, Scalar* t = nullptr);
+
+template<typename Scalar, int Dim>
+bool raycast(const AlignedBox<Scalar, Dim>& box,
+             const Eigen::Matrix<Scalar, Dim, 1>& origin,
+             const Eigen::Matrix<Scalar, Dim, 1>& direction,
+             Scalar maxT, Scalar* t = nullptr);
+
+template<typename Scalar, int Dim>
+bool raycast(const OrientedBox<Scalar, Dim>& box,
+             const Eigen::Matrix<Scalar, Dim, 1>& origin,
+             const Eigen::Matrix<Scalar, Dim, 1>& direction,
+             Scalar maxT, Scalar* t = nullptr);
+
+
+// Batch intersections
+
+/// Aligned boxes stored as a structure of arrays, for batch tests.
+class AlignedBox2Batch {
+public:
+	inline unsigned size() const { return minX.size(); }
+
+	inline void clear() {
+		minX.clear();
+		minY.clear();
+		maxX.clear();
+		maxY.clear();
+	}
+
+	inline void push_back(const AlignedBox2& box) {
+		minX.push_back(box.min()(0));
+		minY.push_back(box.min()(1));
+		maxX.push_back(box.max()(0));
+		maxY.push_back(box.max()(1));
+	}
+
+public:
+	std::vector<float> minX;
+	std::vector<float> minY;
+	std::vector<float> maxX;
+	std::vector<float> maxY;
+};
+
+/// Spheres stored as a structure of arrays, for batch tests.
+class Sphere2Batch {
+public:
+	inline unsigned size() const { return x.size(); }
+
+	inline void clear() {
+		x.clear();
+		y.clear();
+		radius.clear();
+	}
+
+	inline void push_back(const Sphere2& sphere) {
+		x.push_back(sphere.center()(0));
+		y.push_back(sphere.center()(1));
+		radius.push_back(sphere.radius());
+	}
+
+public:
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> radius;
+};
+
+// Test one shape against a whole batch and write the indices of the
+// intersecting elements in `hits`, which must have room for batch.size()
+// values. Return the number of hits. Results are exactly the same as the
+// non-batch intersect() functions.
+//
+// These use SSE2 (or AVX2 if enabled at compile time) when available. The
+// *Scalar versions process one element at a time.
+
+unsigned intersect(const AlignedBox2& box, const AlignedBox2Batch& batch,
+                   unsigned* hits);
+unsigned intersect(const Sphere2& sphere, const Sphere2Batch& batch,
+                   unsigned* hits);
+
+unsigned intersectScalar(const AlignedBox2& box, const AlignedBox2Batch& batch,
+                         unsigned* hits, unsigned begin = 0);
+unsigned intersectScalar(const Sphere2& sphere, const Sphere2Batch& batch,
+                         unsigned* hits, unsigned begin = 0);
+
+
 // ////////////////////////////////////////////////////////////////////////////
 
 
@@ -248,6 +345,80 @@ inline Scalar distance(const Sphere<Scalar, Dim>& sphere,
 }
 
 
+template<typename Scalar, int Dim>
+inline bool raycast(const Sphere<Scalar, Dim>& sphere,
+                    const Eigen::Matrix<Scalar, Dim, 1>& origin,
+                    const Eigen::Matrix<Scalar, Dim, 1>& direction,
+                    Scalar maxT, Scalar* t) {
+	Eigen::Matrix<Scalar, Dim, 1> m = origin - sphere.center();
+	Scalar c = m.squaredNorm() - sphere.radius() * sphere.radius();
+	if(c <= Scalar(0)) {
+		if(t) *t = Scalar(0);
+		return true;
+	}
+
+	Scalar a = direction.squaredNorm();
+	Scalar b = m.dot(direction);
+	if(a == Scalar(0) || b >= Scalar(0))
+		return false;
+
+	Scalar disc = b * b - a * c;
+	if(disc < Scalar(0))
+		return false;
+
+	Scalar t0 = (-b - std::sqrt(disc)) / a;
+	if(t0 > maxT)
+		return false;
+
+	if(t) *t = t0;
+	return true;
+}
+
+
+template<typename Scalar, int Dim>
+inline bool raycast(const AlignedBox<Scalar, Dim>& box,
+                    const Eigen::Matrix<Scalar, Dim, 1>& origin,
+                    const Eigen::Matrix<Scalar, Dim, 1>& direction,
+                    Scalar maxT, Scalar* t) {
+	Scalar tMin = Scalar(0);
+	Scalar tMax = maxT;
+	for(int i = 0; i < Dim; ++i) {
+		if(direction(i) == Scalar(0)) {
+			if(origin(i) < box.min()(i) || box.max()(i) < origin(i))
+				return false;
+			continue;
+		}
+
+		Scalar inv = Scalar(1) / direction(i);
+		Scalar t0  = (box.min()(i) - origin(i)) * inv;
+		Scalar t1  = (box.max()(i) - origin(i)) * inv;
+		if(t0 > t1)
+			std::swap(t0, t1);
+
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if(tMin > tMax)
+			return false;
+	}
+
+	if(t) *t = tMin;
+	return true;
+}
+
+
+template<typename Scalar, int Dim>
+inline bool raycast(const OrientedBox<Scalar, Dim>& box,
+                    const Eigen::Matrix<Scalar, Dim, 1>& origin,
+                    const Eigen::Matrix<Scalar, Dim, 1>& direction,
+                    Scalar maxT, Scalar* t) {
+	typedef Eigen::Matrix<Scalar, Dim, 1> Vector;
+	Vector o = box.basis().transpose() * (origin - box.center());
+	Vector d = box.basis().transpose() * direction;
+	return raycast(AlignedBox<Scalar, Dim>(-box.halfSize(), box.halfSize()),
+	               o, d, maxT, t);
+}
+
+
 }
 
 
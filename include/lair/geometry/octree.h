@@ -23,6 +23,8 @@
 #define _LAIR_CORE_OCTREE_H
 
 
+#include <atomic>
+#include <limits>
 #include <vector>
 
 #include <lair/core/lair.h>
@@ -68,6 +70,15 @@ protected:
 };
 
 
+/**
+ * \brief A quadtree (in 2D) or an octree (in 3D).
+ *
+ * By default, an item is stored in the deepest cell that fully contains it,
+ * so small items straddling a cell center stay high in the tree. If
+ * `looseness` is greater than 1, the tree is loose: cells bounds are
+ * enlarged by this factor and items are placed by their center and size,
+ * which puts any item at a depth that depends only on its size.
+ */
 template<typename _Object>
 class Octree {
 public:
@@ -86,16 +97,21 @@ public:
 
 public:
 	inline Octree(const Box& box, unsigned maxDepth = 8,
-	       size_t blockSize = 1024)
+	       Scalar looseness = 1, size_t blockSize = 1024)
 	    : _items(blockSize)
 	    , _cells(blockSize)
 	    , _root(_cells.construct(box.min(), box.max()))
 	    , _maxDepth(maxDepth)
-	{}
+	    , _looseness(looseness)
+	    , _nQueries(0)
+	    , _nItemsTested(0)
+	{
+		lairAssert(looseness >= 1);
+	}
 
 	inline Octree(const Vector& min, const Vector& max, unsigned maxDepth = 8,
-	       size_t blockSize = 1024)
-	    : Octree(Box(min, max), maxDepth, blockSize)
+	       Scalar looseness = 1, size_t blockSize = 1024)
+	    : Octree(Box(min, max), maxDepth, looseness, blockSize)
 	{}
 
 	Octree(const Octree& ) = delete;
@@ -113,6 +129,36 @@ public:
 		return Box(*_root);
 	}
 
+	inline Scalar looseness() const {
+		return _looseness;
+	}
+
+	inline bool isLoose() const {
+		return _looseness > 1;
+	}
+
+	/// Number of queries (hitTest(), raycast(), nearest()) since the last
+	/// resetStats().
+	inline Size nQueries() const {
+		return _nQueries.load(std::memory_order_relaxed);
+	}
+
+	/// Number of items whose bounding box was tested by queries since the
+	/// last resetStats().
+	inline Size nItemsTested() const {
+		return _nItemsTested.load(std::memory_order_relaxed);
+	}
+
+	inline double avgItemsTestedPerQuery() const {
+		Size nQueries = this->nQueries();
+		return nQueries? double(nItemsTested()) / double(nQueries): 0;
+	}
+
+	inline void resetStats() {
+		_nQueries     = 0;
+		_nItemsTested = 0;
+	}
+
 	template<typename... Args>
 	inline Object* insert(Args... args) {
 		Item* item = _items.construct(std::forward<Args>(args)...);
@@ -127,6 +173,24 @@ public:
 		_removeItem(cell, item);
 	}
 
+	/// Must be called when the bounding box of `object` changed. The object
+	/// is kept in its cell if it still fits inside, and is moved otherwise.
+	/// Returns true if the object did not move.
+	bool update(Object* object) {
+		Item* item = static_cast<Item*>(object);
+		Cell* cell = item->cell;
+		lairAssert(cell);
+
+		const Box& box = item->boundingBox();
+		if(cell == _root
+		|| (isLoose()? _looseBounds(cell).contains(box): cell->contains(box)))
+			return true;
+
+		_unlinkItem(cell, item);
+		_insert(item);
+		return false;
+	}
+
 	template<typename Predicate>
 	void filterIf(const Predicate& predicate) {
 		_filterIf(_root, predicate);
@@ -144,9 +208,39 @@ public:
 		_destroyAllSubCells(_root);
 	}
 
+	/// Queries only read the tree, so several threads may run them at once.
 	template<typename Callback>
 	bool hitTest(const Box& box, const Callback& callback = Callback()) const {
-		return _hitTest(_root, box, callback);
+		Size nTested = 0;
+		bool stopped = isLoose()? _hitTestLoose(_root, box, callback, nTested):
+		                          _hitTest     (_root, box, callback, nTested);
+		_addQueryStats(nTested);
+		return stopped;
+	}
+
+	/// Visit the items whose bounding box, enlarged by `extent` on each side,
+	/// is hit by the ray `origin + t * direction` for t in [0, maxT]. Cells
+	/// are traversed front to back. `callback(object, maxT)` returns true to
+	/// stop and may lower `maxT` (e.g. to the closest hit so far) to prune
+	/// the remaining cells.
+	template<typename Callback>
+	bool raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	             const Vector& extent, const Callback& callback) const {
+		Size nTested = 0;
+		bool stopped = _raycast(_root, origin, direction, extent, maxT, callback, nTested);
+		_addQueryStats(nTested);
+		return stopped;
+	}
+
+	/// Visit the items whose bounding box is within `maxDist` of `p`, nearest
+	/// cells first. `callback(object, maxDist)` returns true to stop and may
+	/// lower `maxDist` to prune the remaining cells.
+	template<typename Callback>
+	bool nearest(const Vector& p, Scalar maxDist, const Callback& callback) const {
+		Size nTested = 0;
+		bool stopped = _nearest(_root, p, maxDist, callback, nTested);
+		_addQueryStats(nTested);
+		return stopped;
 	}
 
 protected:
@@ -201,8 +295,17 @@ protected:
 	typedef MemoryPool<Cell> CellPool;
 
 protected:
+	inline void _addQueryStats(Size nTested) const {
+		_nQueries    .fetch_add(1,       std::memory_order_relaxed);
+		_nItemsTested.fetch_add(nTested, std::memory_order_relaxed);
+	}
 
 	void _insert(Item* item) {
+		if(isLoose()) {
+			_insertLoose(item);
+			return;
+		}
+
 		unsigned depth = _maxDepth;
 		Cell*    cell  = _root;
 
@@ -223,6 +326,59 @@ protected:
 		_appendItem(cell, item);
 	}
 
+	void _insertLoose(Item* item) {
+		Vector   center = item->boundingBox().center();
+		Vector   sizes  = item->boundingBox().sizes();
+		unsigned depth  = _maxDepth;
+		Cell*    cell   = _root;
+
+		// The loose bounds of a cell extend by (looseness - 1) / 2 times its
+		// size on each side, so an item centered in a child fits in its loose
+		// bounds if it is smaller than (looseness - 1) times the child size.
+		// Items centered outside of the root stay in the root.
+		while(depth && cell->contains(center)) {
+			Vector childSizes = cell->sizes() / 2;
+			if((sizes.array() > (_looseness - 1) * childSizes.array()).any())
+				break;
+
+			unsigned ci    = _subCellIndex(cell, center);
+			Cell*    child = _subCell(cell, ci);
+			if(!child)
+				child = _createSubCell(cell, ci);
+
+			cell   = child;
+			depth -= 1;
+		}
+
+		_appendItem(cell, item);
+	}
+
+	inline Box _looseBounds(const Cell* cell) const {
+		Vector margin = cell->sizes() * ((_looseness - 1) / 2);
+		return Box(cell->min() - margin, cell->max() + margin);
+	}
+
+
+	/// Region containing every item stored in the subtree of `cell`. In a
+	/// tight tree, items overflowing the root are pushed down along the
+	/// border cells, so these are unbounded on the root sides.
+	inline Box _subtreeBounds(const Cell* cell) const {
+		if(isLoose())
+			return _looseBounds(cell);
+
+		Box box(*cell);
+		for(unsigned axis = 0; axis < Dim; ++axis) {
+			if(cell->min()(axis) <= _root->min()(axis))
+				box.min()(axis) = -std::numeric_limits<Scalar>::infinity();
+			if(cell->max()(axis) >= _root->max()(axis))
+				box.max()(axis) =  std::numeric_limits<Scalar>::infinity();
+		}
+		return box;
+	}
+
+	static inline Box _enlarged(const Box& box, const Vector& extent) {
+		return Box(box.min() - extent, box.max() + extent);
+	}
 
 	inline unsigned _subCellIndex(const Cell* cell, const Vector& p) const {
 		unsigned q = 0;
@@ -248,7 +404,7 @@ protected:
 		if(!child) {
 			child = _cells.construct();
 			cell->_cells[i] = child;
-			Vector mid = child->center();
+			Vector mid = cell->center();
 			for(unsigned axis = 0; axis < Dim; ++axis) {
 				unsigned cmp = i & (1 << axis);
 				child->min()(axis) = cmp?       mid  (axis): cell->min()(axis);
@@ -265,6 +421,7 @@ protected:
 				_removeAllOwnItems(child);
 				_destroyAllSubCells(child);
 				_cells.destroy(child);
+				cell->_cells[ci] = nullptr;
 			}
 		}
 	}
@@ -280,7 +437,7 @@ protected:
 		item->next->prev = item;
 	}
 
-	inline void _removeItem(Cell* cell, Item* item) {
+	inline void _unlinkItem(Cell* cell, Item* item) {
 		lairAssert(item->cell == cell);
 
 		item->prev->next = item->next;
@@ -289,7 +446,10 @@ protected:
 		item->cell = nullptr;
 		item->prev = nullptr;
 		item->next = nullptr;
+	}
 
+	inline void _removeItem(Cell* cell, Item* item) {
+		_unlinkItem(cell, item);
 		_items.destroy(item);
 	}
 
@@ -317,8 +477,10 @@ protected:
 	}
 
 	template<typename Callback>
-	bool _hitTest(const Cell* cell, const Box& box, const Callback& callback = Callback()) const {
+	bool _hitTest(const Cell* cell, const Box& box, const Callback& callback,
+	              Size& nTested) const {
 		for(Item* item = cell->_sentinel->next; item != &cell->_sentinel; item = item->next) {
+			++nTested;
 			if(intersect(box, item->boundingBox())
 			&& callback(*item))
 				return true;
@@ -331,7 +493,103 @@ protected:
 		for(int ci = 0; ci < NCells; ++ci) {
 			const Cell* child = _subCell(cell, ci);
 			if(child && ((ci ^ ciMin) & mask) == 0
-			&& _hitTest(child, box, callback))
+			&& _hitTest(child, box, callback, nTested))
+				return true;
+		}
+
+		return false;
+	}
+
+	template<typename Callback>
+	bool _hitTestLoose(const Cell* cell, const Box& box, const Callback& callback,
+	                   Size& nTested) const {
+		for(Item* item = cell->_sentinel->next; item != &cell->_sentinel; item = item->next) {
+			++nTested;
+			if(intersect(box, item->boundingBox())
+			&& callback(*item))
+				return true;
+		}
+
+		for(int ci = 0; ci < NCells; ++ci) {
+			const Cell* child = _subCell(cell, ci);
+			if(child && box.intersects(_looseBounds(child))
+			&& _hitTestLoose(child, box, callback, nTested))
+				return true;
+		}
+
+		return false;
+	}
+
+	template<typename Callback>
+	bool _raycast(const Cell* cell, const Vector& origin, const Vector& direction,
+	              const Vector& extent, Scalar& maxT, const Callback& callback,
+	              Size& nTested) const {
+		for(Item* item = cell->_sentinel->next; item != &cell->_sentinel; item = item->next) {
+			++nTested;
+			if(lair::raycast(_enlarged(item->boundingBox(), extent), origin, direction, maxT)
+			&& callback(*item, maxT))
+				return true;
+		}
+
+		// Insertion sort of the children by entry distance.
+		const Cell* children[NCells];
+		Scalar      tEnter  [NCells];
+		unsigned    nChildren = 0;
+		for(int ci = 0; ci < NCells; ++ci) {
+			const Cell* child = _subCell(cell, ci);
+			Scalar t;
+			if(child && lair::raycast(_enlarged(_subtreeBounds(child), extent),
+			                          origin, direction, maxT, &t)) {
+				unsigned i = nChildren++;
+				for(; i && tEnter[i - 1] > t; --i) {
+					children[i] = children[i - 1];
+					tEnter  [i] = tEnter  [i - 1];
+				}
+				children[i] = child;
+				tEnter  [i] = t;
+			}
+		}
+
+		for(unsigned i = 0; i < nChildren && tEnter[i] <= maxT; ++i) {
+			if(_raycast(children[i], origin, direction, extent, maxT, callback, nTested))
+				return true;
+		}
+
+		return false;
+	}
+
+	template<typename Callback>
+	bool _nearest(const Cell* cell, const Vector& p, Scalar& maxDist,
+	              const Callback& callback, Size& nTested) const {
+		for(Item* item = cell->_sentinel->next; item != &cell->_sentinel; item = item->next) {
+			++nTested;
+			if(squaredDistance(item->boundingBox(), p) <= maxDist * maxDist
+			&& callback(*item, maxDist))
+				return true;
+		}
+
+		const Cell* children[NCells];
+		Scalar      sqDist  [NCells];
+		unsigned    nChildren = 0;
+		for(int ci = 0; ci < NCells; ++ci) {
+			const Cell* child = _subCell(cell, ci);
+			if(!child)
+				continue;
+
+			Scalar d = squaredDistance(_subtreeBounds(child), p);
+			if(d <= maxDist * maxDist) {
+				unsigned i = nChildren++;
+				for(; i && sqDist[i - 1] > d; --i) {
+					children[i] = children[i - 1];
+					sqDist  [i] = sqDist  [i - 1];
+				}
+				children[i] = child;
+				sqDist  [i] = d;
+			}
+		}
+
+		for(unsigned i = 0; i < nChildren && sqDist[i] <= maxDist * maxDist; ++i) {
+			if(_nearest(children[i], p, maxDist, callback, nTested))
 				return true;
 		}
 
@@ -339,10 +597,14 @@ protected:
 	}
 
 protected:
-	ObjectPool _items;
-	CellPool   _cells;
-	Cell*      _root;
-	unsigned   _maxDepth;
+	ObjectPool   _items;
+	CellPool     _cells;
+	Cell*        _root;
+	unsigned     _maxDepth;
+	Scalar       _looseness;
+
+	mutable std::atomic<Size> _nQueries;
+	mutable std::atomic<Size> _nItemsTested;
 };
 
 
@@ -23,6 +23,8 @@
 #define LAIR_GEOMETRY_SHAPE_2D_H
 
 
+#include <new>
+
 #include <lair/core/lair.h>
 
 #include <lair/ldl/ldl_parser.h>
@@ -51,34 +53,55 @@ enum Shape2DType {
 };
 
 
+/**
+ * \brief A 2D shape of any supported type.
+ *
+ * The shape is stored inline in a tagged union, so Shape2D never allocates
+ * and can be copied and moved around cheaply.
+ */
 class Shape2D {
 public:
 	inline Shape2D()
 	    : _type(SHAPE_NONE)
-	    , _shape(nullptr)
 	{}
 
 	inline Shape2D(const Sphere2& sphere)
-	    : _type(SHAPE_SPHERE)
-	    , _shape(new Sphere2(sphere))
-	{}
+	    : _type(SHAPE_SPHERE) {
+		new(&_storage.sphere) Sphere2(sphere);
+	}
 
 	inline Shape2D(const AlignedBox2& box)
-	    : _type(SHAPE_ALIGNED_BOX)
-	    , _shape(new AlignedBox2(box))
-	{}
+	    : _type(SHAPE_ALIGNED_BOX) {
+		new(&_storage.alignedBox) AlignedBox2(box);
+	}
 
 	inline Shape2D(const OrientedBox2& oBox)
-	    : _type(SHAPE_ORIENTED_BOX)
-	    , _shape(new OrientedBox2(oBox))
-	{}
+	    : _type(SHAPE_ORIENTED_BOX) {
+		new(&_storage.orientedBox) OrientedBox2(oBox);
+	}
 
-	Shape2D(const Shape2D& other);
-	Shape2D(Shape2D&& other);
+	inline Shape2D(const Shape2D& other)
+	    : _type(SHAPE_NONE) {
+		_copy(other);
+	}
+
+	inline Shape2D(Shape2D&& other)
+	    : _type(SHAPE_NONE) {
+		_copy(other);
+		other._destroy();
+	}
 
-	~Shape2D();
+	inline ~Shape2D() {
+		_destroy();
+	}
 
-	Shape2D& operator=(Shape2D other);
+	inline Shape2D& operator=(const Shape2D& other) {
+		if(this != &other) {
+			_destroy();
+			_copy(other);
+		}
+		return *this;
+	}
 
 	inline Shape2DType type()   const { return _type; }
 	inline bool isValid()       const { return _type != SHAPE_NONE; }
@@ -88,17 +111,17 @@ public:
 
 	inline const Sphere2& asSphere() const {
 		lairAssert(isSphere());
-		return *static_cast<Sphere2*>(_shape);
+		return _storage.sphere;
 	}
 
 	inline const AlignedBox2& asAlignedBox() const {
 		lairAssert(isAlignedBox());
-		return *static_cast<AlignedBox2*>(_shape);
+		return _storage.alignedBox;
 	}
 
 	inline const OrientedBox2& asOrientedBox() const {
 		lairAssert(isOrientedBox());
-		return *static_cast<OrientedBox2*>(_shape);
+		return _storage.orientedBox;
 	}
 
 	Shape2D transformed(const Matrix3& transform) const;
@@ -121,13 +144,71 @@ public:
 
 	bool intersect(const Shape2D& other) const;
 
+	/// Cast the ray `origin + t * direction`, with t in [0, maxT]. On
+	/// success, `t` is set to the entry point (0 if `origin` is inside).
+	bool raycast(const Vector2& origin, const Vector2& direction, float maxT,
+	             float* t = nullptr) const;
+
+	/// Move this shape by `t * motion`, with t in [0, maxT], and find the
+	/// first t where it touches `other`. Exact for sphere/sphere,
+	/// sphere/box and aligned box/aligned box; other pairs are sampled
+	/// along the motion then refined by bisection.
+	bool sweep(const Vector2& motion, const Shape2D& other, float maxT,
+	           float* t = nullptr) const;
+
 	void swap(Shape2D& other);
 
 	static void registerSerializableTypes(PropertySerializer& serializer);
 
+protected:
+	union Storage {
+		inline Storage() {}
+		inline ~Storage() {}
+
+		Sphere2      sphere;
+		AlignedBox2  alignedBox;
+		OrientedBox2 orientedBox;
+	};
+
+protected:
+	inline void _copy(const Shape2D& other) {
+		lairAssert(_type == SHAPE_NONE);
+		switch(other._type) {
+		case SHAPE_NONE:
+			break;
+		case SHAPE_SPHERE:
+			new(&_storage.sphere) Sphere2(other._storage.sphere);
+			break;
+		case SHAPE_ALIGNED_BOX:
+			new(&_storage.alignedBox) AlignedBox2(other._storage.alignedBox);
+			break;
+		case SHAPE_ORIENTED_BOX:
+			new(&_storage.orientedBox) OrientedBox2(other._storage.orientedBox);
+			break;
+		}
+		_type = other._type;
+	}
+
+	inline void _destroy() {
+		switch(_type) {
+		case SHAPE_NONE:
+			break;
+		case SHAPE_SPHERE:
+			_storage.sphere.~Sphere2();
+			break;
+		case SHAPE_ALIGNED_BOX:
+			_storage.alignedBox.~AlignedBox2();
+			break;
+		case SHAPE_ORIENTED_BOX:
+			_storage.orientedBox.~OrientedBox2();
+			break;
+		}
+		_type = SHAPE_NONE;
+	}
+
 protected:
 	Shape2DType _type;
-	void*       _shape;
+	Storage     _storage;
 };
 
 
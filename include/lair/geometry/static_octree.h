@@ -0,0 +1,385 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_GEOMETRY_STATIC_OCTREE_H
+#define _LAIR_GEOMETRY_STATIC_OCTREE_H
+
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/geometry/aligned_box.h>
+#include <lair/geometry/intersection.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief An immutable quadtree (in 2D) or octree (in 3D) for static objects.
+ *
+ * The tree is built at once by build(): objects are sorted along a Morton
+ * curve of their centers, so the objects of any cell are contiguous, and
+ * the tree is split top-down until cells hold at most `leafSize` objects.
+ * Objects and their bounding boxes are stored in flat arrays and each node
+ * keeps the tight bounds of its subtree, so queries never follow pointers
+ * to items. The tree can not be modified after build(), except by building
+ * it again.
+ *
+ * Provides the same queries as Octree.
+ */
+template<typename _Object>
+class StaticOctree {
+public:
+	typedef _Object              Object;
+	typedef StaticOctree<Object> Self;
+
+	typedef typename Object::Scalar Scalar;
+
+	enum {
+		Dim = Object::Dim,
+		NCells = (1 << Dim),
+		// Bits per axis of the Morton codes.
+		MortonBits = 32 / Dim,
+	};
+
+	typedef Eigen::Matrix<Scalar, Dim, 1> Vector;
+	typedef AlignedBox   <Scalar, Dim>    Box;
+
+public:
+	inline StaticOctree(unsigned maxDepth = MortonBits, unsigned leafSize = 8)
+	    : _maxDepth(std::min<unsigned>(maxDepth, MortonBits))
+	    , _leafSize(std::max(leafSize, 1u))
+	    , _nQueries(0)
+	    , _nItemsTested(0)
+	{}
+
+	StaticOctree(const StaticOctree& ) = delete;
+	StaticOctree(      StaticOctree&&) = default;
+	~StaticOctree() = default;
+
+	StaticOctree& operator=(const StaticOctree& ) = delete;
+	StaticOctree& operator=(      StaticOctree&&) = default;
+
+	inline Size size() const {
+		return _objects.size();
+	}
+
+	inline Size nNodes() const {
+		return _nodes.size();
+	}
+
+	/// Bounds of all the objects.
+	inline Box bounds() const {
+		return _nodes.empty()? Box(): _nodes[0].bounds;
+	}
+
+	/// Objects, in Morton order.
+	inline const Object& object(Size index) const {
+		return _objects[index];
+	}
+
+	inline Size nQueries() const {
+		return _nQueries;
+	}
+
+	inline Size nItemsTested() const {
+		return _nItemsTested;
+	}
+
+	inline double avgItemsTestedPerQuery() const {
+		return _nQueries? double(_nItemsTested) / double(_nQueries): 0;
+	}
+
+	inline void resetStats() {
+		_nQueries     = 0;
+		_nItemsTested = 0;
+	}
+
+	/// Replace the content of the tree by a copy of the objects in
+	/// [first, last).
+	template<typename InputIt>
+	void build(InputIt first, InputIt last) {
+		std::vector<Object> objects(first, last);
+
+		clear();
+		if(objects.empty())
+			return;
+
+		Box centers;
+		for(const Object& obj: objects)
+			centers.extend(obj.boundingBox().center());
+
+		// Sort (code, index) pairs: the index breaks ties so the order does
+		// not depend on the sort implementation.
+		typedef std::pair<uint32, unsigned> Key;
+		std::vector<Key> keys;
+		keys.reserve(objects.size());
+		for(unsigned i = 0; i < objects.size(); ++i)
+			keys.emplace_back(_morton(centers, objects[i].boundingBox().center()), i);
+		std::sort(keys.begin(), keys.end());
+
+		_objects.reserve(objects.size());
+		_boxes  .reserve(objects.size());
+		_codes  .reserve(objects.size());
+		for(const Key& key: keys) {
+			_objects.push_back(std::move(objects[key.second]));
+			_boxes  .push_back(_objects.back().boundingBox());
+			_codes  .push_back(key.first);
+		}
+
+		_nodes.emplace_back();
+		_build(0, 0, _objects.size(), 0);
+
+		// Only needed while building.
+		_codes.clear();
+		_codes.shrink_to_fit();
+	}
+
+	void clear() {
+		_objects.clear();
+		_boxes  .clear();
+		_nodes  .clear();
+	}
+
+	/// Call `callback(object)` for each object whose bounding box intersects
+	/// `box`, until it returns true.
+	template<typename Callback>
+	bool hitTest(const Box& box, const Callback& callback) const {
+		++_nQueries;
+		return !_nodes.empty() && _hitTest(0, box, callback);
+	}
+
+	/// Same as Octree::raycast(). Nodes are traversed front to back.
+	template<typename Callback>
+	bool raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	             const Vector& extent, const Callback& callback) const {
+		++_nQueries;
+		return !_nodes.empty() && _raycast(0, origin, direction, extent, maxT, callback);
+	}
+
+	/// Same as Octree::nearest(). Nearest nodes are traversed first.
+	template<typename Callback>
+	bool nearest(const Vector& p, Scalar maxDist, const Callback& callback) const {
+		++_nQueries;
+		return !_nodes.empty() && _nearest(0, p, maxDist, callback);
+	}
+
+protected:
+	struct Node {
+		Box      bounds;      // Tight bounds of the objects of the subtree
+		unsigned begin;       // Objects of the subtree are [begin, end)
+		unsigned end;
+		unsigned firstChild;  // Children are contiguous, 0 for leaves
+		unsigned nChildren;
+	};
+
+	typedef std::vector<Object> ObjectVector;
+	typedef std::vector<Box>    BoxVector;
+	typedef std::vector<uint32> CodeVector;
+	typedef std::vector<Node>   NodeVector;
+
+protected:
+	static uint32 _morton(const Box& bounds, const Vector& p) {
+		const uint32 maxCoord = (1u << MortonBits) - 1;
+
+		uint32 coords[Dim];
+		for(int axis = 0; axis < Dim; ++axis) {
+			Scalar extent = bounds.max()(axis) - bounds.min()(axis);
+			Scalar x = (extent > 0)? (p(axis) - bounds.min()(axis)) / extent: 0;
+			coords[axis] = uint32(clamp(x, Scalar(0), Scalar(1)) * maxCoord);
+		}
+
+		// The first bits are the most significant, so each group of Dim bits
+		// is the index of a child cell, from the root down.
+		uint32 code = 0;
+		for(int bit = MortonBits; bit--; ) {
+			for(int axis = Dim; axis--; )
+				code = (code << 1) | ((coords[axis] >> bit) & 1);
+		}
+		return code;
+	}
+
+	void _build(unsigned ni, unsigned begin, unsigned end, unsigned depth) {
+		_nodes[ni].begin      = begin;
+		_nodes[ni].end        = end;
+		_nodes[ni].firstChild = 0;
+		_nodes[ni].nChildren  = 0;
+
+		if(end - begin <= _leafSize || depth == _maxDepth) {
+			Box bounds;
+			for(unsigned i = begin; i < end; ++i)
+				bounds.extend(_boxes[i]);
+			_nodes[ni].bounds = bounds;
+			return;
+		}
+
+		// Codes are sorted, so children are contiguous ranges of the objects.
+		unsigned shift = (MortonBits - depth - 1) * Dim;
+		unsigned childBegin[NCells];
+		unsigned childEnd  [NCells];
+		unsigned nChildren = 0;
+		for(unsigned i = begin; i < end; ) {
+			uint64 cell = _codes[i] >> shift;
+			uint32 last = uint32(((cell + 1) << shift) - 1);
+			unsigned j = std::upper_bound(_codes.begin() + i, _codes.begin() + end, last)
+			           - _codes.begin();
+			childBegin[nChildren] = i;
+			childEnd  [nChildren] = j;
+			++nChildren;
+			i = j;
+		}
+
+		unsigned firstChild = _nodes.size();
+		_nodes[ni].firstChild = firstChild;
+		_nodes[ni].nChildren  = nChildren;
+		_nodes.resize(_nodes.size() + nChildren);
+
+		Box bounds;
+		for(unsigned ci = 0; ci < nChildren; ++ci) {
+			_build(firstChild + ci, childBegin[ci], childEnd[ci], depth + 1);
+			bounds.extend(_nodes[firstChild + ci].bounds);
+		}
+		_nodes[ni].bounds = bounds;
+	}
+
+	template<typename Callback>
+	bool _hitTest(unsigned ni, const Box& box, const Callback& callback) const {
+		const Node& node = _nodes[ni];
+		if(!box.intersects(node.bounds))
+			return false;
+
+		if(!node.nChildren) {
+			for(unsigned i = node.begin; i < node.end; ++i) {
+				++_nItemsTested;
+				if(box.intersects(_boxes[i])
+				&& callback(_objects[i]))
+					return true;
+			}
+			return false;
+		}
+
+		for(unsigned ci = 0; ci < node.nChildren; ++ci) {
+			if(_hitTest(node.firstChild + ci, box, callback))
+				return true;
+		}
+		return false;
+	}
+
+	template<typename Callback>
+	bool _raycast(unsigned ni, const Vector& origin, const Vector& direction,
+	              const Vector& extent, Scalar& maxT, const Callback& callback) const {
+		const Node& node = _nodes[ni];
+		if(!node.nChildren) {
+			for(unsigned i = node.begin; i < node.end; ++i) {
+				++_nItemsTested;
+				if(lair::raycast(Box(_boxes[i].min() - extent, _boxes[i].max() + extent),
+				                 origin, direction, maxT)
+				&& callback(_objects[i], maxT))
+					return true;
+			}
+			return false;
+		}
+
+		// Insertion sort of the children by entry distance.
+		unsigned children[NCells];
+		Scalar   tEnter  [NCells];
+		unsigned nChildren = 0;
+		for(unsigned ci = 0; ci < node.nChildren; ++ci) {
+			const Box& bounds = _nodes[node.firstChild + ci].bounds;
+			Scalar t;
+			if(lair::raycast(Box(bounds.min() - extent, bounds.max() + extent),
+			                 origin, direction, maxT, &t)) {
+				unsigned i = nChildren++;
+				for(; i && tEnter[i - 1] > t; --i) {
+					children[i] = children[i - 1];
+					tEnter  [i] = tEnter  [i - 1];
+				}
+				children[i] = node.firstChild + ci;
+				tEnter  [i] = t;
+			}
+		}
+
+		for(unsigned i = 0; i < nChildren && tEnter[i] <= maxT; ++i) {
+			if(_raycast(children[i], origin, direction, extent, maxT, callback))
+				return true;
+		}
+		return false;
+	}
+
+	template<typename Callback>
+	bool _nearest(unsigned ni, const Vector& p, Scalar& maxDist,
+	              const Callback& callback) const {
+		const Node& node = _nodes[ni];
+		if(!node.nChildren) {
+			for(unsigned i = node.begin; i < node.end; ++i) {
+				++_nItemsTested;
+				if(squaredDistance(_boxes[i], p) <= maxDist * maxDist
+				&& callback(_objects[i], maxDist))
+					return true;
+			}
+			return false;
+		}
+
+		unsigned children[NCells];
+		Scalar   sqDist  [NCells];
+		unsigned nChildren = 0;
+		for(unsigned ci = 0; ci < node.nChildren; ++ci) {
+			Scalar d = squaredDistance(_nodes[node.firstChild + ci].bounds, p);
+			if(d <= maxDist * maxDist) {
+				unsigned i = nChildren++;
+				for(; i && sqDist[i - 1] > d; --i) {
+					children[i] = children[i - 1];
+					sqDist  [i] = sqDist  [i - 1];
+				}
+				children[i] = node.firstChild + ci;
+				sqDist  [i] = d;
+			}
+		}
+
+		for(unsigned i = 0; i < nChildren && sqDist[i] <= maxDist * maxDist; ++i) {
+			if(_nearest(children[i], p, maxDist, callback))
+				return true;
+		}
+		return false;
+	}
+
+protected:
+	ObjectVector _objects;
+	BoxVector    _boxes;
+	CodeVector   _codes;
+	NodeVector   _nodes;
+	unsigned     _maxDepth;
+	unsigned     _leafSize;
+
+	mutable Size _nQueries;
+	mutable Size _nItemsTested;
+};
+
+
+}
+
+
+#endif
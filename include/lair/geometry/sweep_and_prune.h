@@ -0,0 +1,276 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_GEOMETRY_SWEEP_AND_PRUNE_H
+#define _LAIR_GEOMETRY_SWEEP_AND_PRUNE_H
+
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <lair/core/lair.h>
+#include <lair/core/memory_pool.h>
+
+#include <lair/geometry/aligned_box.h>
+#include <lair/geometry/intersection.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief Objects sorted along one axis by the min of their bounding box.
+ *
+ * Queries binary-search the first candidate and sweep until the objects
+ * start past the query box. Boxes and keys are stored in contiguous arrays
+ * so the sweep is cache friendly. Works best with many objects of similar
+ * size spread along the sort axis.
+ *
+ * Provides the same interface as Octree.
+ */
+template<typename _Object>
+class SweepAndPrune {
+public:
+	typedef _Object               Object;
+	typedef SweepAndPrune<Object> Self;
+
+	typedef typename Object::Scalar Scalar;
+
+	enum {
+		Dim = Object::Dim,
+	};
+
+	typedef Eigen::Matrix<Scalar, Dim, 1> Vector;
+	typedef AlignedBox   <Scalar, Dim>    Box;
+
+public:
+	inline SweepAndPrune(unsigned axis = 0, size_t blockSize = 1024)
+	    : _items(blockSize)
+	    , _axis(axis)
+	    , _maxExtent(0)
+	{
+		lairAssert(axis < Dim);
+	}
+
+	SweepAndPrune(const SweepAndPrune& ) = delete;
+	SweepAndPrune(      SweepAndPrune&&) = delete;
+
+	inline ~SweepAndPrune() {
+		clear();
+	}
+
+	SweepAndPrune& operator=(const SweepAndPrune& ) = delete;
+	SweepAndPrune& operator=(      SweepAndPrune&&) = delete;
+
+	inline unsigned axis() const {
+		return _axis;
+	}
+
+	inline unsigned size() const {
+		return _itemArray.size();
+	}
+
+	template<typename... Args>
+	inline Object* insert(Args... args) {
+		Item* item = _items.construct(std::forward<Args>(args)...);
+		item->bounds = item->boundingBox();
+
+		Scalar key = item->bounds.min()(_axis);
+		_maxExtent = std::max(_maxExtent, item->bounds.max()(_axis) - key);
+
+		unsigned i = std::upper_bound(_keys.begin(), _keys.end(), key) - _keys.begin();
+		_keys     .insert(_keys     .begin() + i, key);
+		_boxes    .insert(_boxes    .begin() + i, item->bounds);
+		_itemArray.insert(_itemArray.begin() + i, item);
+
+		return item;
+	}
+
+	void remove(Object* object) {
+		Item*    item = static_cast<Item*>(object);
+		unsigned i    = _index(item);
+
+		_keys     .erase(_keys     .begin() + i);
+		_boxes    .erase(_boxes    .begin() + i);
+		_itemArray.erase(_itemArray.begin() + i);
+
+		_items.destroy(item);
+	}
+
+	/// Must be called when the bounding box of `object` changed. Objects
+	/// usually move a little between two updates, so the object is moved
+	/// toward its new place in the sorted array step by step. Returns true if
+	/// the object kept its place.
+	bool update(Object* object) {
+		Item*    item = static_cast<Item*>(object);
+		unsigned i    = _index(item);
+
+		item->bounds = item->boundingBox();
+		Scalar key = item->bounds.min()(_axis);
+		_maxExtent = std::max(_maxExtent, item->bounds.max()(_axis) - key);
+
+		_keys [i] = key;
+		_boxes[i] = item->bounds;
+
+		bool inPlace = true;
+		while(i > 0 && _keys[i - 1] > key) {
+			_swap(i - 1, i);
+			--i;
+			inPlace = false;
+		}
+		while(i + 1 < _keys.size() && _keys[i + 1] < key) {
+			_swap(i, i + 1);
+			++i;
+			inPlace = false;
+		}
+
+		return inPlace;
+	}
+
+	template<typename Predicate>
+	void filterIf(const Predicate& predicate) {
+		unsigned dst = 0;
+		_maxExtent = 0;
+		for(unsigned src = 0; src < _itemArray.size(); ++src) {
+			Item* item = _itemArray[src];
+			if(predicate(*item)) {
+				_items.destroy(item);
+				continue;
+			}
+
+			_keys     [dst] = _keys [src];
+			_boxes    [dst] = _boxes[src];
+			_itemArray[dst] = item;
+			_maxExtent = std::max(_maxExtent, _boxes[dst].max()(_axis) - _keys[dst]);
+			++dst;
+		}
+
+		_keys     .resize(dst);
+		_boxes    .resize(dst);
+		_itemArray.resize(dst);
+	}
+
+	void reset(const Box& /*box*/) {
+		clear();
+	}
+
+	void clear() {
+		for(Item* item: _itemArray)
+			_items.destroy(item);
+
+		_keys     .clear();
+		_boxes    .clear();
+		_itemArray.clear();
+		_maxExtent = 0;
+	}
+
+	template<typename Callback>
+	bool hitTest(const Box& box, const Callback& callback = Callback()) const {
+		// No object starting before min - _maxExtent can reach the box.
+		Scalar   end = box.max()(_axis);
+		unsigned i   = std::lower_bound(_keys.begin(), _keys.end(),
+		                                box.min()(_axis) - _maxExtent) - _keys.begin();
+		for(; i < _keys.size() && _keys[i] <= end; ++i) {
+			if(box.intersects(_boxes[i])
+			&& callback(*_itemArray[i]))
+				return true;
+		}
+
+		return false;
+	}
+
+	/// Same as Octree::raycast(), but items are not visited in order. `maxT`
+	/// must be finite.
+	template<typename Callback>
+	bool raycast(const Vector& origin, const Vector& direction, Scalar maxT,
+	             const Vector& extent, const Callback& callback) const {
+		lairAssert(std::isfinite(maxT));
+		Vector end = origin + maxT * direction;
+		Box box(origin.cwiseMin(end) - extent, origin.cwiseMax(end) + extent);
+		return hitTest(box, [&](Object& object) {
+			const Box& objBox = object.boundingBox();
+			return lair::raycast(Box(objBox.min() - extent, objBox.max() + extent),
+			                     origin, direction, maxT)
+			    && callback(object, maxT);
+		});
+	}
+
+	/// Same as Octree::nearest(), but items are not visited in order.
+	/// `maxDist` must be finite.
+	template<typename Callback>
+	bool nearest(const Vector& p, Scalar maxDist, const Callback& callback) const {
+		lairAssert(std::isfinite(maxDist));
+		Vector margin = Vector::Constant(maxDist);
+		return hitTest(Box(p - margin, p + margin), [&](Object& object) {
+			return squaredDistance(object.boundingBox(), p) <= maxDist * maxDist
+			    && callback(object, maxDist);
+		});
+	}
+
+protected:
+	class Item : public Object {
+	public:
+		template<typename... Args>
+		inline Item(Args... args)
+		    : Object(std::forward<Args>(args)...)
+		{}
+
+		Box bounds;
+	};
+
+	typedef std::vector<Scalar> ScalarVector;
+	typedef std::vector<Box>    BoxVector;
+	typedef std::vector<Item*>  ItemVector;
+
+	typedef MemoryPool<Item> ObjectPool;
+
+protected:
+	inline unsigned _index(const Item* item) const {
+		Scalar key = item->bounds.min()(_axis);
+		unsigned i = std::lower_bound(_keys.begin(), _keys.end(), key) - _keys.begin();
+		while(i < _itemArray.size() && _itemArray[i] != item)
+			++i;
+		lairAssert(i < _itemArray.size());
+		return i;
+	}
+
+	inline void _swap(unsigned i, unsigned j) {
+		std::swap(_keys     [i], _keys     [j]);
+		std::swap(_boxes    [i], _boxes    [j]);
+		std::swap(_itemArray[i], _itemArray[j]);
+	}
+
+protected:
+	ObjectPool   _items;
+	ScalarVector _keys;
+	BoxVector    _boxes;
+	ItemVector   _itemArray;
+	unsigned     _axis;
+	Scalar       _maxExtent;
+};
+
+
+}
+
+
+#endif
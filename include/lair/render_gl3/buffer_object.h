@@ -23,6 +23,8 @@
 #define LAIR_RENDER_GL3_BUFFER_OBJECT_H
 
 
+#include <vector>
+
 #include <lair/core/lair.h>
 
 #include <lair/render_gl3/context.h>
@@ -42,11 +44,18 @@ class Renderer;
  * allows to write linearly in it (like a stream) and you must do so between
  * beginWrite() and endWrite(). Behind the scene, it tries to upload the data
  * efficiently.
+ *
+ * If segmentCount > 1, the buffer is split in several segments used as a
+ * ring: each beginWrite() moves to the next segment, which is mapped without
+ * synchronization after waiting for a fence set when it was last used. This
+ * allows to stream data every frame without stalling on the previous frames.
+ * Users must take segmentOffset() into account when setting up attributes or
+ * issuing draw calls (VertexArray and RenderPass do it).
  */
 class BufferObject {
 public:
 	BufferObject(Renderer* renderer, GLenum target = gl::ARRAY_BUFFER,
-	             GLenum usage = gl::STREAM_DRAW);
+	             GLenum usage = gl::STREAM_DRAW, unsigned segmentCount = 1);
 	BufferObject(const BufferObject&) = delete;
 	BufferObject(BufferObject&&)      = delete;
 	~BufferObject();
@@ -54,11 +63,21 @@ public:
 	BufferObject& operator=(const BufferObject&) = delete;
 	BufferObject& operator=(BufferObject&&)      = delete;
 
+	inline GLuint id() const { return _buffer; }
+
 	void bind(GLenum target = 0);
 
 	void beginWrite(Size size);
 	bool endWrite();
 
+	inline unsigned segmentCount() const { return _segmentCount; }
+
+	/// Offset in bytes of the segment being written or last written.
+	inline Size segmentOffset() const { return _segment * _size; }
+
+	/// Number of bytes written by the last beginWrite() / endWrite() pair.
+	inline Size bytesWritten() const { return _bytesWritten; }
+
 	inline Size pos() const {
 		lairAssert(_begin);
 		return Size(_pos - _begin);
@@ -84,8 +103,29 @@ public:
 		return write(reinterpret_cast<const void*>(objs), sizeof(T) * count);
 	}
 
+	/**
+	 * \brief Reserve size bytes and return a pointer to them, so they can be
+	 * filled later, possibly from other threads (before endWrite()).
+	 *
+	 * Return nullptr on overflow, with the same rules than write().
+	 */
+	Byte* reserve(Size size);
+
+	/**
+	 * \brief Pad the buffer with zeros so that pos() is a multiple of
+	 * alignment. Follows the same overflow rules than write().
+	 */
+	bool align(Size alignment);
+
 	void _release();
 
+protected:
+	typedef std::vector<GLsync> FenceList;
+
+protected:
+	void _waitFence(unsigned segment);
+	void _deleteFences();
+
 protected:
 	Context*  _context;
 	Renderer* _renderer;
@@ -95,6 +135,12 @@ protected:
 	GLuint    _buffer;
 	Byte*     _begin;
 	Byte*     _pos;
+
+	unsigned  _segmentCount;
+	unsigned  _segment;
+	FenceList _fences;
+	bool      _used;
+	Size      _bytesWritten;
 };
 
 
@@ -974,6 +974,13 @@ enum GL {
 	// GL_ARB_texture_storage
 
 	TEXTURE_IMMUTABLE_FORMAT                      = 0x912F,
+
+	// GL_ARB_get_program_binary
+
+	PROGRAM_BINARY_RETRIEVABLE_HINT               = 0x8257,
+	PROGRAM_BINARY_LENGTH                         = 0x8741,
+	NUM_PROGRAM_BINARY_FORMATS                    = 0x87FE,
+	PROGRAM_BINARY_FORMATS                        = 0x87FF,
 };
 }
 
@@ -1500,6 +1507,12 @@ public:
 	void texStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
 	void texStorage3D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
 
+	// GL_ARB_get_program_binary
+
+	void getProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	void programBinary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	void programParameteri(GLuint program, GLenum pname, GLint value);
+
 public:
 	bool _gl_1_0;
 	bool _gl_1_1;
@@ -1517,6 +1530,7 @@ public:
 	bool _gl_khr_debug;
 	bool _gl_arb_conservative_depth;
 	bool _gl_arb_texture_storage;
+	bool _gl_arb_get_program_binary;
 
 public:
 
@@ -2278,6 +2292,15 @@ public:
 	typedef void (GLAPIENTRYP _PfnGlTexStorage3D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
 	_PfnGlTexStorage3D _glTexStorage3D;
 
+	// GL_ARB_get_program_binary
+
+	typedef void (GLAPIENTRYP _PfnGlGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	_PfnGlGetProgramBinary _glGetProgramBinary;
+	typedef void (GLAPIENTRYP _PfnGlProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	_PfnGlProgramBinary _glProgramBinary;
+	typedef void (GLAPIENTRYP _PfnGlProgramParameteri)(GLuint program, GLenum pname, GLint value);
+	_PfnGlProgramParameteri _glProgramParameteri;
+
 private:
 	void* _getProcAddress(const char* proc);
 
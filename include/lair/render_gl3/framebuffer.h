@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_RENDER_GL3_FRAMEBUFFER_H
+#define _LAIR_RENDER_GL3_FRAMEBUFFER_H
+
+
+#include <lair/core/lair.h>
+
+#include <lair/render_gl3/context.h>
+#include <lair/render_gl3/texture.h>
+
+
+namespace lair
+{
+
+
+class Renderer;
+
+
+/**
+ * \brief An offscreen render target.
+ *
+ * Renders into a color texture, with an optional depth buffer of the same
+ * size. Set it as the target of a RenderPass to render to texture.
+ */
+class Framebuffer {
+public:
+	Framebuffer(Renderer* renderer);
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer(Framebuffer&&)      = delete;
+	~Framebuffer();
+
+	Framebuffer& operator=(const Framebuffer&) = delete;
+	Framebuffer& operator=(Framebuffer&&)      = delete;
+
+	inline bool     isValid() const { return _fbo; }
+	inline unsigned width()   const { return _width; }
+	inline unsigned height()  const { return _height; }
+
+	inline TextureAspectSP colorTexture() const { return _color; }
+
+	/**
+	 * \brief Attach color, which must be a valid texture, and allocate a
+	 * depth buffer if depth is true.
+	 *
+	 * Return false and release the framebuffer if it is not complete.
+	 */
+	bool create(TextureAspectSP color, bool depth = true);
+
+	/// Bind the framebuffer and set the viewport to cover it.
+	void bind();
+
+	void _release();
+	inline GLuint _glId() const { return _fbo; }
+
+protected:
+	Renderer*       _renderer;
+	Context*        _context;
+	GLuint          _fbo;
+	GLuint          _depth;
+	TextureAspectSP _color;
+	unsigned        _width;
+	unsigned        _height;
+};
+
+
+}
+
+
+#endif
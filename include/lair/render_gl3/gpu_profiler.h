@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_RENDER_GL3_GPU_PROFILER_H
+#define _LAIR_RENDER_GL3_GPU_PROFILER_H
+
+
+#include <deque>
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/profiler.h>
+
+#include <lair/render_gl3/context.h>
+
+
+#ifdef LAIR_PROFILER
+#define LAIR_PROFILE_GPU_SCOPE(_gpuProfiler, _name) \
+	::lair::GpuProfileZone _LAIR_PROFILE_CONCAT(_lairGpuProfileZone, __LINE__)(_gpuProfiler, _name)
+#else
+#define LAIR_PROFILE_GPU_SCOPE(_gpuProfiler, _name) ((void)0)
+#endif
+
+
+namespace lair
+{
+
+
+/**
+ * \brief Measure GPU time with timestamp queries and report it to the
+ * Profiler, in a "GPU" track.
+ *
+ * Results are read back by update() a few frames later, once available, so
+ * it never stalls the pipeline. GPU timestamps are converted to Profiler
+ * time each update().
+ */
+class GpuProfiler {
+public:
+	GpuProfiler(Context* context);
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler(GpuProfiler&&)      = delete;
+	~GpuProfiler();
+
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(GpuProfiler&&)      = delete;
+
+	/// Timer queries are core since OpenGL 3.3.
+	bool isSupported() const;
+
+	void begin(const char* name);
+	void end();
+
+	/// Report finished zones to the profiler. Call once per frame.
+	void update();
+
+	inline unsigned pendingCount() const { return _pending.size(); }
+
+	void _release();
+
+protected:
+	struct Zone {
+		const char* name;
+		GLuint      begin;
+		GLuint      end;
+		unsigned    depth;
+	};
+	typedef std::vector<Zone> ZoneStack;
+	typedef std::deque<Zone>  ZoneQueue;
+
+protected:
+	GLuint _query();
+
+protected:
+	Context*            _context;
+	std::vector<GLuint> _freeQueries;
+	std::vector<GLuint> _allQueries;
+	ZoneStack           _open;
+	ZoneQueue           _pending;
+	int64               _offset;
+};
+
+
+/// Measure the GPU time of the commands issued during its lifetime.
+class GpuProfileZone {
+public:
+	inline GpuProfileZone(GpuProfiler* profiler, const char* name)
+	    : _profiler(nullptr) {
+		if(profiler && Profiler::instance().isCapturing() && profiler->isSupported()) {
+			_profiler = profiler;
+			_profiler->begin(name);
+		}
+	}
+
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone(GpuProfileZone&&)      = delete;
+
+	inline ~GpuProfileZone() {
+		if(_profiler)
+			_profiler->end();
+	}
+
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(GpuProfileZone&&)      = delete;
+
+protected:
+	GpuProfiler* _profiler;
+};
+
+
+}
+
+
+#endif
@@ -45,6 +45,9 @@ public:
 
 	Matrix4 transform() const;
 
+	/// Returns true if the box intersects the view box. The z axis is ignored.
+	bool isVisible(const Box2& box) const;
+
 protected:
 	Box3 _viewBox;
 };
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_RENDER_GL3_PROGRAM_CACHE_H
+#define _LAIR_RENDER_GL3_PROGRAM_CACHE_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+#include <lair/core/path.h>
+
+#include <lair/render_gl3/context.h>
+
+
+namespace lair
+{
+
+
+class GlslSource;
+class ProgramObject;
+class VertexAttribSet;
+
+
+/**
+ * \brief On-disk cache of linked program binaries.
+ *
+ * Programs are identified by a hash of their preprocessed sources, their
+ * attribute bindings and the driver strings, so any change falls back to a
+ * regular compilation. Disabled if no directory is set or if the driver does
+ * not support GL_ARB_get_program_binary.
+ */
+class ProgramCache {
+public:
+	struct Stats {
+		unsigned hitCount;
+		unsigned missCount;
+		double   warmTime; // Seconds spent loading cached programs.
+		double   coldTime; // Seconds spent compiling programs.
+	};
+
+public:
+	ProgramCache(Context* context, Logger* log);
+	ProgramCache(const ProgramCache&) = delete;
+	ProgramCache(ProgramCache&&)      = delete;
+	~ProgramCache();
+
+	ProgramCache& operator=(const ProgramCache&) = delete;
+	ProgramCache& operator=(ProgramCache&&)      = delete;
+
+	/// Directory where binaries are stored. Must exist. Empty disables the cache.
+	void setDirectory(const Path& directory);
+	inline const Path& directory() const { return _directory; }
+
+	bool isEnabled();
+
+	uint64 key(const VertexAttribSet* attribs,
+	           const GlslSource& vert, const GlslSource& frag);
+
+	/// Try to load the program `key` in `program`, which must be generated.
+	bool load(ProgramObject& program, uint64 key);
+	void store(const ProgramObject& program, uint64 key);
+
+	void recordBuild(bool fromCache, double seconds);
+	inline const Stats& stats() const { return _stats; }
+
+protected:
+	Path _path(uint64 key) const;
+
+protected:
+	Context*  _context;
+	Logger*   _log;
+	Path      _directory;
+	int       _nFormats;
+	String    _driver;
+	Stats     _stats;
+	std::vector<Byte> _buffer;
+};
+
+
+}
+
+
+#endif
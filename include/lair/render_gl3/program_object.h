@@ -24,6 +24,7 @@
 
 
 #include <ostream>
+#include <vector>
 
 #include <lair/asset/loader.h>
 
@@ -67,6 +68,11 @@ public:
 	bool link();
 	bool validate();
 
+	/// Load a binary retrieved with getBinary(). Return true if the program
+	/// is linked, which may fail if the driver changed.
+	bool loadBinary(GLenum format, const void* binary, GLsizei length);
+	bool getBinary(GLenum& format, std::vector<Byte>& binary) const;
+
 	void use() const;
 
 	GLint nbActiveAttributes() const;
@@ -74,6 +80,9 @@ public:
 
 	GLint getAttributeLocation(const GLchar* name) const;
 	GLint getUniformLocation(const GLchar* name) const;
+	GLuint getUniformBlockIndex(const GLchar* name) const;
+
+	void setUniformBlockBinding(GLuint blockIndex, GLuint binding);
 
 	void getLog(std::string& out) const;
 	void dumpInfo(std::ostream& out) const;
@@ -116,8 +125,8 @@ protected:
 protected:
 	Renderer*              _renderer;
 	const VertexAttribSet* _attribs;
-	ShaderObject           _vertexShader;
-	ShaderObject           _fragmentShader;
+	AspectSP               _vertexSource;
+	AspectSP               _fragmentSource;
 };
 
 
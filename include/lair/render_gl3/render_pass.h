@@ -24,6 +24,7 @@
 
 
 #include <vector>
+#include <unordered_map>
 
 #include <lair/core/lair.h>
 
@@ -38,6 +39,7 @@ namespace lair
 
 
 class Renderer;
+class Framebuffer;
 class ProgramObject;
 class BufferObject;
 class VertexArray;
@@ -140,6 +142,23 @@ ShaderParameter makeShaderParameter(int index, const Eigen::PlainObjectBase<Deri
 }
 
 
+/**
+ * \brief A range of a buffer object to bind to a uniform block binding point.
+ *
+ * Passed as a ShaderParameter of type gl::UNIFORM_BUFFER whose index is the
+ * binding point. RenderPass only rebinds it if the range changes.
+ */
+struct UniformBufferRange {
+	BufferObject* buffer;
+	Size          offset;
+	Size          size;
+};
+
+inline ShaderParameter makeShaderParameter(int binding, const UniformBufferRange* range) {
+	return ShaderParameter{ binding, gl::UNIFORM_BUFFER, range };
+}
+
+
 enum BlendingMode {
 	BLEND_NONE,
 	BLEND_ALPHA,
@@ -165,7 +184,8 @@ public:
 	// Stuff that is unlikely to be the same even for contiguous draw calls
 	struct DrawCall {
 		DrawCall(const DrawStates& states, const ShaderParameter* params,
-		         unsigned depth, unsigned index, unsigned count, GLenum primitive);
+		         unsigned depth, unsigned index, unsigned count, GLenum primitive,
+		         unsigned firstInstance = 0, unsigned instanceCount = 0);
 
 		// TODO: Test if using a pointer to avoid state duplication helps in any way.
 		DrawStates              states;
@@ -174,6 +194,8 @@ public:
 		unsigned                index;
 		unsigned                count;
 		GLenum                  primitive;
+		unsigned                firstInstance;
+		unsigned                instanceCount; // 0 means not instanced
 	};
 	typedef std::vector<DrawCall> DrawCallList;
 
@@ -186,9 +208,17 @@ public:
 		unsigned shaderStateChangeCount;
 		unsigned vertexArraySetupCount;
 		unsigned samplerBindCount;
+		unsigned samplerBindSkipCount;
 		unsigned textureBindCount;
+		unsigned textureBindSkipCount;
 		unsigned blendingModeChangeCount;
+		unsigned uniformUploadCount;
+		unsigned uniformSkipCount;
+		unsigned uniformBufferBindCount;
+		unsigned uniformBufferBindSkipCount;
 		unsigned drawCallCount;
+		unsigned instanceCount;
+		unsigned culledCount;
 	};
 
 public:
@@ -204,12 +234,38 @@ public:
 	void addDrawCall(const DrawStates& states, const ShaderParameter* param,
 	                 float depth, unsigned index, unsigned count,
 	                 GLenum primitive = gl::TRIANGLES);
+	void addInstancedDrawCall(const DrawStates& states, const ShaderParameter* param,
+	                          float depth, unsigned index, unsigned count,
+	                          unsigned firstInstance, unsigned instanceCount,
+	                          GLenum primitive = gl::TRIANGLES);
 	void render();
 
+	/**
+	 * \brief Render into framebuffer instead of the default framebuffer.
+	 *
+	 * The viewport is set to the framebuffer size during render(), and
+	 * restored afterward. nullptr renders to the default framebuffer.
+	 */
+	inline void setFramebuffer(Framebuffer* framebuffer) { _framebuffer = framebuffer; }
+	inline Framebuffer* framebuffer() const { return _framebuffer; }
+
+	/// Buffers to clear at the beginning of render(). Default to 0 (none).
+	inline void setClearBuffers(GLbitfield buffers, const Vector4& color = Vector4::Zero()) {
+		_clearBuffers = buffers;
+		_clearColor   = color;
+	}
+
+	/// Tell the pass that count objects have been culled, for stats purpose.
+	inline void notifyCulled(unsigned count = 1) { _culledCount += count; }
+
+	inline const Stats& stats() const { return _stats; }
+
 	static void setBits(Index& index, Index value, unsigned loBit, unsigned bitCount);
 	static Index solidIndex(const DrawCall& call);
 	static Index transparentIndex(const DrawCall& call);
 
+	static unsigned shaderParameterSize(GLenum type);
+
 protected:
 	struct IndexedCall {
 		IndexedCall(Index index, DrawCall* call);
@@ -223,18 +279,67 @@ protected:
 	};
 	typedef std::vector<IndexedCall> SortBuffer;
 
+	// Last value uploaded to a uniform location.
+	struct UniformValue {
+		GLenum type;
+		Byte   data[64];
+	};
+	typedef std::vector<UniformValue> UniformValueList;
+
+	struct ProgramState {
+		const ShaderParameter* params;
+		UniformValueList       uniforms;
+	};
+	typedef std::unordered_map<GLuint, ProgramState> ProgramStateMap;
+
+	struct BoundRange {
+		GLuint buffer;
+		Size   offset;
+		Size   size;
+	};
+	typedef std::vector<BoundRange> BoundRangeList;
+
+	// Mirror of the GL state set by render(), used to skip redundant calls.
+	// It is reset at the beginning of each render() as other code may touch
+	// the GL state between two passes.
+	struct StateCache {
+		ProgramObject*        shader;
+		VertexArray*          vertices;
+		const TextureSet*     textureSet;
+		int                   blendingMode;
+		GLenum                activeUnit;
+		std::vector<GLuint>   textures;
+		std::vector<GLuint>   samplers;
+		BoundRangeList        uniformBuffers;
+		ProgramStateMap       programs;
+	};
+
+protected:
+	void _resetStateCache();
+	void _setActiveUnit(unsigned unit);
+	void _bindTexture(unsigned unit, const Texture& texture);
+	void _bindSampler(unsigned unit, Sampler* sampler);
+	void _setBlendingMode(BlendingMode blendingMode);
+	void _bindUniformBuffer(unsigned binding, const UniformBufferRange& range);
+	void _setShaderParameters(ProgramObject* shader, const ShaderParameter* params);
+
 
 protected:
 	Renderer* _renderer;
 
-	// TODO: Framebuffer* _framebuffer;
+	Framebuffer* _framebuffer;
+	GLbitfield   _clearBuffers;
+	Vector4      _clearColor;
 	// bool _depthTestEnable;
 	// DepthTest _depthTest;
 
 	DrawCallList _drawCalls;
 	SortBuffer   _sortBuffer;
 
-	Stats _stats;
+	unsigned   _culledCount;
+
+	StateCache _state;
+	Stats      _stats;
 };
 
 
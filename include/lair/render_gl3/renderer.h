@@ -24,6 +24,7 @@
 
 
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <mutex>
 
@@ -34,13 +35,17 @@
 #include <lair/asset/asset_manager.h>
 
 #include <lair/render_gl3/context.h>
+#include <lair/render_gl3/gpu_profiler.h>
 #include <lair/render_gl3/glsl_source.h>
 #include <lair/render_gl3/vertex_array.h>
 #include <lair/render_gl3/shader_object.h>
 #include <lair/render_gl3/program_object.h>
+#include <lair/render_gl3/program_cache.h>
 #include <lair/render_gl3/sampler.h>
 #include <lair/render_gl3/texture.h>
 #include <lair/render_gl3/texture_set.h>
+#include <lair/render_gl3/texture_atlas.h>
+#include <lair/render_gl3/texture_uploader.h>
 
 
 namespace lair
@@ -69,7 +74,8 @@ public:
 
 	VertexArraySP createVertexArray(GLsizei sizeInBytes,
 	                                const VertexAttrib* attribs,
-	                                BufferObject* indices);
+	                                BufferObject* indices,
+	                                GLsizei instanceSizeInBytes = 0);
 
 	ShaderObject compileShader(const char* name, GLenum type,
 	                           const GlslSource& source);
@@ -78,12 +84,48 @@ public:
 	                             const ShaderObject* vert,
 	                             const ShaderObject* frag);
 
+	/**
+	 * \brief Build a program from sources, using the program cache if
+	 * possible.
+	 */
+	ProgramObject compileProgram(const char* name,
+	                             const VertexAttribSet* attribs,
+	                             const GlslSource& vert,
+	                             const GlslSource& frag);
+
+	inline ProgramCache& programCache() { return _programCache; }
+
+	inline GpuProfiler& gpuProfiler() { return _gpuProfiler; }
+
 	SamplerSP getSampler(const SamplerParams& params);
 
 	TextureAspectSP createTexture(AssetSP asset);
+	/**
+	 * \brief Create an uninitialized RGBA texture, to use as the color
+	 * target of a Framebuffer.
+	 */
+	TextureAspectSP createRenderTexture(const Path& logicPath,
+	                                    unsigned width, unsigned height);
 	void enqueueToUpload(TextureAspectSP texture);
+	/**
+	 * \brief Upload textures whose image is loaded, within the budget of
+	 * the texture uploader. Should be called once per frame.
+	 */
 	void uploadPendingTextures();
 
+	inline TextureUploader& textureUploader() { return _textureUploader; }
+
+	inline TextureAtlas& textureAtlas() { return _textureAtlas; }
+
+	/**
+	 * \brief Request `texture` to be packed in the texture atlas instead of
+	 * being uploaded in its own texture.
+	 *
+	 * Does nothing if the atlas is disabled or if the texture is already
+	 * uploaded.
+	 */
+	void packInAtlas(TextureAspectSP texture);
+
 	inline TextureAspectSP defaultTexture() {
 		return _defaultTexture;
 	}
@@ -126,6 +168,8 @@ protected:
 
 	typedef std::unordered_map<String, const TextureUnit*> TextureUnitMap;
 
+	typedef std::unordered_set<const TextureAspect*> TextureAspectSet;
+
 protected:
 	void _createDefaultTexture();
 
@@ -134,12 +178,18 @@ protected:
 	AssetManager*       _assetManager;
 
 	Context*            _context;
+	ProgramCache        _programCache;
+	GpuProfiler         _gpuProfiler;
 
 	unsigned            _vertexArrayIndex;
 
 	TextureList         _pendingTextures;
 	TextureAspectSP     _defaultTexture;
 
+	TextureAtlas        _textureAtlas;
+	TextureAspectSet    _atlasRequests;
+	TextureUploader     _textureUploader;
+
 	SamplerMap          _samplerMap;
 	TextureSetMap       _textureSetMap;
 	StringTextureSetMap _textureSetByName;
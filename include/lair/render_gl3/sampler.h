@@ -191,6 +191,9 @@ public:
 		_dirty  = true;
 	}
 
+	inline bool   _isDirty() const { return _dirty; }
+	inline GLuint _glId()    const { return _sampler; }
+
 	void _release();
 
 protected:
@@ -26,6 +26,7 @@
 #include <lair/core/lair.h>
 
 #include <lair/asset/asset_manager.h>
+#include <lair/asset/image.h>
 
 #include <lair/meta/metatype.h>
 
@@ -39,6 +40,11 @@ namespace lair
 class Context;
 class Renderer;
 class Image;
+class Texture;
+
+typedef GenericAspect       <Texture>       TextureAspect;
+typedef IntrusivePointer    <TextureAspect> TextureAspectSP;
+typedef IntrusiveWeakPointer<TextureAspect> TextureAspectWP;
 
 
 class Texture {
@@ -59,15 +65,31 @@ public:
 	inline uint16   height()         const { return _height; }
 	inline unsigned maxMipmapLevel() const { return _maxMipmapLevel; }
 
+	/// Return true if this texture is a part of a texture atlas page.
+	inline bool isAtlasView() const { return bool(_atlasPage); }
+	inline TextureAspectSP atlasPage() const { return _atlasPage; }
+	/// The part of the GL texture used by this texture, in texture coordinates.
+	inline const Box2& region() const { return _region; }
+
 	void bind() const;
 
 	bool _upload(const Image& image, unsigned maxMipmapLevel = DEFAULT_MAX_MIPMAP_LEVEL,
 	             bool linear = false);
+	/// Like above, but data may be an offset in the bound PIXEL_UNPACK_BUFFER.
+	bool _upload(unsigned width, unsigned height, Image::Format imageFormat,
+	             const void* data, unsigned maxMipmapLevel = DEFAULT_MAX_MIPMAP_LEVEL,
+	             bool linear = false);
+	/// Allocate the storage of the texture without initializing it.
+	bool _allocate(unsigned width, unsigned height, Image::Format imageFormat,
+	               unsigned maxMipmapLevel = DEFAULT_MAX_MIPMAP_LEVEL,
+	               bool linear = false);
+	bool _uploadRegion(const Image& image, const Box2i& rect);
+	void _setAtlasView(TextureAspectSP page, const Box2i& rect);
 
 	friend void swap(Texture& t0, Texture& t1);
 
 	void _release();
-	inline GLuint _glId() { return _id; }
+	inline GLuint _glId() const { return _id; }
 
 protected:
 	Context*       _context;
@@ -81,17 +103,14 @@ protected:
 	unsigned       _maxMipmapLevel;
 	// unsigned       _swizzle;
 	// TODO: Support base mipmap level & swizzling.
+	TextureAspectSP _atlasPage;
+	Box2           _region;
 };
 
 
 typedef std::shared_ptr<Texture> TextureSP;
 typedef std::weak_ptr  <Texture> TextureWP;
 
-typedef GenericAspect       <Texture>       TextureAspect;
-typedef IntrusivePointer    <TextureAspect> TextureAspectSP;
-typedef IntrusiveWeakPointer<TextureAspect> TextureAspectWP;
-
-
 }
 
 
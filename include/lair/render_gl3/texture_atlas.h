@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_RENDER_GL3_TEXTURE_ATLAS_H
+#define _LAIR_RENDER_GL3_TEXTURE_ATLAS_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+#include <lair/core/path.h>
+
+#include <lair/meta/variant.h>
+
+#include <lair/asset/asset_manager.h>
+#include <lair/asset/image_atlas.h>
+
+#include <lair/render_gl3/texture.h>
+
+
+namespace lair
+{
+
+
+class Renderer;
+class LoaderManager;
+
+
+/**
+ * \brief Pack small textures in shared pages so they can be batched.
+ *
+ * Packed textures stay valid TextureAspect, but their Texture is a view on a
+ * part of a page (see Texture::isAtlasView()). Users must map texture
+ * coordinates with Texture::region() and bind the page instead.
+ */
+class TextureAtlas {
+public:
+	TextureAtlas(Renderer* renderer, AssetManager* assetManager,
+	             unsigned pageSize = ImageAtlas::DEFAULT_PAGE_SIZE,
+	             unsigned padding  = ImageAtlas::DEFAULT_PADDING);
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas(TextureAtlas&&)      = delete;
+	~TextureAtlas() = default;
+
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(TextureAtlas&&)      = delete;
+
+	inline bool isEnabled() const { return _enabled; }
+	inline void setEnabled(bool enabled) { _enabled = enabled; }
+
+	inline const ImageAtlas& images() const { return _images; }
+
+	inline unsigned nPages() const { return _pages.size(); }
+	TextureAspectSP page(unsigned index) const;
+
+	/**
+	 * \brief Pack `image` in a page and make `texture` a view on it.
+	 *
+	 * The view is set on the next call to _update(). Return false if the
+	 * image can not be packed.
+	 */
+	bool pack(TextureAspectSP texture, const Image& image);
+
+	/**
+	 * \brief Use a pre-packed atlas, as written by ImageAtlas::writeIndex().
+	 *
+	 * Textures of packed images become views on pages loaded with `loader`
+	 * instead of being uploaded separately.
+	 */
+	bool loadIndex(const Variant& index, const Path& indexPath,
+	               LoaderManager* loader, Logger& log);
+
+	/// Upload modified pages and setup the pending views.
+	void _update();
+
+protected:
+	struct PendingView {
+		TextureAspectSP texture;
+		TextureAspectSP page;
+		Box2i           rect;
+	};
+	typedef std::vector<TextureAspectSP> PageList;
+	typedef std::vector<PendingView>     PendingViewList;
+
+protected:
+	Renderer*       _renderer;
+	AssetManager*   _assetManager;
+	bool            _enabled;
+	ImageAtlas      _images;
+	PageList        _pages;
+	PendingViewList _pendingViews;
+};
+
+
+}
+
+
+#endif
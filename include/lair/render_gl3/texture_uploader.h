@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_RENDER_GL3_TEXTURE_UPLOADER_H
+#define _LAIR_RENDER_GL3_TEXTURE_UPLOADER_H
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/asset/image.h>
+
+#include <lair/render_gl3/context.h>
+#include <lair/render_gl3/texture.h>
+
+
+namespace lair
+{
+
+
+class Renderer;
+
+
+/**
+ * \brief Upload textures progressively, within a per-frame budget.
+ *
+ * Queued images are copied into pixel buffer objects by a staging thread, so
+ * the main thread only maps / unmaps buffers and issues the GL calls. Each
+ * update() uploads staged textures until the byte or time budget is
+ * exhausted, but always uploads at least one texture to make progress.
+ */
+class TextureUploader {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Stats {
+		unsigned queueDepth;   ///< Textures waiting to be uploaded.
+		unsigned uploadCount;  ///< Textures uploaded by the last update().
+		Size     uploadBytes;  ///< Bytes uploaded by the last update().
+		double   uploadTime;   ///< Seconds spent in the last update().
+		double   avgLatency;   ///< Moving average of the queue-to-GPU latency.
+		double   maxLatency;   ///< Maximum queue-to-GPU latency.
+		uint64   totalCount;
+		uint64   totalBytes;
+	};
+
+public:
+	TextureUploader(Renderer* renderer);
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader(TextureUploader&&)      = delete;
+	~TextureUploader();
+
+	TextureUploader& operator=(const TextureUploader&) = delete;
+	TextureUploader& operator=(TextureUploader&&)      = delete;
+
+	/// Budget per update(). 0 means unlimited.
+	void setBudget(Size bytes, double seconds);
+	inline Size   byteBudget() const { return _byteBudget; }
+	inline double timeBudget() const { return _timeBudget; }
+
+	void enqueue(TextureAspectSP texture, ImageAspectSP image);
+	void update();
+
+	inline const Stats& stats() const { return _stats; }
+
+protected:
+	struct Job {
+		TextureAspectSP   texture;
+		ImageAspectSP     image;
+		Clock::time_point queueTime;
+		GLuint            buffer;
+		Byte*             mapped;
+		std::atomic_bool  staged;
+	};
+	typedef std::unique_ptr<Job> JobUP;
+	typedef std::deque<JobUP>    JobQueue;
+
+protected:
+	bool _stage(Job& job);
+	void _upload(Job& job);
+
+	void _run();
+
+protected:
+	Renderer* _renderer;
+	Context*  _context;
+
+	Size     _byteBudget;
+	double   _timeBudget;
+
+	JobQueue _waiting;
+	JobQueue _staging;
+	Size     _stagingBytes;
+	std::vector<GLuint> _freeBuffers;
+
+	std::mutex              _mutex;
+	std::condition_variable _cond;
+	std::deque<Job*>        _copyQueue;
+	bool                    _running;
+	std::thread             _thread;
+
+	Stats _stats;
+};
+
+
+}
+
+
+#endif
@@ -42,6 +42,8 @@ struct VertexAttrib {
 	GLenum        type;
 	GLboolean     normalized;
 	GLsizei       offset;
+	/// 0 for per-vertex attributes, 1 for per-instance attributes.
+	GLuint        divisor;
 
 	/// Arbitrary order so that sort() group attribs by buffer.
 	inline bool operator<(const VertexAttrib& other) const {
@@ -49,7 +51,7 @@ struct VertexAttrib {
 	}
 };
 
-#define LAIR_VERTEX_ATTRIB_END { nullptr, 0, 0, 0, 0, 0 }
+#define LAIR_VERTEX_ATTRIB_END { nullptr, 0, 0, 0, 0, 0, 0 }
 
 
 class VertexArray {
@@ -61,7 +63,8 @@ public:
 
 public:
 	VertexArray(Renderer* renderer, unsigned index, GLsizei sizeInBytes,
-	            const VertexAttrib* attribs, BufferObject* indices = nullptr);
+	            const VertexAttrib* attribs, BufferObject* indices = nullptr,
+	            GLsizei instanceSizeInBytes = 0);
 	VertexArray(const VertexArray&) = delete;
 	VertexArray(VertexArray&&)      = delete;
 	~VertexArray();
@@ -71,6 +74,7 @@ public:
 
 	inline unsigned index() const { return _index; }
 	inline GLsizei sizeInBytes() const { return _sizeInBytes; }
+	inline GLsizei instanceSizeInBytes() const { return _instanceSizeInBytes; }
 
 	AttribIterator begin() const;
 	AttribIterator end() const;
@@ -80,15 +84,32 @@ public:
 	/// Bind the vao (and set it if required).
 	void setup();
 
+	/**
+	 * \brief Offset per-instance attributes so that instance 0 reads the
+	 * record at index firstInstance. The vao *must* be bound.
+	 *
+	 * This emulates base instance, which is not available in OpenGL 3.3.
+	 */
+	void setInstanceBase(unsigned firstInstance);
+
 	void _release();
 
+protected:
+	typedef std::vector<Size> OffsetList;
+
+protected:
+	void _updatePointers(bool force);
+
 protected:
 	Context*      _context;
 	Renderer*     _renderer;
 	unsigned      _index;
 	GLuint        _vao;
 	GLsizei       _sizeInBytes;
+	GLsizei       _instanceSizeInBytes;
+	unsigned      _instanceBase;
 	AttribList    _attribs;
+	OffsetList    _attribOffsets;
 	BufferObject* _indices;
 };
 
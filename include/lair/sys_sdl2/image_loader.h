@@ -58,6 +58,10 @@ protected:
 };
 
 
+/// Save `image` as a png file at `realPath` (a path on the real file system).
+bool saveImage(const Image& image, const Path& realPath, Logger& log);
+
+
 }
 
 
@@ -73,6 +73,7 @@ public:
 	float    musicVolume;
 	Vector2i windowSize;
 	bool     debugGl;
+	bool     shaderCache;
 };
 
 
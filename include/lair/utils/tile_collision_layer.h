@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _LAIR_UTILS_TILE_COLLISION_LAYER_H
+#define _LAIR_UTILS_TILE_COLLISION_LAYER_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/geometry/aligned_box.h>
+
+#include <lair/utils/tile_map.h>
+
+
+namespace lair
+{
+
+
+/**
+ * \brief The solid tiles of a TileLayer, queried by direct grid indexing.
+ *
+ * Each tile gets the collision flags of its gid in the TileMap (see
+ * TileMap::tileFlags()), which are matched against the hit mask of queries.
+ * Coordinates are in layer space, as rendered by TileLayerComponent: rows
+ * go down from the top of the layer.
+ */
+class TileCollisionLayer {
+public:
+	class MergedBox {
+	public:
+		AlignedBox2 box;
+		uint32      flags;
+	};
+	typedef std::vector<MergedBox> MergedBoxVector;
+
+public:
+	TileCollisionLayer();
+	TileCollisionLayer(const TileMap& tileMap, unsigned layerIndex);
+	TileCollisionLayer(const TileCollisionLayer&) = delete;
+	TileCollisionLayer(TileCollisionLayer&&)      = default;
+	~TileCollisionLayer() = default;
+
+	TileCollisionLayer& operator=(const TileCollisionLayer&) = delete;
+	TileCollisionLayer& operator=(TileCollisionLayer&&)      = default;
+
+	void setFromTileMap(const TileMap& tileMap, unsigned layerIndex);
+	/// Resize the layer and clear all the tiles.
+	void reset(const Vector2i& offsetInTiles, const Vector2i& sizeInTiles,
+	           const Vector2& tileSize);
+
+	inline const Vector2i& offsetInTiles() const { return _offsetInTiles; }
+	inline const Vector2i& sizeInTiles()   const { return _sizeInTiles; }
+	inline const Vector2&  tileSize()      const { return _tileSize; }
+
+	/// Flags of the tile (x, y), 0 outside of the layer.
+	inline uint32 flags(int x, int y) const {
+		if(x < 0 || y < 0 || x >= _sizeInTiles(0) || y >= _sizeInTiles(1))
+			return 0;
+		return _flags[x + y * _sizeInTiles(0)];
+	}
+
+	void setFlags(int x, int y, uint32 flags);
+
+	AlignedBox2 tileBox(int x, int y) const;
+	/// Tiles overlapping `box`, clamped to the layer, max excluded.
+	Box2i tileRange(const AlignedBox2& box) const;
+
+	/// Call `callback(x, y)` for each tile overlapping `box` whose flags
+	/// match `hitMask`, until it returns true.
+	template<typename Callback>
+	bool hitTest(const AlignedBox2& box, uint32 hitMask, const Callback& callback) const {
+		Box2i range = tileRange(box);
+		for(int y = range.min()(1); y < range.max()(1); ++y) {
+			for(int x = range.min()(0); x < range.max()(0); ++x) {
+				if((flags(x, y) & hitMask) && callback(x, y))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	bool hitTest(const AlignedBox2& box, uint32 hitMask = 0x01) const;
+
+	/// Move `box` by `t * motion`, with t in [0, 1], and find the first t
+	/// where it hits a tile matching `hitMask`. Tiles are visited front to
+	/// back. The box is shrunk by a small margin, so sliding along a wall or
+	/// a floor does not count as a hit.
+	bool sweep(const AlignedBox2& box, const Vector2& motion, uint32 hitMask = 0x01,
+	           float* t = nullptr, Vector2i* tile = nullptr) const;
+
+	/// The solid tiles merged in boxes: horizontal runs of tiles with the
+	/// same flags, themselves merged with runs of the same extent on the
+	/// following rows. Recomputed when tiles changed.
+	const MergedBoxVector& mergedBoxes() const;
+
+protected:
+	typedef std::vector<uint32> FlagsVector;
+
+protected:
+	int _column(float x) const;
+	int _row(float y) const;
+	void _mergeBoxes() const;
+
+protected:
+	Vector2i    _offsetInTiles;
+	Vector2i    _sizeInTiles;
+	Vector2     _tileSize;
+	FlagsVector _flags;
+
+	mutable MergedBoxVector _mergedBoxes;
+	mutable bool            _mergedBoxesDirty;
+};
+
+
+}
+
+
+#endif
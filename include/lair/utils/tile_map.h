@@ -137,6 +137,12 @@ public:
 	unsigned      tileSetHTiles() const;
 	unsigned      tileSetVTiles() const;
 
+	/// Collision flags of the tile `gid`, read from the `tile_flags` list of
+	/// the tileset. Used as a hit mask by TileCollisionLayer; 0 means that
+	/// the tile is not solid.
+	uint32 tileFlags(TileIndex gid) const;
+	void setTileFlags(TileIndex gid, uint32 flags);
+
 	bool setFromLdl(LdlParser& parser);
 	void setTileSet(AssetSP tileset, unsigned nHTiles, unsigned nVTiles);
 
@@ -144,10 +150,12 @@ public:
 
 protected:
 	typedef std::vector<TileLayerSP> LayerVector;
+	typedef std::vector<uint32>      FlagsVector;
 
 protected:
 	bool _parseTileSets(LdlParser& parser);
 	bool _parseTileSet(LdlParser& parser);
+	bool _parseTileFlags(LdlParser& parser);
 	bool _parseTileLayers(LdlParser& parser);
 
 protected:
@@ -160,6 +168,7 @@ protected:
 	ImageAspectSP _tileSet;
 	unsigned      _tileSetHTiles;
 	unsigned      _tileSetVTiles;
+	FlagsVector   _tileFlags;
 };
 
 typedef std::shared_ptr<TileMap> TileMapSP;
@@ -20,6 +20,7 @@
 
 
 #include <cctype>
+#include <algorithm>
 
 #include <lair/core/text.h>
 
@@ -60,50 +61,94 @@ BitmapFont::BitmapFont()
       _fontSize(0),
       _height(0),
       _baselineToTop(0),
-      _glyphMap() {
+      _glyphs(1, Glyph{ Box2(Vector2(0, 0), Vector2(0, 0)), Vector2(0, 0), Vector2(0, 0), 0 }),
+      _directIndex(),
+      _sparseIndex(),
+      _defaultGlyph(0),
+      _kerning() {
 }
 
 
-const BitmapFont::Glyph& BitmapFont::glyph(int cp) const {
-	auto git = _glyphMap.find(cp);
-	if(git != _glyphMap.end()) {
-		return git->second;
+void BitmapFont::setGlyph(int cp, const Glyph& glyph) {
+	if(cp >= 0 && cp < DIRECT_RANGE) {
+		_growDirectIndex(cp);
+		uint16& entry = _directIndex[cp];
+		if((entry & INDEX_MASK) != NO_GLYPH) {
+			_glyphs[entry & INDEX_MASK] = glyph;
+			return;
+		}
+		entry = (entry & KERNING_FLAG) | _glyphs.size();
+	}
+	else {
+		auto it = std::lower_bound(_sparseIndex.begin(), _sparseIndex.end(), cp,
+		                           [](const SparseGlyph& g, int cp) { return g.cp < cp; });
+		if(it != _sparseIndex.end() && it->cp == cp) {
+			_glyphs[it->index] = glyph;
+			return;
+		}
+		_sparseIndex.insert(it, SparseGlyph{ cp, unsigned(_glyphs.size()) });
+		if(cp == -1) {
+			_defaultGlyph = _glyphs.size();
+		}
 	}
-	return _glyphMap.find(-1)->second;
-}
-
 
-void BitmapFont::setGlyph(int cp, const Glyph& glyph) {
-	_glyphMap[cp] = glyph;
+	lairAssert(_glyphs.size() < NO_GLYPH);
+	_glyphs.push_back(glyph);
 }
 
 
 int BitmapFont::kerning(int cp0, int cp1) const {
-	auto it = _kerning.find(CharPair(cp0, cp1));
-	if(it == _kerning.end()) {
+	uint64 key = _kerningKey(cp0, cp1);
+	auto it = std::lower_bound(_kerning.begin(), _kerning.end(), key,
+	                           [](const KerningPair& p, uint64 key) { return p.key < key; });
+	if(it == _kerning.end() || it->key != key) {
 		return 0;
 	}
-	return it->second;
+	return it->kern;
 }
 
 
 void BitmapFont::setKerning(int cp0, int cp1, int kern) {
-	_kerning[CharPair(cp0, cp1)] = kern;
+	uint64 key = _kerningKey(cp0, cp1);
+	auto it = std::lower_bound(_kerning.begin(), _kerning.end(), key,
+	                           [](const KerningPair& p, uint64 key) { return p.key < key; });
+	if(it != _kerning.end() && it->key == key) {
+		it->kern = kern;
+	}
+	else {
+		_kerning.insert(it, KerningPair{ key, kern });
+	}
+
+	if(cp0 >= 0 && cp0 < DIRECT_RANGE) {
+		_growDirectIndex(cp0);
+		_directIndex[cp0] |= KERNING_FLAG;
+	}
 }
 
 
 unsigned BitmapFont::textWidth(const std::string& msg) const {
-	unsigned w = 0;
-	for(char c: msg) {
-		auto git = _glyphMap.find(c);
-		if(git != _glyphMap.end()) {
-			w += git->second.advance;
-		}
+	unsigned w   = 0;
+	Codepoint pcp = -1;
+	GlyphRef  pg{ 0, false };
+	Utf8CodepointIterator cpIt(msg);
+	while(cpIt.hasNext()) {
+		Codepoint cp = cpIt.next();
+		GlyphRef  g  = _glyphRef(cp);
+		if(pg.kerning)
+			w += kerning(pcp, cp);
+		w += _glyphs[g.index].advance;
+		pcp = cp;
+		pg  = g;
 	}
 	return w;
 }
 
 
+inline bool _isSpace(Codepoint cp) {
+	return cp >= 0 && cp < 0x80 && std::isspace(cp);
+}
+
+
 TextLayout BitmapFont::layoutText(const std::string& msg, unsigned maxWidth) const {
 	TextLayout layout;
 	int      x = 0;
@@ -113,7 +158,7 @@ TextLayout BitmapFont::layoutText(const std::string& msg, unsigned maxWidth) con
 	while(cpIt.hasNext()) {
 		Utf8CodepointIterator cpIt2(cpIt);
 		int ww = 0;
-		while(cpIt2.hasNext() && !std::isspace(cp = cpIt2.next())) {
+		while(cpIt2.hasNext() && !_isSpace(cp = cpIt2.next())) {
 			ww += glyph(cp).advance;
 		}
 		if(x + ww > int(maxWidth)) {
@@ -121,14 +166,18 @@ TextLayout BitmapFont::layoutText(const std::string& msg, unsigned maxWidth) con
 			y -= _height;
 		}
 		Codepoint pcp = -1;
-		while(cpIt.hasNext() && !std::isspace(cp = cpIt.next())) {
-			x += kerning(pcp, cp);
+		GlyphRef  pg{ 0, false };
+		while(cpIt.hasNext() && !_isSpace(cp = cpIt.next())) {
+			GlyphRef g = _glyphRef(cp);
+			if(pg.kerning)
+				x += kerning(pcp, cp);
 			layout.addGlyph(cp, Vector2(x, y - int(_baselineToTop)));
-			x += glyph(cp).advance;
+			x += _glyphs[g.index].advance;
 			layout.grow(Vector2(x, y - int(_height)));
 			pcp = cp;
+			pg  = g;
 		}
-		if(std::isspace(cp)) {
+		if(_isSpace(cp)) {
 			if(cp == '\n') {
 				x = 0;
 				y -= _height;
@@ -144,15 +193,47 @@ TextLayout BitmapFont::layoutText(const std::string& msg, unsigned maxWidth) con
 }
 
 
+unsigned BitmapFont::_sparseGlyph(int cp) const {
+	auto it = std::lower_bound(_sparseIndex.begin(), _sparseIndex.end(), cp,
+	                           [](const SparseGlyph& g, int cp) { return g.cp < cp; });
+	if(it == _sparseIndex.end() || it->cp != cp) {
+		return _defaultGlyph;
+	}
+	return it->index;
+}
+
+
+void BitmapFont::_growDirectIndex(int cp) {
+	if(cp >= int(_directIndex.size())) {
+		_directIndex.resize(cp + 1, uint16(NO_GLYPH));
+	}
+}
+
+
 unsigned BitmapFont::wordWidth(const std::string& msg, unsigned i, unsigned* ci) const {
 	unsigned w = 0;
-	do {
-		auto git = _glyphMap.find(msg[i]);
-		if(git != _glyphMap.end()) {
-			w += git->second.advance;
+	if(i < msg.size()) {
+		Utf8CodepointIterator cpIt(msg.data() + i, msg.data() + msg.size());
+		Codepoint pcp   = -1;
+		GlyphRef  pg{ 0, false };
+		bool      first = true;
+		while(cpIt.hasNext()) {
+			Utf8CodepointIterator prev(cpIt);
+			Codepoint cp = cpIt.next();
+			if(!first && _isSpace(cp)) {
+				cpIt = prev;
+				break;
+			}
+			GlyphRef g = _glyphRef(cp);
+			if(pg.kerning)
+				w += kerning(pcp, cp);
+			w += _glyphs[g.index].advance;
+			pcp   = cp;
+			pg    = g;
+			first = false;
 		}
-		++i;
-	} while(i < msg.size() && !std::isspace(msg[i]));
+		i = cpIt.pos() - msg.data();
+	}
 	if(ci) *ci = i;
 	return w;
 }
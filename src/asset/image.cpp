@@ -19,6 +19,8 @@
  */
 
 
+#include <cstring>
+
 #include "lair/asset/image.h"
 
 
@@ -48,8 +50,10 @@ Image::Image(unsigned width, unsigned height, Format format,
     : _width(width),
       _height(height),
       _format(format),
-      _data(reinterpret_cast<Byte*>(data),
-            reinterpret_cast<Byte*>(data) + (width * height * formatByteSize(format))) {
+      _data(width * height * formatByteSize(format)) {
+	if(data) {
+		std::memcpy(_data.data(), data, _data.size());
+	}
 }
 
 
@@ -78,6 +82,11 @@ const void* Image::data() const {
 }
 
 
+void* Image::data() {
+	return _data.data();
+}
+
+
 size_t Image::sizeInBytes() const {
 	return sizeof(Image) + _data.size();
 }
@@ -0,0 +1,300 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <limits>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/ldl/write.h>
+
+#include "lair/asset/image_atlas.h"
+
+
+namespace lair {
+
+
+SkylinePacker::SkylinePacker(const Vector2i& size)
+    : _size(),
+      _skyline(),
+      _usedArea(0) {
+	reset(size);
+}
+
+
+float SkylinePacker::occupancy() const {
+	Size area = Size(_size(0)) * Size(_size(1));
+	return area? float(_usedArea) / float(area): 0.f;
+}
+
+
+void SkylinePacker::reset(const Vector2i& size) {
+	_size     = size;
+	_usedArea = 0;
+	_skyline.clear();
+	_skyline.push_back(Node{ 0, 0, size(0) });
+}
+
+
+bool SkylinePacker::pack(const Vector2i& size, Vector2i& pos) {
+	if(size(0) <= 0 || size(1) <= 0)
+		return false;
+
+	int bestIndex  = -1;
+	int bestBottom = std::numeric_limits<int>::max();
+	int bestWidth  = std::numeric_limits<int>::max();
+	int bestY      = 0;
+	for(unsigned i = 0; i < _skyline.size(); ++i) {
+		int y = _fit(i, size);
+		if(y < 0)
+			continue;
+
+		int bottom = y + size(1);
+		if(bottom <  bestBottom
+		|| (bottom == bestBottom && _skyline[i].width < bestWidth)) {
+			bestIndex  = i;
+			bestBottom = bottom;
+			bestWidth  = _skyline[i].width;
+			bestY      = y;
+		}
+	}
+
+	if(bestIndex < 0)
+		return false;
+
+	pos = Vector2i(_skyline[bestIndex].x, bestY);
+	_addNode(bestIndex, pos, size);
+	_usedArea += Size(size(0)) * Size(size(1));
+
+	return true;
+}
+
+
+int SkylinePacker::_fit(unsigned index, const Vector2i& size) const {
+	int x = _skyline[index].x;
+	if(x + size(0) > _size(0))
+		return -1;
+
+	int y = 0;
+	int widthLeft = size(0);
+	while(widthLeft > 0) {
+		if(index == _skyline.size())
+			return -1;
+		y = std::max(y, _skyline[index].y);
+		if(y + size(1) > _size(1))
+			return -1;
+		widthLeft -= _skyline[index].width;
+		++index;
+	}
+
+	return y;
+}
+
+
+void SkylinePacker::_addNode(unsigned index, const Vector2i& pos, const Vector2i& size) {
+	_skyline.insert(_skyline.begin() + index, Node{ pos(0), pos(1) + size(1), size(0) });
+
+	// Shrink or remove the nodes covered by the new one.
+	for(unsigned i = index + 1; i < _skyline.size(); ) {
+		const Node& prev = _skyline[i - 1];
+		Node& node = _skyline[i];
+		int prevEnd = prev.x + prev.width;
+		if(node.x >= prevEnd)
+			break;
+
+		int shrink = prevEnd - node.x;
+		node.x     += shrink;
+		node.width -= shrink;
+		if(node.width > 0)
+			break;
+		_skyline.erase(_skyline.begin() + i);
+	}
+
+	// Merge neighbor nodes at the same height.
+	for(unsigned i = 0; i + 1 < _skyline.size(); ) {
+		if(_skyline[i].y == _skyline[i + 1].y) {
+			_skyline[i].width += _skyline[i + 1].width;
+			_skyline.erase(_skyline.begin() + i + 1);
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+
+//---------------------------------------------------------------------------//
+
+
+ImageAtlas::ImageAtlas(unsigned pageSize, unsigned padding)
+    : _pageSize(pageSize),
+      _padding(padding),
+      _pages(),
+      _entries() {
+}
+
+
+bool ImageAtlas::canPack(const Image& image) const {
+	unsigned maxSize = _pageSize - 2 * _padding;
+	return (image.format() == Image::FormatRGB8
+	     || image.format() == Image::FormatRGBA8)
+	    && image.width()  > 0 && image.width()  <= maxSize
+	    && image.height() > 0 && image.height() <= maxSize;
+}
+
+
+const ImageAtlas::Entry* ImageAtlas::add(const String& name, const Image& image) {
+	auto it = _entries.find(name);
+	if(it != _entries.end())
+		return &it->second;
+
+	if(!canPack(image))
+		return nullptr;
+
+	Vector2i size(image.width()  + 2 * _padding,
+	              image.height() + 2 * _padding);
+	Vector2i pos;
+
+	unsigned page = 0;
+	for(; page < _pages.size(); ++page) {
+		if(_pages[page].packer.pack(size, pos))
+			break;
+	}
+
+	if(page == _pages.size()) {
+		_pages.push_back(Page{
+		    Image(_pageSize, _pageSize, Image::FormatRGBA8),
+		    SkylinePacker(Vector2i(_pageSize, _pageSize)),
+		    Box2i()
+		});
+		bool ok = _pages.back().packer.pack(size, pos);
+		lairAssert(ok);
+	}
+
+	Vector2i min = pos + Vector2i::Constant(_padding);
+	Entry entry{ page, Box2i(min, min + Vector2i(image.width(), image.height())) };
+	_blit(_pages[page], entry.rect, image);
+
+	return &_entries.emplace(name, entry).first->second;
+}
+
+
+const ImageAtlas::Entry* ImageAtlas::find(const String& name) const {
+	auto it = _entries.find(name);
+	return (it != _entries.end())? &it->second: nullptr;
+}
+
+
+const Image& ImageAtlas::pageImage(unsigned page) const {
+	lairAssert(page < _pages.size());
+	return _pages[page].image;
+}
+
+
+const Box2i& ImageAtlas::dirtyRect(unsigned page) const {
+	lairAssert(page < _pages.size());
+	return _pages[page].dirty;
+}
+
+
+void ImageAtlas::_clearDirty(unsigned page) {
+	lairAssert(page < _pages.size());
+	_pages[page].dirty.setEmpty();
+}
+
+
+bool ImageAtlas::writeIndex(LdlWriter& writer, const std::vector<Path>& pageFiles) const {
+	if(pageFiles.size() != _pages.size()) {
+		writer.error("Expected ", _pages.size(), " page files, got ", pageFiles.size());
+		return false;
+	}
+
+	// Sort entries to get a stable output.
+	std::vector<const EntryMap::value_type*> entries;
+	entries.reserve(_entries.size());
+	for(const EntryMap::value_type& entry: _entries)
+		entries.push_back(&entry);
+	std::sort(entries.begin(), entries.end(),
+	          [](const EntryMap::value_type* e0, const EntryMap::value_type* e1) {
+		return e0->first < e1->first;
+	});
+
+	bool success = true;
+
+	writer.openMap(LdlWriter::CF_MULTI_LINE, "ImageAtlas");
+
+	writer.writeKey("pages");
+	writer.openList();
+	for(const Path& file: pageFiles)
+		success &= ldlWrite(writer, file);
+	writer.close();
+
+	writer.writeKey("entries");
+	writer.openMap();
+	for(const EntryMap::value_type* entry: entries) {
+		writer.writeKey(entry->first);
+		writer.openMap(LdlWriter::CF_SINGLE_LINE);
+		writer.writeKey("page");
+		writer.writeInt(entry->second.page);
+		writer.writeKey("rect");
+		success &= ldlWrite(writer, entry->second.rect);
+		writer.close();
+	}
+	writer.close();
+
+	writer.close();
+
+	return success;
+}
+
+
+void ImageAtlas::_blit(Page& page, const Box2i& rect, const Image& image) {
+	const unsigned srcBpp   = Image::formatByteSize(image.format());
+	const unsigned dstBpp   = Image::formatByteSize(Image::FormatRGBA8);
+	const int      padding  = _padding;
+	const int      width    = image.width();
+	const int      height   = image.height();
+	const Byte*    src      = static_cast<const Byte*>(image.data());
+	Byte*          dst      = static_cast<Byte*>(page.image.data());
+
+	// Copy the image and extrude its borders in the padding.
+	for(int y = -padding; y < height + padding; ++y) {
+		int sy = clamp(y, 0, height - 1);
+		const Byte* srcRow = src + sy * width * srcBpp;
+		Byte* dstRow = dst + ((rect.min()(1) + y) * _pageSize + rect.min()(0)) * dstBpp;
+		for(int x = -padding; x < width + padding; ++x) {
+			const Byte* s = srcRow + clamp(x, 0, width - 1) * srcBpp;
+			Byte* d = dstRow + x * int(dstBpp);
+			d[0] = s[0];
+			d[1] = s[1];
+			d[2] = s[2];
+			d[3] = (srcBpp == 4)? s[3]: 255;
+		}
+	}
+
+	Vector2i pad = Vector2i::Constant(padding);
+	page.dirty.extend(rect.min() - pad);
+	page.dirty.extend(rect.max() + pad);
+}
+
+
+}
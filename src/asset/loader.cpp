@@ -23,6 +23,7 @@
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include "lair/asset/loader.h"
 
@@ -212,12 +213,14 @@ void _LoaderThread::wait() {
 
 
 void _LoaderThread::_run() {
+	LAIR_PROFILE_THREAD("loader");
 	_logger.log("Start loader thread ", _thread.get_id(), ".");
 	while(_running) {
 		LoaderSP loader = _manager->_popLoader();
 		// Loader can be null to signal the thread it may be stopped
 		if(loader) {
 			_logger.log("Loading \"", loader->asset()->logicPath(), "\" from thread ", _thread.get_id(), "...");
+			LAIR_PROFILE_SCOPE("Loader::loadSync");
 			loader->loadSync(_logger);
 			_logger.info("Done loading \"", loader->asset()->logicPath(), "\" from thread ", _thread.get_id(), ".");
 		}
@@ -395,6 +398,7 @@ void LoaderManager::_finalize(LoaderList::iterator loaderIt) {
 	// This is thread-safe because only the main thread can set the LOADED state.
 	if(loader->state() == Loader::READY) {
 		//log().info("Finalize \"", loader->asset()->logicPath(), "\"...");
+		LAIR_PROFILE_SCOPE("Loader::commit");
 		loader->commit();
 	}
 
@@ -0,0 +1,269 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include <lair/core/lair.h>
+
+#include "lair/core/profiler.h"
+
+
+namespace lair
+{
+
+
+namespace {
+
+struct ThreadTrackCache {
+	unsigned profiler;
+	void*    track;
+};
+
+// Profiler ids start at 1, so the cache is initially invalid.
+std::atomic<unsigned> nextProfilerId(1);
+thread_local ThreadTrackCache threadTrackCache = { 0, nullptr };
+
+void writeJsonString(std::ostream& out, const char* str) {
+	out << '"';
+	for(const char* c = str; *c; ++c) {
+		switch(*c) {
+		case '"':  out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n";  break;
+		case '\t': out << "\\t";  break;
+		default:
+			if(static_cast<unsigned char>(*c) < 0x20)
+				out << ' ';
+			else
+				out << *c;
+		}
+	}
+	out << '"';
+}
+
+}
+
+
+Profiler::Profiler(unsigned bufferSize)
+    : _id(nextProfilerId++),
+      _bufferSize(std::max(bufferSize, 1u)),
+      _capturing(false),
+      _startTime(0),
+      _tracksMutex(),
+      _tracks() {
+}
+
+
+Profiler::~Profiler() {
+}
+
+
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+
+uint64 Profiler::now() {
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+void Profiler::start() {
+	clear();
+	_startTime = now();
+	_capturing.store(true, std::memory_order_relaxed);
+}
+
+
+void Profiler::stop() {
+	_capturing.store(false, std::memory_order_relaxed);
+}
+
+
+void Profiler::clear() {
+	std::lock_guard<std::mutex> lock(_tracksMutex);
+	for(TrackPtr& track: _tracks) {
+		std::lock_guard<std::mutex> trackLock(track->mutex);
+		track->count = 0;
+	}
+}
+
+
+void Profiler::setThreadName(const String& name) {
+	Track* track = _threadTrack();
+	std::lock_guard<std::mutex> lock(track->mutex);
+	track->name = name;
+}
+
+
+unsigned Profiler::currentTrack() {
+	return _threadTrack()->index;
+}
+
+
+unsigned Profiler::track(const String& name) {
+	std::lock_guard<std::mutex> lock(_tracksMutex);
+	return _findOrCreateTrack(name, std::thread::id())->index;
+}
+
+
+unsigned Profiler::_enterZone() {
+	return _threadTrack()->depth++;
+}
+
+
+void Profiler::_leaveZone(const char* name, uint64 begin, uint64 end) {
+	Track* track = _threadTrack();
+	lairAssert(track->depth);
+	track->depth -= 1;
+	_push(track, ProfileEvent{ name, begin, end, track->index, track->depth });
+}
+
+
+void Profiler::addEvent(unsigned track, const char* name, uint64 begin, uint64 end,
+                        unsigned depth) {
+	Track* t;
+	{
+		std::lock_guard<std::mutex> lock(_tracksMutex);
+		lairAssert(track < _tracks.size());
+		t = _tracks[track].get();
+	}
+	_push(t, ProfileEvent{ name, begin, end, track, depth });
+}
+
+
+ProfileEventList Profiler::events() const {
+	ProfileEventList events;
+
+	std::lock_guard<std::mutex> lock(_tracksMutex);
+	for(const TrackPtr& track: _tracks) {
+		std::lock_guard<std::mutex> trackLock(track->mutex);
+		uint64 count = std::min<uint64>(track->count, _bufferSize);
+		uint64 first = track->count - count;
+		auto begin = events.size();
+		for(uint64 i = first; i < track->count; ++i) {
+			events.push_back(track->events[i % _bufferSize]);
+		}
+		std::stable_sort(events.begin() + begin, events.end(),
+		                 [](const ProfileEvent& e0, const ProfileEvent& e1) {
+			return e0.begin < e1.begin;
+		});
+	}
+
+	return events;
+}
+
+
+bool Profiler::writeChromeTrace(std::ostream& out) const {
+	ProfileEventList evs = events();
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	{
+		std::lock_guard<std::mutex> lock(_tracksMutex);
+		for(const TrackPtr& track: _tracks) {
+			std::lock_guard<std::mutex> trackLock(track->mutex);
+			if(track->name.empty())
+				continue;
+			out << (first? "": ",\n")
+			    << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+			    << track->index << ",\"args\":{\"name\":";
+			writeJsonString(out, track->name.c_str());
+			out << "}}";
+			first = false;
+		}
+	}
+
+	// Chrome trace use microseconds.
+	for(const ProfileEvent& event: evs) {
+		int64 begin = int64(event.begin) - int64(_startTime);
+		out << (first? "": ",\n") << "{\"name\":";
+		writeJsonString(out, event.name);
+		out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track
+		    << ",\"ts\":"  << double(begin) / 1000.
+		    << ",\"dur\":" << double(event.end - event.begin) / 1000.
+		    << "}";
+		first = false;
+	}
+
+	out << "\n]}\n";
+
+	return bool(out);
+}
+
+
+bool Profiler::writeChromeTrace(const Path& path) const {
+	std::ofstream out(path.native().c_str());
+	if(!out)
+		return false;
+	return writeChromeTrace(out);
+}
+
+
+Profiler::Track* Profiler::_threadTrack() {
+	if(threadTrackCache.profiler == _id)
+		return static_cast<Track*>(threadTrackCache.track);
+
+	Track* track;
+	{
+		std::lock_guard<std::mutex> lock(_tracksMutex);
+		track = _findOrCreateTrack(String(), std::this_thread::get_id());
+	}
+
+	threadTrackCache = ThreadTrackCache{ _id, track };
+	return track;
+}
+
+
+Profiler::Track* Profiler::_findOrCreateTrack(const String& name, std::thread::id thread) {
+	for(TrackPtr& track: _tracks) {
+		if(track->thread == thread
+		&& (thread != std::thread::id() || track->name == name))
+			return track.get();
+	}
+
+	TrackPtr track(new Track);
+	track->name   = name;
+	track->thread = thread;
+	track->index  = _tracks.size();
+	track->depth  = 0;
+	track->count  = 0;
+	track->events.resize(_bufferSize);
+
+	_tracks.push_back(std::move(track));
+	return _tracks.back().get();
+}
+
+
+void Profiler::_push(Track* track, const ProfileEvent& event) {
+	// Only contended while events are being exported.
+	std::lock_guard<std::mutex> lock(track->mutex);
+	track->events[track->count % _bufferSize] = event;
+	track->count += 1;
+}
+
+
+}
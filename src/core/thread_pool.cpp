@@ -0,0 +1,125 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/lair.h>
+#include <lair/core/profiler.h>
+
+#include "lair/core/thread_pool.h"
+
+
+namespace lair
+{
+
+
+ThreadPool::ThreadPool(int nWorkers)
+    : _workers(),
+      _generation(0),
+      _running(0),
+      _stop(false),
+      _task(nullptr),
+      _nTasks(0),
+      _nextTask(0) {
+	if(nWorkers < 0) {
+		nWorkers = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+	}
+
+	_workers.reserve(nWorkers);
+	for(int i = 0; i < nWorkers; ++i) {
+		_workers.emplace_back(&ThreadPool::_work, this);
+	}
+}
+
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_start.notify_all();
+
+	for(std::thread& worker: _workers) {
+		worker.join();
+	}
+}
+
+
+void ThreadPool::run(unsigned nTasks, const Task& task) {
+	if(!nTasks)
+		return;
+
+	if(_workers.empty() || nTasks == 1) {
+		for(unsigned i = 0; i < nTasks; ++i) {
+			task(i);
+		}
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_task     = &task;
+		_nTasks   = nTasks;
+		_nextTask = 0;
+		_running  = _workers.size();
+		_generation += 1;
+	}
+	_start.notify_all();
+
+	_runTasks();
+
+	// Workers must be done before task goes out of scope.
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this] { return _running == 0; });
+	_task = nullptr;
+}
+
+
+void ThreadPool::_work() {
+	LAIR_PROFILE_THREAD("worker");
+	uint64 generation = 0;
+	while(true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_start.wait(lock, [&] { return _stop || _generation != generation; });
+			if(_stop)
+				return;
+			generation = _generation;
+		}
+
+		_runTasks();
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_running -= 1;
+		if(_running == 0) {
+			_done.notify_one();
+		}
+	}
+}
+
+
+void ThreadPool::_runTasks() {
+	unsigned i;
+	while((i = _nextTask.fetch_add(1)) < _nTasks) {
+		(*_task)(i);
+	}
+}
+
+
+}
@@ -21,6 +21,8 @@
 
 #include <json/json.h>
 
+#include <lair/core/profiler.h>
+
 #include <lair/asset/bitmap_font.h>
 
 #include <lair/sys_sdl2/image_loader.h>
@@ -153,7 +155,12 @@ BitmapTextComponent::BitmapTextComponent(Manager* manager, _Entity* entity)
       _color(1, 1, 1, 1),
       _size(0, 0),
       _anchor(0, 0),
-      _blendingMode(BLEND_NONE) {
+      _blendingMode(BLEND_NONE),
+      _layoutFont(nullptr),
+      _layoutDirty(true),
+      _layout(),
+      _glyphQuads(),
+      _layoutBox() {
 }
 
 
@@ -164,6 +171,7 @@ BitmapTextComponent::Manager* BitmapTextComponent::manager() {
 
 void BitmapTextComponent::setFont(BitmapFontAspectSP font) {
 	_font = font;
+	_layoutDirty = true;
 }
 
 
@@ -222,6 +230,23 @@ const PropertyList& BitmapTextComponent::properties() {
 }
 
 
+void BitmapTextComponent::_updateLayout(const BitmapFont& font) {
+	if(!_layoutDirty && _layoutFont == &font)
+		return;
+
+	unsigned width = (_size(0) > 0)? _size(0): 999999;
+	_layout = font.layoutText(_text, width);
+	bitmapGlyphQuads(_glyphQuads, font, _layout, _anchor);
+
+	_layoutBox.setEmpty();
+	for(const BitmapGlyphQuad& quad: _glyphQuads)
+		_layoutBox.extend(quad.coords);
+
+	_layoutFont  = &font;
+	_layoutDirty = false;
+}
+
+
 //---------------------------------------------------------------------------//
 
 
@@ -255,10 +280,11 @@ void BitmapTextComponentManager::createTextures() {
 
 
 void BitmapTextComponentManager::render(EntityRef entity, float interp, const OrthographicCamera& camera) {
+	LAIR_PROFILE_SCOPE("BitmapTextComponentManager::render");
 	compactArray();
 
-	_states.shader   = _spriteRenderer->shader()->get();
-	_states.vertices = _spriteRenderer->vertexArray();
+	_states.shader   = _spriteRenderer->spriteShader()->get();
+	_states.vertices = _spriteRenderer->spriteVertexArray();
 
 	_render(entity, interp, camera);
 }
@@ -304,60 +330,101 @@ void BitmapTextComponentManager::_render(EntityRef entity, float interp, const O
 						  comp->_entity()->prevWorldTransform.matrix(),
 						  comp->_entity()->worldTransform.matrix());
 
-		unsigned width = (comp->size()(0) > 0)? comp->size()(0): 999999;
-		TextLayout layout = font.layoutText(comp->text(), width);
+		comp->_updateLayout(font);
 
-		float depth = 1.f - normalize(wt(2, 3), camera.viewBox().min()(2),
-		                                        camera.viewBox().max()(2));
-		renderBitmapText(_renderPass, _spriteRenderer, font, textureSet,
-		                 wt, depth, layout, comp->anchor(), comp->color(),
-		                 camera.transform(), comp->blendingMode());
+		Box2 box = transformedBox(wt, comp->_layoutBox);
+		if(camera.isVisible(box)) {
+			float depth = 1.f - normalize(wt(2, 3), camera.viewBox().min()(2),
+			                                        camera.viewBox().max()(2));
+			renderBitmapText(_renderPass, _spriteRenderer, textureSet,
+			                 wt, depth, comp->_glyphQuads, comp->color(),
+			                 camera.transform(), comp->blendingMode());
+		}
+		else {
+			_renderPass->notifyCulled();
+		}
 	}
 
 	EntityRef child = entity.firstChild();
 	while(child.isValid()) {
-		render(child, interp, camera);
+		if(!child.isCached())
+			render(child, interp, camera);
 		child = child.nextSibling();
 	}
 }
 
 
+inline Box2 _glyphCoords(const BitmapFont& font, const TextLayout& layout,
+                         unsigned i, const Vector2& anchor) {
+	const BitmapFont::Glyph& glyph = font.glyph(layout.glyph(i).codepoint);
+	Vector2 pos  = layout.glyph(i).pos;
+	Vector2 size = glyph.size;
+
+	pos(0) += glyph.offset(0);
+	pos(1) += font.height() - size(1) - glyph.offset(1)
+	        + layout.box().sizes()(1);
+	pos -= layout.box().sizes().cwiseProduct(anchor);
+	return Box2(pos, pos + size);
+}
+
+
+Box2 bitmapTextBox(const BitmapFont& font, const TextLayout& layout,
+                   const Vector2& anchor) {
+	Box2 box;
+	for(unsigned i = 0; i < layout.nGlyphs(); ++i) {
+		box.extend(_glyphCoords(font, layout, i, anchor));
+	}
+	return box;
+}
+
+
+void bitmapGlyphQuads(BitmapGlyphQuadList& quads, const BitmapFont& font,
+                      const TextLayout& layout, const Vector2& anchor) {
+	quads.resize(layout.nGlyphs());
+	for(unsigned i = 0; i < layout.nGlyphs(); ++i) {
+		quads[i].coords    = _glyphCoords(font, layout, i, anchor);
+		quads[i].texCoords = font.glyph(layout.glyph(i).codepoint).region;
+	}
+}
+
+
 void renderBitmapText(RenderPass* pass, SpriteRenderer* renderer,
                       const BitmapFont& font, const TextureSetCSP& textureSet,
                       const Matrix4& transform, float depth,
                       const TextLayout& layout, const Vector2& anchor,
                       const Vector4& color, const Matrix4& viewTransform,
                       BlendingMode blendingMode) {
-	unsigned index = renderer->indexCount();
-	for(unsigned i = 0; i < layout.nGlyphs(); ++i) {
-		unsigned cp = layout.glyph(i).codepoint;
-		Vector2 pos = layout.glyph(i).pos;
-		const BitmapFont::Glyph& glyph = font.glyph(cp);
+	BitmapGlyphQuadList quads;
+	bitmapGlyphQuads(quads, font, layout, anchor);
+	renderBitmapText(pass, renderer, textureSet, transform, depth, quads,
+	                 color, viewTransform, blendingMode);
+}
 
-		Vector2 size = glyph.size;
 
-		pos(0) += glyph.offset(0);
-		pos(1) += font.height() - size(1) - glyph.offset(1)
-		        + layout.box().sizes()(1);
-		pos -= layout.box().sizes().cwiseProduct(anchor);
-		Box2 coords(pos, pos + size);
+void renderBitmapText(RenderPass* pass, SpriteRenderer* renderer,
+                      const TextureSetCSP& textureSet,
+                      const Matrix4& transform, float depth,
+                      const BitmapGlyphQuadList& quads,
+                      const Vector4& color, const Matrix4& viewTransform,
+                      BlendingMode blendingMode) {
+	if(quads.empty())
+		return;
 
-		renderer->addSprite(transform, coords, color, glyph.region);
+	unsigned index = renderer->spriteIndex();
+	Vector4 linearColor = linearFromSrgb(color);
+	for(const BitmapGlyphQuad& quad: quads) {
+		renderer->addSprite(quad.coords, linearColor, quad.texCoords);
 	}
-	unsigned count = renderer->indexCount() - index;
 
-	if(count) {
-		RenderPass::DrawStates states;
-		states.shader       = renderer->shader()->get();
-		states.vertices     = renderer->vertexArray();
-		states.textureSet   = textureSet;
-		states.blendingMode = blendingMode;
+	RenderPass::DrawStates states;
+	states.textureSet   = textureSet;
+	states.blendingMode = blendingMode;
 
-		const ShaderParameter* params = renderer->addShaderParameters(
-		            renderer->shader(), viewTransform, 0, Vector4i(1, 1, 65536, 65536));
+	const ShaderParameter* params = renderer->addShaderParameters(
+	            renderer->spriteShader(), viewTransform, transform, 0,
+	            Vector4i(1, 1, 65536, 65536));
 
-		pass->addDrawCall(states, params, depth, index, count);
-	}
+	renderer->addSpriteDrawCall(pass, states, params, depth, index);
 }
 
 }
@@ -19,13 +19,23 @@
  */
 
 
+#include <algorithm>
+
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
+#include <lair/core/thread_pool.h>
+
+#include <lair/geometry/octree.h>
+#include <lair/geometry/hash_grid.h>
+#include <lair/geometry/sweep_and_prune.h>
 
 #include <lair/render_gl3/orthographic_camera.h>
 #include <lair/render_gl3/texture.h>
 #include <lair/render_gl3/renderer.h>
 
+#include <lair/utils/tile_collision_layer.h>
+
 #include <lair/ec/sprite_renderer.h>
 
 #include "lair/ec/collision_component.h"
@@ -40,8 +50,11 @@ CollisionComponent::CollisionComponent(Manager* manager, _Entity* entity, const
     , _debugColor (0, 1, 0, .2)
 	, _hitMask    (1u)
 	, _ignoreMask (0u)
+	, _id         (manager->_allocateId())
 	, _dirty      (true)
     , _firstElem  (nullptr)
+    , _transformVersion(0)
+    , _moved      (false)
 {
 }
 
@@ -69,22 +82,57 @@ const PropertyList& CollisionComponent::properties() {
 
 CollisionComponentManager::CollisionComponentManager(size_t componentBlockSize)
 	: DenseComponentManager<CollisionComponent>("collision", componentBlockSize)
-    , _quadTree(AlignedBox2(Vector2(0, 0), Vector2(4096, 4096)))
+    , _bounds(Vector2(0, 0), Vector2(4096, 4096))
+    , _broadphaseType(BROADPHASE_QUADTREE)
+    , _broadphase(new BroadphaseAdapter<Octree<_Element>>(_bounds))
+    , _nextId(1)
+    , _threadPool(nullptr)
+    , _debugRenderer()
+    , _debugOutlines(false)
 {
 }
 
 
 void CollisionComponentManager::setBounds(const AlignedBox2& bounds) {
 	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
-		// QuadTree::reset clears the tree, so mark nodes dirty so they are re-inserted.
+		// Broadphase::reset clears the tree, so mark nodes dirty so they are re-inserted.
 		_components[ci0].setDirty();
 	}
 
-	_quadTree.reset(bounds);
+	_bounds = bounds;
+	_broadphase->reset(bounds);
+}
+
+
+void CollisionComponentManager::setBroadphase(BroadphaseType type, float cellSize) {
+	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
+		// Elements are owned by the broadphase: forget them and re-insert
+		// everything in the new one.
+		_components[ci0].setDirty();
+		_components[ci0]._firstElem = nullptr;
+	}
+
+	_broadphaseType = type;
+	switch(type) {
+	case BROADPHASE_QUADTREE:
+		_broadphase.reset(new BroadphaseAdapter<Octree<_Element>>(_bounds));
+		break;
+	case BROADPHASE_LOOSE_QUADTREE:
+		_broadphase.reset(new BroadphaseAdapter<Octree<_Element>>(_bounds, 8, 2.f));
+		break;
+	case BROADPHASE_HASH_GRID:
+		_broadphase.reset(new BroadphaseAdapter<HashGrid<_Element>>(cellSize));
+		break;
+	case BROADPHASE_SWEEP_AND_PRUNE:
+		_broadphase.reset(new BroadphaseAdapter<SweepAndPrune<_Element>>());
+		break;
+	}
 }
 
 
 void CollisionComponentManager::findCollisions() {
+	LAIR_PROFILE_SCOPE("CollisionComponentManager::findCollisions");
+
 	// Set all unusable shapes dirty: this will remove their elements from the list.
 	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
 		CollisionComponent& c0 = _components[ci0];
@@ -92,21 +140,91 @@ void CollisionComponentManager::findCollisions() {
 		if(!c0.isAlive() || !c0.isEnabled() || !c0.entity().isEnabledRec())
 			c0.setDirty();
 
-		if(c0.isDirty())
+		if(c0.isDirty()) {
 			c0._firstElem = nullptr;
+			continue;
+		}
+
+		// Moved colliders are refit below. If the shapes were changed
+		// without setting the component dirty, re-insert everything.
+		if(c0.entity().worldTransformVersion() != c0._transformVersion) {
+			unsigned nElems = 0;
+			for(_Element* elem = c0._firstElem; elem; elem = elem->next)
+				++nElems;
+
+			if(nElems == c0.shapes().size()) {
+				c0._moved = true;
+			}
+			else {
+				c0.setDirty();
+				c0._firstElem = nullptr;
+			}
+		}
 	}
 
 	// Filter out dirty elements.
-	_quadTree.filterIf(_FilterDirtyElement(this));
-
-	// Filter out hitEvents with a dirty Entity.
-	auto dirtyEventsBegin = std::remove_if(_hitEvents.begin(), _hitEvents.end(), _FilterDirty(this));
-	_hitEvents.erase(dirtyEventsBegin, _hitEvents.end());
+	_broadphase->filterIf(_FilterDirtyElement(this));
+
+	// Contacts with a dirty or moved Entity are stale: they end unless found
+	// again below. The others stay without being tested.
+	_contactBegins.clear();
+	_contactEnds.clear();
+	_staleContacts.clear();
+	_staleIds.clear();
+	_foundIds.clear();
+
+	_FilterDirty isDirty(this);
+	unsigned nKept = 0;
+	for(const HitEvent& hit: _hitEvents) {
+		if(isDirty(hit)) {
+			_staleContacts.push_back(hit);
+			_staleIds.insert(hit.pairId);
+		}
+		else {
+			_hitEvents[nKept++] = hit;
+		}
+	}
+	_hitEvents.resize(nKept);
 
 	compactArray();
 
-	// Update dirty entities
-	HitEvent hit;
+	// Refit moved entities in place. All of them must be refit before testing
+	// any, or a moved entity could be tested against stale elements.
+	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
+		CollisionComponent& c0 = _components[ci0];
+		if(!c0._moved)
+			continue;
+
+		// Elements are chained in the reverse order of the shapes.
+		const Transform& wt = c0.entity().worldTransform();
+		unsigned si = c0.shapes().size();
+		for(_Element* elem = c0._firstElem; elem; elem = elem->next) {
+			--si;
+			elem->shape = c0.shapes()[si].transformed(wt);
+			elem->box   = elem->shape.boundingBox();
+			_broadphase->update(elem);
+		}
+
+		c0._transformVersion = c0.entity().worldTransformVersion();
+	}
+
+	_queryElements.clear();
+	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
+		CollisionComponent& c0 = _components[ci0];
+		if(!c0._moved)
+			continue;
+
+		for(_Element* elem = c0._firstElem; elem; elem = elem->next)
+			_queryElements.push_back(elem);
+
+		c0._moved = false;
+	}
+	_findAllHits();
+
+	// Insert dirty entities, then test them in a second pass. Each new
+	// element is only tested against the older ones (see _Element::order),
+	// as if they were inserted and tested one at a time.
+	_queryElements.clear();
 	for(unsigned ci0 = 0; ci0 < nComponents(); ++ci0) {
 		CollisionComponent& c0 = _components[ci0];
 
@@ -115,6 +233,7 @@ void CollisionComponentManager::findCollisions() {
 			continue;
 
 		c0.setDirty(false);
+		c0._transformVersion = c0.entity().worldTransformVersion();
 
 		_Element* next = nullptr;
 		for(const Shape2D& shape: c0.shapes()) {
@@ -122,30 +241,26 @@ void CollisionComponentManager::findCollisions() {
 			e0.entity = c0.entity();
 			e0.shape  = shape.transformed(c0.entity().worldTransform());
 			e0.box    = e0.shape.boundingBox();
+			e0.order  = _queryElements.size() + 1;
 
-			_quadTree.hitTest(e0.box, [&hit, &e0, this](_Element& e1) {
-				CollisionComponent* comp0 = get(e0.entity);
-				CollisionComponent* comp1 = get(e1.entity);
-				if(comp0 != comp1
-				&& (comp0->hitMask() & comp1->hitMask())    != 0
-				&& (comp0->hitMask() & comp1->ignoreMask()) == 0
-				&& (comp0->hitMask() & comp1->ignoreMask()) == 0
-				&& e0.shape.intersect(e1.shape)) {
-					hit.entities[0] = e0.entity;
-					hit.entities[1] = e1.entity;
-					_hitEvents.push_back(hit);
-				}
-
-				return false;
-			});
-
-			_Element* elem = _quadTree.insert(e0);
+			_Element* elem = _broadphase->insert(e0);
 			elem->next = next;
 			next = elem;
+			_queryElements.push_back(elem);
 		}
 
 		c0._firstElem = next;
 	}
+	_findAllHits();
+
+	for(_Element* elem: _queryElements)
+		elem->order = 0;
+
+	for(const HitEvent& hit: _staleContacts) {
+		if(!_foundIds.count(hit.pairId))
+			_contactEnds.push_back(hit);
+	}
+	_staleContacts.clear();
 }
 
 
@@ -153,12 +268,8 @@ bool CollisionComponentManager::hitTest(std::deque<EntityRef>& hits, const Align
                                         unsigned hitMask, EntityRef dontPick) {
 	bool found = false;
 
-	_quadTree.hitTest(box, [this, &hits, hitMask, &dontPick, &found](_Element& e) {
-		CollisionComponent* comp = get(e.entity);
-		if( comp
-		&& e.entity != dontPick
-		&& (hitMask & comp->hitMask())    != 0
-		&& (hitMask & comp->ignoreMask()) == 0) {
+	_broadphase->hitTest(box, [this, &hits, hitMask, &dontPick, &found](_Element& e) {
+		if(_isPickable(e, hitMask, dontPick)) {
 			hits.push_back(e.entity);
 			found = true;
 		}
@@ -166,6 +277,17 @@ bool CollisionComponentManager::hitTest(std::deque<EntityRef>& hits, const Align
 		return false;
 	});
 
+	for(const _TileLayer& tileLayer: _tileLayers) {
+		if(!tileLayer.entity.isValid() || tileLayer.entity == dontPick)
+			continue;
+
+		Vector2 offset = tileLayer.entity.worldTransform().translation().head<2>();
+		if(tileLayer.layer->hitTest(AlignedBox2(box.min() - offset, box.max() - offset), hitMask)) {
+			hits.push_back(tileLayer.entity);
+			found = true;
+		}
+	}
+
 	return found;
 }
 
@@ -176,14 +298,124 @@ bool CollisionComponentManager::hitTest(std::deque<EntityRef>& hits, const Vecto
 }
 
 
+void CollisionComponentManager::addTileLayer(EntityRef entity, const TileCollisionLayer* layer) {
+	lairAssert(layer);
+	_tileLayers.push_back(_TileLayer{ entity, layer });
+}
+
+
+void CollisionComponentManager::removeTileLayer(const TileCollisionLayer* layer) {
+	_tileLayers.erase(std::remove_if(_tileLayers.begin(), _tileLayers.end(),
+	                                 [layer](const _TileLayer& tl) { return tl.layer == layer; }),
+	                  _tileLayers.end());
+}
+
+
+bool CollisionComponentManager::raycast(RaycastHit& hit, const Vector2& origin,
+                                        const Vector2& direction, float maxT,
+                                        unsigned hitMask, EntityRef dontPick) {
+	bool found = false;
+
+	_broadphase->raycast(origin, direction, maxT, Vector2::Zero(),
+	                     [&](_Element& e, float& tMax) {
+		float t;
+		if(_isPickable(e, hitMask, dontPick)
+		&& e.shape.raycast(origin, direction, tMax, &t)) {
+			hit.entity = e.entity;
+			hit.t      = t;
+			tMax       = t;
+			found      = true;
+		}
+
+		return false;
+	});
+
+	return found;
+}
+
+
+bool CollisionComponentManager::shapeCast(RaycastHit& hit, const Shape2D& shape,
+                                          const Vector2& motion,
+                                          unsigned hitMask, EntityRef dontPick) {
+	bool found = false;
+
+	// Cast the bounding box center, with the items enlarged by its half-size.
+	AlignedBox2 box = shape.boundingBox();
+	_broadphase->raycast(box.center(), motion, 1, box.sizes() / 2,
+	                     [&](_Element& e, float& tMax) {
+		float t;
+		if(_isPickable(e, hitMask, dontPick)
+		&& shape.sweep(motion, e.shape, tMax, &t)) {
+			hit.entity = e.entity;
+			hit.t      = t;
+			tMax       = t;
+			found      = true;
+		}
+
+		return false;
+	});
+
+	return found;
+}
+
+
+unsigned CollisionComponentManager::nearest(NearestHit* hits, unsigned k, const Vector2& p,
+                                            float maxDist, unsigned hitMask,
+                                            EntityRef dontPick) {
+	if(k == 0)
+		return 0;
+
+	unsigned nHits = 0;
+
+	_broadphase->nearest(p, maxDist, [&](_Element& e, float& dMax) {
+		if(!_isPickable(e, hitMask, dontPick))
+			return false;
+
+		float d = std::max(e.shape.distance(p), 0.f);
+		if(d > dMax)
+			return false;
+
+		// An entity with several shapes is kept once, at its closest distance.
+		unsigned i = 0;
+		while(i < nHits && hits[i].entity != e.entity)
+			++i;
+		if(i < nHits) {
+			if(hits[i].distance <= d)
+				return false;
+		}
+		else if(nHits < k) {
+			i = nHits++;
+		}
+		else {
+			i = nHits - 1;
+		}
+
+		// hits is sorted and slot i is free: shift up the entries farther
+		// than d, insert, and prune the search once the buffer is full.
+		for(; i && hits[i - 1].distance > d; --i)
+			hits[i] = hits[i - 1];
+		hits[i].entity   = e.entity;
+		hits[i].distance = d;
+
+		if(nHits == k)
+			dMax = hits[k - 1].distance;
+
+		return false;
+	});
+
+	return nHits;
+}
+
+
 void CollisionComponentManager::update(EntityRef entity) {
+	LAIR_PROFILE_SCOPE("CollisionComponentManager::update");
 	CollisionComponent* comp = get(entity);
 
 	if(comp) {
 		_Element* elem = comp->_firstElem;
 		while(elem) {
 			_Element* next = elem->next;
-			_quadTree.remove(elem);
+			_broadphase->remove(elem);
 			elem = next;
 		}
 
@@ -193,23 +425,122 @@ void CollisionComponentManager::update(EntityRef entity) {
 			e.entity = entity;
 			e.shape  = shape.transformed(comp->entity().worldTransform());
 			e.box    = e.shape.boundingBox();
+			e.order  = 0;
 
-			_Element* elem = _quadTree.insert(e);
+			_Element* elem = _broadphase->insert(e);
 			elem->next = next;
 			next = elem;
 		}
+
+		comp->_firstElem = next;
+		comp->_transformVersion = entity.worldTransformVersion();
 	}
 }
 
 
+void CollisionComponentManager::_findAllHits() {
+	// Queries only read the broadphase, so chunks can run in parallel. Hits
+	// are deduplicated and merged in chunk order, which gives the same events
+	// as a serial run.
+	static const unsigned grainSize = 64;
+
+	unsigned nElems  = _queryElements.size();
+	unsigned nChunks = parallelChunkCount(_threadPool, nElems, grainSize);
+	if(!nElems)
+		return;
+
+	if(_chunks.size() < nChunks)
+		_chunks.resize(nChunks);
+	parallelFor(_threadPool, nElems, grainSize,
+	            [this](unsigned chunk, unsigned begin, unsigned end) {
+		_Chunk& ch = _chunks[chunk];
+		ch.hits.clear();
+		for(unsigned i = begin; i < end; ++i)
+			_findHits(ch, *_queryElements[i]);
+	});
+
+	for(unsigned chunk = 0; chunk < nChunks; ++chunk) {
+		// Colliders with several shapes may hit each other more than once.
+		for(const _Hit& h: _chunks[chunk].hits) {
+			if(!_foundIds.insert(h.pairId).second)
+				continue;
+
+			HitEvent hit;
+			hit.entities[0] = h.elements[0]->entity;
+			hit.entities[1] = h.elements[1]->entity;
+			hit.pairId      = h.pairId;
+			_hitEvents.push_back(hit);
+			if(!_staleIds.count(hit.pairId))
+				_contactBegins.push_back(hit);
+		}
+	}
+}
+
+
+void CollisionComponentManager::_findHits(_Chunk& chunk, const _Element& e0) {
+	chunk.candidates.clear();
+	_broadphase->hitTest(e0.box, [this, &chunk, &e0](_Element& e1) {
+		if(e0.order && e1.order >= e0.order)
+			return false;
+
+		CollisionComponent* comp0 = _get(e0.entity._get());
+		CollisionComponent* comp1 = _get(e1.entity._get());
+		if(comp0 != comp1
+		&& (comp0->hitMask() & comp1->hitMask())    != 0
+		&& (comp0->hitMask() & comp1->ignoreMask()) == 0
+		&& (comp0->hitMask() & comp1->ignoreMask()) == 0)
+			chunk.candidates.push_back(&e1);
+		return false;
+	});
+
+	// Sphere-sphere and box-box tests are done in batch, the other
+	// combinations one at a time.
+	Shape2DType type = e0.shape.type();
+	chunk.batchElements.clear();
+	chunk.boxBatch.clear();
+	chunk.sphereBatch.clear();
+	for(_Element* e1: chunk.candidates) {
+		if(type == SHAPE_ALIGNED_BOX && e1->shape.isAlignedBox()) {
+			chunk.batchElements.push_back(e1);
+			chunk.boxBatch.push_back(e1->shape.asAlignedBox());
+		}
+		else if(type == SHAPE_SPHERE && e1->shape.isSphere()) {
+			chunk.batchElements.push_back(e1);
+			chunk.sphereBatch.push_back(e1->shape.asSphere());
+		}
+		else if(e0.shape.intersect(e1->shape)) {
+			_pushHit(chunk, e0, *e1);
+		}
+	}
+
+	if(chunk.batchElements.empty())
+		return;
+
+	chunk.batchHits.resize(chunk.batchElements.size());
+	unsigned nHits = (type == SHAPE_SPHERE)?
+	            intersect(e0.shape.asSphere(),     chunk.sphereBatch, chunk.batchHits.data()):
+	            intersect(e0.shape.asAlignedBox(), chunk.boxBatch,    chunk.batchHits.data());
+	for(unsigned i = 0; i < nHits; ++i)
+		_pushHit(chunk, e0, *chunk.batchElements[chunk.batchHits[i]]);
+}
+
+
+void CollisionComponentManager::_pushHit(_Chunk& chunk, const _Element& e0, const _Element& e1) {
+	_Hit hit;
+	hit.elements[0] = &e0;
+	hit.elements[1] = &e1;
+	hit.pairId      = pairId(_get(e0.entity._get())->id(), _get(e1.entity._get())->id());
+	chunk.hits.push_back(hit);
+}
+
+
 void CollisionComponentManager::render(
         SpriteRenderer* spriteRenderer, RenderPass* renderPass,
         TextureSetCSP texture, const OrthographicCamera& camera) {
-	RenderPass::DrawStates states;
-	states.shader     = spriteRenderer->shader()->get();
-	states.vertices   = spriteRenderer->vertexArray();
-	states.textureSet = texture;
-	states.blendingMode = BLEND_ALPHA;
+	// All the shapes go in a single draw call, so use the depth of the
+	// frontmost one.
+	float depth = 1.f;
+	Matrix4 trans = Matrix4::Identity();
 
 	for(unsigned ci = 0; ci < nComponents(); ++ci) {
 		CollisionComponent& comp = _components[ci];
@@ -219,21 +550,24 @@ void CollisionComponentManager::render(
 
 		const Transform& wt = comp.entity().worldTransform();
 		float z = wt(2, 3) + 0.0001;
-		float depth = 1.f - normalize(z, camera.viewBox().min()(2),
-		                                 camera.viewBox().max()(2));
-		const ShaderParameter* params = spriteRenderer->addShaderParameters(
-		            spriteRenderer->shader(), camera.transform(), 0, Vector4i(1, 1, 1, 1));
-
-		Matrix4 trans = Matrix4::Identity();
 		trans(2, 3) = z;
 
 		for(_CollisionComponentElement* elem = comp._firstElem; elem; elem = elem->next) {
-			unsigned index = spriteRenderer->indexCount();
-			spriteRenderer->addShape(trans, elem->shape, comp.debugColor());
-			unsigned count = spriteRenderer->indexCount() - index;
-			renderPass->addDrawCall(states, params, depth, index, count);
+			if(!camera.isVisible(elem->box)) {
+				renderPass->notifyCulled();
+				continue;
+			}
+
+			depth = std::min(depth, 1.f - normalize(z, camera.viewBox().min()(2),
+			                                           camera.viewBox().max()(2)));
+			if(_debugOutlines)
+				_debugRenderer.addOutline(trans, elem->shape, comp.debugColor());
+			else
+				_debugRenderer.addShape(trans, elem->shape, comp.debugColor());
 		}
 	}
+
+	_debugRenderer.render(renderPass, spriteRenderer, texture, camera.transform(), depth);
 }
 
 
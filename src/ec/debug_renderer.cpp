@@ -0,0 +1,274 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cmath>
+
+#include <lair/core/lair.h>
+
+#include "lair/ec/debug_renderer.h"
+
+
+namespace lair
+{
+
+
+DebugRenderer::DebugRenderer(unsigned circleSegments)
+    : _unitCircle(),
+      _points(),
+      _batches(),
+      _vertexCount(0) {
+	lairAssert(circleSegments >= 3);
+	_unitCircle.reserve(circleSegments);
+	for(unsigned i = 0; i < circleSegments; ++i) {
+		float alpha = 2 * M_PI * float(i) / float(circleSegments);
+		_unitCircle.emplace_back(std::cos(alpha), std::sin(alpha));
+	}
+}
+
+
+void DebugRenderer::addShape(const Matrix4& trans, const Sphere2& sphere,
+                             const Vector4& color, BlendingMode blendingMode) {
+	Batch& batch = _triangles(blendingMode);
+	unsigned vi    = batch.vertices.size();
+	unsigned count = _unitCircle.size();
+
+	batch.vertices.reserve(vi + count);
+	batch.indices.reserve(batch.indices.size() + 3 * (count - 2));
+
+	Vector4 center;
+	center << sphere.center(), 0, 1;
+	center = trans * center;
+	Vector4 axis0 = trans.col(0) * sphere.radius();
+	Vector4 axis1 = trans.col(1) * sphere.radius();
+
+	for(unsigned i = 0; i < count; ++i) {
+		const Vector2& v = _unitCircle[i];
+		batch.vertices.push_back(SpriteVertex{
+		    center + axis0 * v(0) + axis1 * v(1), color, v / 2 + Vector2(.5, .5) });
+
+		if(i > 1) {
+			batch.indices.push_back(vi);
+			batch.indices.push_back(vi + i - 1);
+			batch.indices.push_back(vi + i);
+		}
+	}
+
+	_vertexCount += count;
+}
+
+
+void DebugRenderer::addShape(const Matrix4& trans, const AlignedBox2& box,
+                             const Vector4& color, BlendingMode blendingMode) {
+	Vector2 corners[4];
+	for(int i = 0; i < 4; ++i)
+		corners[i] = box.corner(i);
+	_addQuad(_triangles(blendingMode), trans, corners, color);
+}
+
+
+void DebugRenderer::addShape(const Matrix4& trans, const OrientedBox2& box,
+                             const Vector4& color, BlendingMode blendingMode) {
+	Vector2 corners[4];
+	for(int i = 0; i < 4; ++i)
+		corners[i] = box.corner(i);
+	_addQuad(_triangles(blendingMode), trans, corners, color);
+}
+
+
+void DebugRenderer::addShape(const Matrix4& trans, const Shape2D& shape,
+                             const Vector4& color, BlendingMode blendingMode) {
+	switch(shape.type()) {
+	case SHAPE_SPHERE:
+		addShape(trans, shape.asSphere(), color, blendingMode);
+		break;
+	case SHAPE_ALIGNED_BOX:
+		addShape(trans, shape.asAlignedBox(), color, blendingMode);
+		break;
+	case SHAPE_ORIENTED_BOX:
+		addShape(trans, shape.asOrientedBox(), color, blendingMode);
+		break;
+	default:
+		break;
+	}
+}
+
+
+void DebugRenderer::addOutline(const Matrix4& trans, const Sphere2& sphere,
+                               const Vector4& color, BlendingMode blendingMode) {
+	_points.resize(_unitCircle.size());
+	for(unsigned i = 0; i < _unitCircle.size(); ++i)
+		_points[i] = sphere.center() + _unitCircle[i] * sphere.radius();
+	_addLoop(_lines(blendingMode), trans, _points.data(), _points.size(), color);
+}
+
+
+void DebugRenderer::addOutline(const Matrix4& trans, const AlignedBox2& box,
+                               const Vector4& color, BlendingMode blendingMode) {
+	// Corners in loop order.
+	Vector2 points[4] = { box.corner(0), box.corner(1), box.corner(3), box.corner(2) };
+	_addLoop(_lines(blendingMode), trans, points, 4, color);
+}
+
+
+void DebugRenderer::addOutline(const Matrix4& trans, const OrientedBox2& box,
+                               const Vector4& color, BlendingMode blendingMode) {
+	Vector2 points[4] = { box.corner(0), box.corner(1), box.corner(3), box.corner(2) };
+	_addLoop(_lines(blendingMode), trans, points, 4, color);
+}
+
+
+void DebugRenderer::addOutline(const Matrix4& trans, const Shape2D& shape,
+                               const Vector4& color, BlendingMode blendingMode) {
+	switch(shape.type()) {
+	case SHAPE_SPHERE:
+		addOutline(trans, shape.asSphere(), color, blendingMode);
+		break;
+	case SHAPE_ALIGNED_BOX:
+		addOutline(trans, shape.asAlignedBox(), color, blendingMode);
+		break;
+	case SHAPE_ORIENTED_BOX:
+		addOutline(trans, shape.asOrientedBox(), color, blendingMode);
+		break;
+	default:
+		break;
+	}
+}
+
+
+void DebugRenderer::addLine(const Vector3& p0, const Vector3& p1, const Vector4& color,
+                            BlendingMode blendingMode) {
+	Batch& batch = _lines(blendingMode);
+	unsigned vi = batch.vertices.size();
+	batch.vertices.push_back(SpriteVertex{ (Vector4() << p0, 1).finished(), color, Vector2(.5, .5) });
+	batch.vertices.push_back(SpriteVertex{ (Vector4() << p1, 1).finished(), color, Vector2(.5, .5) });
+	batch.indices.push_back(vi);
+	batch.indices.push_back(vi + 1);
+	_vertexCount += 2;
+}
+
+
+void DebugRenderer::render(RenderPass* pass, SpriteRenderer* spriteRenderer,
+                           TextureSetCSP textureSet, const Matrix4& viewTransform,
+                           float depth) {
+	if(isEmpty())
+		return;
+
+	RenderPass::DrawStates states;
+	states.shader     = spriteRenderer->shader()->get();
+	states.vertices   = spriteRenderer->vertexArray();
+	states.textureSet = textureSet;
+
+	const ShaderParameter* params = spriteRenderer->addShaderParameters(
+	            spriteRenderer->shader(), viewTransform, 0, Vector4i(1, 1, 1, 1));
+
+	for(int bm = 0; bm < N_BLENDING_MODES; ++bm) {
+		states.blendingMode = BlendingMode(bm);
+		_flush(pass, spriteRenderer, states, params, depth,
+		       _triangles(BlendingMode(bm)), gl::TRIANGLES);
+		_flush(pass, spriteRenderer, states, params, depth,
+		       _lines(BlendingMode(bm)), gl::LINES);
+	}
+
+	_vertexCount = 0;
+}
+
+
+void DebugRenderer::clear() {
+	for(Batch& batch: _batches) {
+		batch.vertices.clear();
+		batch.indices.clear();
+	}
+	_vertexCount = 0;
+}
+
+
+DebugRenderer::Batch& DebugRenderer::_triangles(BlendingMode blendingMode) {
+	lairAssert(blendingMode >= 0 && blendingMode < N_BLENDING_MODES);
+	return _batches[2 * blendingMode];
+}
+
+
+DebugRenderer::Batch& DebugRenderer::_lines(BlendingMode blendingMode) {
+	lairAssert(blendingMode >= 0 && blendingMode < N_BLENDING_MODES);
+	return _batches[2 * blendingMode + 1];
+}
+
+
+void DebugRenderer::_addQuad(Batch& batch, const Matrix4& trans, const Vector2* corners,
+                             const Vector4& color) {
+	unsigned vi = batch.vertices.size();
+	for(unsigned i = 0; i < 4; ++i) {
+		Vector4 p;
+		p << corners[i], 0, 1;
+		batch.vertices.push_back(SpriteVertex{
+		    trans * p, color, Vector2((i&1)? 1: 0, (i&2)? 1: 0) });
+	}
+
+	static const unsigned quadIndices[] = { 0, 1, 2, 2, 1, 3 };
+	for(unsigned index: quadIndices)
+		batch.indices.push_back(vi + index);
+
+	_vertexCount += 4;
+}
+
+
+void DebugRenderer::_addLoop(Batch& batch, const Matrix4& trans, const Vector2* points,
+                             unsigned count, const Vector4& color) {
+	unsigned vi = batch.vertices.size();
+	batch.vertices.reserve(vi + count);
+	batch.indices.reserve(batch.indices.size() + 2 * count);
+
+	for(unsigned i = 0; i < count; ++i) {
+		Vector4 p;
+		p << points[i], 0, 1;
+		batch.vertices.push_back(SpriteVertex{ trans * p, color, Vector2(.5, .5) });
+		batch.indices.push_back(vi + i);
+		batch.indices.push_back(vi + (i + 1) % count);
+	}
+
+	_vertexCount += count;
+}
+
+
+void DebugRenderer::_flush(RenderPass* pass, SpriteRenderer* spriteRenderer,
+                           const RenderPass::DrawStates& states, const ShaderParameter* params,
+                           float depth, Batch& batch, GLenum primitive) {
+	if(batch.indices.empty())
+		return;
+
+	// Indices are relative to the batch, rebase them in place since the batch
+	// is cleared anyway.
+	unsigned baseVertex = spriteRenderer->vertexCount();
+	for(unsigned& index: batch.indices)
+		index += baseVertex;
+
+	unsigned firstIndex = spriteRenderer->indexCount();
+	spriteRenderer->addVertices(batch.vertices.data(), batch.vertices.size());
+	spriteRenderer->addIndices(batch.indices.data(), batch.indices.size());
+
+	pass->addDrawCall(states, params, depth, firstIndex, batch.indices.size(), primitive);
+
+	batch.vertices.clear();
+	batch.indices.clear();
+}
+
+
+}
@@ -206,7 +206,7 @@ void EntityRef::destroy() {
 
 
 void _updateWorldTransformsHelper(_Entity* entity, const Transform& parentTransform) {
-	entity->worldTransform = parentTransform * entity->transform;
+	entity->setWorldTransform(parentTransform * entity->transform);
 
 	_Entity* child = entity->firstChild;
 	while(child) {
@@ -223,7 +223,7 @@ void EntityRef::updateWorldTransformRec() {
 
 
 void _setPrevWorldTransformsHelper(_Entity* entity, const Transform& parentTransform) {
-	entity->worldTransform = parentTransform * entity->transform;
+	entity->setWorldTransform(parentTransform * entity->transform);
 	entity->prevWorldTransform = entity->worldTransform;
 
 	_Entity* child = entity->firstChild;
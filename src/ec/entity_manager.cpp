@@ -24,6 +24,7 @@
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include <lair/meta/var_list.h>
 #include <lair/meta/var_map.h>
@@ -371,6 +372,7 @@ void EntityManager::setPrevWorldTransforms() {
 void EntityManager::updateWorldTransforms() {
 	// TODO: Update this algorithm when using homogenous arrays to make it
 	// more cache-firendly.
+	LAIR_PROFILE_SCOPE("EntityManager::updateWorldTransforms");
 
 	_updateWorldTransformsHelper(_root._get(), Transform::Identity());
 }
@@ -414,7 +416,7 @@ _Entity* EntityManager::_createDetachedEntity(const char* name) {
 
 void EntityManager::_updateWorldTransformsHelper(
         _Entity* entity, const Transform& parentTransform) {
-	entity->worldTransform = parentTransform * entity->transform;
+	entity->setWorldTransform(parentTransform * entity->transform);
 
 	_Entity* child = entity->firstChild;
 	while(child) {
@@ -0,0 +1,223 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <sstream>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/render_gl3/renderer.h>
+#include <lair/render_gl3/sampler.h>
+
+#include "lair/ec/layer_cache.h"
+
+
+namespace lair
+{
+
+
+LayerCache::LayerCache(Renderer* renderer, RenderPass* renderPass, SpriteRenderer* spriteRenderer)
+    : _renderer(renderer),
+      _renderPass(renderPass),
+      _spriteRenderer(spriteRenderer),
+      _id(0),
+      _root(),
+      _bounds(),
+      _scale(1),
+      _tileSize(DEFAULT_TILE_SIZE),
+      _renderFunction(),
+      _valid(false),
+      _tilesDirty(true),
+      _tiles(),
+      _rebuildCount(0),
+      _states() {
+	lairAssert(_renderer);
+	lairAssert(_renderPass);
+	lairAssert(_spriteRenderer);
+
+	static unsigned nextId = 0;
+	_id = nextId++;
+}
+
+
+LayerCache::~LayerCache() {
+	setRoot(EntityRef());
+}
+
+
+void LayerCache::setRoot(EntityRef root) {
+	if(_root.isValid())
+		_root.setCached(false);
+
+	_root = root;
+	if(_root.isValid())
+		_root.setCached(true);
+
+	_valid = false;
+}
+
+
+void LayerCache::setBounds(const Box2& bounds) {
+	_bounds     = bounds;
+	_valid      = false;
+	_tilesDirty = true;
+}
+
+
+void LayerCache::setScale(Scalar scale) {
+	_scale      = scale;
+	_valid      = false;
+	_tilesDirty = true;
+}
+
+
+void LayerCache::setTileSize(unsigned tileSize) {
+	_tileSize   = tileSize;
+	_valid      = false;
+	_tilesDirty = true;
+}
+
+
+bool LayerCache::update(const OrthographicCamera& camera) {
+	if(_valid || !_root.isValid() || !_renderFunction)
+		return false;
+
+	if(_tilesDirty)
+		_createTiles();
+
+	Vector3 origin = _root.worldTransform().translation();
+	for(Tile& tile: _tiles) {
+		_renderTile(tile, origin, camera);
+	}
+
+	_renderPass->setFramebuffer(nullptr);
+	_renderPass->setClearBuffers(0);
+	_renderPass->clear();
+
+	_valid = true;
+	_rebuildCount += 1;
+
+	return true;
+}
+
+
+void LayerCache::render(float interp, const OrthographicCamera& camera) {
+	if(!_valid || !_root.isValid() || !_root.isEnabled())
+		return;
+
+	_states.shader       = _spriteRenderer->spriteShader()->get();
+	_states.vertices     = _spriteRenderer->spriteVertexArray();
+	_states.blendingMode = BLEND_ALPHA;
+
+	Matrix4 trans = Matrix4::Identity();
+	trans.block<3, 1>(0, 3) = _root.interpPosition3(interp);
+
+	float depth = 1.f - normalize(trans(2, 3), camera.viewBox().min()(2),
+	                                           camera.viewBox().max()(2));
+
+	// Framebuffer textures are bottom-up, unlike images.
+	Box2 texCoords(Vector2(0.001, 0.999), Vector2(0.999, 0.001));
+	Vector4i tileInfo(1, 1, _tileSize, _tileSize);
+
+	for(const Tile& tile: _tiles) {
+		if(!camera.isVisible(transformedBox(trans, tile.box))) {
+			_renderPass->notifyCulled();
+			continue;
+		}
+
+		unsigned index = _spriteRenderer->spriteIndex();
+		_spriteRenderer->addSprite(trans, tile.box, Vector4(1, 1, 1, 1), texCoords);
+
+		_states.textureSet = tile.textureSet;
+
+		const ShaderParameter* params = _spriteRenderer->addShaderParameters(
+		            _spriteRenderer->spriteShader(), camera.transform(), 0, tileInfo);
+
+		_spriteRenderer->addSpriteDrawCall(_renderPass, _states, params, depth, index);
+	}
+}
+
+
+void LayerCache::_createTiles() {
+	_tiles.clear();
+	_tilesDirty = false;
+
+	if(_bounds.isEmpty() || _scale <= 0 || _tileSize == 0)
+		return;
+
+	Scalar  tileExtent = _tileSize / _scale;
+	Vector2 size       = _bounds.sizes();
+	unsigned nx = std::max(1u, unsigned(std::ceil(size(0) / tileExtent)));
+	unsigned ny = std::max(1u, unsigned(std::ceil(size(1) / tileExtent)));
+
+	SamplerSP sampler = _renderer->getSampler(
+	            SamplerParams(SamplerParams::BILINEAR_NO_MIPMAP | SamplerParams::CLAMP));
+
+	_tiles.reserve(nx * ny);
+	for(unsigned y = 0; y < ny; ++y) {
+		for(unsigned x = 0; x < nx; ++x) {
+			std::ostringstream name;
+			name << "/__builtin__/layer_cache_" << _id << "_" << x << "_" << y;
+			TextureAspectSP texture =
+			        _renderer->createRenderTexture(name.str(), _tileSize, _tileSize);
+
+			Tile tile;
+			tile.framebuffer.reset(new Framebuffer(_renderer));
+			if(!tile.framebuffer->create(texture))
+				continue;
+
+			Vector2 min = _bounds.min() + Vector2(x, y) * tileExtent;
+			tile.box        = Box2(min, min + Vector2(tileExtent, tileExtent));
+			tile.textureSet = _spriteRenderer->getTextureSet(TexColor, texture, sampler);
+			_tiles.push_back(std::move(tile));
+		}
+	}
+
+	_renderer->log().info("Layer cache ", _id, ": ", _tiles.size(), " tiles of ",
+	                      _tileSize, "x", _tileSize);
+}
+
+
+void LayerCache::_renderTile(Tile& tile, const Vector3& origin,
+                             const OrthographicCamera& camera) {
+	Box3 viewBox;
+	viewBox.min() << origin.head<2>() + tile.box.min(), camera.viewBox().min()(2);
+	viewBox.max() << origin.head<2>() + tile.box.max(), camera.viewBox().max()(2);
+
+	OrthographicCamera tileCamera;
+	tileCamera.setViewBox(viewBox);
+
+	_renderPass->setFramebuffer(tile.framebuffer.get());
+	_renderPass->setClearBuffers(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+
+	bool buffersFilled = false;
+	while(!buffersFilled) {
+		_renderPass->clear();
+		_spriteRenderer->beginRender();
+		_renderFunction(_root, 1, tileCamera);
+		buffersFilled = _spriteRenderer->endRender();
+	}
+
+	_renderPass->render();
+}
+
+
+}
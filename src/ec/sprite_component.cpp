@@ -20,6 +20,8 @@
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
+#include <lair/core/thread_pool.h>
 
 #include <lair/render_gl3/orthographic_camera.h>
 #include <lair/render_gl3/texture.h>
@@ -43,7 +45,9 @@ SpriteComponent::SpriteComponent(Manager* manager,_Entity* entity)
       _tileGridSize(1, 1),
       _tileIndex(0),
       _view(Vector2(0, 0), Vector2(1, 1)),
-      _blendingMode(BLEND_NONE) {
+      _blendingMode(BLEND_NONE),
+      _atlasSource(),
+      _atlasSet() {
 }
 
 
@@ -56,8 +60,17 @@ SpriteComponent::Manager* SpriteComponent::manager() {
 }
 
 
+void SpriteComponent::setTextureSet(TextureSetCSP textureSet) {
+	_textureSet = textureSet;
+	if(_textureSet) {
+		manager()->spriteRenderer()->renderer()->packInAtlas(
+		            _textureSet->getTextureAspect(TexColor));
+	}
+}
+
+
 void SpriteComponent::setTextureSet(const TextureSet& textureSet) {
-	_textureSet = manager()->spriteRenderer()->getTextureSet(textureSet);
+	setTextureSet(manager()->spriteRenderer()->getTextureSet(textureSet));
 }
 
 
@@ -69,8 +82,8 @@ TextureAspectSP SpriteComponent::texture() const {
 void SpriteComponent::setTexture(TextureAspectSP texture) {
 	SamplerSP sampler = _textureSet? _textureSet->getSampler(TexColor):
 	                                 manager()->spriteRenderer()->defaultSampler();
-	_textureSet = manager()->spriteRenderer()->getTextureSet(
-	                  TexColor, texture, sampler);
+	setTextureSet(manager()->spriteRenderer()->getTextureSet(
+	                  TexColor, texture, sampler));
 }
 
 
@@ -128,6 +141,16 @@ Box2 SpriteComponent::_texCoords() const {
 	return boxView(tileBox(nTiles, _tileIndex), _view);
 }
 
+TextureSetCSP SpriteComponent::_atlasTextureSet(const Texture* texColor) {
+	lairAssert(texColor && texColor->isAtlasView());
+	if(_atlasSource != _textureSet || !_atlasSet) {
+		_atlasSource = _textureSet;
+		_atlasSet = manager()->spriteRenderer()->getTextureSet(
+		                TexColor, texColor->atlasPage(), _textureSet->getSampler(TexColor));
+	}
+	return _atlasSet;
+}
+
 inline bool SpriteComponent::_renderCompare(SpriteComponent* c0, SpriteComponent* c1) {
 	return c0->_blendingMode <  c1->_blendingMode
 	   || (c0->_blendingMode == c1->_blendingMode
@@ -146,8 +169,11 @@ SpriteComponentManager::SpriteComponentManager(AssetManager* assetManager,
       _assets(assetManager),
       _loader(loaderManager),
       _spriteRenderer(spriteRenderer),
-	  _renderPass(renderPass),
-      _states() {
+      _renderPass(renderPass),
+      _threadPool(nullptr),
+      _states(),
+      _renderItems(),
+      _chunks() {
 	lairAssert(_assets);
 	lairAssert(_loader);
 	lairAssert(_spriteRenderer);
@@ -159,12 +185,86 @@ SpriteComponentManager::~SpriteComponentManager() {
 
 
 void SpriteComponentManager::render(EntityRef entity, float interp, const OrthographicCamera& camera) {
+	LAIR_PROFILE_SCOPE("SpriteComponentManager::render");
 //	compactArray();
 
-	_states.shader   = _spriteRenderer->shader()->get();
-	_states.vertices = _spriteRenderer->vertexArray();
+	// Sprites are rendered in three steps: a serial scene graph traversal
+	// gathers the sprites to render, then worker threads compute them and
+	// write their vertices in a range of the mapped buffer reserved for the
+	// visible ones, and finally per-chunk draw calls are merged in order.
+	static const unsigned grainSize = 256;
+
+	_states.shader   = _spriteRenderer->spriteShader()->get();
+	_states.vertices = _spriteRenderer->spriteVertexArray();
+
+	_renderItems.clear();
+	_gather(entity);
+
+	unsigned nItems  = _renderItems.size();
+	unsigned nChunks = parallelChunkCount(_threadPool, nItems, grainSize);
+	if(!nItems)
+		return;
 
-	_render(entity, interp, camera);
+	_chunks.resize(nChunks);
+	parallelFor(_threadPool, nItems, grainSize,
+	            [&](unsigned chunk, unsigned begin, unsigned end) {
+		unsigned visibleCount = 0;
+		for(unsigned i = begin; i < end; ++i) {
+			_computeItem(_renderItems[i], interp, camera);
+			visibleCount += _renderItems[i].visible;
+		}
+		_chunks[chunk].visibleCount = visibleCount;
+	});
+
+	unsigned spriteCount = 0;
+	for(_Chunk& chunk: _chunks) {
+		chunk.firstSprite = spriteCount;
+		spriteCount += chunk.visibleCount;
+	}
+	_renderPass->notifyCulled(nItems - spriteCount);
+
+	SpriteRange range = _spriteRenderer->reserveSprites(spriteCount);
+	parallelFor(_threadPool, nItems, grainSize,
+	            [&](unsigned chunk, unsigned begin, unsigned end) {
+		_Chunk& ch = _chunks[chunk];
+		ch.batches.clear();
+
+		unsigned index = ch.firstSprite;
+		for(unsigned i = begin; i < end; ++i) {
+			const _RenderItem& item = _renderItems[i];
+			if(!item.visible)
+				continue;
+
+			SpriteRenderer::fillSprite(range, index, item.transform, item.coords,
+			                           item.sprite->color(), item.texCoords);
+
+			if(!ch.batches.empty()
+			&& _canMerge(_renderItems[ch.batches.back().item], item)) {
+				ch.batches.back().count += 1;
+			}
+			else {
+				_Batch batch = { i, index, 1 };
+				ch.batches.push_back(batch);
+			}
+			++index;
+		}
+	});
+
+	// Shader parameters are allocated from an arena that is not thread-safe.
+	for(unsigned chunk = 0; chunk < nChunks; ++chunk) {
+		for(const _Batch& batch: _chunks[chunk].batches) {
+			const _RenderItem& item = _renderItems[batch.item];
+
+			_states.textureSet   = item.textureSet;
+			_states.blendingMode = item.sprite->blendingMode();
+
+			const ShaderParameter* params = _spriteRenderer->addShaderParameters(
+			            _spriteRenderer->spriteShader(), camera.transform(), 0, item.tileInfo);
+
+			_spriteRenderer->addSpriteDrawCall(_renderPass, _states, params, item.depth,
+			                                   range, batch.first, batch.count);
+		}
+	}
 }
 
 
@@ -183,7 +283,7 @@ SpriteRenderer* SpriteComponentManager::spriteRenderer() {
 }
 
 
-void SpriteComponentManager::_render(EntityRef entity, float interp, const OrthographicCamera& camera) {
+void SpriteComponentManager::_gather(EntityRef entity) {
 	if ( !entity.isEnabled() )
 		return;
 
@@ -198,46 +298,69 @@ void SpriteComponentManager::_render(EntityRef entity, float interp, const Ortho
 			textureSet = _spriteRenderer->defaultTextureSet();
 			texColor = textureSet->getTexture(TexColor);
 		}
+		else if(texColor->isAtlasView()) {
+			textureSet = sc->_atlasTextureSet(texColor);
+		}
 	}
 
 	if(texColor) {
-		Matrix4 wt = lerp(interp,
-		                  sc->_entity()->prevWorldTransform.matrix(),
-		                  sc->_entity()->worldTransform.matrix());
+		_renderItems.emplace_back();
+		_RenderItem& item = _renderItems.back();
+		item.sprite     = sc;
+		item.textureSet = textureSet;
+		item.texColor   = texColor;
+	}
 
-		Box2 texCoords = sc->_texCoords();
-		Scalar w = texColor->width()  * texCoords.sizes()(0);
-		Scalar h = texColor->height() * texCoords.sizes()(1);
-		Vector2 offset(-w * sc->anchor().x(),
-		               -h * sc->anchor().y());
-		Box2 coords(offset, Vector2(w, h) + offset);
+	EntityRef child = entity.firstChild();
+	while(child.isValid()) {
+		if(!child.isCached())
+			_gather(child);
+		child = child.nextSibling();
+	}
+}
 
-		texCoords = boxView(texCoords, Box2(Vector2(0.001, 0.001), Vector2(0.999, 0.999)));
 
-		unsigned index = _spriteRenderer->indexCount();
-		_spriteRenderer->addSprite(wt, coords, sc->color(), texCoords);
-		unsigned count = _spriteRenderer->indexCount() - index;
+void SpriteComponentManager::_computeItem(_RenderItem& item, float interp,
+                                          const OrthographicCamera& camera) const {
+	const SpriteComponent* sc       = item.sprite;
+	const Texture*         texColor = item.texColor;
 
-		if(count) {
-			_states.textureSet   = textureSet;
-			_states.blendingMode = sc->blendingMode();
+	item.transform = lerp(interp,
+	                      sc->_entity()->prevWorldTransform.matrix(),
+	                      sc->_entity()->worldTransform.matrix());
 
-			Vector4i tileInfo;
-			tileInfo << sc->tileGridSize(), texColor->width(), texColor->height();
-			const ShaderParameter* params = _spriteRenderer->addShaderParameters(
-			            _spriteRenderer->shader(), camera.transform(), 0, tileInfo);
+	Box2 texCoords = sc->_texCoords();
+	Scalar w = texColor->width()  * texCoords.sizes()(0);
+	Scalar h = texColor->height() * texCoords.sizes()(1);
+	Vector2 offset(-w * sc->anchor().x(),
+	               -h * sc->anchor().y());
+	item.coords = Box2(offset, Vector2(w, h) + offset);
 
-			float depth = 1.f - normalize(wt(2, 3), camera.viewBox().min()(2),
-			                                        camera.viewBox().max()(2));
-			_renderPass->addDrawCall(_states, params, depth, index, count);
-		}
-	}
+	texCoords = boxView(texCoords, Box2(Vector2(0.001, 0.001), Vector2(0.999, 0.999)));
 
-	EntityRef child = entity.firstChild();
-	while(child.isValid()) {
-		render(child, interp, camera);
-		child = child.nextSibling();
+	// Tile clamping works on the whole GL texture, so disable it for
+	// packed textures: the atlas padding prevents bleeding.
+	if(texColor->isAtlasView()) {
+		const Texture& page = texColor->atlasPage()->get();
+		texCoords = boxView(texColor->region(), texCoords);
+		item.tileInfo << 1, 1, page.width(), page.height();
+	}
+	else {
+		item.tileInfo << sc->tileGridSize(), texColor->width(), texColor->height();
 	}
+	item.texCoords = texCoords;
+
+	item.visible = camera.isVisible(transformedBox(item.transform, item.coords));
+	item.depth   = 1.f - normalize(item.transform(2, 3), camera.viewBox().min()(2),
+	                                                     camera.viewBox().max()(2));
+}
+
+
+bool SpriteComponentManager::_canMerge(const _RenderItem& item0, const _RenderItem& item1) const {
+	return item0.textureSet == item1.textureSet
+	    && item0.sprite->blendingMode() == item1.sprite->blendingMode()
+	    && item0.tileInfo == item1.tileInfo
+	    && item0.depth == item1.depth;
 }
 
 
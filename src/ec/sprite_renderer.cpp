@@ -19,10 +19,12 @@
  */
 
 
+#include <algorithm>
 #include <functional>
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/hash.h>
 
 #include <lair/asset/loader.h>
 
@@ -41,19 +43,19 @@ static const VertexAttribInfo _spriteVertexAttribSet[] = {
 };
 
 
-static const TextureUnit _texColor = { 0, "sprite_color" };
-const TextureUnit* TexColor = &_texColor;
-
-
-//---------------------------------------------------------------------------//
+static const VertexAttribInfo _spriteInstanceAttribSet[] = {
+    { "vx_corner",    IxCorner },
+    { "vx_transform", IxTransform },
+    { "vx_offset",    IxOffset },
+    { "vx_coords",    IxCoords },
+    { "vx_texCoords", IxTexCoords },
+    { "vx_color",     IxColor },
+    LAIR_VERTEX_ATTRIB_INFO_END
+};
 
 
-SpriteShaderParams::SpriteShaderParams(const Matrix4& viewMatrix, int texUnit, const Vector4i& tileInfo)
-	: viewMatrix(viewMatrix),
-	  texUnit(texUnit),
-	  tileInfo(tileInfo.cast<float>()) {
-	params[0].index = -1;
-}
+static const TextureUnit _texColor = { 0, "sprite_color" };
+const TextureUnit* TexColor = &_texColor;
 
 
 //---------------------------------------------------------------------------//
@@ -63,7 +65,9 @@ SpriteShader::SpriteShader()
     : shader       (nullptr),
       viewMatrixLoc(-1),
       textureLoc   (-1),
-      tileInfoLoc (-1) {
+      tileInfoLoc  (-1),
+      viewBlockIndex    (gl::INVALID_INDEX),
+      materialBlockIndex(gl::INVALID_INDEX) {
 }
 
 
@@ -72,16 +76,27 @@ SpriteShader::SpriteShader(ShaderAspectSP shader)
       finalized    (false),
       viewMatrixLoc(-1),
       textureLoc   (-1),
-      tileInfoLoc  (-1) {
+      tileInfoLoc  (-1),
+      viewBlockIndex    (gl::INVALID_INDEX),
+      materialBlockIndex(gl::INVALID_INDEX) {
 }
 
 bool SpriteShader::finalize() {
 	if(!finalized && shader->isValid()) {
-		const ProgramObject& s = shader->get();
+		ProgramObject& s = shader->_get();
 		finalized     = true;
 		viewMatrixLoc = s.getUniformLocation("viewMatrix");
 		textureLoc    = s.getUniformLocation("texture");
 		tileInfoLoc   = s.getUniformLocation("tileInfo");
+
+		viewBlockIndex     = s.getUniformBlockIndex("ViewBlock");
+		materialBlockIndex = s.getUniformBlockIndex("SpriteBlock");
+		if(useViewBlock()) {
+			s.setUniformBlockBinding(viewBlockIndex, UbView);
+		}
+		if(useMaterialBlock()) {
+			s.setUniformBlockBinding(materialBlockIndex, UbSprite);
+		}
 	}
 	return finalized;
 }
@@ -103,8 +118,21 @@ SpriteRenderer::SpriteRenderer(LoaderManager* loader, Renderer* renderer,
       _vertexArray(),
       _vertexBufferSize(vBufferSize),
       _indexBufferSize(iBufferSize),
-      _vertexBuffer(renderer),
-      _indexBuffer(renderer) {
+      _vertexBuffer(renderer, gl::ARRAY_BUFFER, gl::STREAM_DRAW, STREAM_SEGMENT_COUNT),
+      _indexBuffer(renderer, gl::ARRAY_BUFFER, gl::STREAM_DRAW, STREAM_SEGMENT_COUNT),
+      _uniformBufferSize(1 << 16),
+      _uniformAlignment(0),
+      _uniformBuffer(renderer, gl::UNIFORM_BUFFER, gl::STREAM_DRAW, STREAM_SEGMENT_COUNT),
+      _shaderParamCount(0),
+      _lastShaderParams(nullptr),
+      _instanced(false),
+      _instanceAttribSet(_spriteInstanceAttribSet),
+      _instanceArray(),
+      _instancedShader(),
+      _instanceBufferSize((1 << 16) * sizeof(SpriteInstance)),
+      _instanceBuffer(renderer, gl::ARRAY_BUFFER, gl::STREAM_DRAW, STREAM_SEGMENT_COUNT),
+      _quadBuffer(renderer, gl::ARRAY_BUFFER, gl::STATIC_DRAW),
+      _quadBufferReady(false) {
 	lairAssert(_renderer);
 
 	_renderer->registerTextureUnit(TexColor);
@@ -122,6 +150,25 @@ SpriteRenderer::SpriteRenderer(LoaderManager* loader, Renderer* renderer,
 	_vertexArray = renderer->createVertexArray(
 	                sizeof(SpriteVertex), spriteVertexAttribs, &_indexBuffer);
 
+	const VertexAttrib spriteInstanceAttribs[] = {
+	    { &_quadBuffer,     IxCorner,    2, gl::FLOAT, false, 0, 0 },
+	    { &_instanceBuffer, IxTransform, 4, gl::FLOAT, false,
+	      offsetof(SpriteInstance, transform), 1 },
+	    { &_instanceBuffer, IxOffset,    4, gl::FLOAT, false,
+	      offsetof(SpriteInstance, offset), 1 },
+	    { &_instanceBuffer, IxCoords,    4, gl::FLOAT, false,
+	      offsetof(SpriteInstance, coords), 1 },
+	    { &_instanceBuffer, IxTexCoords, 4, gl::FLOAT, false,
+	      offsetof(SpriteInstance, texCoords), 1 },
+	    { &_instanceBuffer, IxColor,     4, gl::FLOAT, false,
+	      offsetof(SpriteInstance, color), 1 },
+	    LAIR_VERTEX_ATTRIB_END
+	};
+
+	_instanceArray = renderer->createVertexArray(
+	                sizeof(Vector2), spriteInstanceAttribs, nullptr,
+	                sizeof(SpriteInstance));
+
 	_defaultShader = loadShader("shader/sprite.ldl");
 }
 
@@ -140,6 +187,21 @@ unsigned SpriteRenderer::indexCount()  const {
 }
 
 
+unsigned SpriteRenderer::instanceCount() const {
+	return _instanced? _instanceBuffer.pos() / sizeof(SpriteInstance): 0;
+}
+
+
+Size SpriteRenderer::streamedBytes() const {
+	Size bytes = _vertexBuffer.bytesWritten() + _indexBuffer.bytesWritten()
+	           + _uniformBuffer.bytesWritten();
+	if(_instanced) {
+		bytes += _instanceBuffer.bytesWritten();
+	}
+	return bytes;
+}
+
+
 SpriteShaderSP SpriteRenderer::shader() {
 	return _defaultShader;
 }
@@ -165,9 +227,60 @@ BufferObject* SpriteRenderer::indexBuffer() {
 }
 
 
+void SpriteRenderer::setInstanced(bool instanced) {
+	_instanced = instanced;
+	if(_instanced && !_instancedShader) {
+		_instancedShader = _loadShader("shader/sprite_instanced.ldl", &_instanceAttribSet);
+	}
+}
+
+
+SpriteShaderSP SpriteRenderer::spriteShader() {
+	return _instanced? _instancedShader: _defaultShader;
+}
+
+
+VertexArray* SpriteRenderer::spriteVertexArray() {
+	return _instanced? _instanceArray.get(): _vertexArray.get();
+}
+
+
+unsigned SpriteRenderer::spriteIndex() const {
+	return _instanced? instanceCount(): indexCount();
+}
+
+
 void SpriteRenderer::beginRender() {
 	_vertexBuffer.beginWrite(_vertexBufferSize);
 	_indexBuffer.beginWrite(_indexBufferSize);
+
+	if(!_uniformAlignment) {
+		GLint alignment = 0;
+		_renderer->context()->getIntegerv(gl::UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		_uniformAlignment = std::max(alignment, GLint(sizeof(Vector4)));
+	}
+	// Segments must start on an aligned offset too.
+	_uniformBufferSize = (_uniformBufferSize + _uniformAlignment - 1)
+	                   / _uniformAlignment * _uniformAlignment;
+	_uniformBuffer.beginWrite(_uniformBufferSize);
+
+	// Parameters of the previous frame have been consumed by the render passes.
+	_shaderParamCount = 0;
+	_lastShaderParams = nullptr;
+	_lastViewBlock    = UniformBufferRange{ nullptr, 0, 0 };
+	std::fill(_shaderParamCache, _shaderParamCache + SHADER_PARAM_CACHE_SIZE, nullptr);
+
+	if(_instanced) {
+		if(!_quadBufferReady) {
+			_quadBuffer.beginWrite(4 * sizeof(Vector2));
+			for(int corner = 0; corner < 4; ++corner) {
+				_quadBuffer.write(Vector2(float(corner & 0x01), float(corner >> 1)));
+			}
+			_quadBufferReady = _quadBuffer.endWrite();
+		}
+
+		_instanceBuffer.beginWrite(_instanceBufferSize);
+	}
 }
 
 
@@ -188,8 +301,26 @@ bool SpriteRenderer::endRender() {
 		success = false;
 	}
 
+	if(_uniformBuffer.pos() > _uniformBufferSize) {
+		dbgLogger.warning("SpriteRenderer: Uniform buffer too small ! Actual size: ",
+		                  _uniformBufferSize, ", required size: ", _uniformBuffer.pos());
+		_uniformBufferSize = _uniformBuffer.pos() * 2;
+		success = false;
+	}
+
+	if(_instanced && _instanceBuffer.pos() > _instanceBufferSize) {
+		dbgLogger.warning("SpriteRenderer: Instance buffer too small ! Actual size: ",
+		                  _instanceBufferSize, ", required size: ", _instanceBuffer.pos());
+		_instanceBufferSize = _instanceBuffer.pos() * 2;
+		success = false;
+	}
+
 	success &= _vertexBuffer.endWrite();
 	success &= _indexBuffer.endWrite();
+	success &= _uniformBuffer.endWrite();
+	if(_instanced) {
+		success &= _instanceBuffer.endWrite();
+	}
 
 	return success;
 }
@@ -210,16 +341,109 @@ void SpriteRenderer::addIndex(unsigned index) {
 }
 
 
+void SpriteRenderer::addVertices(const SpriteVertex* vertices, unsigned count) {
+	_vertexBuffer.write(vertices, count);
+}
+
+
+void SpriteRenderer::addIndices(const unsigned* indices, unsigned count) {
+	_indexBuffer.write(indices, count);
+}
+
+
 void SpriteRenderer::addSprite(const Matrix4& trans, const Box2& coords,
                                const Vector4& color, const Box2& texCoords) {
+	fillSprite(reserveSprites(1), 0, trans, coords, color, texCoords);
+}
+
+
+SpriteRange SpriteRenderer::reserveSprites(unsigned count) {
+	SpriteRange range;
+	range.firstVertex = vertexCount();
+	range.firstSprite = spriteIndex();
+	range.count       = count;
+
+	if(_instanced) {
+		range.vertices  = nullptr;
+		range.indices   = nullptr;
+		range.instances = reinterpret_cast<SpriteInstance*>(
+		                      _instanceBuffer.reserve(count * sizeof(SpriteInstance)));
+	}
+	else {
+		range.vertices  = reinterpret_cast<SpriteVertex*>(
+		                      _vertexBuffer.reserve(4 * count * sizeof(SpriteVertex)));
+		range.indices   = reinterpret_cast<unsigned*>(
+		                      _indexBuffer.reserve(6 * count * sizeof(unsigned)));
+		range.instances = nullptr;
+		if(!range.vertices || !range.indices) {
+			range.vertices = nullptr;
+			range.indices  = nullptr;
+		}
+	}
+
+	return range;
+}
+
+
+void SpriteRenderer::fillSprite(const SpriteRange& range, unsigned i, const Matrix4& trans,
+                                const Box2& coords, const Vector4& color, const Box2& texCoords) {
+	lairAssert(i < range.count);
+
+	if(range.instances) {
+		SpriteInstance& instance = range.instances[i];
+		instance.transform << trans(0, 0), trans(1, 0), trans(0, 1), trans(1, 1);
+		instance.offset    << trans(0, 3), trans(1, 3), trans(2, 3), 0;
+		instance.coords    << coords.min(), coords.max();
+		instance.texCoords << texCoords.min(), texCoords.max();
+		instance.color     =  linearFromSrgb(color);
+		return;
+	}
+
+	if(!range.vertices)
+		return;
+
+	Vector4 linearColor = linearFromSrgb(color);
+	SpriteVertex* vx = range.vertices + 4 * i;
+	for(int corner = 0; corner < 4; ++corner) {
+		int tcCorner = corner ^ 0x02; // texCoords are bottom-up.
+		Vector4 p;
+		p << coords.corner(Box2::CornerType(corner)), 0, 1;
+		vx[corner].position = trans * p;
+		vx[corner].color    = linearColor;
+		vx[corner].texCoord = texCoords.corner(Box2::CornerType(tcCorner));
+	}
+
+	unsigned  index = range.firstVertex + 4 * i;
+	unsigned* ix    = range.indices + 6 * i;
+	ix[0] = index + 0;
+	ix[1] = index + 1;
+	ix[2] = index + 2;
+	ix[3] = index + 2;
+	ix[4] = index + 1;
+	ix[5] = index + 3;
+}
+
+
+void SpriteRenderer::addSprite(const Box2& coords, const Vector4& linearColor,
+                               const Box2& texCoords) {
+	if(_instanced) {
+		SpriteInstance instance;
+		instance.transform << 1, 0, 0, 1;
+		instance.offset    << 0, 0, 0, 0;
+		instance.coords    << coords.min(), coords.max();
+		instance.texCoords << texCoords.min(), texCoords.max();
+		instance.color     =  linearColor;
+		_instanceBuffer.write(instance);
+		return;
+	}
+
 	GLuint index = vertexCount();
 
 	for(int corner = 0; corner < 4; ++corner) {
 		int tcCorner = corner ^ 0x02; // texCoords are bottom-up.
 		Vector4 p;
 		p << coords.corner(Box2::CornerType(corner)), 0, 1;
-		p = trans * p;
-		addVertex(p, linearFromSrgb(color), texCoords.corner(Box2::CornerType(tcCorner)));
+		addVertex(p, linearColor, texCoords.corner(Box2::CornerType(tcCorner)));
 	}
 
 	addIndex(index + 0);
@@ -231,12 +455,63 @@ void SpriteRenderer::addSprite(const Matrix4& trans, const Box2& coords,
 }
 
 
+void SpriteRenderer::addSpriteDrawCall(RenderPass* pass, const RenderPass::DrawStates& states,
+                                       const ShaderParameter* params, float depth,
+                                       unsigned firstSprite) {
+	unsigned count = spriteIndex() - firstSprite;
+	if(!count)
+		return;
+
+	RenderPass::DrawStates spriteStates = states;
+	spriteStates.shader   = spriteShader()->get();
+	spriteStates.vertices = spriteVertexArray();
+
+	if(_instanced) {
+		pass->addInstancedDrawCall(spriteStates, params, depth, 0, 4,
+		                           firstSprite, count, gl::TRIANGLE_STRIP);
+	}
+	else {
+		pass->addDrawCall(spriteStates, params, depth, firstSprite, count);
+	}
+}
+
+
+void SpriteRenderer::addSpriteDrawCall(RenderPass* pass, const RenderPass::DrawStates& states,
+                                       const ShaderParameter* params, float depth,
+                                       const SpriteRange& range, unsigned first, unsigned count) {
+	lairAssert(first + count <= range.count);
+	if(!count)
+		return;
+
+	RenderPass::DrawStates spriteStates = states;
+	spriteStates.shader   = spriteShader()->get();
+	spriteStates.vertices = spriteVertexArray();
+
+	if(_instanced) {
+		pass->addInstancedDrawCall(spriteStates, params, depth, 0, 4,
+		                           range.firstSprite + first, count, gl::TRIANGLE_STRIP);
+	}
+	else {
+		pass->addDrawCall(spriteStates, params, depth,
+		                  range.firstSprite + 6 * first, 6 * count);
+	}
+}
+
+
 void SpriteRenderer::addShape(const Matrix4& trans, const Sphere2& sphere, const Vector4& color) {
-	unsigned vi    = vertexCount();
-	unsigned count = 64;
+	static const unsigned count = 64;
+	static const std::vector<Vector2> unitCircle = [] {
+		std::vector<Vector2> circle;
+		for(unsigned i = 0; i < count; ++i) {
+			float alpha = 2 * M_PI * float(i) / float(count);
+			circle.emplace_back(cos(alpha), sin(alpha));
+		}
+		return circle;
+	}();
+
+	unsigned vi = vertexCount();
 	for(unsigned i = 0; i < count; ++i) {
-		float alpha = 2 * M_PI * float(i) / float(count);
-		Vector2 v(cos(alpha), sin(alpha));
+		const Vector2& v = unitCircle[i];
 		Vector4 p;
 		p << sphere.center() + v * sphere.radius(), 0, 1;
 		p = trans * p;
@@ -305,7 +580,32 @@ void SpriteRenderer::addShape(const Matrix4& trans, const Shape2D& shape, const
 
 
 SpriteShaderSP SpriteRenderer::loadShader(const Path& logicPath) {
-	auto loader = _loader->load<ShaderLoader>(logicPath, _renderer, &_attribSet);
+	return _loadShader(logicPath, &_attribSet);
+}
+
+
+SpriteShaderParams* SpriteRenderer::_allocShaderParams() {
+	unsigned chunk = _shaderParamCount / SHADER_PARAM_CHUNK_SIZE;
+	unsigned index = _shaderParamCount % SHADER_PARAM_CHUNK_SIZE;
+	if(chunk == _shaderParamChunks.size()) {
+		_shaderParamChunks.emplace_back(new SpriteShaderParams[SHADER_PARAM_CHUNK_SIZE]);
+	}
+	_shaderParamCount += 1;
+	return &_shaderParamChunks[chunk][index];
+}
+
+
+UniformBufferRange SpriteRenderer::_writeUniformBlock(const void* data, Size size) {
+	_uniformBuffer.align(_uniformAlignment);
+	UniformBufferRange range{ &_uniformBuffer,
+	                          _uniformBuffer.segmentOffset() + _uniformBuffer.pos(), size };
+	_uniformBuffer.write(data, size);
+	return range;
+}
+
+
+SpriteShaderSP SpriteRenderer::_loadShader(const Path& logicPath, VertexAttribSet* attribSet) {
+	auto loader = _loader->load<ShaderLoader>(logicPath, _renderer, attribSet);
 	auto shader = std::make_shared<SpriteShader>(loader->asset()->aspect<ShaderAspect>());
 	_unfinalizedShaders.push_back(shader);
 	return shader;
@@ -321,28 +621,79 @@ void SpriteRenderer::finalizeShaders() {
 
 const ShaderParameter* SpriteRenderer::addShaderParameters(
         const SpriteShaderSP shader, const Matrix4& viewTransform, int texUnit, const Vector4i& tileInfo) {
-	if(!_shaderParams.empty()) {
-		SpriteShaderParams& sp = _shaderParams.back();
-		if(sp.viewMatrix == viewTransform && sp.texUnit == texUnit && sp.tileInfo == tileInfo.cast<float>())
-			return sp.params;
+	return addShaderParameters(shader, viewTransform, Matrix4::Identity(), texUnit, tileInfo);
+}
+
+
+const ShaderParameter* SpriteRenderer::addShaderParameters(
+        const SpriteShaderSP shader, const Matrix4& viewTransform, const Matrix4& modelTransform,
+        int texUnit, const Vector4i& tileInfo) {
+	Vector4 ftileInfo = tileInfo.cast<float>();
+
+	// Most views are shared by all the draw calls of a pass.
+	if(!_lastViewBlock.buffer || _lastViewMatrix != viewTransform) {
+		SpriteViewBlock block{ viewTransform };
+		_lastViewBlock  = _writeUniformBlock(&block, sizeof(block));
+		_lastViewMatrix = viewTransform;
 	}
 
-	_shaderParams.emplace_back(viewTransform, texUnit, tileInfo);
-	SpriteShaderParams& sp = _shaderParams.back();
-	ShaderParameter* params = sp.params;
+	auto matches = [&](const SpriteShaderParams* sp) {
+		return sp && sp->shader == shader.get()
+		    && sp->viewBlock.offset == _lastViewBlock.offset
+		    && sp->texUnit == texUnit && sp->tileInfo == ftileInfo
+		    && sp->modelMatrix == modelTransform;
+	};
+
+	if(matches(_lastShaderParams))
+		return _lastShaderParams->params;
 
+	std::size_t h = std::hash<const void*>()(shader.get());
+	h = combineHash(h, _lastViewBlock.offset);
+	h = combineHash(h, hash(texUnit));
+	for(int i = 0; i < 4; ++i) {
+		h = combineHash(h, hash(tileInfo(i)));
+	}
+	h = combineHash(h, hash(modelTransform(0, 3)));
+	h = combineHash(h, hash(modelTransform(1, 3)));
+	SpriteShaderParams*& cached = _shaderParamCache[h % SHADER_PARAM_CACHE_SIZE];
+	if(matches(cached)) {
+		_lastShaderParams = cached;
+		return cached->params;
+	}
+
+	SpriteShaderParams* sp = _allocShaderParams();
+	sp->shader          = shader.get();
+	sp->viewBlock       = _lastViewBlock;
+	sp->viewMatrix      = viewTransform;
+	sp->modelMatrix     = modelTransform;
+	sp->modelViewMatrix = viewTransform * modelTransform;
+	sp->texUnit         = texUnit;
+	sp->tileInfo        = ftileInfo;
+
+	ShaderParameter* params = sp->params;
+	if(shader->useViewBlock()) {
+		*(params++) = makeShaderParameter(UbView, &sp->viewBlock);
+	}
+	if(shader->useMaterialBlock()) {
+		SpriteMaterialBlock block{ modelTransform, ftileInfo };
+		sp->materialBlock = _writeUniformBlock(&block, sizeof(block));
+		*(params++) = makeShaderParameter(UbSprite, &sp->materialBlock);
+	}
+	// Fallback for shaders that do not use uniform blocks.
 	if(shader->viewMatrixLoc >= 0) {
-		*(params++) = makeShaderParameter(shader->viewMatrixLoc, sp.viewMatrix);
+		*(params++) = makeShaderParameter(shader->viewMatrixLoc, sp->modelViewMatrix);
 	}
 	if(shader->textureLoc >= 0) {
-		*(params++) = makeShaderParameter(shader->textureLoc, &sp.texUnit);
+		*(params++) = makeShaderParameter(shader->textureLoc, &sp->texUnit);
 	}
 	if(shader->tileInfoLoc >= 0) {
-		*(params++) = makeShaderParameter(shader->tileInfoLoc, sp.tileInfo);
+		*(params++) = makeShaderParameter(shader->tileInfoLoc, sp->tileInfo);
 	}
 	params->index = -1;
 
-	return sp.params;
+	cached            = sp;
+	_lastShaderParams = sp;
+	return sp->params;
 }
 
 
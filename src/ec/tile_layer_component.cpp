@@ -21,6 +21,7 @@
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include <lair/utils/tile_map.h>
 
@@ -40,21 +41,9 @@ TileLayerComponent::TileLayerComponent(Manager* manager, _Entity* entity)
     , _tileMap()
     , _layerIndex(0)
     , _blendingMode(BLEND_NONE)
-    , _vBuffer(new BufferObject(manager->spriteRenderer()->renderer()))
-    , _iBuffer(new BufferObject(manager->spriteRenderer()->renderer())) {
-
-	const VertexAttrib spriteVertexAttribs[] = {
-	    { _vBuffer.get(), VxPosition, 4, gl::FLOAT, false,
-	      offsetof(SpriteVertex, position) },
-	    { _vBuffer.get(), VxColor,    4, gl::FLOAT, false,
-	      offsetof(SpriteVertex, color) },
-	    { _vBuffer.get(), VxTexCoord, 2, gl::FLOAT, false,
-	      offsetof(SpriteVertex, texCoord) },
-	    LAIR_VERTEX_ATTRIB_END
-	};
-
-	_vertexArray = manager->spriteRenderer()->renderer()->createVertexArray(
-	                sizeof(SpriteVertex), spriteVertexAttribs, _iBuffer.get());
+    , _bufferDirty(true)
+    , _chunkCount(0, 0)
+    , _chunks() {
 }
 
 
@@ -98,6 +87,15 @@ void TileLayerComponent::_setTileSet(TextureAspectSP texture) {
 }
 
 
+void TileLayerComponent::setTileDirty(unsigned x, unsigned y) {
+	unsigned cx = x / CHUNK_SIZE;
+	unsigned cy = y / CHUNK_SIZE;
+	if(cx < unsigned(_chunkCount(0)) && cy < unsigned(_chunkCount(1))) {
+		_chunks[cx + cy * _chunkCount(0)].dirty = true;
+	}
+}
+
+
 const PropertyList& TileLayerComponent::properties() {
 	static PropertyList props;
 	if(props.nProperties() == 0) {
@@ -131,6 +129,7 @@ TileLayerComponentManager::TileLayerComponentManager(
 
 
 void TileLayerComponentManager::render(EntityRef entity, float interp, const OrthographicCamera& camera) {
+	LAIR_PROFILE_SCOPE("TileLayerComponentManager::render");
 	compactArray();
 
 	_states.shader = _spriteRenderer->shader()->get();
@@ -149,30 +148,85 @@ LoaderManager* TileLayerComponentManager::loader() {
 }
 
 
-unsigned TileLayerComponentManager::_fillBuffer(BufferObject& vBuffer, BufferObject& iBuffer,
-                                                const TileMap& tileMap, unsigned layerIndex,
-                                                const Matrix4& wt) const {
-	TileLayerCSP layer = tileMap.tileLayer(layerIndex);
+void TileLayerComponentManager::_setupChunks(TileLayerComponent& comp, const TileLayer& layer) {
+	typedef TileLayerComponent TLC;
+
+	Vector2i layerSize = layer.sizeInTiles();
+	Vector2i chunkCount((layerSize(0) + TLC::CHUNK_SIZE - 1) / TLC::CHUNK_SIZE,
+	                    (layerSize(1) + TLC::CHUNK_SIZE - 1) / TLC::CHUNK_SIZE);
+
+	// Reuse existing chunks (and their vertex array indices) if possible.
+	if(chunkCount != comp._chunkCount) {
+		Renderer* renderer = _spriteRenderer->renderer();
+
+		comp._chunks.clear();
+		comp._chunks.resize(chunkCount.prod());
+		for(Chunk& chunk: comp._chunks) {
+			chunk.vBuffer.reset(new BufferObject(renderer));
+			chunk.iBuffer.reset(new BufferObject(renderer));
+
+			const VertexAttrib spriteVertexAttribs[] = {
+			    { chunk.vBuffer.get(), VxPosition, 4, gl::FLOAT, false,
+			      offsetof(SpriteVertex, position) },
+			    { chunk.vBuffer.get(), VxColor,    4, gl::FLOAT, false,
+			      offsetof(SpriteVertex, color) },
+			    { chunk.vBuffer.get(), VxTexCoord, 2, gl::FLOAT, false,
+			      offsetof(SpriteVertex, texCoord) },
+			    LAIR_VERTEX_ATTRIB_END
+			};
+
+			chunk.vertexArray = renderer->createVertexArray(
+			            sizeof(SpriteVertex), spriteVertexAttribs, chunk.iBuffer.get());
+		}
+		comp._chunkCount = chunkCount;
+	}
+
+	Vector2i offset     = layer.offsetInTiles();
+	Vector2  tileSize   = layer.tileSizeInPixels().cast<float>();
+	int      height     = layerSize(1);
+	for(int cy = 0; cy < chunkCount(1); ++cy) {
+		for(int cx = 0; cx < chunkCount(0); ++cx) {
+			Chunk& chunk = comp._chunks[cx + cy * chunkCount(0)];
+
+			Vector2i min(cx * TLC::CHUNK_SIZE, cy * TLC::CHUNK_SIZE);
+			Vector2i max = (min + Vector2i::Constant(int(TLC::CHUNK_SIZE))).cwiseMin(layerSize);
+			chunk.tiles = Box2i(min, max);
+
+			// Tile rows are top-down, y axis is bottom-up.
+			chunk.box = Box2(Vector2(min(0) + offset(0), height - max(1) - offset(1)).cwiseProduct(tileSize),
+			                 Vector2(max(0) + offset(0), height - min(1) - offset(1)).cwiseProduct(tileSize));
+
+			chunk.dirty      = true;
+			chunk.indexCount = 0;
+		}
+	}
+}
+
+
+unsigned TileLayerComponentManager::_fillChunk(Chunk& chunk, const TileMap& tileMap,
+                                               const TileLayer& layer) const {
+	BufferObject& vBuffer = *chunk.vBuffer;
+	BufferObject& iBuffer = *chunk.iBuffer;
 
-	unsigned offsetX = layer->offsetInTiles()(0);
-	unsigned offsetY = layer->offsetInTiles()(1);
+	unsigned offsetX = layer.offsetInTiles()(0);
+	unsigned offsetY = layer.offsetInTiles()(1);
 
-	unsigned width   = layer->widthInTiles();
-	unsigned height  = layer->heightInTiles();
+	unsigned height  = layer.heightInTiles();
 
-	unsigned tileWidth  = layer->tileWidthInPixels();
-	unsigned tileHeight = layer->tileHeightInPixels();
+	unsigned tileWidth  = layer.tileWidthInPixels();
+	unsigned tileHeight = layer.tileHeightInPixels();
 
-	unsigned nVertices = width * height * 4;
-	unsigned nIndices  = width * height * 6;
+	unsigned nTilesInChunk = chunk.tiles.sizes().prod();
+	unsigned nVertices = nTilesInChunk * 4;
+	unsigned nIndices  = nTilesInChunk * 6;
 
 	vBuffer.beginWrite(nVertices * sizeof(SpriteVertex));
 	iBuffer.beginWrite(nIndices * sizeof(unsigned));
 
 	Vector2i nTiles(tileMap.tileSetHTiles(), tileMap.tileSetVTiles());
-	for(unsigned y = 0; y < height; ++y) {
-		for(unsigned x = 0; x < width; ++x) {
-			TileMap::TileIndex tile = layer->tile(x, y);
+	for(unsigned y = chunk.tiles.min()(1); y < unsigned(chunk.tiles.max()(1)); ++y) {
+		for(unsigned x = chunk.tiles.min()(0); x < unsigned(chunk.tiles.max()(0)); ++x) {
+			TileMap::TileIndex tile = layer.tile(x, y);
 			TileMap::TileIndex gid  = tile & TileMap::GID_MASK;
 			if(gid == 0)
 				continue;
@@ -192,8 +246,10 @@ unsigned TileLayerComponentManager::_fillBuffer(BufferObject& vBuffer, BufferObj
 					std::swap(tx, ty);
 				}
 
-				Vector4 pos = wt * Vector4((         x + x2 + offsetX) * tileWidth,
-				                           (height - y - y2 - offsetY) * tileHeight, 0, 1);
+				// Vertices are in layer space, the world transform is part
+				// of the view matrix.
+				Vector4 pos((         x + x2 + offsetX) * tileWidth,
+				            (height - y - y2 - offsetY) * tileHeight, 0, 1);
 				vBuffer.write(SpriteVertex{ pos, Vector4::Constant(1),
 				                            tc.corner(Box2::CornerType(tx + ty*2)) });
 			}
@@ -207,11 +263,12 @@ unsigned TileLayerComponentManager::_fillBuffer(BufferObject& vBuffer, BufferObj
 		}
 	}
 
-	// FIXME: Check return value and retry.
+	// Only non-empty tiles are written, so the buffers can not overflow.
+	unsigned indexCount = iBuffer.pos() / sizeof(unsigned);
 	vBuffer.endWrite();
 	iBuffer.endWrite();
 
-	return nIndices;
+	return indexCount;
 }
 
 
@@ -250,40 +307,57 @@ void TileLayerComponentManager::_render(EntityRef entity, float interp, const Or
 		}
 	}
 
-	if(texColor) {
+	if(texColor && comp->layerIndex() < tileMapAspect->get().nLayers()) {
 		const TileMap& tileMap = tileMapAspect->get();
-		unsigned       layer   = comp->layerIndex();
+		TileLayerCSP   layer   = tileMap.tileLayer(comp->layerIndex());
 
-		// FIXME: wt should be applied as a shader parameter
 		Matrix4 wt = lerp(interp,
 						  comp->_entity()->prevWorldTransform.matrix(),
 						  comp->_entity()->worldTransform.matrix());
 
 		if(comp->_bufferDirty) {
-			comp->_vertexCount = _fillBuffer(*comp->_vBuffer, *comp->_iBuffer,
-			                                 tileMap, layer, wt);
+			_setupChunks(*comp, *layer);
 			comp->_bufferDirty = false;
 		}
 
-		if(comp->_vertexCount) {
-			_states.vertices     = comp->_vertexArray.get();
-			_states.textureSet   = textureSet;
-			_states.blendingMode = comp->blendingMode();
+		_states.textureSet   = textureSet;
+		_states.blendingMode = comp->blendingMode();
+
+		Vector4i tileInfo(tileMap.tileSetHTiles(), tileMap.tileSetVTiles(),
+		                  texColor->width(), texColor->height());
+		const ShaderParameter* params = nullptr;
 
-			Vector4i tileInfo(tileMap.tileSetHTiles(), tileMap.tileSetVTiles(),
-			                  texColor->width(), texColor->height());
-			const ShaderParameter* params = _spriteRenderer->addShaderParameters(
-			            _spriteRenderer->shader(), camera.transform(), 0, tileInfo);
+		float depth = 1.f - normalize(wt(2, 3), camera.viewBox().min()(2),
+		                                        camera.viewBox().max()(2));
+
+		for(Chunk& chunk: comp->_chunks) {
+			if(!camera.isVisible(transformedBox(wt, chunk.box))) {
+				_renderPass->notifyCulled();
+				continue;
+			}
+
+			if(chunk.dirty) {
+				chunk.indexCount = _fillChunk(chunk, tileMap, *layer);
+				chunk.dirty = false;
+			}
+
+			if(!chunk.indexCount)
+				continue;
+
+			if(!params) {
+				params = _spriteRenderer->addShaderParameters(
+				             _spriteRenderer->shader(), camera.transform(), wt, 0, tileInfo);
+			}
 
-			float depth = 1.f - normalize(wt(2, 3), camera.viewBox().min()(2),
-			                                        camera.viewBox().max()(2));
-			_renderPass->addDrawCall(_states, params, depth, 0, comp->_vertexCount);
+			_states.vertices = chunk.vertexArray.get();
+			_renderPass->addDrawCall(_states, params, depth, 0, chunk.indexCount);
 		}
 	}
 
 	EntityRef child = entity.firstChild();
 	while(child.isValid()) {
-		render(child, interp, camera);
+		if(!child.isCached())
+			render(child, interp, camera);
 		child = child.nextSibling();
 	}
 }
@@ -19,6 +19,14 @@
  */
 
 
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #include <lair/core/log.h>
 
 #include "lair/geometry/intersection.h"
@@ -79,4 +87,154 @@ bool intersect(const OrientedBox2& box0, const OrientedBox2& box1) {
 }
 
 
+unsigned intersectScalar(const AlignedBox2& box, const AlignedBox2Batch& batch,
+                         unsigned* hits, unsigned begin) {
+	float minX = box.min()(0);
+	float minY = box.min()(1);
+	float maxX = box.max()(0);
+	float maxY = box.max()(1);
+
+	unsigned nHits = 0;
+	for(unsigned i = begin; i < batch.size(); ++i) {
+		// Same comparisons as Eigen::AlignedBox::intersects().
+		if(minX <= batch.maxX[i] && minY <= batch.maxY[i]
+		&& batch.minX[i] <= maxX && batch.minY[i] <= maxY)
+			hits[nHits++] = i;
+	}
+	return nHits;
+}
+
+
+unsigned intersectScalar(const Sphere2& sphere, const Sphere2Batch& batch,
+                         unsigned* hits, unsigned begin) {
+	float x = sphere.center()(0);
+	float y = sphere.center()(1);
+	float r = sphere.radius();
+
+	unsigned nHits = 0;
+	for(unsigned i = begin; i < batch.size(); ++i) {
+		// Same operations as intersect(Sphere, Sphere), to get the same
+		// rounding.
+		float dx = x - batch.x[i];
+		float dy = y - batch.y[i];
+		float d  = std::sqrt(dx * dx + dy * dy);
+		if(d - r - batch.radius[i] <= 0.f)
+			hits[nHits++] = i;
+	}
+	return nHits;
+}
+
+
+#if defined(__AVX2__)
+
+typedef __m256 Pack;
+enum { PACK_SIZE = 8 };
+
+static inline Pack packSet(float f)            { return _mm256_set1_ps(f); }
+static inline Pack packLoad(const float* p)    { return _mm256_loadu_ps(p); }
+static inline Pack packAnd(Pack a, Pack b)     { return _mm256_and_ps(a, b); }
+static inline Pack packAdd(Pack a, Pack b)     { return _mm256_add_ps(a, b); }
+static inline Pack packSub(Pack a, Pack b)     { return _mm256_sub_ps(a, b); }
+static inline Pack packMul(Pack a, Pack b)     { return _mm256_mul_ps(a, b); }
+static inline Pack packSqrt(Pack a)            { return _mm256_sqrt_ps(a); }
+static inline Pack packLessEq(Pack a, Pack b)  { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline unsigned packMask(Pack a)        { return _mm256_movemask_ps(a); }
+
+#define LAIR_GEOMETRY_SIMD
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+typedef __m128 Pack;
+enum { PACK_SIZE = 4 };
+
+static inline Pack packSet(float f)            { return _mm_set1_ps(f); }
+static inline Pack packLoad(const float* p)    { return _mm_loadu_ps(p); }
+static inline Pack packAnd(Pack a, Pack b)     { return _mm_and_ps(a, b); }
+static inline Pack packAdd(Pack a, Pack b)     { return _mm_add_ps(a, b); }
+static inline Pack packSub(Pack a, Pack b)     { return _mm_sub_ps(a, b); }
+static inline Pack packMul(Pack a, Pack b)     { return _mm_mul_ps(a, b); }
+static inline Pack packSqrt(Pack a)            { return _mm_sqrt_ps(a); }
+static inline Pack packLessEq(Pack a, Pack b)  { return _mm_cmple_ps(a, b); }
+static inline unsigned packMask(Pack a)        { return _mm_movemask_ps(a); }
+
+#define LAIR_GEOMETRY_SIMD
+
+#endif
+
+
+#ifdef LAIR_GEOMETRY_SIMD
+
+static inline unsigned appendHits(unsigned mask, unsigned base, unsigned* hits) {
+	unsigned nHits = 0;
+	while(mask) {
+		unsigned bit = 0;
+		while(!(mask & (1u << bit)))
+			++bit;
+		hits[nHits++] = base + bit;
+		mask &= mask - 1;
+	}
+	return nHits;
+}
+
+
+unsigned intersect(const AlignedBox2& box, const AlignedBox2Batch& batch,
+                   unsigned* hits) {
+	Pack minX = packSet(box.min()(0));
+	Pack minY = packSet(box.min()(1));
+	Pack maxX = packSet(box.max()(0));
+	Pack maxY = packSet(box.max()(1));
+
+	unsigned nHits = 0;
+	unsigned i     = 0;
+	for(; i + PACK_SIZE <= batch.size(); i += PACK_SIZE) {
+		Pack hit = packAnd(
+		    packAnd(packLessEq(minX, packLoad(&batch.maxX[i])),
+		            packLessEq(minY, packLoad(&batch.maxY[i]))),
+		    packAnd(packLessEq(packLoad(&batch.minX[i]), maxX),
+		            packLessEq(packLoad(&batch.minY[i]), maxY)));
+
+		nHits += appendHits(packMask(hit), i, hits + nHits);
+	}
+
+	return nHits + intersectScalar(box, batch, hits + nHits, i);
+}
+
+
+unsigned intersect(const Sphere2& sphere, const Sphere2Batch& batch,
+                   unsigned* hits) {
+	Pack x    = packSet(sphere.center()(0));
+	Pack y    = packSet(sphere.center()(1));
+	Pack r    = packSet(sphere.radius());
+	Pack zero = packSet(0.f);
+
+	unsigned nHits = 0;
+	unsigned i     = 0;
+	for(; i + PACK_SIZE <= batch.size(); i += PACK_SIZE) {
+		Pack dx = packSub(x, packLoad(&batch.x[i]));
+		Pack dy = packSub(y, packLoad(&batch.y[i]));
+		Pack d  = packSqrt(packAdd(packMul(dx, dx), packMul(dy, dy)));
+		Pack hit = packLessEq(packSub(packSub(d, r), packLoad(&batch.radius[i])), zero);
+
+		nHits += appendHits(packMask(hit), i, hits + nHits);
+	}
+
+	return nHits + intersectScalar(sphere, batch, hits + nHits, i);
+}
+
+#else
+
+unsigned intersect(const AlignedBox2& box, const AlignedBox2Batch& batch,
+                   unsigned* hits) {
+	return intersectScalar(box, batch, hits);
+}
+
+
+unsigned intersect(const Sphere2& sphere, const Sphere2Batch& batch,
+                   unsigned* hits) {
+	return intersectScalar(sphere, batch, hits);
+}
+
+#endif
+
+
 }
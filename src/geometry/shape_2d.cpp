@@ -41,56 +41,6 @@ namespace lair
 {
 
 
-Shape2D::Shape2D(const Shape2D& other)
-    : _type(other._type)
-    , _shape(nullptr) {
-	switch(type()) {
-	case SHAPE_NONE:
-		break;
-	case SHAPE_SPHERE:
-		_shape = new Sphere2(other.asSphere());
-		break;
-	case SHAPE_ALIGNED_BOX:
-		_shape = new AlignedBox2(other.asAlignedBox());
-		break;
-	case SHAPE_ORIENTED_BOX:
-		_shape = new OrientedBox2(other.asOrientedBox());
-		break;
-	}
-}
-
-
-Shape2D::Shape2D(Shape2D&& other)
-    : _type(other._type)
-    , _shape(other._shape){
-	other._type = SHAPE_NONE;
-	other._shape = nullptr;
-}
-
-
-Shape2D::~Shape2D() {
-	switch(type()) {
-	case SHAPE_NONE:
-		break;
-	case SHAPE_SPHERE:
-		delete static_cast<Sphere2*>(_shape);
-		break;
-	case SHAPE_ALIGNED_BOX:
-		delete static_cast<AlignedBox2*>(_shape);
-		break;
-	case SHAPE_ORIENTED_BOX:
-		delete static_cast<OrientedBox2*>(_shape);
-		break;
-	}
-}
-
-
-Shape2D& Shape2D::operator=(Shape2D other) {
-	swap(other);
-	return *this;
-}
-
-
 Shape2D Shape2D::transformed(const Matrix3& transform) const {
 	switch(type()) {
 	case SHAPE_NONE:
@@ -203,9 +153,153 @@ bool Shape2D::intersect(const Shape2D& other) const {
 }
 
 
+bool Shape2D::raycast(const Vector2& origin, const Vector2& direction,
+                      float maxT, float* t) const {
+	switch(type()) {
+	case SHAPE_NONE:
+		break;
+	case SHAPE_SPHERE:
+		return lair::raycast(asSphere(), origin, direction, maxT, t);
+	case SHAPE_ALIGNED_BOX:
+		return lair::raycast(asAlignedBox(), origin, direction, maxT, t);
+	case SHAPE_ORIENTED_BOX:
+		return lair::raycast(asOrientedBox(), origin, direction, maxT, t);
+	}
+	return false;
+}
+
+
+/// Ray cast against `box` inflated by `radius` with rounded corners, which
+/// is the set of centers of the spheres of radius `radius` touching `box`.
+static bool raycastRounded(const AlignedBox2& box, float radius,
+                           const Vector2& origin, const Vector2& direction,
+                           float maxT, float* t) {
+	Vector2 margin = Vector2::Constant(radius);
+	float t0;
+	if(!lair::raycast(AlignedBox2(box.min() - margin, box.max() + margin),
+	                  origin, direction, maxT, &t0))
+		return false;
+
+	// Entering through a face: the entry point is within radius of the box.
+	// Otherwise, it lies in a corner region and the ray can only enter the
+	// rounded box through this corner.
+	Vector2 p = origin + t0 * direction;
+	Vector2 corner = closestPoint(box, p);
+	if((p - corner).squaredNorm() <= radius * radius) {
+		if(t) *t = t0;
+		return true;
+	}
+
+	return lair::raycast(Sphere2(corner, radius), origin, direction, maxT, t);
+}
+
+
+static float minExtent(const Shape2D& shape) {
+	switch(shape.type()) {
+	case SHAPE_NONE:
+		break;
+	case SHAPE_SPHERE:
+		return 2 * shape.asSphere().radius();
+	case SHAPE_ALIGNED_BOX:
+		return shape.asAlignedBox().sizes().minCoeff();
+	case SHAPE_ORIENTED_BOX:
+		return shape.asOrientedBox().sizes().minCoeff();
+	}
+	return 0;
+}
+
+
+bool Shape2D::sweep(const Vector2& motion, const Shape2D& other,
+                    float maxT, float* t) const {
+	const Shape2D* shape0 = this;
+	const Shape2D* shape1 = &other;
+	Vector2 m = motion;
+
+	// Moving shape0 by m relative to shape1 is moving shape1 by -m.
+	if(shape0->_type > shape1->_type) {
+		std::swap(shape0, shape1);
+		m = -m;
+	}
+
+	if(shape0->_type == SHAPE_NONE)
+		return false;
+
+	if(shape0->isSphere()) {
+		const Sphere2& sphere = shape0->asSphere();
+		switch(shape1->_type) {
+		case SHAPE_NONE:
+			break;
+		case SHAPE_SPHERE: {
+			const Sphere2& sphere1 = shape1->asSphere();
+			return lair::raycast(Sphere2(sphere1.center(), sphere.radius() + sphere1.radius()),
+			                     sphere.center(), m, maxT, t);
+		}
+		case SHAPE_ALIGNED_BOX:
+			return raycastRounded(shape1->asAlignedBox(), sphere.radius(),
+			                      sphere.center(), m, maxT, t);
+		case SHAPE_ORIENTED_BOX: {
+			const OrientedBox2& box = shape1->asOrientedBox();
+			Vector2 o = box.basis().transpose() * (sphere.center() - box.center());
+			Vector2 d = box.basis().transpose() * m;
+			return raycastRounded(AlignedBox2(-box.halfSize(), box.halfSize()),
+			                      sphere.radius(), o, d, maxT, t);
+		}
+		}
+		return false;
+	}
+
+	if(shape0->isAlignedBox() && shape1->isAlignedBox()) {
+		const AlignedBox2& box0 = shape0->asAlignedBox();
+		const AlignedBox2& box1 = shape1->asAlignedBox();
+		Vector2 h = box0.sizes() / 2;
+		return lair::raycast(AlignedBox2(box1.min() - h, box1.max() + h),
+		                     Vector2(box0.center()), m, maxT, t);
+	}
+
+	// No closed form: step by at most half the smallest extent of the shapes
+	// so that neither can be skipped, then bisect the first overlapping step.
+	if(shape0->intersect(*shape1)) {
+		if(t) *t = 0;
+		return true;
+	}
+
+	const unsigned maxSteps = 64;
+	float    length = m.norm() * maxT;
+	float    step   = std::min(minExtent(*shape0), minExtent(*shape1)) / 2;
+	unsigned nSteps = (step > 0)? unsigned(std::ceil(length / step)): maxSteps;
+	nSteps = clamp(nSteps, 1u, maxSteps);
+
+	Matrix3 translation = Matrix3::Identity();
+	float t0 = 0;
+	for(unsigned i = 1; i <= nSteps; ++i) {
+		float t1 = maxT * float(i) / float(nSteps);
+		translation.topRightCorner<2, 1>() = t1 * m;
+		if(!shape0->transformed(translation).intersect(*shape1)) {
+			t0 = t1;
+			continue;
+		}
+
+		for(unsigned j = 0; j < 16; ++j) {
+			float mid = (t0 + t1) / 2;
+			translation.topRightCorner<2, 1>() = mid * m;
+			if(shape0->transformed(translation).intersect(*shape1))
+				t1 = mid;
+			else
+				t0 = mid;
+		}
+
+		if(t) *t = t1;
+		return true;
+	}
+
+	return false;
+}
+
+
 void Shape2D::swap(Shape2D& other) {
-	std::swap(_type,  other._type);
-	std::swap(_shape, other._shape);
+	Shape2D tmp(std::move(other));
+	other = *this;
+	*this = tmp;
 }
 
 
@@ -32,7 +32,8 @@ namespace lair
 {
 
 
-BufferObject::BufferObject(Renderer* renderer, GLenum target, GLenum usage)
+BufferObject::BufferObject(Renderer* renderer, GLenum target, GLenum usage,
+                           unsigned segmentCount)
     : _context(renderer->context()),
       _renderer(renderer),
       _target(target),
@@ -40,7 +41,12 @@ BufferObject::BufferObject(Renderer* renderer, GLenum target, GLenum usage)
       _size(0),
       _buffer(0),
       _begin(nullptr),
-      _pos(nullptr) {
+      _pos(nullptr),
+      _segmentCount(std::max(segmentCount, 1u)),
+      _segment(0),
+      _fences(_segmentCount, nullptr),
+      _used(false),
+      _bytesWritten(0) {
 }
 
 
@@ -67,17 +73,38 @@ void BufferObject::beginWrite(Size size) {
 
 	bind();
 
+	GLbitfield access = gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_RANGE_BIT |
+	                    gl::MAP_FLUSH_EXPLICIT_BIT;
+
+	if(_segmentCount > 1) {
+		if(size != _size) {
+			// Reallocation orphans the whole buffer, no need to wait.
+			_deleteFences();
+			_segment = 0;
+		}
+		else {
+			// Every command using the current segment has been issued, so we
+			// can fence it and move to the next one.
+			if(_used) {
+				lairAssert(!_fences[_segment]);
+				_fences[_segment] = _context->fenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+				_segment = (_segment + 1) % _segmentCount;
+			}
+
+			_waitFence(_segment);
+			access |= gl::MAP_UNSYNCHRONIZED_BIT;
+		}
+	}
+
 	if(size != _size) {
-		_context->bufferData(_target, size, nullptr, _usage);
+		_context->bufferData(_target, size * _segmentCount, nullptr, _usage);
 		_size = size;
 	}
 
 	_begin = reinterpret_cast<Byte*>(
-	            _context->mapBufferRange(
-	                    _target, 0, _size,
-	                    gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_RANGE_BIT |
-	                    gl::MAP_FLUSH_EXPLICIT_BIT));
+	            _context->mapBufferRange(_target, segmentOffset(), _size, access));
 	_pos = _begin;
+	_used = true;
 }
 
 bool BufferObject::endWrite() {
@@ -88,6 +115,7 @@ bool BufferObject::endWrite() {
 	if(pos() <= _size) {
 		_context->flushMappedBufferRange(_target, 0, pos());
 	}
+	_bytesWritten = std::min(pos(), _size);
 
 	_begin = nullptr;
 	return _context->unmapBuffer(_target);
@@ -105,12 +133,71 @@ bool BufferObject::write(const void* data, Size size) {
 	return fitIn;
 }
 
+Byte* BufferObject::reserve(Size size) {
+	lairAssert(_begin);
+
+	Byte* ptr = _pos;
+	_pos += size;
+
+	return (_pos <= _begin + _size)? ptr: nullptr;
+}
+
+bool BufferObject::align(Size alignment) {
+	lairAssert(_begin);
+	lairAssert(alignment);
+
+	Size padding = (alignment - pos() % alignment) % alignment;
+	bool fitIn = (_pos + padding <= _begin + _size);
+	if(fitIn) {
+		memset(_pos, 0, padding);
+	}
+	_pos += padding;
+
+	return fitIn;
+}
+
 
 void BufferObject::_release() {
+	_deleteFences();
 	if(_buffer) {
 		_context->deleteBuffers(1, &_buffer);
 		_buffer = 0;
 	}
+	_size    = 0;
+	_segment = 0;
+	_used    = false;
+}
+
+
+void BufferObject::_waitFence(unsigned segment) {
+	GLsync& fence = _fences[segment];
+	if(!fence)
+		return;
+
+	// Should only block if the GPU is more than _segmentCount frames late.
+	GLbitfield flags = gl::SYNC_FLUSH_COMMANDS_BIT;
+	GLenum status;
+	do {
+		status = _context->clientWaitSync(fence, flags, 1000000000u);
+		flags  = 0;
+	} while(status == gl::TIMEOUT_EXPIRED);
+
+	if(status == gl::WAIT_FAILED) {
+		dbgLogger.warning("BufferObject: failed to wait for a fence.");
+	}
+
+	_context->deleteSync(fence);
+	fence = nullptr;
+}
+
+
+void BufferObject::_deleteFences() {
+	for(GLsync& fence: _fences) {
+		if(fence) {
+			_context->deleteSync(fence);
+			fence = nullptr;
+		}
+	}
 }
 
 
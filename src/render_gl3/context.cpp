@@ -78,6 +78,7 @@ Context::Context(GlGetProcAddress glGetProcAddress, Logger* logger):
 	_gl_khr_debug(false),
 	_gl_arb_conservative_depth(false),
 	_gl_arb_texture_storage(false),
+	_gl_arb_get_program_binary(false),
 
 	// GL_VERSION_1_0
 
@@ -479,6 +480,12 @@ Context::Context(GlGetProcAddress glGetProcAddress, Logger* logger):
 	_glTexStorage2D(nullptr),
 	_glTexStorage3D(nullptr),
 
+	// GL_ARB_get_program_binary
+
+	_glGetProgramBinary(nullptr),
+	_glProgramBinary(nullptr),
+	_glProgramParameteri(nullptr),
+
 	_log(logger),
 	_abortOnError(false),
 	_logErrors(true),
@@ -922,6 +929,14 @@ bool Context::initialize(bool debugGl) {
 	_glTexStorage3D = (_PfnGlTexStorage3D)_getProcAddress("glTexStorage3D");
 	_gl_arb_texture_storage = (_procCount == 3);
 
+	// GL_ARB_get_program_binary
+
+	_procCount = 0;
+	_glGetProgramBinary = (_PfnGlGetProgramBinary)_getProcAddress("glGetProgramBinary");
+	_glProgramBinary = (_PfnGlProgramBinary)_getProcAddress("glProgramBinary");
+	_glProgramParameteri = (_PfnGlProgramParameteri)_getProcAddress("glProgramParameteri");
+	_gl_arb_get_program_binary = (_procCount == 3);
+
 	if(!_gl_3_3) {
 		log().error("Failed to load gl 3.3.");
 		return false;
@@ -932,6 +947,7 @@ bool Context::initialize(bool debugGl) {
 	_gl_khr_debug = _gl_khr_debug && hasExtension("GL_KHR_debug");
 	_gl_arb_conservative_depth = hasExtension("GL_ARB_conservative_depth");
 	_gl_arb_texture_storage = _gl_arb_texture_storage && hasExtension("GL_ARB_texture_storage");
+	_gl_arb_get_program_binary = _gl_arb_get_program_binary && hasExtension("GL_ARB_get_program_binary");
 
 	log().info("OpenGL version: ",      getString(gl::VERSION));
 	log().info("OpenGL GLSL version: ", getString(gl::SHADING_LANGUAGE_VERSION));
@@ -941,6 +957,7 @@ bool Context::initialize(bool debugGl) {
 	if(_gl_khr_debug) log().info("OpenGL enable extension: GL_KHR_debug");
 	if(_gl_arb_conservative_depth) log().info("OpenGL enable extension: GL_ARB_conservative_depth");
 	if(_gl_arb_texture_storage) log().info("OpenGL enable extension: GL_ARB_texture_storage");
+	if(_gl_arb_get_program_binary) log().info("OpenGL enable extension: GL_ARB_get_program_binary");
 
 	return _gl_3_3;
 }
@@ -1278,6 +1295,7 @@ const char* Context::getEnumName(GLenum enum_) const {
 		case 0x0000824f: return "GL_DEBUG_TYPE_PORTABILITY";
 		case 0x00008250: return "GL_DEBUG_TYPE_PERFORMANCE";
 		case 0x00008251: return "GL_DEBUG_TYPE_OTHER";
+		case 0x00008257: return "GL_PROGRAM_BINARY_RETRIEVABLE_HINT";
 		case 0x00008268: return "GL_DEBUG_TYPE_MARKER";
 		case 0x00008269: return "GL_DEBUG_TYPE_PUSH_GROUP";
 		case 0x0000826a: return "GL_DEBUG_TYPE_POP_GROUP";
@@ -1373,8 +1391,11 @@ const char* Context::getEnumName(GLenum enum_) const {
 		case 0x000086a1: return "GL_TEXTURE_COMPRESSED";
 		case 0x000086a2: return "GL_NUM_COMPRESSED_TEXTURE_FORMATS";
 		case 0x000086a3: return "GL_COMPRESSED_TEXTURE_FORMATS";
+		case 0x00008741: return "GL_PROGRAM_BINARY_LENGTH";
 		case 0x00008764: return "GL_BUFFER_SIZE";
 		case 0x00008765: return "GL_BUFFER_USAGE";
+		case 0x000087fe: return "GL_NUM_PROGRAM_BINARY_FORMATS";
+		case 0x000087ff: return "GL_PROGRAM_BINARY_FORMATS";
 		case 0x00008800: return "GL_STENCIL_BACK_FUNC";
 		case 0x00008801: return "GL_STENCIL_BACK_FAIL";
 		case 0x00008802: return "GL_STENCIL_BACK_PASS_DEPTH_FAIL";
@@ -5926,6 +5947,33 @@ void Context::texStorage3D(GLenum target, GLsizei levels, GLenum internalformat,
 }
 
 
+// GL_ARB_get_program_binary
+
+void Context::getProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary) {
+	if(_logCalls) {
+		_log->write(_logLevel, "glGetProgramBinary(", program, ", ", bufSize, ", ", length, ", ", binaryFormat, ", ", binary, ")");
+	}
+	_glGetProgramBinary(program, bufSize, length, binaryFormat, binary);
+	checkGlErrors();
+}
+
+void Context::programBinary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length) {
+	if(_logCalls) {
+		_log->write(_logLevel, "glProgramBinary(", program, ", ", getEnumName(binaryFormat), ", ", binary, ", ", length, ")");
+	}
+	_glProgramBinary(program, binaryFormat, binary, length);
+	checkGlErrors();
+}
+
+void Context::programParameteri(GLuint program, GLenum pname, GLint value) {
+	if(_logCalls) {
+		_log->write(_logLevel, "glProgramParameteri(", program, ", ", getEnumName(pname), ", ", value, ")");
+	}
+	_glProgramParameteri(program, pname, value);
+	checkGlErrors();
+}
+
+
 void* Context::_getProcAddress(const char* proc) {
 	void* ptr = _glGetProcAddress(proc);
 	if(ptr) ++_procCount;
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/render_gl3/renderer.h>
+
+#include "lair/render_gl3/framebuffer.h"
+
+
+namespace lair
+{
+
+
+Framebuffer::Framebuffer(Renderer* renderer)
+    : _renderer(renderer),
+      _context(renderer? renderer->context(): nullptr),
+      _fbo(0),
+      _depth(0),
+      _color(),
+      _width(0),
+      _height(0) {
+	lairAssert(_renderer);
+}
+
+
+Framebuffer::~Framebuffer() {
+	_release();
+}
+
+
+bool Framebuffer::create(TextureAspectSP color, bool depth) {
+	lairAssert(color && color->isValid());
+
+	_release();
+
+	const Texture& tex = color->get();
+	_color  = color;
+	_width  = tex.width();
+	_height = tex.height();
+
+	_context->genFramebuffers(1, &_fbo);
+	_context->bindFramebuffer(gl::FRAMEBUFFER, _fbo);
+	_context->framebufferTexture2D(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0,
+	                               gl::TEXTURE_2D, tex._glId(), 0);
+
+	if(depth) {
+		_context->genRenderbuffers(1, &_depth);
+		_context->bindRenderbuffer(gl::RENDERBUFFER, _depth);
+		_context->renderbufferStorage(gl::RENDERBUFFER, gl::DEPTH_COMPONENT24,
+		                              _width, _height);
+		_context->framebufferRenderbuffer(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT,
+		                                  gl::RENDERBUFFER, _depth);
+		_context->bindRenderbuffer(gl::RENDERBUFFER, 0);
+	}
+
+	GLenum status = _context->checkFramebufferStatus(gl::FRAMEBUFFER);
+	_context->bindFramebuffer(gl::FRAMEBUFFER, 0);
+
+	if(status != gl::FRAMEBUFFER_COMPLETE) {
+		_renderer->log().error("Incomplete framebuffer (", _width, "x", _height,
+		                       "): ", _context->getEnumName(status));
+		_release();
+		return false;
+	}
+
+	return true;
+}
+
+
+void Framebuffer::bind() {
+	lairAssert(_fbo);
+	_context->bindFramebuffer(gl::FRAMEBUFFER, _fbo);
+	_context->viewport(0, 0, _width, _height);
+}
+
+
+void Framebuffer::_release() {
+	if(_context && _fbo) {
+		_context->deleteFramebuffers(1, &_fbo);
+		_fbo = 0;
+	}
+	if(_context && _depth) {
+		_context->deleteRenderbuffers(1, &_depth);
+		_depth = 0;
+	}
+	_color.reset();
+	_width  = 0;
+	_height = 0;
+}
+
+
+}
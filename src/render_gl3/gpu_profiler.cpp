@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/lair.h>
+
+#include "lair/render_gl3/gpu_profiler.h"
+
+
+namespace lair
+{
+
+
+GpuProfiler::GpuProfiler(Context* context)
+    : _context(context),
+      _freeQueries(),
+      _allQueries(),
+      _open(),
+      _pending(),
+      _offset(0) {
+}
+
+
+GpuProfiler::~GpuProfiler() {
+	_release();
+}
+
+
+bool GpuProfiler::isSupported() const {
+	return _context && _context->_gl_3_3;
+}
+
+
+void GpuProfiler::begin(const char* name) {
+	lairAssert(isSupported());
+
+	Zone zone;
+	zone.name  = name;
+	zone.begin = _query();
+	zone.end   = 0;
+	zone.depth = _open.size();
+	_context->queryCounter(zone.begin, gl::TIMESTAMP);
+
+	_open.push_back(zone);
+}
+
+
+void GpuProfiler::end() {
+	lairAssert(!_open.empty());
+
+	Zone zone = _open.back();
+	_open.pop_back();
+
+	zone.end = _query();
+	_context->queryCounter(zone.end, gl::TIMESTAMP);
+
+	_pending.push_back(zone);
+}
+
+
+void GpuProfiler::update() {
+	if(_pending.empty() || !isSupported())
+		return;
+
+	GLint64 gpuTime = 0;
+	_context->getInteger64v(gl::TIMESTAMP, &gpuTime);
+	_offset = int64(Profiler::now()) - int64(gpuTime);
+
+	Profiler& profiler = Profiler::instance();
+	unsigned  track    = profiler.track("GPU");
+
+	while(!_pending.empty()) {
+		const Zone& zone = _pending.front();
+
+		// Queries complete in order, so the end query is the last one.
+		GLint available = 0;
+		_context->getQueryObjectiv(zone.end, gl::QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+
+		GLuint64 begin = 0;
+		GLuint64 end   = 0;
+		_context->getQueryObjectui64v(zone.begin, gl::QUERY_RESULT, &begin);
+		_context->getQueryObjectui64v(zone.end,   gl::QUERY_RESULT, &end);
+
+		profiler.addEvent(track, zone.name, int64(begin) + _offset,
+		                  int64(end) + _offset, zone.depth);
+
+		_freeQueries.push_back(zone.begin);
+		_freeQueries.push_back(zone.end);
+		_pending.pop_front();
+	}
+}
+
+
+void GpuProfiler::_release() {
+	if(_context && !_allQueries.empty()) {
+		_context->deleteQueries(_allQueries.size(), _allQueries.data());
+	}
+	_allQueries.clear();
+	_freeQueries.clear();
+	_open.clear();
+	_pending.clear();
+}
+
+
+GLuint GpuProfiler::_query() {
+	if(_freeQueries.empty()) {
+		GLuint query = 0;
+		_context->genQueries(1, &query);
+		_allQueries.push_back(query);
+		return query;
+	}
+
+	GLuint query = _freeQueries.back();
+	_freeQueries.pop_back();
+	return query;
+}
+
+
+}
@@ -62,4 +62,10 @@ Matrix4 OrthographicCamera::transform() const {
 }
 
 
+bool OrthographicCamera::isVisible(const Box2& box) const {
+	return box.min()(0) <= _viewBox.max()(0) && box.max()(0) >= _viewBox.min()(0)
+	    && box.min()(1) <= _viewBox.max()(1) && box.max()(1) >= _viewBox.min()(1);
+}
+
+
 }
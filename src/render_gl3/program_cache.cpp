@@ -0,0 +1,209 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstring>
+#include <cstdio>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/render_gl3/glsl_source.h>
+#include <lair/render_gl3/program_object.h>
+#include <lair/render_gl3/vertex_attrib_set.h>
+
+#include "lair/render_gl3/program_cache.h"
+
+
+namespace lair
+{
+
+
+namespace {
+
+static const char   CACHE_MAGIC[8] = { 'L', 'A', 'I', 'R', 'P', 'R', 'O', 'G' };
+static const uint32 CACHE_VERSION  = 1;
+
+struct CacheHeader {
+	char   magic[8];
+	uint32 version;
+	uint32 format;
+	uint64 key;
+	uint64 length;
+};
+
+// FNV-1a, stable across runs and platforms unlike std::hash.
+inline uint64 hashBytes(uint64 hash, const void* data, Size size) {
+	const Byte* bytes = static_cast<const Byte*>(data);
+	for(Size i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+inline uint64 hashString(uint64 hash, const char* str) {
+	// Include the terminating 0 as a separator.
+	return hashBytes(hash, str, std::strlen(str) + 1);
+}
+
+uint64 hashSource(uint64 hash, const GlslSource& source) {
+	for(GLsizei i = 0; i < source.count(); ++i) {
+		hash = hashBytes(hash, source.string(i), source.length()[i]);
+	}
+	return hashBytes(hash, "", 1);
+}
+
+}
+
+
+ProgramCache::ProgramCache(Context* context, Logger* log)
+    : _context(context),
+      _log(log),
+      _directory(),
+      _nFormats(-1),
+      _driver(),
+      _stats{ 0, 0, 0, 0 },
+      _buffer() {
+}
+
+
+ProgramCache::~ProgramCache() {
+}
+
+
+void ProgramCache::setDirectory(const Path& directory) {
+	_directory = directory;
+}
+
+
+bool ProgramCache::isEnabled() {
+	if(_directory.empty() || !_context || !_context->_gl_arb_get_program_binary)
+		return false;
+
+	if(_nFormats < 0) {
+		_context->getIntegerv(gl::NUM_PROGRAM_BINARY_FORMATS, &_nFormats);
+		if(!_nFormats) {
+			_log->info("Program binary cache disabled: no binary format supported.");
+		}
+	}
+
+	return _nFormats > 0;
+}
+
+
+uint64 ProgramCache::key(const VertexAttribSet* attribs,
+                         const GlslSource& vert, const GlslSource& frag) {
+	if(_driver.empty()) {
+		for(GLenum name: { gl::VENDOR, gl::RENDERER, gl::VERSION, gl::SHADING_LANGUAGE_VERSION }) {
+			const GLubyte* str = _context->getString(name);
+			_driver += str? reinterpret_cast<const char*>(str): "";
+			_driver += '\n';
+		}
+	}
+
+	uint64 hash = 0xcbf29ce484222325ull;
+	hash = hashString(hash, _driver.c_str());
+	if(attribs) {
+		for(const VertexAttribInfo& attrib: *attribs) {
+			hash = hashString(hash, attrib.name);
+			hash = hashBytes(hash, &attrib.index, sizeof(attrib.index));
+		}
+	}
+	hash = hashSource(hash, vert);
+	hash = hashSource(hash, frag);
+	return hash;
+}
+
+
+bool ProgramCache::load(ProgramObject& program, uint64 key) {
+	Path path = _path(key);
+	Path::IStream in(path.native().c_str(), std::ios_base::in | std::ios_base::binary);
+	if(!in.good())
+		return false;
+
+	CacheHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(!in.good() || std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+	|| header.version != CACHE_VERSION || header.key != key) {
+		_log->warning("Invalid program binary \"", path, "\", ignoring it.");
+		return false;
+	}
+
+	_buffer.resize(header.length);
+	in.read(reinterpret_cast<char*>(_buffer.data()), _buffer.size());
+	if(Size(in.gcount()) != _buffer.size()) {
+		_log->warning("Truncated program binary \"", path, "\", ignoring it.");
+		return false;
+	}
+
+	if(!program.loadBinary(header.format, _buffer.data(), _buffer.size())) {
+		_log->info("Program binary \"", path, "\" rejected by the driver, recompile.");
+		return false;
+	}
+
+	return true;
+}
+
+
+void ProgramCache::store(const ProgramObject& program, uint64 key) {
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key     = key;
+
+	GLenum format = 0;
+	if(!program.getBinary(format, _buffer)) {
+		_log->warning("Failed to retrieve program binary.");
+		return;
+	}
+	header.format = format;
+	header.length = _buffer.size();
+
+	Path path = _path(key);
+	Path::OStream out(path.native().c_str(), std::ios_base::out | std::ios_base::binary);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(_buffer.data()), _buffer.size());
+	if(!out.good()) {
+		_log->warning("Failed to write program binary \"", path, "\".");
+	}
+}
+
+
+void ProgramCache::recordBuild(bool fromCache, double seconds) {
+	if(fromCache) {
+		_stats.hitCount += 1;
+		_stats.warmTime += seconds;
+	}
+	else {
+		_stats.missCount += 1;
+		_stats.coldTime += seconds;
+	}
+}
+
+
+Path ProgramCache::_path(uint64 key) const {
+	char filename[32];
+	std::snprintf(filename, sizeof(filename), "program_%016llx.bin",
+	              (unsigned long long)key);
+	return _directory / filename;
+}
+
+
+}
@@ -141,6 +141,31 @@ bool ProgramObject::link() {
 }
 
 
+bool ProgramObject::loadBinary(GLenum format, const void* binary, GLsizei length) {
+	assert(isGenerated());
+
+	_context->programBinary(_id, format, binary, length);
+	_context->getProgramiv(_id, gl::LINK_STATUS, &_link_status);
+	return _link_status == gl::TRUE;
+}
+
+
+bool ProgramObject::getBinary(GLenum& format, std::vector<Byte>& binary) const {
+	assert(isLinked());
+
+	GLint length = 0;
+	_context->getProgramiv(_id, gl::PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return false;
+
+	binary.resize(length);
+	GLsizei written = 0;
+	_context->getProgramBinary(_id, length, &written, &format, binary.data());
+	binary.resize(written);
+	return written > 0;
+}
+
+
 bool ProgramObject::validate() {
 	assert(isLinked());
 
@@ -189,6 +214,18 @@ GLint ProgramObject::getUniformLocation(const GLchar* name) const {
 }
 
 
+GLuint ProgramObject::getUniformBlockIndex(const GLchar* name) const {
+	assert(isLinked());
+	return _context->getUniformBlockIndex(_id, name);
+}
+
+
+void ProgramObject::setUniformBlockBinding(GLuint blockIndex, GLuint binding) {
+	assert(isLinked());
+	_context->uniformBlockBinding(_id, blockIndex, binding);
+}
+
+
 void ProgramObject::getLog(std::string& out) const {
 	GLint log_size;
 	_context->getProgramiv(_id, gl::INFO_LOG_LENGTH, &log_size);
@@ -257,11 +294,14 @@ ShaderLoader::ShaderLoader(LoaderManager* manager, AspectSP aspect,
 void ShaderLoader::commit() {
 	ShaderAspectSP aspect = static_pointer_cast<ShaderAspect>(_aspect);
 
-	if(_vertexShader.isValid() && _fragmentShader.isValid()) {
+	// Compilation is deferred until both sources are available so that the
+	// program cache can skip it entirely.
+	if(_vertexSource && _fragmentSource) {
+		const GlslSource& vert = static_pointer_cast<GlslSourceAspect>(_vertexSource)->get();
+		const GlslSource& frag = static_pointer_cast<GlslSourceAspect>(_fragmentSource)->get();
 		std::unique_ptr<ProgramObject> shader(new ProgramObject(
 		        _renderer->compileProgram(
-		            asset()->logicPath().utf8CStr(),
-		            _attribs, &_vertexShader, &_fragmentShader)));
+		            asset()->logicPath().utf8CStr(), _attribs, vert, frag)));
 		aspect->_set(std::move(shader));
 	}
 
@@ -363,16 +403,12 @@ void ShaderLoader::loadSyncImpl(Logger& log) {
 
 void ShaderLoader::loadShader(AspectSP aspect, Logger& log, GLenum type) {
 	if(aspect->isValid()) {
-		GlslSourceAspectSP sourceAspect = static_pointer_cast<GlslSourceAspect>(aspect);
-
-		ShaderObject* shader = (type == gl::VERTEX_SHADER)?   &_vertexShader:
-		                       (type == gl::FRAGMENT_SHADER)? &_fragmentShader:
-		                                                      nullptr;
-		lairAssert(shader);
+		AspectSP* source = (type == gl::VERTEX_SHADER)?   &_vertexSource:
+		                   (type == gl::FRAGMENT_SHADER)? &_fragmentSource:
+		                                                  nullptr;
+		lairAssert(source);
 
-		*shader = _renderer->compileShader(
-		              aspect->asset()->logicPath().utf8CStr(),
-		              type, sourceAspect->get());
+		*source = aspect;
 	}
 	else {
 		log.error("Error while loading shader \"", asset()->logicPath(),
@@ -19,13 +19,19 @@
  */
 
 
+#include <cstring>
+
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include <lair/render_gl3/context.h>
+#include <lair/render_gl3/buffer_object.h>
+#include <lair/render_gl3/framebuffer.h>
 #include <lair/render_gl3/program_object.h>
 #include <lair/render_gl3/sampler.h>
 #include <lair/render_gl3/texture.h>
+#include <lair/render_gl3/vertex_array.h>
 #include <lair/render_gl3/renderer.h>
 
 #include "lair/render_gl3/render_pass.h"
@@ -49,13 +55,16 @@ const EnumInfo* blendingModeInfo() {
 
 RenderPass::DrawCall::DrawCall(const DrawStates& states, const ShaderParameter* params,
                                unsigned depth, unsigned index, unsigned count,
-                               GLenum primitive)
+                               GLenum primitive, unsigned firstInstance,
+                               unsigned instanceCount)
     : states(states),
       params(params),
       depth(depth),
       index(index),
       count(count),
-      primitive(primitive)
+      primitive(primitive),
+      firstInstance(firstInstance),
+      instanceCount(instanceCount)
 {
 }
 
@@ -64,24 +73,42 @@ void RenderPass::Stats::reset() {
 	shaderStateChangeCount = 0;
 	vertexArraySetupCount = 0;
 	samplerBindCount = 0;
+	samplerBindSkipCount = 0;
 	textureBindCount = 0;
+	textureBindSkipCount = 0;
 	blendingModeChangeCount = 0;
+	uniformUploadCount = 0;
+	uniformSkipCount = 0;
+	uniformBufferBindCount = 0;
+	uniformBufferBindSkipCount = 0;
 	drawCallCount = 0;
+	instanceCount = 0;
+	culledCount = 0;
 }
 
 
 void RenderPass::Stats::dump(Logger& log) const {
 	log.info("Shader changes:         ", shaderStateChangeCount);
 	log.info("VAO setups:             ", vertexArraySetupCount);
-	log.info("Sampler bindings:       ", samplerBindCount);
-	log.info("Texture bindings:       ", textureBindCount);
+	log.info("Sampler bindings:       ", samplerBindCount, " (", samplerBindSkipCount, " skipped)");
+	log.info("Texture bindings:       ", textureBindCount, " (", textureBindSkipCount, " skipped)");
 	log.info("Blending mode changes:  ", blendingModeChangeCount);
+	log.info("Uniform uploads:        ", uniformUploadCount, " (", uniformSkipCount, " skipped)");
+	log.info("Uniform buffer binds:   ", uniformBufferBindCount, " (", uniformBufferBindSkipCount, " skipped)");
 	log.info("Draw calls:             ", drawCallCount);
+	log.info("Instances:              ", instanceCount);
+	log.info("Culled objects:         ", culledCount);
 }
 
 
 RenderPass::RenderPass(Renderer* renderer)
-    : _renderer(renderer) {
+    : _renderer(renderer),
+      _framebuffer(nullptr),
+      _clearBuffers(0),
+      _clearColor(Vector4::Zero()),
+      _culledCount(0) {
+	_resetStateCache();
+	_stats.reset();
 }
 
 
@@ -91,6 +118,7 @@ RenderPass::~RenderPass() {
 
 void RenderPass::clear() {
 	_drawCalls.clear();
+	_culledCount = 0;
 }
 
 
@@ -103,71 +131,69 @@ void RenderPass::addDrawCall(const DrawStates& states, const ShaderParameter* pa
 }
 
 
+void RenderPass::addInstancedDrawCall(const DrawStates& states, const ShaderParameter* param,
+                                      float depth, unsigned index, unsigned count,
+                                      unsigned firstInstance, unsigned instanceCount,
+                                      GLenum primitive) {
+	unsigned maxDepth = 0x00ffffffu;
+	unsigned idepth = clamp(unsigned(depth * maxDepth), 0u, maxDepth);
+	_drawCalls.emplace_back(states, param, idepth, index, count, primitive,
+	                        firstInstance, instanceCount);
+}
+
+
 void RenderPass::render() {
 	_stats.reset();
-
-	_sortBuffer.clear();
-	_sortBuffer.reserve(_drawCalls.size());
-	for(DrawCall& call: _drawCalls) {
-		Index index = (call.states.blendingMode == BLEND_NONE)? solidIndex(call):
-		                                                        transparentIndex(call);
-		_sortBuffer.emplace_back(index, &call);
+	_stats.culledCount = _culledCount;
+	_resetStateCache();
+
+	{
+		LAIR_PROFILE_SCOPE("RenderPass::sort");
+		_sortBuffer.clear();
+		_sortBuffer.reserve(_drawCalls.size());
+		for(DrawCall& call: _drawCalls) {
+			Index index = (call.states.blendingMode == BLEND_NONE)? solidIndex(call):
+			                                                        transparentIndex(call);
+			_sortBuffer.emplace_back(index, &call);
+		}
+		std::sort(_sortBuffer.begin(), _sortBuffer.end());
 	}
-	std::sort(_sortBuffer.begin(), _sortBuffer.end());
+
+	LAIR_PROFILE_SCOPE("RenderPass::submit");
+	LAIR_PROFILE_GPU_SCOPE(&_renderer->gpuProfiler(), "RenderPass");
 
 	Context* glc = _renderer->context();
 
-	DrawCall* prev = 0;
+	GLint viewport[4];
+	if(_framebuffer) {
+		glc->getIntegerv(gl::VIEWPORT, viewport);
+		_framebuffer->bind();
+	}
+
+	if(_clearBuffers) {
+		glc->clearColor(_clearColor(0), _clearColor(1), _clearColor(2), _clearColor(3));
+		glc->clear(_clearBuffers);
+	}
+
 	for(IndexedCall icall: _sortBuffer) {
 		DrawCall&   call   = *icall.call;
 		DrawStates& states = call.states;
 
-		if(!prev || prev->states.shader != states.shader) {
+		if(_state.shader != states.shader) {
 			states.shader->use();
+			_state.shader = states.shader;
 			_stats.shaderStateChangeCount += 1;
 		}
 
-		if(!prev || prev->states.vertices != states.vertices) {
+		if(_state.vertices != states.vertices) {
 			states.vertices->setup();
+			_state.vertices = states.vertices;
 			_stats.vertexArraySetupCount += 1;
 		}
 
-		const ShaderParameter* param = call.params;
-		while(param->index >= 0) {
-			#define LAIR_UNIF_CASE(_glType, _suffix, _type) case _glType:\
-				glc->uniform##_suffix(param->index, 1, reinterpret_cast<const _type*>(param->value));\
-				break
-			#define LAIR_UNIF_CASE_MAT(_glType, _suffix, _type) case _glType:\
-				glc->uniformMatrix##_suffix(param->index, 1, false, reinterpret_cast<const _type*>(param->value));\
-				break
-			switch(param->type) {
-			LAIR_UNIF_CASE    (gl::INT,        1iv, int);
-			LAIR_UNIF_CASE    (gl::INT_VEC2,   2iv, int);
-			LAIR_UNIF_CASE    (gl::INT_VEC3,   3iv, int);
-			LAIR_UNIF_CASE    (gl::INT_VEC4,   4iv, int);
-			LAIR_UNIF_CASE    (gl::BOOL,       1iv, int);
-			LAIR_UNIF_CASE    (gl::BOOL_VEC2,  2iv, int);
-			LAIR_UNIF_CASE    (gl::BOOL_VEC3,  3iv, int);
-			LAIR_UNIF_CASE    (gl::BOOL_VEC4,  4iv, int);
-			LAIR_UNIF_CASE    (gl::FLOAT,      1fv, float);
-			LAIR_UNIF_CASE    (gl::FLOAT_VEC2, 2fv, float);
-			LAIR_UNIF_CASE    (gl::FLOAT_VEC3, 3fv, float);
-			LAIR_UNIF_CASE    (gl::FLOAT_VEC4, 4fv, float);
-			LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT2, 2fv, float);
-			LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT3, 3fv, float);
-			LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT4, 4fv, float);
-			}
-			#undef LAIR_UNIF_CASE
-			#undef LAIR_UNIF_CASE_MAT
-			++param;
-		}
-//		SpriteShaderParams params(viewTransform);
-//		_defaultShader.setParams(glc, params);
-
-		if(!prev || prev->states.textureSet != states.textureSet) {
-			// TODO: Optimize state changes: keep track of the currently bound
-			// texture / sampler per unit and only update them when required.
+		_setShaderParameters(states.shader, call.params);
 
+		if(_state.textureSet != states.textureSet.get()) {
 			// TODO: Instead of setting all textures in the texture set, should
 			// we ask the shader for the active texture units and set them ? The
 			// main difference is that if a unit is not present in a texture
@@ -176,58 +202,46 @@ void RenderPass::render() {
 
 			for(const TextureBinding& binding: *states.textureSet) {
 				if(binding.texture) {
-					glc->activeTexture(gl::TEXTURE0 + binding.unit->index);
-
 					TextureAspectSP texture =
 					        binding.texture->isValid()? binding.texture:
 					                                    _renderer->defaultTexture();
-					texture->get().bind();
-
-					if(binding.sampler)
-						binding.sampler->bind(binding.unit->index);
-					else
-						glc->bindSampler(binding.unit->index, 0);
-
-					_stats.textureBindCount += 1;
-					_stats.samplerBindCount += 1;
+					_bindTexture(binding.unit->index, texture->get());
+					_bindSampler(binding.unit->index, binding.sampler.get());
 				}
 			}
+			_state.textureSet = states.textureSet.get();
 		}
 
-		if(!prev || prev->states.blendingMode != states.blendingMode) {
-			switch(states.blendingMode) {
-			case BLEND_NONE:
-				glc->disable(gl::BLEND);
-				break;
-			case BLEND_ALPHA:
-				glc->enable(gl::BLEND);
-				glc->blendEquation(gl::FUNC_ADD);
-				glc->blendFunc(gl::SRC_ALPHA, gl::ONE_MINUS_SRC_ALPHA);
-				break;
-			case BLEND_ADD:
-				glc->enable(gl::BLEND);
-				glc->blendEquation(gl::FUNC_ADD);
-				glc->blendFunc(gl::ONE, gl::ONE);
-				break;
-			case BLEND_MULTIPLY:
-				glc->enable(gl::BLEND);
-				glc->blendEquation(gl::FUNC_ADD);
-				glc->blendFunc(gl::DST_COLOR, gl::ZERO);
-				break;
+		_setBlendingMode(states.blendingMode);
+
+		BufferObject* indices = states.vertices->indices();
+		Size indexOffset = indices? call.index * sizeof(unsigned) + indices->segmentOffset(): 0;
+		if(call.instanceCount) {
+			states.vertices->setInstanceBase(call.firstInstance);
+			if(indices) {
+				glc->drawElementsInstanced(call.primitive, call.count, gl::UNSIGNED_INT,
+				                           reinterpret_cast<void*>(indexOffset),
+				                           call.instanceCount);
 			}
-			_stats.blendingModeChangeCount += 1;
+			else {
+				glc->drawArraysInstanced(call.primitive, call.index, call.count,
+				                         call.instanceCount);
+			}
+			_stats.instanceCount += call.instanceCount;
 		}
-
-		if(states.vertices->indices()) {
+		else if(indices) {
 			glc->drawElements(call.primitive, call.count, gl::UNSIGNED_INT,
-			                  reinterpret_cast<void*>(call.index*sizeof(unsigned)));
+			                  reinterpret_cast<void*>(indexOffset));
 		}
 		else {
 			glc->drawArrays(call.primitive, call.index, call.count);
 		}
 		_stats.drawCallCount += 1;
+	}
 
-		prev = &call;
+	if(_framebuffer) {
+		glc->bindFramebuffer(gl::FRAMEBUFFER, 0);
+		glc->viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 	}
 
 //	_stats.dump(dbgLogger);
@@ -297,6 +311,225 @@ RenderPass::IndexedCall::IndexedCall(Index index, DrawCall* call)
 }
 
 
+unsigned RenderPass::shaderParameterSize(GLenum type) {
+	switch(type) {
+	case gl::INT:
+	case gl::BOOL:
+	case gl::FLOAT:
+		return 4;
+	case gl::INT_VEC2:
+	case gl::BOOL_VEC2:
+	case gl::FLOAT_VEC2:
+		return 8;
+	case gl::INT_VEC3:
+	case gl::BOOL_VEC3:
+	case gl::FLOAT_VEC3:
+		return 12;
+	case gl::INT_VEC4:
+	case gl::BOOL_VEC4:
+	case gl::FLOAT_VEC4:
+	case gl::FLOAT_MAT2:
+		return 16;
+	case gl::FLOAT_MAT3:
+		return 36;
+	case gl::FLOAT_MAT4:
+		return 64;
+	}
+	return 0;
+}
+
+
+void RenderPass::_resetStateCache() {
+	_state.shader       = nullptr;
+	_state.vertices     = nullptr;
+	_state.textureSet   = nullptr;
+	_state.blendingMode = -1;
+	_state.activeUnit   = 0;
+	_state.textures.clear();
+	_state.samplers.clear();
+	_state.uniformBuffers.clear();
+
+	// Keep the allocated storage, but forget about the values.
+	for(auto& program: _state.programs) {
+		program.second.params = nullptr;
+		for(UniformValue& value: program.second.uniforms) {
+			value.type = 0;
+		}
+	}
+}
+
+
+void RenderPass::_setActiveUnit(unsigned unit) {
+	GLenum glUnit = gl::TEXTURE0 + unit;
+	if(_state.activeUnit != glUnit) {
+		_renderer->context()->activeTexture(glUnit);
+		_state.activeUnit = glUnit;
+	}
+}
+
+
+void RenderPass::_bindTexture(unsigned unit, const Texture& texture) {
+	if(_state.textures.size() <= unit) {
+		_state.textures.resize(unit + 1, GLuint(-1));
+	}
+
+	if(_state.textures[unit] != texture._glId()) {
+		_setActiveUnit(unit);
+		texture.bind();
+		_state.textures[unit] = texture._glId();
+		_stats.textureBindCount += 1;
+	}
+	else {
+		_stats.textureBindSkipCount += 1;
+	}
+}
+
+
+void RenderPass::_bindSampler(unsigned unit, Sampler* sampler) {
+	if(_state.samplers.size() <= unit) {
+		_state.samplers.resize(unit + 1, GLuint(-1));
+	}
+
+	// Dirty samplers must be bound to get their parameters updated.
+	GLuint id    = sampler? sampler->_glId():    0;
+	bool   dirty = sampler? sampler->_isDirty(): false;
+	if(!dirty && _state.samplers[unit] == id) {
+		_stats.samplerBindSkipCount += 1;
+		return;
+	}
+
+	if(sampler)
+		sampler->bind(unit);
+	else
+		_renderer->context()->bindSampler(unit, 0);
+
+	_state.samplers[unit] = sampler? sampler->_glId(): 0;
+	_stats.samplerBindCount += 1;
+}
+
+
+void RenderPass::_setBlendingMode(BlendingMode blendingMode) {
+	if(_state.blendingMode == blendingMode)
+		return;
+
+	Context* glc = _renderer->context();
+	switch(blendingMode) {
+	case BLEND_NONE:
+		glc->disable(gl::BLEND);
+		break;
+	case BLEND_ALPHA:
+		glc->enable(gl::BLEND);
+		glc->blendEquation(gl::FUNC_ADD);
+		glc->blendFunc(gl::SRC_ALPHA, gl::ONE_MINUS_SRC_ALPHA);
+		break;
+	case BLEND_ADD:
+		glc->enable(gl::BLEND);
+		glc->blendEquation(gl::FUNC_ADD);
+		glc->blendFunc(gl::ONE, gl::ONE);
+		break;
+	case BLEND_MULTIPLY:
+		glc->enable(gl::BLEND);
+		glc->blendEquation(gl::FUNC_ADD);
+		glc->blendFunc(gl::DST_COLOR, gl::ZERO);
+		break;
+	}
+	_state.blendingMode = blendingMode;
+	_stats.blendingModeChangeCount += 1;
+}
+
+
+void RenderPass::_bindUniformBuffer(unsigned binding, const UniformBufferRange& range) {
+	if(_state.uniformBuffers.size() <= binding) {
+		_state.uniformBuffers.resize(binding + 1, BoundRange{ GLuint(-1), 0, 0 });
+	}
+
+	BoundRange& bound = _state.uniformBuffers[binding];
+	GLuint id = range.buffer->id();
+	if(bound.buffer == id && bound.offset == range.offset && bound.size == range.size) {
+		_stats.uniformBufferBindSkipCount += 1;
+		return;
+	}
+
+	_renderer->context()->bindBufferRange(gl::UNIFORM_BUFFER, binding, id,
+	                                      range.offset, range.size);
+	bound = BoundRange{ id, range.offset, range.size };
+	_stats.uniformBufferBindCount += 1;
+}
+
+
+void RenderPass::_setShaderParameters(ProgramObject* shader, const ShaderParameter* params) {
+	ProgramState& program = _state.programs[shader->id()];
+
+	// Contiguous draw calls often share the same parameter block. Uniform
+	// buffer bindings are not part of the program state, so they are always
+	// checked.
+	if(program.params == params) {
+		for(const ShaderParameter* param = params; param->index >= 0; ++param) {
+			if(param->type == gl::UNIFORM_BUFFER) {
+				_bindUniformBuffer(param->index,
+				                   *static_cast<const UniformBufferRange*>(param->value));
+			}
+			else {
+				_stats.uniformSkipCount += 1;
+			}
+		}
+		return;
+	}
+	program.params = params;
+
+	Context* glc = _renderer->context();
+	for(const ShaderParameter* param = params; param->index >= 0; ++param) {
+		if(param->type == gl::UNIFORM_BUFFER) {
+			_bindUniformBuffer(param->index,
+			                   *static_cast<const UniformBufferRange*>(param->value));
+			continue;
+		}
+
+		unsigned size = shaderParameterSize(param->type);
+		lairAssert(size <= sizeof(UniformValue::data));
+
+		if(program.uniforms.size() <= unsigned(param->index)) {
+			program.uniforms.resize(param->index + 1, UniformValue{ 0, {} });
+		}
+		UniformValue& cached = program.uniforms[param->index];
+		if(cached.type == param->type
+		&& std::memcmp(cached.data, param->value, size) == 0) {
+			_stats.uniformSkipCount += 1;
+			continue;
+		}
+		cached.type = param->type;
+		std::memcpy(cached.data, param->value, size);
+
+		#define LAIR_UNIF_CASE(_glType, _suffix, _type) case _glType:\
+			glc->uniform##_suffix(param->index, 1, reinterpret_cast<const _type*>(param->value));\
+			break
+		#define LAIR_UNIF_CASE_MAT(_glType, _suffix, _type) case _glType:\
+			glc->uniformMatrix##_suffix(param->index, 1, false, reinterpret_cast<const _type*>(param->value));\
+			break
+		switch(param->type) {
+		LAIR_UNIF_CASE    (gl::INT,        1iv, int);
+		LAIR_UNIF_CASE    (gl::INT_VEC2,   2iv, int);
+		LAIR_UNIF_CASE    (gl::INT_VEC3,   3iv, int);
+		LAIR_UNIF_CASE    (gl::INT_VEC4,   4iv, int);
+		LAIR_UNIF_CASE    (gl::BOOL,       1iv, int);
+		LAIR_UNIF_CASE    (gl::BOOL_VEC2,  2iv, int);
+		LAIR_UNIF_CASE    (gl::BOOL_VEC3,  3iv, int);
+		LAIR_UNIF_CASE    (gl::BOOL_VEC4,  4iv, int);
+		LAIR_UNIF_CASE    (gl::FLOAT,      1fv, float);
+		LAIR_UNIF_CASE    (gl::FLOAT_VEC2, 2fv, float);
+		LAIR_UNIF_CASE    (gl::FLOAT_VEC3, 3fv, float);
+		LAIR_UNIF_CASE    (gl::FLOAT_VEC4, 4fv, float);
+		LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT2, 2fv, float);
+		LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT3, 3fv, float);
+		LAIR_UNIF_CASE_MAT(gl::FLOAT_MAT4, 4fv, float);
+		}
+		#undef LAIR_UNIF_CASE
+		#undef LAIR_UNIF_CASE_MAT
+		_stats.uniformUploadCount += 1;
+	}
+}
+
+
 }
 
 
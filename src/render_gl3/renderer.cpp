@@ -21,9 +21,11 @@
 
 #include <vector>
 #include <algorithm>
+#include <chrono>
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include <lair/meta/property_serializer.h>
 
@@ -47,8 +49,13 @@ Renderer::Renderer(RenderModule* module, AssetManager* assetManager)
     : _module(module),
       _assetManager(assetManager),
       _context(module? module->context(): nullptr),
+      _programCache(_context, module? &module->log(): nullptr),
+      _gpuProfiler(_context),
       _vertexArrayIndex(0),
       _defaultTexture(),
+      _textureAtlas(this, assetManager),
+      _atlasRequests(),
+      _textureUploader(this),
       _textureSetIndex(0) {
 	lairAssert(_module);
 	lairAssert(_assetManager);
@@ -83,9 +90,11 @@ ShaderObject Renderer::compileShader(const char* name, GLenum type,
 
 VertexArraySP Renderer::createVertexArray(GLsizei sizeInBytes,
                                           const VertexAttrib* attribs,
-                                          BufferObject* indices) {
+                                          BufferObject* indices,
+                                          GLsizei instanceSizeInBytes) {
 	return std::make_shared<VertexArray>(
-	            this, _vertexArrayIndex++, sizeInBytes, attribs, indices);
+	            this, _vertexArrayIndex++, sizeInBytes, attribs, indices,
+	            instanceSizeInBytes);
 }
 
 
@@ -102,6 +111,10 @@ ProgramObject Renderer::compileProgram(const char* name,
 		prog.bindAttributeLocation(attrib.name, attrib.index);
 	}
 
+	if(_programCache.isEnabled()) {
+		_context->programParameteri(prog.id(), gl::PROGRAM_BINARY_RETRIEVABLE_HINT, gl::TRUE);
+	}
+
 	if(!prog.link()) {
 		std::string sLog;
 		prog.getLog(sLog);
@@ -112,6 +125,47 @@ ProgramObject Renderer::compileProgram(const char* name,
 }
 
 
+ProgramObject Renderer::compileProgram(const char* name,
+                                       const VertexAttribSet* attribs,
+                                       const GlslSource& vert,
+                                       const GlslSource& frag) {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	bool   useCache = _programCache.isEnabled();
+	uint64 key      = useCache? _programCache.key(attribs, vert, frag): 0;
+
+	if(useCache) {
+		ProgramObject prog(this);
+		prog.generateObject();
+		if(_programCache.load(prog, key)) {
+			double time = std::chrono::duration<double>(Clock::now() - start).count();
+			_programCache.recordBuild(true, time);
+			log().info("Load program "", name, "" from cache in ", time * 1000, "ms (warm: ",
+			           _programCache.stats().warmTime * 1000, "ms, cold: ",
+			           _programCache.stats().coldTime * 1000, "ms)");
+			return prog;
+		}
+	}
+
+	ShaderObject vertShader = compileShader(name, gl::VERTEX_SHADER, vert);
+	ShaderObject fragShader = compileShader(name, gl::FRAGMENT_SHADER, frag);
+	ProgramObject prog = compileProgram(name, attribs, &vertShader, &fragShader);
+
+	if(useCache && prog.isLinked()) {
+		_programCache.store(prog, key);
+	}
+
+	double time = std::chrono::duration<double>(Clock::now() - start).count();
+	_programCache.recordBuild(false, time);
+	log().info("Compile program "", name, "" in ", time * 1000, "ms (warm: ",
+	           _programCache.stats().warmTime * 1000, "ms, cold: ",
+	           _programCache.stats().coldTime * 1000, "ms)");
+
+	return prog;
+}
+
+
 SamplerSP Renderer::getSampler(const SamplerParams& params) {
 	SamplerWP& wp = _samplerMap[params];
 	SamplerSP  sp = wp.lock();
@@ -138,26 +192,64 @@ TextureAspectSP Renderer::createTexture(AssetSP asset) {
 }
 
 
+TextureAspectSP Renderer::createRenderTexture(const Path& logicPath,
+                                              unsigned width, unsigned height) {
+	AssetSP asset = _assetManager->getOrCreateAsset(logicPath);
+	TextureAspectSP aspect = asset->getOrCreateAspect<TextureAspect>();
+
+	if(!aspect->isValid()
+	|| aspect->get().width() != width || aspect->get().height() != height) {
+		// No mipmaps: render targets are usually drawn at their own scale.
+		std::unique_ptr<Texture> tex(new Texture(this));
+		tex->_allocate(width, height, Image::FormatRGBA8, 0);
+		aspect->_set(std::move(tex));
+	}
+
+	return aspect;
+}
+
+
 void Renderer::enqueueToUpload(TextureAspectSP texture) {
 	_pendingTextures.push_back(texture);
 }
 
 
+void Renderer::packInAtlas(TextureAspectSP texture) {
+	if(_textureAtlas.isEnabled() && texture && !texture->isValid()) {
+		_atlasRequests.insert(texture.get());
+	}
+}
+
+
 void Renderer::uploadPendingTextures() {
-	for(TextureAspectSP texture: _pendingTextures) {
-		ImageAspectSP image = texture->asset()->aspect<ImageAspect>();
-		if(image && image->isValid() && !texture->isValid()) {
-			log().info("Upload texture \"", texture->asset()->logicPath(), "\"...");
+	LAIR_PROFILE_SCOPE("Renderer::uploadPendingTextures");
+
+	auto end = std::remove_if(_pendingTextures.begin(), _pendingTextures.end(),
+	                          [this](TextureAspectSP texture) {
+		if(texture->isValid())
+			return true;
 
-			std::unique_ptr<Texture> tex(new Texture(this));
-			tex->_upload(image->get());
-			texture->_set(std::move(tex));
+		ImageAspectSP image = texture->asset()->aspect<ImageAspect>();
+		if(!image || !image->isValid())
+			return false;
+
+		auto request = _atlasRequests.find(texture.get());
+		if(request != _atlasRequests.end()) {
+			_atlasRequests.erase(request);
+			if(_textureAtlas.pack(texture, image->get())) {
+				log().debug("Pack texture \"", texture->asset()->logicPath(), "\" in atlas...");
+				return true;
+			}
 		}
-	}
 
-	auto end = std::remove_if(_pendingTextures.begin(), _pendingTextures.end(),
-	                          [](TextureAspectSP tex) { return bool(tex->isValid()); });
+		log().debug("Queue texture \"", texture->asset()->logicPath(), "\" for upload...");
+		_textureUploader.enqueue(texture, image);
+		return true;
+	});
 	_pendingTextures.erase(end, _pendingTextures.end());
+
+	_textureAtlas._update();
+	_textureUploader.update();
 }
 
 
@@ -19,8 +19,12 @@
  */
 
 
+layout(std140) uniform SpriteBlock {
+	highp mat4 modelMatrix;
+	highp vec4 tileInfo;
+};
+
 uniform sampler2D sprite;
-uniform vec4      tileInfo;
 
 in highp   vec4 position;
 in lowp    vec4 color;
@@ -19,7 +19,14 @@
  */
 
 
-uniform highp mat4 viewMatrix;
+layout(std140) uniform ViewBlock {
+	highp mat4 viewMatrix;
+};
+
+layout(std140) uniform SpriteBlock {
+	highp mat4 modelMatrix;
+	highp vec4 tileInfo;
+};
 
 in highp   vec4 vx_position;
 in lowp    vec4 vx_color;
@@ -30,7 +37,7 @@ out lowp    vec4 color;
 out mediump vec2 texCoord;
 
 void main() {
-	gl_Position = viewMatrix * vx_position;
+	gl_Position = viewMatrix * (modelMatrix * vx_position);
 	position    = vx_position;
 	color       = vx_color;
 	texCoord    = vx_texCoord;
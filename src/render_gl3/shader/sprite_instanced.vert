@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2015-2018 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+layout(std140) uniform ViewBlock {
+	highp mat4 viewMatrix;
+};
+
+layout(std140) uniform SpriteBlock {
+	highp mat4 modelMatrix;
+	highp vec4 tileInfo;
+};
+
+// Per-vertex: corner of the unit quad.
+in highp   vec2 vx_corner;
+
+// Per-instance: 2D affine transform, local box, texture box and color.
+in highp   vec4 vx_transform;
+in highp   vec4 vx_offset;
+in highp   vec4 vx_coords;
+in mediump vec4 vx_texCoords;
+in lowp    vec4 vx_color;
+
+out highp   vec4 position;
+out lowp    vec4 color;
+out mediump vec2 texCoord;
+
+void main() {
+	mat2 basis  = mat2(vx_transform.xy, vx_transform.zw);
+	vec2 local  = mix(vx_coords.xy, vx_coords.zw, vx_corner);
+
+	position    = vec4(basis * local + vx_offset.xy, vx_offset.z, 1.0);
+	gl_Position = viewMatrix * (modelMatrix * position);
+	color       = vx_color;
+	// texCoords are bottom-up.
+	texCoord    = mix(vx_texCoords.xy, vx_texCoords.zw, vec2(vx_corner.x, 1.0 - vx_corner.y));
+}
@@ -42,7 +42,9 @@ Texture::Texture(Renderer* renderer)
       _width         (0),
       _height        (0),
       _format        (0),
-      _maxMipmapLevel(0) {
+      _maxMipmapLevel(0),
+      _atlasPage     (),
+      _region        (Vector2(0, 0), Vector2(1, 1)) {
 }
 
 
@@ -54,7 +56,9 @@ Texture::Texture(Texture&& other)
       _width         (other._width),
       _height        (other._height),
       _format        (other._format),
-      _maxMipmapLevel(other._maxMipmapLevel) {
+      _maxMipmapLevel(other._maxMipmapLevel),
+      _atlasPage     (std::move(other._atlasPage)),
+      _region        (other._region) {
 	other._context        = nullptr;
 	other._renderer       = nullptr;
 	other._target         = 0;
@@ -85,14 +89,37 @@ void Texture::bind() const {
 
 bool Texture::_upload(const Image& image, unsigned maxMipmapLevel, bool linear) {
 	lairAssert(image.isValid());
+	return _upload(image.width(), image.height(), image.format(), image.data(),
+	               maxMipmapLevel, linear);
+}
+
+
+bool Texture::_upload(unsigned width, unsigned height, Image::Format imageFormat,
+                      const void* data, unsigned maxMipmapLevel, bool linear) {
+	if(!_allocate(width, height, imageFormat, maxMipmapLevel, linear))
+		return false;
+
+	GLenum imgFormat = (imageFormat == Image::FormatRGB8)? gl::RGB: gl::RGBA;
+	_context->texSubImage2D(_target, 0, 0, 0, _width, _height,
+	                        imgFormat, gl::UNSIGNED_BYTE, data);
+
+	if(_maxMipmapLevel > 0) {
+		_context->generateMipmap(_target);
+	}
+
+	return true;
+}
+
 
+bool Texture::_allocate(unsigned width, unsigned height, Image::Format imageFormat,
+                        unsigned maxMipmapLevel, bool linear) {
 	// Compute GL parameters from image
 
 	GLenum target = gl::TEXTURE_2D;
 
 	GLenum format;
 	GLenum imgFormat;
-	switch(image.format()) {
+	switch(imageFormat) {
 	case Image::FormatRGB8:
 		format    = linear? gl::RGB8: gl::SRGB8;
 		imgFormat = gl::RGB;
@@ -106,7 +133,7 @@ bool Texture::_upload(const Image& image, unsigned maxMipmapLevel, bool linear)
 	}
 
 	unsigned nMipmaps = 0;
-	unsigned maxSize = std::max(image.width(), image.height());
+	unsigned maxSize = std::max(width, height);
 	while(maxSize) {
 		nMipmaps += 1;
 		maxSize = maxSize >> 1;
@@ -118,15 +145,16 @@ bool Texture::_upload(const Image& image, unsigned maxMipmapLevel, bool linear)
 	// We use immutable texture storage, so if the texture size / format changed,
 	// we recreate a new texture.
 	bool allocateStorage = !_id
+	                    || isAtlasView()
 	                    || target         != _target
-	                    || image.width()  != _width
-	                    || image.height() != _height
+	                    || width          != _width
+	                    || height         != _height
 	                    || format         != _format
 	                    || maxMipmapLevel != _maxMipmapLevel;
 
 	_target         = target;
-	_width          = image.width();
-	_height         = image.height();
+	_width          = width;
+	_height         = height;
 	_format         = format;
 	_maxMipmapLevel = maxMipmapLevel;
 
@@ -137,19 +165,54 @@ bool Texture::_upload(const Image& image, unsigned maxMipmapLevel, bool linear)
 
 	_context->bindTexture(_target, _id);
 
-	if(_context->_gl_arb_texture_storage) {
-		_context->texStorage2D(_target, _maxMipmapLevel + 1, _format,
-		                       _width, _height);
-	}
-	else {
-		_context->texImage2D(_target, 0, _format, _width, _height, 0,
-		                     imgFormat, gl::UNSIGNED_BYTE, nullptr);
+	// Immutable storage can not be reallocated.
+	if(allocateStorage || !_context->_gl_arb_texture_storage) {
+		if(_context->_gl_arb_texture_storage) {
+			_context->texStorage2D(_target, _maxMipmapLevel + 1, _format,
+			                       _width, _height);
+		}
+		else {
+			_context->texImage2D(_target, 0, _format, _width, _height, 0,
+			                     imgFormat, gl::UNSIGNED_BYTE, nullptr);
+		}
 	}
 
-	_context->texSubImage2D(_target, 0, 0, 0, _width, _height,
-	                        imgFormat, gl::UNSIGNED_BYTE, image.data());
 	_context->texParameteri(_target, gl::TEXTURE_MAX_LEVEL, _maxMipmapLevel);
 
+	return true;
+}
+
+
+bool Texture::_uploadRegion(const Image& image, const Box2i& rect) {
+	lairAssert(isValid() && !isAtlasView());
+	lairAssert(image.isValid());
+
+	GLenum imgFormat;
+	switch(image.format()) {
+	case Image::FormatRGB8:
+		imgFormat = gl::RGB;
+		break;
+	case Image::FormatRGBA8:
+		imgFormat = gl::RGBA;
+		break;
+	default:
+		return false;
+	}
+
+	if(rect.isEmpty())
+		return true;
+
+	const Byte* data = static_cast<const Byte*>(image.data())
+	                 + (rect.min()(1) * image.width() + rect.min()(0))
+	                 * Image::formatByteSize(image.format());
+	Vector2i size = rect.sizes();
+
+	_context->bindTexture(_target, _id);
+	_context->pixelStorei(gl::UNPACK_ROW_LENGTH, image.width());
+	_context->texSubImage2D(_target, 0, rect.min()(0), rect.min()(1), size(0), size(1),
+	                        imgFormat, gl::UNSIGNED_BYTE, data);
+	_context->pixelStorei(gl::UNPACK_ROW_LENGTH, 0);
+
 	if(_maxMipmapLevel > 0) {
 		_context->generateMipmap(_target);
 	}
@@ -158,6 +221,29 @@ bool Texture::_upload(const Image& image, unsigned maxMipmapLevel, bool linear)
 }
 
 
+void Texture::_setAtlasView(TextureAspectSP page, const Box2i& rect) {
+	lairAssert(page && page->isValid() && !page->get().isAtlasView());
+
+	const Texture& tex = page->get();
+
+	_release();
+
+	_context        = tex._context;
+	_renderer       = tex._renderer;
+	_target         = tex._target;
+	_id             = tex._id;
+	_width          = rect.sizes()(0);
+	_height         = rect.sizes()(1);
+	_format         = tex._format;
+	_maxMipmapLevel = tex._maxMipmapLevel;
+	_atlasPage      = page;
+
+	Vector2 pageSize(tex._width, tex._height);
+	_region = Box2(rect.min().cast<float>().cwiseQuotient(pageSize),
+	               rect.max().cast<float>().cwiseQuotient(pageSize));
+}
+
+
 void swap(Texture& t0, Texture& t1) {
 	std::swap(t0._context,        t1._context);
 	std::swap(t0._renderer,       t1._renderer);
@@ -167,11 +253,19 @@ void swap(Texture& t0, Texture& t1) {
 	std::swap(t0._height,         t1._height);
 	std::swap(t0._format,         t1._format);
 	std::swap(t0._maxMipmapLevel, t1._maxMipmapLevel);
+	std::swap(t0._atlasPage,      t1._atlasPage);
+	std::swap(t0._region,         t1._region);
 }
 
 
 void Texture::_release() {
-	if(isValid()) {
+	if(isAtlasView()) {
+		// The GL texture is owned by the atlas page.
+		_id = 0;
+		_atlasPage.reset();
+		_region = Box2(Vector2(0, 0), Vector2(1, 1));
+	}
+	else if(isValid()) {
 		_context->deleteTextures(1, &_id);
 	}
 }
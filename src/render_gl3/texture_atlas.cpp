@@ -0,0 +1,180 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <sstream>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/meta/var_list.h>
+#include <lair/meta/var_map.h>
+#include <lair/meta/variant_reader.h>
+
+#include <lair/asset/loader.h>
+
+#include <lair/sys_sdl2/image_loader.h>
+
+#include <lair/render_gl3/renderer.h>
+
+#include "lair/render_gl3/texture_atlas.h"
+
+
+namespace lair
+{
+
+
+TextureAtlas::TextureAtlas(Renderer* renderer, AssetManager* assetManager,
+                           unsigned pageSize, unsigned padding)
+    : _renderer(renderer),
+      _assetManager(assetManager),
+      _enabled(false),
+      _images(pageSize, padding),
+      _pages(),
+      _pendingViews() {
+	lairAssert(_renderer);
+	lairAssert(_assetManager);
+}
+
+
+TextureAspectSP TextureAtlas::page(unsigned index) const {
+	lairAssert(index < _pages.size());
+	return _pages[index];
+}
+
+
+bool TextureAtlas::pack(TextureAspectSP texture, const Image& image) {
+	lairAssert(bool(texture));
+
+	const ImageAtlas::Entry* entry =
+	        _images.add(texture->asset()->logicPath().utf8String(), image);
+	if(!entry)
+		return false;
+
+	while(_pages.size() < _images.nPages()) {
+		std::ostringstream name;
+		name << "/__builtin__/atlas_page_" << _pages.size();
+		AssetSP asset = _assetManager->getOrCreateAsset(name.str());
+		_pages.push_back(asset->getOrCreateAspect<TextureAspect>());
+	}
+
+	_pendingViews.push_back(PendingView{ texture, _pages[entry->page], entry->rect });
+
+	return true;
+}
+
+
+bool TextureAtlas::loadIndex(const Variant& index, const Path& indexPath,
+                             LoaderManager* loader, Logger& log) {
+	if(!index.isVarMap()) {
+		log.error(index.parseInfoDesc(), "Invalid type: expected ImageAtlas (VarMap), got ", index.typeName());
+		return false;
+	}
+
+	const VarMap& map = index.asVarMap();
+	if(!map.type().empty() && map.type() != "ImageAtlas") {
+		log.warning(index.parseInfoDesc(), "Unexpected type annotation: expected ImageAtlas, got ",
+		            map.type());
+	}
+
+	const Variant& pagesVar   = index.get("pages");
+	const Variant& entriesVar = index.get("entries");
+	if(!pagesVar.isVarList() || !entriesVar.isVarMap()) {
+		log.error(index.parseInfoDesc(), "ImageAtlas requires a \"pages\" list and an \"entries\" map.");
+		return false;
+	}
+
+	bool success = true;
+
+	std::vector<TextureAspectSP> pages;
+	for(const Variant& pageVar: pagesVar.asVarList()) {
+		String file;
+		if(!varRead(file, pageVar, log)) {
+			success = false;
+			pages.emplace_back();
+			continue;
+		}
+
+		AssetSP asset = loader->loadAsset<ImageLoader>(
+		                    makeAbsolute(indexPath.dir(), file));
+		pages.push_back(_renderer->createTexture(asset));
+	}
+
+	for(const VarMap::Pair& pair: entriesVar.asVarMap()) {
+		int   page = -1;
+		Box2i rect;
+		bool  ok = varRead(page, pair.second.get("page"), log)
+		        && varRead(rect, pair.second.get("rect"), log);
+		if(!ok || page < 0 || unsigned(page) >= pages.size() || !pages[page]) {
+			log.error(pair.second.parseInfoDesc(), "Invalid atlas entry \"", pair.first, "\".");
+			success = false;
+			continue;
+		}
+
+		AssetSP asset = _assetManager->getOrCreateAsset(pair.first);
+		TextureAspectSP texture = asset->getOrCreateAspect<TextureAspect>();
+		if(!texture->isValid())
+			_pendingViews.push_back(PendingView{ texture, pages[page], rect });
+	}
+
+	return success;
+}
+
+
+void TextureAtlas::_update() {
+	for(unsigned i = 0; i < _pages.size(); ++i) {
+		const Box2i& dirty = _images.dirtyRect(i);
+		if(dirty.isEmpty())
+			continue;
+
+		const Image& image = _images.pageImage(i);
+		TextureAspectSP page = _pages[i];
+		if(!page->isValid()) {
+			_renderer->log().info("Upload texture atlas page ", i, "...");
+
+			// No mipmaps: they would bleed between packed textures.
+			std::unique_ptr<Texture> tex(new Texture(_renderer));
+			tex->_upload(image, 0);
+			page->_set(std::move(tex));
+		}
+		else {
+			page->_get()._uploadRegion(image, dirty);
+		}
+		_images._clearDirty(i);
+	}
+
+	auto end = std::remove_if(_pendingViews.begin(), _pendingViews.end(),
+	                          [this](const PendingView& view) {
+		if(view.texture->isValid())
+			return true;
+		if(!view.page->isValid())
+			return false;
+
+		std::unique_ptr<Texture> tex(new Texture(_renderer));
+		tex->_setAtlasView(view.page, view.rect);
+		view.texture->_set(std::move(tex));
+		return true;
+	});
+	_pendingViews.erase(end, _pendingViews.end());
+}
+
+
+}
@@ -0,0 +1,236 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstring>
+
+#include <lair/core/lair.h>
+#include <lair/core/log.h>
+
+#include <lair/render_gl3/renderer.h>
+
+#include "lair/render_gl3/texture_uploader.h"
+
+
+namespace lair
+{
+
+
+TextureUploader::TextureUploader(Renderer* renderer)
+    : _renderer(renderer),
+      _context(renderer? renderer->context(): nullptr),
+      _byteBudget(16 << 20),
+      _timeBudget(.004),
+      _waiting(),
+      _staging(),
+      _stagingBytes(0),
+      _freeBuffers(),
+      _running(true),
+      _thread() {
+	std::memset(&_stats, 0, sizeof(_stats));
+	_thread = std::thread(&TextureUploader::_run, this);
+}
+
+
+TextureUploader::~TextureUploader() {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_cond.notify_all();
+	_thread.join();
+
+	for(JobUP& job: _staging) {
+		_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, job->buffer);
+		_context->unmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+		_freeBuffers.push_back(job->buffer);
+	}
+	_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+	if(!_freeBuffers.empty()) {
+		_context->deleteBuffers(_freeBuffers.size(), _freeBuffers.data());
+	}
+}
+
+
+void TextureUploader::setBudget(Size bytes, double seconds) {
+	_byteBudget = bytes;
+	_timeBudget = seconds;
+}
+
+
+void TextureUploader::enqueue(TextureAspectSP texture, ImageAspectSP image) {
+	lairAssert(texture && image && image->isValid());
+
+	JobUP job(new Job);
+	job->texture   = texture;
+	job->image     = image;
+	job->queueTime = Clock::now();
+	job->buffer    = 0;
+	job->mapped    = nullptr;
+	job->staged    = false;
+	_waiting.push_back(std::move(job));
+}
+
+
+void TextureUploader::update() {
+	Clock::time_point start = Clock::now();
+
+	_stats.uploadCount = 0;
+	_stats.uploadBytes = 0;
+
+	// Upload in order, textures are often requested by priority.
+	while(!_staging.empty() && _staging.front()->staged) {
+		if(_stats.uploadCount) {
+			Size size = _staging.front()->image->get().sizeInBytes();
+			double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			if((_byteBudget && _stats.uploadBytes + size > _byteBudget)
+			|| (_timeBudget && elapsed > _timeBudget))
+				break;
+		}
+
+		JobUP job = std::move(_staging.front());
+		_staging.pop_front();
+		_upload(*job);
+	}
+
+	// Keep about two frames worth of data in staging buffers.
+	Size maxStaging = _byteBudget? 2 * _byteBudget: Size(-1);
+	while(!_waiting.empty() && (_staging.empty() || _stagingBytes < maxStaging)) {
+		JobUP job = std::move(_waiting.front());
+		_waiting.pop_front();
+		if(job->texture->isValid())
+			continue;
+
+		if(_stage(*job)) {
+			_staging.push_back(std::move(job));
+		}
+		else {
+			// Fallback to a synchronous upload.
+			_upload(*job);
+		}
+	}
+
+	_stats.queueDepth = _waiting.size() + _staging.size();
+	_stats.uploadTime = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+bool TextureUploader::_stage(Job& job) {
+	const Image& image = job.image->get();
+	Size size = image.sizeInBytes();
+
+	if(_freeBuffers.empty()) {
+		GLuint buffer = 0;
+		_context->genBuffers(1, &buffer);
+		_freeBuffers.push_back(buffer);
+	}
+	job.buffer = _freeBuffers.back();
+
+	// Orphan the previous storage, so we never wait for a pending upload.
+	_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, job.buffer);
+	_context->bufferData(gl::PIXEL_UNPACK_BUFFER, size, nullptr, gl::STREAM_DRAW);
+	job.mapped = static_cast<Byte*>(_context->mapBufferRange(
+	                 gl::PIXEL_UNPACK_BUFFER, 0, size,
+	                 gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_BUFFER_BIT));
+	_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+
+	if(!job.mapped) {
+		job.buffer = 0;
+		return false;
+	}
+	_freeBuffers.pop_back();
+
+	_stagingBytes += size;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_copyQueue.push_back(&job);
+	}
+	_cond.notify_one();
+
+	return true;
+}
+
+
+void TextureUploader::_upload(Job& job) {
+	const Image& image = job.image->get();
+
+	// Do not replace a texture that has been uploaded by other means.
+	if(!job.texture->isValid()) {
+		std::unique_ptr<Texture> texture(new Texture(_renderer));
+
+		bool staged = job.buffer;
+		if(staged) {
+			_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, job.buffer);
+			staged = _context->unmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+			if(staged) {
+				texture->_upload(image.width(), image.height(), image.format(), nullptr);
+			}
+			_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+		}
+		// The staging buffer may be lost (unmapBuffer returns false).
+		if(!staged) {
+			texture->_upload(image);
+		}
+
+		job.texture->_set(std::move(texture));
+	}
+	else if(job.buffer) {
+		_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, job.buffer);
+		_context->unmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+		_context->bindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	if(job.buffer) {
+		_stagingBytes -= image.sizeInBytes();
+		_freeBuffers.push_back(job.buffer);
+	}
+
+	double latency = std::chrono::duration<double>(Clock::now() - job.queueTime).count();
+	_stats.avgLatency = _stats.totalCount? .9 * _stats.avgLatency + .1 * latency: latency;
+	_stats.maxLatency = std::max(_stats.maxLatency, latency);
+
+	_stats.uploadCount += 1;
+	_stats.uploadBytes += image.sizeInBytes();
+	_stats.totalCount  += 1;
+	_stats.totalBytes  += image.sizeInBytes();
+}
+
+
+void TextureUploader::_run() {
+	while(true) {
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cond.wait(lock, [this]{ return !_running || !_copyQueue.empty(); });
+			if(!_running)
+				return;
+			job = _copyQueue.front();
+			_copyQueue.pop_front();
+		}
+
+		const Image& image = job->image->get();
+		std::memcpy(job->mapped, image.data(), image.sizeInBytes());
+		job->staged = true;
+	}
+}
+
+
+}
@@ -34,12 +34,15 @@ namespace lair
 
 
 VertexArray::VertexArray(Renderer* renderer, unsigned index, GLsizei sizeInBytes,
-                         const VertexAttrib* attribs, BufferObject* indices)
+                         const VertexAttrib* attribs, BufferObject* indices,
+                         GLsizei instanceSizeInBytes)
     : _context(renderer->context()),
       _renderer(renderer),
       _index(index),
       _vao(0),
       _sizeInBytes(sizeInBytes),
+      _instanceSizeInBytes(instanceSizeInBytes),
+      _instanceBase(0),
       _attribs(),
       _indices(indices) {
 	const VertexAttrib* end = attribs;
@@ -72,17 +75,14 @@ void VertexArray::setup() {
 
 		_context->bindVertexArray(_vao);
 
-		BufferObject* buffer = nullptr;
+		_attribOffsets.assign(_attribs.size(), 0);
 		for(const VertexAttrib& attrib: _attribs) {
-			if(attrib.buffer != buffer) {
-				buffer = attrib.buffer;
-				buffer->bind();
-			}
 			_context->enableVertexAttribArray(attrib.index);
-			_context->vertexAttribPointer(attrib.index, attrib.size, attrib.type,
-			                              attrib.normalized, _sizeInBytes,
-			                              reinterpret_cast<const void*>(attrib.offset));
+			if(attrib.divisor) {
+				_context->vertexAttribDivisor(attrib.index, attrib.divisor);
+			}
 		}
+		_updatePointers(true);
 
 		if(_indices) {
 			_indices->bind(gl::ELEMENT_ARRAY_BUFFER);
@@ -92,6 +92,46 @@ void VertexArray::setup() {
 	}
 
 	_context->bindVertexArray(_vao);
+
+	// Streamed buffers may have moved to an other segment.
+	_updatePointers(false);
+}
+
+
+void VertexArray::setInstanceBase(unsigned firstInstance) {
+	lairAssert(_vao);
+
+	if(firstInstance == _instanceBase)
+		return;
+
+	_instanceBase = firstInstance;
+	_updatePointers(false);
+}
+
+
+void VertexArray::_updatePointers(bool force) {
+	BufferObject* buffer = nullptr;
+	for(unsigned ai = 0; ai < _attribs.size(); ++ai) {
+		const VertexAttrib& attrib = _attribs[ai];
+
+		GLsizei stride = attrib.divisor? _instanceSizeInBytes: _sizeInBytes;
+		Size    offset = attrib.offset + attrib.buffer->segmentOffset();
+		if(attrib.divisor) {
+			offset += Size(_instanceBase) * _instanceSizeInBytes;
+		}
+
+		if(!force && offset == _attribOffsets[ai])
+			continue;
+
+		if(attrib.buffer != buffer) {
+			buffer = attrib.buffer;
+			buffer->bind();
+		}
+		_context->vertexAttribPointer(attrib.index, attrib.size, attrib.type,
+		                              attrib.normalized, stride,
+		                              reinterpret_cast<const void*>(offset));
+		_attribOffsets[ai] = offset;
+	}
 }
 
 
@@ -99,6 +139,8 @@ void VertexArray::_release() {
 	if(_vao) {
 		_context->deleteVertexArrays(1, &_vao);
 		_vao = 0;
+		_instanceBase = 0;
+		_attribOffsets.clear();
 	}
 }
 
@@ -76,4 +76,33 @@ void ImageLoader::loadSyncImpl(Logger& log) {
 }
 
 
+bool saveImage(const Image& image, const Path& realPath, Logger& log) {
+	Uint32 format;
+	switch(image.format()) {
+	case Image::Format::FormatRGB8:
+		format = SDL_PIXELFORMAT_RGB24;
+		break;
+	case Image::Format::FormatRGBA8:
+		format = SDL_PIXELFORMAT_ABGR8888;
+		break;
+	default:
+		log.error("Failed to save image \"", realPath, "\": Invalid image");
+		return false;
+	}
+
+	unsigned bpp = Image::formatByteSize(image.format());
+	auto surf = make_unique(SDL_CreateRGBSurfaceWithFormatFrom(
+	                            const_cast<void*>(image.data()),
+	                            image.width(), image.height(), bpp * 8,
+	                            image.width() * bpp, format),
+	                        SDL_FreeSurface);
+	if(!surf || IMG_SavePNG(surf.get(), realPath.utf8CStr()) != 0) {
+		log.error("Failed to save image \"", realPath, "\": ", IMG_GetError());
+		return false;
+	}
+
+	return true;
+}
+
+
 }
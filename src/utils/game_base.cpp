@@ -49,6 +49,7 @@ GameConfigBase::GameConfigBase()
     , musicVolume(.35)
     , windowSize(1280, 720)
     , debugGl(false)
+    , shaderCache(true)
 {
 }
 
@@ -98,6 +99,8 @@ const PropertyList& GameConfigBase::staticProperties() {
 		                  &GameConfigBase::windowSize);
 		props.addProperty("debug_gl",
 		                  &GameConfigBase::debugGl);
+		props.addProperty("shader_cache",
+		                  &GameConfigBase::shaderCache);
 	}
 	return props;
 }
@@ -283,6 +286,9 @@ void GameBase::initialize(GameConfigBase& config) {
 	_renderModule.reset(new RenderModule(sys(), assets(), &_mlogger, DEFAULT_LOG_LEVEL));
 	_renderModule->initialize(config.debugGl);
 	_renderer = _renderModule->createRenderer();
+	if(config.shaderCache) {
+		_renderer->programCache().setDirectory(_sys->getPrefPath("lair", "shader_cache"));
+	}
 
 	// Audio
 
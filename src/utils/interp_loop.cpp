@@ -21,6 +21,7 @@
 
 #include <lair/core/lair.h>
 #include <lair/core/log.h>
+#include <lair/core/profiler.h>
 
 #include <lair/sys_sdl2/sys_module.h>
 
@@ -94,11 +95,15 @@ InterpLoop::EventType InterpLoop::nextEvent() {
 		if(!frameDuration())
 			return EventType::Frame;
 
+		LAIR_PROFILE_SCOPE("InterpLoop::wait");
 		_sys->dispatchPendingSystemEvents();
 		_sys->waitNs(nextEvent - now);
 		now = _sys->getTimeNs();
 	}
-	_sys->dispatchPendingSystemEvents();
+	{
+		LAIR_PROFILE_SCOPE("InterpLoop::dispatchEvents");
+		_sys->dispatchPendingSystemEvents();
+	}
 
 	// FIXME: Works only if getTimeNs is near 0 when program start.
 //	uint64 maxFrameTime = _frameRealTime + _maxFrameDuration;
@@ -0,0 +1,230 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cmath>
+
+#include <lair/core/lair.h>
+
+#include <lair/geometry/intersection.h>
+
+#include "lair/utils/tile_collision_layer.h"
+
+
+namespace lair
+{
+
+
+TileCollisionLayer::TileCollisionLayer()
+    : _offsetInTiles(0, 0)
+    , _sizeInTiles(0, 0)
+    , _tileSize(1, 1)
+    , _mergedBoxesDirty(false)
+{
+}
+
+
+TileCollisionLayer::TileCollisionLayer(const TileMap& tileMap, unsigned layerIndex)
+    : TileCollisionLayer()
+{
+	setFromTileMap(tileMap, layerIndex);
+}
+
+
+void TileCollisionLayer::setFromTileMap(const TileMap& tileMap, unsigned layerIndex) {
+	TileLayerCSP layer = tileMap.tileLayer(layerIndex);
+	reset(layer->offsetInTiles(), layer->sizeInTiles(),
+	      layer->tileSizeInPixels().cast<float>());
+
+	for(unsigned y = 0; y < layer->heightInTiles(); ++y) {
+		for(unsigned x = 0; x < layer->widthInTiles(); ++x) {
+			_flags[x + y * _sizeInTiles(0)] = tileMap.tileFlags(layer->tile(x, y));
+		}
+	}
+}
+
+
+void TileCollisionLayer::reset(const Vector2i& offsetInTiles, const Vector2i& sizeInTiles,
+                               const Vector2& tileSize) {
+	lairAssert((sizeInTiles.array() >= 0).all() && (tileSize.array() > 0).all());
+
+	_offsetInTiles = offsetInTiles;
+	_sizeInTiles   = sizeInTiles;
+	_tileSize      = tileSize;
+	_flags.assign(sizeInTiles.prod(), 0);
+	_mergedBoxesDirty = true;
+}
+
+
+void TileCollisionLayer::setFlags(int x, int y, uint32 flags) {
+	lairAssert(x >= 0 && y >= 0 && x < _sizeInTiles(0) && y < _sizeInTiles(1));
+	_flags[x + y * _sizeInTiles(0)] = flags;
+	_mergedBoxesDirty = true;
+}
+
+
+AlignedBox2 TileCollisionLayer::tileBox(int x, int y) const {
+	Vector2 min((x + _offsetInTiles(0)) * _tileSize(0),
+	            (_sizeInTiles(1) - y - 1 - _offsetInTiles(1)) * _tileSize(1));
+	return AlignedBox2(min, min + _tileSize);
+}
+
+
+Box2i TileCollisionLayer::tileRange(const AlignedBox2& box) const {
+	// Rows go down, so the top of the box gives the first row.
+	Vector2i min(_column(box.min()(0)),     _row(box.max()(1)));
+	Vector2i max(_column(box.max()(0)) + 1, _row(box.min()(1)) + 1);
+	return Box2i(min.cwiseMax(Vector2i::Zero()), max.cwiseMin(_sizeInTiles));
+}
+
+
+bool TileCollisionLayer::hitTest(const AlignedBox2& box, uint32 hitMask) const {
+	return hitTest(box, hitMask, [](int, int) { return true; });
+}
+
+
+bool TileCollisionLayer::sweep(const AlignedBox2& box, const Vector2& motion, uint32 hitMask,
+                               float* t, Vector2i* tile) const {
+	Vector2 margin = Vector2::Constant(_tileSize.minCoeff() * 1e-4f);
+	Vector2 center = box.center();
+	Vector2 half   = (box.sizes() / 2 - margin).cwiseMax(Vector2::Zero());
+
+	AlignedBox2 swept((center - half).cwiseMin(center - half + motion),
+	                  (center + half).cwiseMax(center + half + motion));
+	Box2i range = tileRange(swept);
+	if(!(range.min().array() < range.max().array()).all())
+		return false;
+
+	// Visit the slices of the range (columns or rows) along the main axis of
+	// the motion front to back, and stop once they start after the best hit.
+	// Rows go down, so moving up visits them in reverse.
+	int   axis    = (std::abs(motion(0)) >= std::abs(motion(1)))? 0: 1;
+	int   other   = 1 - axis;
+	bool  reverse = (axis == 0)? motion(0) < 0: motion(1) >= 0;
+	int   first   = reverse? range.max()(axis) - 1: range.min()(axis);
+	int   step    = reverse? -1: 1;
+	int   nSlices = range.max()(axis) - range.min()(axis);
+
+	bool     found = false;
+	float    best  = 1;
+	Vector2i bestTile(0, 0);
+	for(int i = 0; i < nSlices; ++i) {
+		Vector2i slice;
+		slice(axis)  = first + i * step;
+		slice(other) = range.min()(other);
+
+		AlignedBox2 sliceBox = tileBox(slice(0), slice(1));
+		float tEnter = 0;
+		if(motion(axis) > 0)
+			tEnter = (sliceBox.min()(axis) - center(axis) - half(axis)) / motion(axis);
+		else if(motion(axis) < 0)
+			tEnter = (sliceBox.max()(axis) - center(axis) + half(axis)) / motion(axis);
+		if(tEnter > best)
+			break;
+
+		Vector2i p = slice;
+		for(p(other) = range.min()(other); p(other) < range.max()(other); ++p(other)) {
+			if(!(flags(p(0), p(1)) & hitMask))
+				continue;
+
+			AlignedBox2 tb = tileBox(p(0), p(1));
+			float tHit;
+			if(raycast(AlignedBox2(tb.min() - half, tb.max() + half), center, motion, best, &tHit)
+			&& (!found || tHit < best)) {
+				found    = true;
+				best     = tHit;
+				bestTile = p;
+			}
+		}
+	}
+
+	if(found) {
+		if(t)    *t    = best;
+		if(tile) *tile = bestTile;
+	}
+	return found;
+}
+
+
+const TileCollisionLayer::MergedBoxVector& TileCollisionLayer::mergedBoxes() const {
+	if(_mergedBoxesDirty)
+		_mergeBoxes();
+	return _mergedBoxes;
+}
+
+
+int TileCollisionLayer::_column(float x) const {
+	float c = std::floor(x / _tileSize(0)) - _offsetInTiles(0);
+	return int(clamp(c, -1.f, float(_sizeInTiles(0) + 1)));
+}
+
+
+int TileCollisionLayer::_row(float y) const {
+	float r = _sizeInTiles(1) - 1 - _offsetInTiles(1) - std::floor(y / _tileSize(1));
+	return int(clamp(r, -1.f, float(_sizeInTiles(1) + 1)));
+}
+
+
+void TileCollisionLayer::_mergeBoxes() const {
+	_mergedBoxes.clear();
+
+	// Index of the box ending on the previous row for each run start, or -1.
+	int width = _sizeInTiles(0);
+	std::vector<int> prevRows(width, -1);
+	std::vector<int> rows    (width, -1);
+
+	for(int y = 0; y < _sizeInTiles(1); ++y) {
+		std::fill(rows.begin(), rows.end(), -1);
+
+		int x = 0;
+		while(x < width) {
+			uint32 f = flags(x, y);
+			int    x1 = x + 1;
+			while(x1 < width && flags(x1, y) == f)
+				++x1;
+
+			if(f) {
+				AlignedBox2 box = tileBox(x, y);
+				box.max()(0) = tileBox(x1 - 1, y).max()(0);
+
+				int prev = prevRows[x];
+				if(prev >= 0
+				&& _mergedBoxes[prev].flags == f
+				&& _mergedBoxes[prev].box.max()(0) == box.max()(0)) {
+					_mergedBoxes[prev].box.min()(1) = box.min()(1);
+					rows[x] = prev;
+				}
+				else {
+					rows[x] = _mergedBoxes.size();
+					_mergedBoxes.push_back(MergedBox{ box, f });
+				}
+			}
+
+			x = x1;
+		}
+
+		std::swap(prevRows, rows);
+	}
+
+	_mergedBoxesDirty = false;
+}
+
+
+}
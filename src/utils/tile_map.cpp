@@ -111,13 +111,13 @@ unsigned TileLayer::tileHeightInPixels() const {
 
 
 TileLayer::TileIndex TileLayer::tile(unsigned x, unsigned y) const {
-	lairAssert(x < widthInTiles() && y < widthInTiles());
+	lairAssert(x < widthInTiles() && y < heightInTiles());
 	return _tiles[x + y * widthInTiles()];
 }
 
 
 void TileLayer::setTile(unsigned x, unsigned y, TileIndex tile) {
-	lairAssert(x < widthInTiles() && y < widthInTiles());
+	lairAssert(x < widthInTiles() && y < heightInTiles());
 	_tiles[x + y * widthInTiles()] = tile;
 }
 
@@ -248,6 +248,21 @@ unsigned TileMap::tileSetVTiles() const {
 }
 
 
+uint32 TileMap::tileFlags(TileIndex gid) const {
+	gid &= GID_MASK;
+	return (gid && gid <= _tileFlags.size())? _tileFlags[gid - 1]: 0;
+}
+
+
+void TileMap::setTileFlags(TileIndex gid, uint32 flags) {
+	gid &= GID_MASK;
+	lairAssert(gid != 0);
+	if(gid > _tileFlags.size())
+		_tileFlags.resize(gid, 0);
+	_tileFlags[gid - 1] = flags;
+}
+
+
 bool TileMap::setFromLdl(LdlParser& parser) {
 	if(parser.valueType() != LdlParser::TYPE_MAP) {
 		parser.error("Expected TileMap (VarMap), got ", parser.valueTypeName());
@@ -356,6 +371,9 @@ bool TileMap::_parseTileSet(LdlParser& parser) {
 		else if(key == "v_tiles") {
 			success = ldlRead(parser, _tileSetVTiles);
 		}
+		else if(key == "tile_flags") {
+			success = _parseTileFlags(parser);
+		}
 		else {
 			parser.warning("Unknown key \"", key, "\" in TileSet, ignoring.");
 			parser.skip();
@@ -370,6 +388,31 @@ bool TileMap::_parseTileSet(LdlParser& parser) {
 }
 
 
+bool TileMap::_parseTileFlags(LdlParser& parser) {
+	if(parser.valueType() != LdlParser::TYPE_LIST) {
+		parser.error("Expected list of tile flags (VarList), got ", parser.valueTypeName());
+		parser.skip();
+		return false;
+	}
+
+	bool success = true;
+
+	_tileFlags.clear();
+	parser.enter();
+	while(success && parser.valueType() != LdlParser::TYPE_END) {
+		uint32 flags = 0;
+		success = ldlRead(parser, flags);
+		_tileFlags.push_back(flags);
+	}
+
+	while(parser.valueType() != LdlParser::TYPE_END)
+		parser.skip();
+	parser.leave();
+
+	return success;
+}
+
+
 bool TileMap::_parseTileLayers(LdlParser& parser) {
 	if(parser.valueType() != LdlParser::TYPE_LIST) {
 		parser.error("Expected list of tile layers (VarList), got ", parser.valueTypeName());
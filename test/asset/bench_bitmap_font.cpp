@@ -0,0 +1,115 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <chrono>
+#include <iostream>
+
+#include <lair/core/text.h>
+
+#include <lair/asset/bitmap_font.h>
+
+
+using namespace lair;
+
+
+// Layout throughput of BitmapFont on a long multilingual text, in glyphs per
+// second.
+
+
+static void addRange(BitmapFont& font, int first, int last) {
+	for(int cp = first; cp <= last; ++cp) {
+		BitmapFont::Glyph glyph;
+		glyph.region  = Box2(Vector2(0, 0), Vector2(.01, .01));
+		glyph.size    = Vector2(8 + cp % 5, 12);
+		glyph.offset  = Vector2(0, cp % 3);
+		glyph.advance = 9 + cp % 4;
+		font.setGlyph(cp, glyph);
+	}
+}
+
+
+int main(int /*argc*/, char** /*argv*/) {
+	BitmapFont font;
+	font.setHeight(16);
+	font.setBaselineToTop(12);
+
+	addRange(font, -1, -1);
+	addRange(font, 0x20, 0x7e);         // ASCII
+	addRange(font, 0xa0, 0xff);         // Latin-1
+	addRange(font, 0x370, 0x3ff);       // Greek
+	addRange(font, 0x400, 0x4ff);       // Cyrillic
+	addRange(font, 0x3040, 0x30ff);     // Kana
+	addRange(font, 0x4e00, 0x4fff);     // Some CJK
+	addRange(font, 0x1f600, 0x1f64f);   // Emoticons (sparse)
+
+	for(int cp0 = 'A'; cp0 <= 'Z'; ++cp0) {
+		for(int cp1 = 'a'; cp1 <= 'z'; cp1 += 3) {
+			font.setKerning(cp0, cp1, -(cp0 + cp1) % 3);
+		}
+	}
+
+	const char* samples[] = {
+	    "The quick brown fox jumps over the lazy dog. ",
+	    "Voix ambigu\xc3\xab d'un c\xc5\x93ur qui, au z\xc3\xa9phyr, pr\xc3\xa9" "f\xc3\xa8re les jattes de kiwis. ",
+	    "\xce\x9e\xce\xb5\xcf\x83\xce\xba\xce\xb5\xcf\x80\xce\xac\xce\xb6\xcf\x89 \xcf\x84\xce\xb7\xce\xbd \xcf\x88\xcf\x85\xcf\x87\xce\xbf\xcf\x86\xce\xb8\xcf\x8c\xcf\x81\xce\xb1 \xce\xb2\xce\xb4\xce\xb5\xce\xbb\xcf\x85\xce\xb3\xce\xbc\xce\xaf\xce\xb1. ",
+	    "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 \xd1\x84\xd1\x80\xd0\xb0\xd0\xbd\xd1\x86\xd1\x83\xd0\xb7\xd1\x81\xd0\xba\xd0\xb8\xd1\x85 \xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba. ",
+	    "\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xe3\x81\xab\xe3\x81\xbb\xe3\x81\xb8\xe3\x81\xa8 \xe4\xb8\x80\xe4\xba\x8c\xe4\xb8\x89 ",
+	    "\xf0\x9f\x98\x80\xf0\x9f\x98\x83 \xf0\x9f\x98\x89\n",
+	};
+
+	std::string text;
+	while(text.size() < (1 << 20)) {
+		for(const char* sample: samples)
+			text += sample;
+	}
+
+	Size nGlyphs = 0;
+	Utf8CodepointIterator it(text);
+	while(it.hasNext()) {
+		it.next();
+		++nGlyphs;
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned nRuns = 20;
+	Size placed = 0;
+	Clock::time_point start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		TextLayout layout = font.layoutText(text, 640);
+		placed += layout.nGlyphs();
+	}
+	double layoutSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	Size width = 0;
+	for(unsigned run = 0; run < nRuns; ++run) {
+		width += font.textWidth(text);
+	}
+	double widthSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "text: " << text.size() << " bytes, " << nGlyphs << " codepoints\n";
+	std::cout << "layoutText: " << double(nGlyphs * nRuns) / layoutSec
+	          << " glyphs/s (" << placed / nRuns << " placed)\n";
+	std::cout << "textWidth:  " << double(nGlyphs * nRuns) / widthSec
+	          << " glyphs/s (" << width / nRuns << " px)\n";
+
+	return 0;
+}
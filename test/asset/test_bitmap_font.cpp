@@ -0,0 +1,99 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <lair/asset/bitmap_font.h>
+
+
+using namespace lair;
+
+
+static BitmapFont::Glyph makeGlyph(unsigned advance) {
+	BitmapFont::Glyph glyph;
+	glyph.region  = Box2(Vector2(0, 0), Vector2(0, 0));
+	glyph.size    = Vector2(advance, 10);
+	glyph.offset  = Vector2(0, 0);
+	glyph.advance = advance;
+	return glyph;
+}
+
+
+TEST(BitmapFontTest, Glyph) {
+	BitmapFont font;
+	font.setGlyph('a', makeGlyph(1));
+	font.setGlyph(0xe9, makeGlyph(2));      // é
+	font.setGlyph(0x1f600, makeGlyph(3));   // Sparse range.
+
+	ASSERT_EQ(3u, font.nGlyphs());
+	ASSERT_EQ(1u, font.glyph('a').advance);
+	ASSERT_EQ(2u, font.glyph(0xe9).advance);
+	ASSERT_EQ(3u, font.glyph(0x1f600).advance);
+
+	// No default glyph yet.
+	ASSERT_EQ(0u, font.glyph('b').advance);
+	ASSERT_EQ(0u, font.glyph(0x1f601).advance);
+
+	font.setGlyph(-1, makeGlyph(7));
+	ASSERT_EQ(7u, font.glyph('b').advance);
+	ASSERT_EQ(7u, font.glyph(0x4e00).advance);
+	ASSERT_EQ(7u, font.glyph(0x1f601).advance);
+
+	font.setGlyph('a', makeGlyph(5));
+	ASSERT_EQ(4u, font.nGlyphs());
+	ASSERT_EQ(5u, font.glyph('a').advance);
+}
+
+
+TEST(BitmapFontTest, Kerning) {
+	BitmapFont font;
+	font.setKerning('A', 'V', -2);
+	font.setGlyph('A', makeGlyph(10));
+	font.setGlyph('V', makeGlyph(10));
+	font.setKerning(0x1f600, 'A', 3);
+	font.setKerning('A', 'V', -3);
+
+	ASSERT_EQ(-3, font.kerning('A', 'V'));
+	ASSERT_EQ( 0, font.kerning('V', 'A'));
+	ASSERT_EQ( 3, font.kerning(0x1f600, 'A'));
+	ASSERT_EQ( 0, font.kerning(-1, 'A'));
+
+	ASSERT_EQ(17u, font.textWidth("AV"));
+	ASSERT_EQ(20u, font.textWidth("VA"));
+}
+
+
+TEST(BitmapFontTest, Utf8Width) {
+	BitmapFont font;
+	font.setGlyph('a', makeGlyph(1));
+	font.setGlyph(0xe9, makeGlyph(2));     // é
+	font.setGlyph(0x3042, makeGlyph(4));   // あ
+	font.setGlyph(' ', makeGlyph(8));
+
+	ASSERT_EQ(7u, font.textWidth("a\xc3\xa9\xe3\x81\x82"));
+	ASSERT_EQ(24u, font.textWidth("\xc3\xa9 \xe3\x81\x82 \xc3\xa9"));
+
+	TextLayout layout = font.layoutText("a\xc3\xa9 \xe3\x81\x82");
+	ASSERT_EQ(4u, layout.nGlyphs());
+	ASSERT_EQ(0xe9u, layout.glyph(1).codepoint);
+	ASSERT_EQ(0x3042u, layout.glyph(3).codepoint);
+	ASSERT_EQ(11, layout.glyph(3).pos(0));
+}
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <lair/asset/image_atlas.h>
+
+
+using namespace lair;
+
+
+TEST(SkylinePackerTest, NoOverlap) {
+	SkylinePacker packer(Vector2i(64, 64));
+
+	std::vector<Box2i> boxes;
+	Vector2i pos;
+	for(int i = 0; i < 64; ++i) {
+		Vector2i size(1 + (i * 7) % 13, 1 + (i * 5) % 11);
+		if(!packer.pack(size, pos))
+			continue;
+
+		Box2i box(pos, pos + size);
+		ASSERT_TRUE(box.min()(0) >= 0 && box.min()(1) >= 0);
+		ASSERT_TRUE(box.max()(0) <= 64 && box.max()(1) <= 64);
+		for(const Box2i& other: boxes) {
+			ASSERT_TRUE(box.intersection(other).sizes().minCoeff() <= 0);
+		}
+		boxes.push_back(box);
+	}
+
+	ASSERT_GT(boxes.size(), 32u);
+	ASSERT_GT(packer.occupancy(), 0.5f);
+}
+
+
+TEST(SkylinePackerTest, Full) {
+	SkylinePacker packer(Vector2i(32, 32));
+
+	Vector2i pos;
+	for(int i = 0; i < 16; ++i) {
+		ASSERT_TRUE(packer.pack(Vector2i(8, 8), pos));
+	}
+	ASSERT_FALSE(packer.pack(Vector2i(1, 1), pos));
+	ASSERT_EQ(1.f, packer.occupancy());
+
+	packer.reset(Vector2i(32, 32));
+	ASSERT_FALSE(packer.pack(Vector2i(33, 1), pos));
+	ASSERT_TRUE(packer.pack(Vector2i(32, 32), pos));
+	ASSERT_EQ(Vector2i(0, 0), pos);
+}
+
+
+TEST(ImageAtlasTest, Add) {
+	Byte rgb[] = {
+		255, 0, 0,   0, 255, 0,
+		0, 0, 255,   255, 255, 255,
+	};
+	Image image(2, 2, Image::FormatRGB8, rgb);
+
+	ImageAtlas atlas(16, 1);
+	const ImageAtlas::Entry* entry = atlas.add("foo", image);
+	ASSERT_TRUE(entry);
+	ASSERT_EQ(1u, atlas.nPages());
+	ASSERT_EQ(Vector2i(2, 2), entry->rect.sizes());
+	ASSERT_EQ(entry, atlas.add("foo", image));
+	ASSERT_EQ(entry, atlas.find("foo"));
+	ASSERT_FALSE(atlas.find("bar"));
+
+	// Check the copy and the extruded border.
+	const Image& page = atlas.pageImage(entry->page);
+	const Byte* data = static_cast<const Byte*>(page.data());
+	for(int y = -1; y < 3; ++y) {
+		for(int x = -1; x < 3; ++x) {
+			int px = entry->rect.min()(0) + x;
+			int py = entry->rect.min()(1) + y;
+			const Byte* dst = data + (py * 16 + px) * 4;
+			const Byte* src = rgb + (clamp(y, 0, 1) * 2 + clamp(x, 0, 1)) * 3;
+			ASSERT_EQ(src[0], dst[0]);
+			ASSERT_EQ(src[1], dst[1]);
+			ASSERT_EQ(src[2], dst[2]);
+			ASSERT_EQ(255,    dst[3]);
+		}
+	}
+
+	Box2i dirty = atlas.dirtyRect(entry->page);
+	ASSERT_TRUE(dirty.contains(entry->rect));
+	atlas._clearDirty(entry->page);
+	ASSERT_TRUE(atlas.dirtyRect(entry->page).isEmpty());
+
+	Image big(15, 15, Image::FormatRGBA8);
+	ASSERT_FALSE(atlas.canPack(big));
+	ASSERT_FALSE(atlas.add("big", big));
+}
+
+
+TEST(ImageAtlasTest, MultiplePages) {
+	Image image(6, 6, Image::FormatRGBA8);
+
+	ImageAtlas atlas(16, 1);
+	for(int i = 0; i < 5; ++i) {
+		std::ostringstream name;
+		name << "image_" << i;
+		ASSERT_TRUE(atlas.add(name.str(), image));
+	}
+
+	ASSERT_EQ(2u, atlas.nPages());
+	ASSERT_EQ(5u, atlas.nEntries());
+	ASSERT_EQ(1u, atlas.find("image_4")->page);
+}
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <lair/core/profiler.h>
+
+
+using namespace lair;
+
+TEST(ProfilerTest, ZonesOnlyRecordedWhileCapturing) {
+	Profiler& profiler = Profiler::instance();
+	profiler.stop();
+	profiler.clear();
+
+	{ ProfileZone zone("ignored"); }
+
+	profiler.start();
+	{
+		ProfileZone outer("outer");
+		ProfileZone inner("inner");
+	}
+	profiler.stop();
+
+	{ ProfileZone zone("ignored"); }
+
+	ProfileEventList events = profiler.events();
+	ASSERT_EQ(2u, events.size());
+
+	// Sorted by begin time: outer begins first.
+	ASSERT_STREQ("outer", events[0].name);
+	ASSERT_EQ(0u, events[0].depth);
+	ASSERT_STREQ("inner", events[1].name);
+	ASSERT_EQ(1u, events[1].depth);
+	ASSERT_LE(events[0].begin, events[1].begin);
+	ASSERT_GE(events[0].end,   events[1].end);
+}
+
+TEST(ProfilerTest, RingBufferKeepsLatestEvents) {
+	Profiler profiler(4);
+	unsigned track = profiler.track("test");
+
+	for(uint64 i = 0; i < 10; ++i)
+		profiler.addEvent(track, "event", i, i + 1);
+
+	ProfileEventList events = profiler.events();
+	ASSERT_EQ(4u, events.size());
+	for(unsigned i = 0; i < 4; ++i)
+		ASSERT_EQ(6u + i, events[i].begin);
+
+	profiler.clear();
+	ASSERT_TRUE(profiler.events().empty());
+}
+
+TEST(ProfilerTest, OneTrackPerThread) {
+	Profiler profiler;
+	unsigned mainTrack = profiler.currentTrack();
+	ASSERT_EQ(mainTrack, profiler.currentTrack());
+	ASSERT_EQ(profiler.track("gpu"), profiler.track("gpu"));
+
+	unsigned otherTrack = mainTrack;
+	std::thread thread([&] { otherTrack = profiler.currentTrack(); });
+	thread.join();
+
+	ASSERT_NE(mainTrack, otherTrack);
+	ASSERT_EQ(3u, profiler.nTracks());
+}
+
+TEST(ProfilerTest, ChromeTrace) {
+	Profiler profiler;
+	profiler.start();
+	profiler.setThreadName("main \"thread\"");
+	uint64 time = Profiler::now();
+	profiler.addEvent(profiler.currentTrack(), "frame", time, time + 2000);
+	profiler.stop();
+
+	std::ostringstream out;
+	ASSERT_TRUE(profiler.writeChromeTrace(out));
+
+	std::string json = out.str();
+	ASSERT_EQ(0u, json.find("{\"traceEvents\":["));
+	ASSERT_NE(std::string::npos, json.find("\"name\":\"main \\\"thread\\\"\""));
+	ASSERT_NE(std::string::npos, json.find("\"name\":\"frame\",\"ph\":\"X\""));
+	ASSERT_NE(std::string::npos, json.find("\"dur\":2}"));
+}
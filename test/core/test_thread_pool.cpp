@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lair/core/thread_pool.h>
+
+
+using namespace lair;
+
+TEST(ThreadPoolTest, RunAllTasks) {
+	ThreadPool pool(3);
+	ASSERT_EQ(4u, pool.nThreads());
+
+	for(int round = 0; round < 100; ++round) {
+		std::vector<unsigned> hits(257, 0);
+		pool.run(hits.size(), [&](unsigned task) { hits[task] += 1; });
+		for(unsigned hit: hits) {
+			ASSERT_EQ(1u, hit);
+		}
+	}
+}
+
+TEST(ThreadPoolTest, NoWorker) {
+	ThreadPool pool(0);
+	ASSERT_EQ(1u, pool.nThreads());
+
+	unsigned sum = 0;
+	pool.run(10, [&](unsigned task) { sum += task; });
+	ASSERT_EQ(45u, sum);
+}
+
+TEST(ThreadPoolTest, ParallelFor) {
+	ThreadPool pool(3);
+
+	for(unsigned count: { 0u, 1u, 7u, 100u, 10000u }) {
+		unsigned nChunks = parallelChunkCount(&pool, count, 16);
+		std::vector<unsigned> chunkBegin(nChunks, count);
+		std::vector<unsigned> chunkEnd(nChunks, count);
+		std::atomic<unsigned> total(0);
+
+		parallelFor(&pool, count, 16, [&](unsigned chunk, unsigned begin, unsigned end) {
+			ASSERT_LT(chunk, nChunks);
+			chunkBegin[chunk] = begin;
+			chunkEnd[chunk]   = end;
+			total += end - begin;
+		});
+
+		ASSERT_EQ(count, total.load());
+		// Chunks are contiguous and in order.
+		unsigned next = 0;
+		for(unsigned chunk = 0; chunk < nChunks; ++chunk) {
+			ASSERT_EQ(next, chunkBegin[chunk]);
+			next = chunkEnd[chunk];
+		}
+		ASSERT_EQ(count, next);
+	}
+}
+
+TEST(ThreadPoolTest, ParallelForWithoutPool) {
+	unsigned calls = 0;
+	parallelFor(nullptr, 100, 1, [&](unsigned chunk, unsigned begin, unsigned end) {
+		ASSERT_EQ(0u, chunk);
+		ASSERT_EQ(0u, begin);
+		ASSERT_EQ(100u, end);
+		calls += 1;
+	});
+	ASSERT_EQ(1u, calls);
+}
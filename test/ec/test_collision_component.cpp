@@ -0,0 +1,402 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lair/core/thread_pool.h>
+
+#include <lair/utils/tile_collision_layer.h>
+
+#include <lair/ec/entity_manager.h>
+#include <lair/ec/collision_component.h>
+
+
+using namespace lair;
+
+
+class CollisionComponentTest : public ::testing::Test {
+public:
+	PropertySerializer         serializer;
+	EntityManager*             em;
+	CollisionComponentManager* collisions;
+	EntityRef                  a;
+	EntityRef                  b;
+
+	CollisionComponentTest()
+		: em(nullptr),
+		  collisions(nullptr) {
+	}
+
+	virtual void SetUp() {
+		em = new EntityManager(noopLogger, serializer);
+		collisions = new CollisionComponentManager;
+		em->registerComponentManager(collisions);
+
+		a = createCollider("a", Vector2(10, 10));
+		b = createCollider("b", Vector2(11, 10));
+		em->updateWorldTransforms();
+	}
+
+	virtual void TearDown() {
+		// Collision elements and events keep references on entities: flush
+		// them before destroying the entity manager.
+		em->destroyEntity(a);
+		em->destroyEntity(b);
+		collisions->findCollisions();
+		collisions->findCollisions();
+		a.release();
+		b.release();
+		delete em;
+		delete collisions;
+	}
+
+	EntityRef createCollider(const char* name, const Vector2& pos) {
+		EntityRef entity = em->createEntity(em->root(), name);
+		entity.placeAt(pos);
+		CollisionComponent* comp = static_cast<CollisionComponent*>(
+		            collisions->addComponent(entity));
+		comp->addShape(Shape2D(Sphere2(Vector2(0, 0), 1)));
+		return entity;
+	}
+
+	// Moved entities are detected by findCollisions, no need to set them dirty.
+	void moveTo(EntityRef entity, const Vector2& pos) {
+		entity.placeAt(pos);
+		em->updateWorldTransforms();
+	}
+};
+
+
+TEST_F(CollisionComponentTest, ContactBeginStayEnd) {
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+	ASSERT_EQ(1, collisions->contactBegins().size());
+	ASSERT_EQ(0, collisions->contactEnds().size());
+
+	uint64 id = CollisionComponentManager::pairId(collisions->get(a)->id(),
+	                                              collisions->get(b)->id());
+	ASSERT_EQ(id, collisions->hitEvents()[0].pairId);
+
+	// Nothing moved: the contact stays.
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+	ASSERT_EQ(0, collisions->contactBegins().size());
+	ASSERT_EQ(0, collisions->contactEnds().size());
+
+	// Moving but still touching: the contact stays.
+	moveTo(b, Vector2(11.5, 10));
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+	ASSERT_EQ(0, collisions->contactBegins().size());
+	ASSERT_EQ(0, collisions->contactEnds().size());
+
+	moveTo(b, Vector2(20, 10));
+	collisions->findCollisions();
+	ASSERT_EQ(0, collisions->hitEvents().size());
+	ASSERT_EQ(0, collisions->contactBegins().size());
+	ASSERT_EQ(1, collisions->contactEnds().size());
+	ASSERT_EQ(id, collisions->contactEnds()[0].pairId);
+
+	collisions->findCollisions();
+	ASSERT_EQ(0, collisions->contactEnds().size());
+}
+
+TEST_F(CollisionComponentTest, OneEventPerPair) {
+	collisions->get(a)->addShape(Shape2D(Sphere2(Vector2(.5, 0), 1)));
+	collisions->get(a)->setDirty();
+
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+	ASSERT_EQ(1, collisions->contactBegins().size());
+}
+
+TEST_F(CollisionComponentTest, DisabledColliderEndsContact) {
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+
+	collisions->get(a)->setEnabled(false);
+	collisions->findCollisions();
+	ASSERT_EQ(0, collisions->hitEvents().size());
+	ASSERT_EQ(1, collisions->contactEnds().size());
+}
+
+TEST_F(CollisionComponentTest, TransformVersion) {
+	uint32 version = b.worldTransformVersion();
+
+	em->updateWorldTransforms();
+	ASSERT_EQ(version, b.worldTransformVersion());
+
+	b.placeAt(Vector2(12, 10));
+	em->updateWorldTransforms();
+	ASSERT_EQ(version + 1, b.worldTransformVersion());
+}
+
+TEST_F(CollisionComponentTest, MovedCollidersAreRefit) {
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+
+	EntityRef c = createCollider("c", Vector2(30, 10));
+	em->updateWorldTransforms();
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+
+	// Both b and c move: b away from a and toward c.
+	moveTo(b, Vector2(29, 10));
+	moveTo(c, Vector2(30.5, 10));
+	collisions->findCollisions();
+	ASSERT_EQ(1, collisions->hitEvents().size());
+	ASSERT_EQ(1, collisions->contactBegins().size());
+	ASSERT_EQ(1, collisions->contactEnds().size());
+
+	std::deque<EntityRef> hits;
+	ASSERT_TRUE(collisions->hitTest(hits, Vector2(30, 10)));
+	ASSERT_EQ(2, hits.size());
+
+	hits.clear();
+	ASSERT_FALSE(collisions->hitTest(hits, Vector2(11, 10), 0x01, a));
+
+	em->destroyEntity(c);
+}
+
+TEST_F(CollisionComponentTest, Update) {
+	collisions->findCollisions();
+
+	b.placeAt(Vector2(20, 10));
+	b.updateWorldTransform();
+	collisions->update(b);
+	ASSERT_NE(nullptr, collisions->get(b)->_firstElem);
+
+	// Used to crash: update() forgot the new elements.
+	b.placeAt(Vector2(30, 10));
+	b.updateWorldTransform();
+	collisions->update(b);
+
+	std::deque<EntityRef> hits;
+	ASSERT_TRUE(collisions->hitTest(hits, Vector2(30, 10)));
+	ASSERT_EQ(1, hits.size());
+	ASSERT_EQ(b, hits[0]);
+}
+
+TEST_F(CollisionComponentTest, MixedShapes) {
+	EntityRef box0 = em->createEntity(em->root(), "box0");
+	EntityRef box1 = em->createEntity(em->root(), "box1");
+	box0.placeAt(Vector2(9, 11.5));
+	box1.placeAt(Vector2(9, 13));
+	static_cast<CollisionComponent*>(collisions->addComponent(box0))
+	        ->addShape(Shape2D(AlignedBox2(Vector2(-1, -1), Vector2(1, 1))));
+	static_cast<CollisionComponent*>(collisions->addComponent(box1))
+	        ->addShape(Shape2D(AlignedBox2(Vector2(-1, -1), Vector2(1, 1))));
+	em->updateWorldTransforms();
+
+	// a-b (spheres), a-box0 (sphere-box), box0-box1 (boxes).
+	collisions->findCollisions();
+	ASSERT_EQ(3, collisions->hitEvents().size());
+
+	em->destroyEntity(box0);
+	em->destroyEntity(box1);
+}
+
+TEST_F(CollisionComponentTest, Raycast) {
+	for(BroadphaseType type: { BROADPHASE_QUADTREE, BROADPHASE_LOOSE_QUADTREE,
+	                           BROADPHASE_HASH_GRID, BROADPHASE_SWEEP_AND_PRUNE }) {
+		collisions->setBroadphase(type);
+		collisions->findCollisions();
+
+		RaycastHit hit;
+		ASSERT_TRUE(collisions->raycast(hit, Vector2(0, 10), Vector2(1, 0), 100));
+		ASSERT_EQ(a, hit.entity);
+		ASSERT_FLOAT_EQ(9, hit.t);
+
+		ASSERT_TRUE(collisions->raycast(hit, Vector2(0, 10), Vector2(1, 0), 100, 0x01, a));
+		ASSERT_EQ(b, hit.entity);
+		ASSERT_FLOAT_EQ(10, hit.t);
+
+		ASSERT_TRUE(collisions->raycast(hit, Vector2(30, 10), Vector2(-1, 0), 100));
+		ASSERT_EQ(b, hit.entity);
+		ASSERT_FALSE(collisions->raycast(hit, Vector2(0, 10), Vector2(1, 0), 8.5));
+		ASSERT_FALSE(collisions->raycast(hit, Vector2(0, 10), Vector2(1, 0), 100, 0x02));
+		ASSERT_FALSE(collisions->raycast(hit, Vector2(0, 12), Vector2(1, 0), 100));
+	}
+}
+
+TEST_F(CollisionComponentTest, ShapeCast) {
+	collisions->findCollisions();
+
+	// A box moving fast enough to go through both spheres in one step.
+	Shape2D box(AlignedBox2(Vector2(-0.5, 9.5), Vector2(0.5, 10.5)));
+	RaycastHit hit;
+	ASSERT_TRUE(collisions->shapeCast(hit, box, Vector2(40, 0)));
+	ASSERT_EQ(a, hit.entity);
+	ASSERT_FLOAT_EQ(8.5f / 40, hit.t);
+
+	// Passing just above the spheres.
+	Shape2D sphere(Sphere2(Vector2(0, 12.1), 1));
+	ASSERT_FALSE(collisions->shapeCast(hit, sphere, Vector2(40, 0)));
+	ASSERT_FALSE(collisions->shapeCast(hit, box, Vector2(5, 0)));
+}
+
+TEST_F(CollisionComponentTest, Nearest) {
+	for(BroadphaseType type: { BROADPHASE_QUADTREE, BROADPHASE_LOOSE_QUADTREE,
+	                           BROADPHASE_HASH_GRID, BROADPHASE_SWEEP_AND_PRUNE }) {
+		collisions->setBroadphase(type);
+		collisions->findCollisions();
+
+		NearestHit hits[4];
+		ASSERT_EQ(2, collisions->nearest(hits, 4, Vector2(30, 10), 100));
+		ASSERT_EQ(b, hits[0].entity);
+		ASSERT_FLOAT_EQ(18, hits[0].distance);
+		ASSERT_EQ(a, hits[1].entity);
+		ASSERT_FLOAT_EQ(19, hits[1].distance);
+
+		ASSERT_EQ(1, collisions->nearest(hits, 1, Vector2(0, 10), 100));
+		ASSERT_EQ(a, hits[0].entity);
+		ASSERT_EQ(1, collisions->nearest(hits, 4, Vector2(30, 10), 18.5));
+		ASSERT_EQ(0, collisions->nearest(hits, 4, Vector2(30, 10), 100, 0x02));
+
+		// An entity with several shapes is reported once.
+		collisions->get(a)->addShape(Shape2D(Sphere2(Vector2(5, 0), 1)));
+		collisions->get(a)->setDirty();
+		collisions->findCollisions();
+		ASSERT_EQ(2, collisions->nearest(hits, 4, Vector2(30, 10), 100));
+		ASSERT_EQ(a, hits[0].entity);
+		ASSERT_FLOAT_EQ(14, hits[0].distance);
+		ASSERT_EQ(b, hits[1].entity);
+		collisions->get(a)->setShapes(Shape2DVector(1, Shape2D(Sphere2(Vector2(0, 0), 1))));
+		collisions->get(a)->setDirty();
+	}
+}
+
+TEST_F(CollisionComponentTest, TileLayerHitTest) {
+	EntityRef map = em->createEntity(em->root(), "map");
+	map.placeAt(Vector2(100, 0));
+	em->updateWorldTransforms();
+
+	TileCollisionLayer layer;
+	layer.reset(Vector2i(0, 0), Vector2i(2, 2), Vector2(10, 10));
+	layer.setFlags(0, 1, 0x01);
+	collisions->addTileLayer(map, &layer);
+	collisions->findCollisions();
+
+	std::deque<EntityRef> hits;
+	ASSERT_TRUE(collisions->hitTest(hits, Vector2(105, 5)));
+	ASSERT_EQ(1, hits.size());
+	ASSERT_EQ(map, hits[0]);
+
+	hits.clear();
+	ASSERT_FALSE(collisions->hitTest(hits, Vector2(115, 5)));
+	ASSERT_FALSE(collisions->hitTest(hits, Vector2(105, 5), 0x02));
+	ASSERT_FALSE(collisions->hitTest(hits, Vector2(105, 5), 0x01, map));
+
+	// Both a collider and the layer.
+	ASSERT_TRUE(collisions->hitTest(hits, AlignedBox2(Vector2(10, 5), Vector2(105, 10))));
+	ASSERT_EQ(3, hits.size());
+
+	collisions->removeTileLayer(&layer);
+	hits.clear();
+	ASSERT_FALSE(collisions->hitTest(hits, Vector2(105, 5)));
+
+	em->destroyEntity(map);
+}
+
+
+// Run a few frames of a crowded scene and log the events, in order.
+static std::vector<std::string> collisionLog(ThreadPool* pool, BroadphaseType broadphase) {
+	PropertySerializer serializer;
+	EntityManager* em = new EntityManager(noopLogger, serializer);
+	CollisionComponentManager* collisions = new CollisionComponentManager;
+	em->registerComponentManager(collisions);
+	collisions->setThreadPool(pool);
+	collisions->setBroadphase(broadphase, 8);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> coord(0, 400);
+	std::uniform_real_distribution<float> size(.5, 4);
+
+	std::vector<EntityRef> entities;
+	for(unsigned i = 0; i < 2000; ++i) {
+		EntityRef entity = em->createEntity(em->root(), std::to_string(i).c_str());
+		entity.placeAt(Vector2(coord(rng), coord(rng)));
+		CollisionComponent* comp = static_cast<CollisionComponent*>(
+		            collisions->addComponent(entity));
+		Vector2 extent(size(rng), size(rng));
+		if(i % 3)
+			comp->addShape(Shape2D(Sphere2(Vector2(0, 0), extent(0))));
+		if(i % 2)
+			comp->addShape(Shape2D(AlignedBox2(-extent, extent)));
+		if(i % 5 == 0)
+			comp->addShape(Shape2D(OrientedBox2(Vector2(1, 0), extent,
+			                                    Eigen::Rotation2Df(.5f).matrix())));
+		entities.push_back(entity);
+	}
+
+	std::vector<std::string> log;
+	auto logEvents = [&log](const char* kind, const HitEventVector& events) {
+		for(const HitEvent& hit: events)
+			log.push_back(kind + std::to_string(hit.pairId));
+	};
+
+	for(unsigned frame = 0; frame < 4; ++frame) {
+		if(frame) {
+			for(unsigned i = frame; i < entities.size(); i += 3)
+				entities[i].placeAt(Vector2(coord(rng), coord(rng)));
+			for(unsigned i = frame; i < entities.size(); i += 7)
+				collisions->get(entities[i])->setDirty();
+		}
+		em->updateWorldTransforms();
+		collisions->findCollisions();
+
+		for(const HitEvent& hit: collisions->hitEvents())
+			log.push_back(std::string(hit.entities[0].name()) + "-" + hit.entities[1].name());
+		logEvents("begin ", collisions->contactBegins());
+		logEvents("end ",   collisions->contactEnds());
+	}
+
+	for(EntityRef& entity: entities)
+		em->destroyEntity(entity);
+	collisions->findCollisions();
+	collisions->findCollisions();
+	entities.clear();
+	delete em;
+	delete collisions;
+
+	return log;
+}
+
+TEST(CollisionComponentParallelTest, SameEventsWithThreads) {
+	ThreadPool pool(3);
+
+	BroadphaseType broadphases[] = {
+	    BROADPHASE_QUADTREE,
+	    BROADPHASE_LOOSE_QUADTREE,
+	    BROADPHASE_HASH_GRID,
+	    BROADPHASE_SWEEP_AND_PRUNE,
+	};
+	for(BroadphaseType broadphase: broadphases) {
+		std::vector<std::string> serial   = collisionLog(nullptr, broadphase);
+		std::vector<std::string> parallel = collisionLog(&pool,   broadphase);
+		ASSERT_LT(1000, serial.size());
+		ASSERT_EQ(serial, parallel);
+	}
+}
@@ -0,0 +1,174 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <lair/geometry/octree.h>
+#include <lair/geometry/hash_grid.h>
+#include <lair/geometry/sweep_and_prune.h>
+#include <lair/geometry/broadphase.h>
+
+
+using namespace lair;
+
+
+// Runs every broadphase on the same synthetic scenes. Each run inserts the
+// objects one by one, querying the structure before each insertion, the way
+// CollisionComponentManager::findCollisions does, then queries every object
+// against the full structure.
+
+
+struct BenchObject {
+	typedef float Scalar;
+	enum {
+		Dim = 2,
+	};
+
+	BenchObject(unsigned id, const AlignedBox2& box)
+	    : id(id), box(box) {}
+
+	const AlignedBox2& boundingBox() const { return box; }
+
+	unsigned    id;
+	AlignedBox2 box;
+};
+
+typedef Broadphase<BenchObject> BenchBroadphase;
+typedef std::vector<AlignedBox2> BoxVector;
+
+static const float worldSize = 4096;
+
+
+BoxVector uniformScene(unsigned count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(0, worldSize - 32);
+	BoxVector boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		boxes.emplace_back(p, p + Vector2(32, 32));
+	}
+	return boxes;
+}
+
+BoxVector clusteredScene(unsigned count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> center(256, worldSize - 256);
+	std::normal_distribution<float> offset(0, 64);
+
+	std::vector<Vector2> clusters;
+	for(unsigned i = 0; i < 16; ++i)
+		clusters.emplace_back(center(rng), center(rng));
+
+	BoxVector boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p = clusters[i % clusters.size()] + Vector2(offset(rng), offset(rng));
+		boxes.emplace_back(p, p + Vector2(16, 16));
+	}
+	return boxes;
+}
+
+BoxVector mixedScene(unsigned count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(0, worldSize - 512);
+	std::uniform_real_distribution<float> logSize(0, 9);
+	BoxVector boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		Vector2 s(std::exp2(logSize(rng)), std::exp2(logSize(rng)));
+		boxes.emplace_back(p, p + s);
+	}
+	return boxes;
+}
+
+
+void bench(const char* name, BenchBroadphase& bp, const BoxVector& boxes) {
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned nRuns = 10;
+
+	Size pairs = 0;
+	Clock::time_point start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		bp.clear();
+		for(unsigned i = 0; i < boxes.size(); ++i) {
+			bp.hitTest(boxes[i], [&pairs](BenchObject&) {
+				++pairs;
+				return false;
+			});
+			bp.insert(BenchObject(i, boxes[i]));
+		}
+	}
+	double buildSec = std::chrono::duration<double>(Clock::now() - start).count() / nRuns;
+
+	Size hits = 0;
+	start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		for(const AlignedBox2& box: boxes) {
+			bp.hitTest(box, [&hits](BenchObject&) {
+				++hits;
+				return false;
+			});
+		}
+	}
+	double querySec = std::chrono::duration<double>(Clock::now() - start).count() / nRuns;
+
+	std::cout << "  " << std::left << std::setw(16) << name << std::right
+	          << std::setw(10) << std::fixed << std::setprecision(2) << buildSec  * 1000 << " ms"
+	          << std::setw(10) << querySec * 1000 << " ms"
+	          << std::setw(10) << pairs / nRuns << " pairs"
+	          << std::setw(10) << hits  / nRuns << " hits\n";
+}
+
+
+void benchScene(const char* name, const BoxVector& boxes, float cellSize) {
+	AlignedBox2 bounds(Vector2(0, 0), Vector2(worldSize, worldSize));
+
+	std::cout << name << " (" << boxes.size() << " boxes): insert+query, query all\n";
+
+	BroadphaseAdapter<Octree<BenchObject>> quadTree(bounds);
+	bench("quadtree", quadTree, boxes);
+
+	BroadphaseAdapter<Octree<BenchObject>> looseQuadTree(bounds, 8, 2.f);
+	bench("loose quadtree", looseQuadTree, boxes);
+
+	BroadphaseAdapter<HashGrid<BenchObject>> hashGrid(cellSize);
+	bench("hash grid", hashGrid, boxes);
+
+	BroadphaseAdapter<SweepAndPrune<BenchObject>> sap;
+	bench("sweep and prune", sap, boxes);
+
+	std::cout << "  items tested per query: quadtree "
+	          << quadTree.impl().avgItemsTestedPerQuery()
+	          << ", loose quadtree " << looseQuadTree.impl().avgItemsTestedPerQuery() << "\n";
+}
+
+
+int main(int /*argc*/, char** /*argv*/) {
+	const unsigned count = 10000;
+	std::mt19937 rng(42);
+
+	benchScene("uniform",   uniformScene  (count, rng), 32);
+	benchScene("clustered", clusteredScene(count, rng), 16);
+	benchScene("mixed",     mixedScene    (count, rng), 64);
+
+	return 0;
+}
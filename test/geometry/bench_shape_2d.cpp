@@ -0,0 +1,137 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include <lair/geometry/shape_2d.h>
+#include <lair/geometry/intersection.h>
+
+
+using namespace lair;
+
+
+// Throughput of Shape2D::transformed() and Shape2D::intersect() on a mix of
+// shape types, as done by CollisionComponentManager each tick.
+
+
+int main(int /*argc*/, char** /*argv*/) {
+	const unsigned nShapes = 10000;
+	const unsigned nRuns   = 100;
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos(-100, 100);
+	std::uniform_real_distribution<float> size(.5, 5);
+	std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+
+	Shape2DVector shapes;
+	shapes.reserve(nShapes);
+	std::vector<Matrix3> transforms;
+	transforms.reserve(nShapes);
+	for(unsigned i = 0; i < nShapes; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		Vector2 s(size(rng), size(rng));
+		switch(i % 3) {
+		case 0:
+			shapes.emplace_back(Sphere2(p, s(0)));
+			break;
+		case 1:
+			shapes.emplace_back(AlignedBox2(p, p + s));
+			break;
+		case 2:
+			shapes.emplace_back(OrientedBox2(p, s, Eigen::Rotation2D<float>(angle(rng)).toRotationMatrix()));
+			break;
+		}
+
+		Matrix3 m = Matrix3::Identity();
+		m.topRightCorner<2, 1>() << pos(rng) / 10, pos(rng) / 10;
+		transforms.push_back(m);
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Shape2DVector transformed(nShapes);
+	Clock::time_point start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		for(unsigned i = 0; i < nShapes; ++i)
+			transformed[i] = shapes[i].transformed(transforms[i]);
+	}
+	double transformSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	const unsigned nPairs = 16;
+	Size hits = 0;
+	start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		for(unsigned i = 0; i < nShapes; ++i) {
+			for(unsigned j = 1; j <= nPairs; ++j)
+				hits += transformed[i].intersect(transformed[(i + j) % nShapes]);
+		}
+	}
+	double intersectSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	// Same spheres and boxes as above, but tested in batch.
+	Sphere2Batch     sphereBatch;
+	AlignedBox2Batch boxBatch;
+	for(const Shape2D& shape: transformed) {
+		if(shape.isSphere())
+			sphereBatch.push_back(shape.asSphere());
+		else if(shape.isAlignedBox())
+			boxBatch.push_back(shape.asAlignedBox());
+	}
+
+	std::vector<unsigned> batchHits(nShapes);
+	Size nBatchTests = 0;
+	Size nBatchHits  = 0;
+	start = Clock::now();
+	for(unsigned run = 0; run < nRuns; ++run) {
+		for(unsigned i = 0; i < nShapes; i += 64) {
+			const Shape2D& shape = transformed[i];
+			if(shape.isSphere()) {
+				nBatchHits  += intersect(shape.asSphere(), sphereBatch, batchHits.data());
+				nBatchTests += sphereBatch.size();
+			}
+			else if(shape.isAlignedBox()) {
+				nBatchHits  += intersect(shape.asAlignedBox(), boxBatch, batchHits.data());
+				nBatchTests += boxBatch.size();
+			}
+		}
+	}
+	double batchSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	Size copied = 0;
+	for(unsigned run = 0; run < nRuns; ++run) {
+		Shape2DVector copy = shapes;
+		copied += copy.size();
+	}
+	double copySec = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "sizeof(Shape2D): " << sizeof(Shape2D) << " bytes\n";
+	std::cout << "transformed: " << double(nShapes * nRuns) / transformSec << " shapes/s\n";
+	std::cout << "intersect:   " << double(nShapes * nPairs * nRuns) / intersectSec
+	          << " tests/s (" << hits / nRuns << " hits)\n";
+	std::cout << "batch:       " << double(nBatchTests) / batchSec
+	          << " tests/s (" << nBatchHits / nRuns << " hits)\n";
+	std::cout << "copy:        " << double(copied) / copySec << " shapes/s\n";
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <lair/geometry/octree.h>
+#include <lair/geometry/static_octree.h>
+
+
+using namespace lair;
+
+
+// Builds the same static level geometry with Octree::insert() and with
+// StaticOctree::build(), then runs the same box queries and raycasts on
+// both.
+
+
+struct BenchObject {
+	typedef float Scalar;
+	enum {
+		Dim = 2,
+	};
+
+	BenchObject(unsigned id, const AlignedBox2& box)
+	    : id(id), box(box) {}
+
+	const AlignedBox2& boundingBox() const { return box; }
+
+	unsigned    id;
+	AlignedBox2 box;
+};
+
+typedef std::vector<BenchObject> ObjectVector;
+typedef std::vector<AlignedBox2> BoxVector;
+typedef std::chrono::high_resolution_clock Clock;
+
+static const float worldSize = 16384;
+
+
+// Walls and platforms of various sizes, the way a level is made.
+ObjectVector levelScene(unsigned count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(0, worldSize - 256);
+	std::uniform_real_distribution<float> logSize(3, 8);
+	ObjectVector objects;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		Vector2 s(std::exp2(logSize(rng)), std::exp2(logSize(rng)));
+		objects.emplace_back(i, AlignedBox2(p, p + s));
+	}
+	return objects;
+}
+
+BoxVector queryBoxes(unsigned count, std::mt19937& rng) {
+	std::uniform_real_distribution<float> pos(0, worldSize - 64);
+	BoxVector boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		boxes.emplace_back(p, p + Vector2(64, 64));
+	}
+	return boxes;
+}
+
+double seconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+typedef std::vector<std::pair<Vector2, Vector2>> RayVector;
+
+template<typename Tree>
+void benchQueries(const char* name, const Tree& tree, double buildSec,
+                  const BoxVector& boxes, const RayVector& rays) {
+	Size hits = 0;
+	Clock::time_point start = Clock::now();
+	for(const AlignedBox2& box: boxes) {
+		tree.hitTest(box, [&hits](const BenchObject&) {
+			++hits;
+			return false;
+		});
+	}
+	double querySec = seconds(start);
+
+	// First hit along each ray.
+	double sumT = 0;
+	start = Clock::now();
+	for(const auto& ray: rays) {
+		const Vector2& origin = ray.first;
+		const Vector2& dir    = ray.second;
+		float first = worldSize;
+		tree.raycast(origin, dir, worldSize, Vector2(0, 0),
+		             [&](const BenchObject& obj, float& tMax) {
+			float t;
+			if(raycast(obj.box, origin, dir, tMax, &t)) {
+				first = t;
+				tMax  = t;
+			}
+			return false;
+		});
+		sumT += first;
+	}
+	double raySec = seconds(start);
+
+	std::cout << "  " << std::left << std::setw(16) << name << std::right
+	          << std::setw(10) << std::fixed << std::setprecision(2) << buildSec * 1000 << " ms"
+	          << std::setw(10) << querySec * 1000 << " ms"
+	          << std::setw(10) << raySec   * 1000 << " ms"
+	          << std::setw(10) << hits << " hits"
+	          << std::setw(12) << sumT / rays.size() << " avg t\n";
+}
+
+
+int main(int /*argc*/, char** /*argv*/) {
+	const unsigned count    = 100000;
+	const unsigned nQueries = 100000;
+	const unsigned nRays    = 10000;
+	std::mt19937 rng(42);
+
+	ObjectVector objects = levelScene(count, rng);
+	BoxVector    boxes   = queryBoxes(nQueries, rng);
+
+	std::uniform_real_distribution<float> pos(0, worldSize);
+	std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+	RayVector rays;
+	for(unsigned i = 0; i < nRays; ++i) {
+		float a = angle(rng);
+		rays.emplace_back(Vector2(pos(rng), pos(rng)), Vector2(std::cos(a), std::sin(a)));
+	}
+
+	std::cout << "level (" << count << " boxes): build, " << nQueries << " box queries, "
+	          << nRays << " raycasts\n";
+
+	AlignedBox2 bounds(Vector2(0, 0), Vector2(worldSize, worldSize));
+	for(float looseness: { 1.f, 2.f }) {
+		Clock::time_point start = Clock::now();
+		Octree<BenchObject> tree(bounds, 8, looseness);
+		for(const BenchObject& obj: objects)
+			tree.insert(obj);
+		double buildSec = seconds(start);
+
+		benchQueries(looseness > 1? "loose quadtree": "quadtree",
+		             tree, buildSec, boxes, rays);
+		std::cout << "    items tested per query: " << tree.avgItemsTestedPerQuery() << "\n";
+	}
+
+	{
+		Clock::time_point start = Clock::now();
+		StaticOctree<BenchObject> tree;
+		tree.build(objects.begin(), objects.end());
+		double buildSec = seconds(start);
+
+		benchQueries("static quadtree", tree, buildSec, boxes, rays);
+		std::cout << "    items tested per query: " << tree.avgItemsTestedPerQuery()
+		          << ", " << tree.nNodes() << " nodes\n";
+	}
+
+	return 0;
+}
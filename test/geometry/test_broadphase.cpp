@@ -0,0 +1,336 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lair/geometry/octree.h>
+#include <lair/geometry/hash_grid.h>
+#include <lair/geometry/sweep_and_prune.h>
+#include <lair/geometry/broadphase.h>
+
+
+using namespace lair;
+
+
+struct TestObject {
+	typedef float Scalar;
+	enum {
+		Dim = 2,
+	};
+
+	TestObject(unsigned id, const AlignedBox2& box)
+	    : id(id), box(box) {}
+
+	const AlignedBox2& boundingBox() const { return box; }
+
+	unsigned    id;
+	AlignedBox2 box;
+};
+
+typedef Broadphase<TestObject> TestBroadphase;
+typedef std::unique_ptr<TestBroadphase> TestBroadphaseUP;
+typedef std::set<unsigned> IdSet;
+
+
+static std::vector<TestBroadphaseUP> makeBroadphases() {
+	AlignedBox2 bounds(Vector2(-512, -512), Vector2(512, 512));
+
+	std::vector<TestBroadphaseUP> bps;
+	bps.emplace_back(new BroadphaseAdapter<Octree<TestObject>>(bounds));
+	bps.emplace_back(new BroadphaseAdapter<Octree<TestObject>>(bounds, 8, 2.f));
+	bps.emplace_back(new BroadphaseAdapter<HashGrid<TestObject>>(16.f, 64));
+	bps.emplace_back(new BroadphaseAdapter<SweepAndPrune<TestObject>>());
+	return bps;
+}
+
+static std::vector<AlignedBox2> randomBoxes(unsigned count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-500, 450);
+	std::uniform_real_distribution<float> size(0, 1);
+
+	std::vector<AlignedBox2> boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		// Mostly small boxes, with a few huge ones.
+		float s = (i % 50 == 0)? 400 * size(rng): 30 * size(rng);
+		boxes.emplace_back(p, p + Vector2(s, s * size(rng)));
+	}
+	return boxes;
+}
+
+static IdSet bruteForce(const std::vector<AlignedBox2>& boxes,
+                        const std::vector<bool>& alive, const AlignedBox2& query) {
+	IdSet ids;
+	for(unsigned i = 0; i < boxes.size(); ++i) {
+		if(alive[i] && query.intersects(boxes[i]))
+			ids.insert(i);
+	}
+	return ids;
+}
+
+static IdSet query(const TestBroadphase& bp, const AlignedBox2& query) {
+	IdSet ids;
+	bp.hitTest(query, [&ids](TestObject& obj) {
+		// Each object must be reported once.
+		EXPECT_TRUE(ids.insert(obj.id).second);
+		return false;
+	});
+	return ids;
+}
+
+static void checkQueries(const TestBroadphase& bp, const std::vector<AlignedBox2>& boxes,
+                         const std::vector<bool>& alive) {
+	for(unsigned i = 0; i < boxes.size(); i += 7)
+		ASSERT_EQ(bruteForce(boxes, alive, boxes[i]), query(bp, boxes[i]));
+
+	// Queries larger than the grid.
+	AlignedBox2 all(Vector2(-600, -600), Vector2(600, 600));
+	ASSERT_EQ(bruteForce(boxes, alive, all), query(bp, all));
+}
+
+
+TEST(BroadphaseTest, MatchesBruteForce) {
+	std::vector<AlignedBox2> boxes = randomBoxes(500);
+
+	for(TestBroadphaseUP& bp: makeBroadphases()) {
+		std::vector<TestObject*> objects;
+		std::vector<bool> alive(boxes.size(), true);
+		for(unsigned i = 0; i < boxes.size(); ++i)
+			objects.push_back(bp->insert(TestObject(i, boxes[i])));
+
+		checkQueries(*bp, boxes, alive);
+
+		bp->filterIf([](const TestObject& obj) { return obj.id % 3 == 0; });
+		for(unsigned i = 0; i < boxes.size(); i += 3)
+			alive[i] = false;
+		checkQueries(*bp, boxes, alive);
+
+		for(unsigned i = 1; i < boxes.size(); i += 5) {
+			if(!alive[i])
+				continue;
+			bp->remove(objects[i]);
+			alive[i] = false;
+		}
+		checkQueries(*bp, boxes, alive);
+
+		bp->clear();
+		checkQueries(*bp, boxes, std::vector<bool>(boxes.size(), false));
+	}
+}
+
+TEST(BroadphaseTest, Update) {
+	std::vector<AlignedBox2> boxes = randomBoxes(500);
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> small(-4, 4);
+	std::uniform_real_distribution<float> large(-200, 200);
+
+	for(TestBroadphaseUP& bp: makeBroadphases()) {
+		std::vector<AlignedBox2> moved = boxes;
+		std::vector<TestObject*> objects;
+		std::vector<bool> alive(boxes.size(), true);
+		for(unsigned i = 0; i < boxes.size(); ++i)
+			objects.push_back(bp->insert(TestObject(i, boxes[i])));
+
+		// Mostly small moves, that should be refit in place, and a few jumps.
+		unsigned nInPlace = 0;
+		for(unsigned i = 0; i < moved.size(); ++i) {
+			Vector2 offset = (i % 10 == 0)? Vector2(large(rng), large(rng)):
+			                                Vector2(small(rng), small(rng));
+			moved[i] = AlignedBox2(moved[i].min() + offset, moved[i].max() + offset);
+			objects[i]->box = moved[i];
+			nInPlace += bp->update(objects[i]);
+		}
+		ASSERT_LT(0, nInPlace);
+
+		checkQueries(*bp, moved, alive);
+	}
+}
+
+TEST(BroadphaseTest, EarlyExit) {
+	std::vector<AlignedBox2> boxes = randomBoxes(100);
+
+	for(TestBroadphaseUP& bp: makeBroadphases()) {
+		for(unsigned i = 0; i < boxes.size(); ++i)
+			bp->insert(TestObject(i, boxes[i]));
+
+		unsigned count = 0;
+		AlignedBox2 all(Vector2(-600, -600), Vector2(600, 600));
+		ASSERT_TRUE(bp->hitTest(all, [&count](TestObject&) { return ++count == 10; }));
+		ASSERT_EQ(10, count);
+	}
+}
+
+TEST(BroadphaseTest, LooseOctreeTestsFewerItems) {
+	// Small boxes all straddling the center of the root get stuck in the root
+	// of a regular octree, but go down in a loose one.
+	AlignedBox2 bounds(Vector2(-512, -512), Vector2(512, 512));
+	Octree<TestObject> tight(bounds);
+	Octree<TestObject> loose(bounds, 8, 2.f);
+	ASSERT_FALSE(tight.isLoose());
+	ASSERT_TRUE(loose.isLoose());
+
+	std::vector<AlignedBox2> boxes;
+	for(int i = 0; i < 100; ++i) {
+		Vector2 p(i * 10 - 500, -1);
+		boxes.emplace_back(p, p + Vector2(2, 2));
+		tight.insert(i, boxes.back());
+		loose.insert(i, boxes.back());
+	}
+
+	for(const AlignedBox2& box: boxes) {
+		IdSet tightIds;
+		IdSet looseIds;
+		tight.hitTest(box, [&tightIds](TestObject& obj) { tightIds.insert(obj.id); return false; });
+		loose.hitTest(box, [&looseIds](TestObject& obj) { looseIds.insert(obj.id); return false; });
+		ASSERT_EQ(tightIds, looseIds);
+	}
+
+	ASSERT_EQ(boxes.size(), tight.nQueries());
+	ASSERT_EQ(boxes.size(), loose.nQueries());
+	ASSERT_DOUBLE_EQ(double(boxes.size()), tight.avgItemsTestedPerQuery());
+	ASSERT_LT(loose.avgItemsTestedPerQuery(), 10);
+
+	loose.resetStats();
+	ASSERT_EQ(0, loose.nQueries());
+	ASSERT_EQ(0, loose.nItemsTested());
+}
+
+TEST(BroadphaseTest, Raycast) {
+	std::vector<AlignedBox2> boxes = randomBoxes(500);
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> pos(-550, 550);
+	std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+
+	for(TestBroadphaseUP& bp: makeBroadphases()) {
+		for(unsigned i = 0; i < boxes.size(); ++i)
+			bp->insert(TestObject(i, boxes[i]));
+
+		for(unsigned r = 0; r < 100; ++r) {
+			Vector2 origin(pos(rng), pos(rng));
+			float   a = angle(rng);
+			Vector2 dir(std::cos(a), std::sin(a));
+			Vector2 extent = (r % 2)? Vector2(3, 2): Vector2(0, 0);
+			float   maxT   = 2000;
+
+			IdSet expected;
+			float closest = maxT + 1;
+			for(unsigned i = 0; i < boxes.size(); ++i) {
+				AlignedBox2 box(boxes[i].min() - extent, boxes[i].max() + extent);
+				float t;
+				if(raycast(box, origin, dir, maxT, &t)) {
+					expected.insert(i);
+					closest = std::min(closest, t);
+				}
+			}
+
+			IdSet ids;
+			bp->raycast(origin, dir, maxT, extent, [&ids](TestObject& obj, float&) {
+				EXPECT_TRUE(ids.insert(obj.id).second);
+				return false;
+			});
+			ASSERT_EQ(expected, ids);
+
+			// Lowering maxT to the closest hit so far gives the first hit.
+			float first = maxT + 1;
+			bp->raycast(origin, dir, maxT, extent, [&](TestObject& obj, float& tMax) {
+				AlignedBox2 box(obj.box.min() - extent, obj.box.max() + extent);
+				float t;
+				if(raycast(box, origin, dir, tMax, &t) && t < first) {
+					first = t;
+					tMax  = t;
+				}
+				return false;
+			});
+			ASSERT_EQ(closest, first);
+		}
+	}
+}
+
+TEST(BroadphaseTest, RaycastFrontToBack) {
+	// Boxes lined up along the x axis: a first-hit query on a quadtree should
+	// stop after the first few cells.
+	AlignedBox2 bounds(Vector2(-512, -512), Vector2(512, 512));
+	Octree<TestObject> tight(bounds);
+	Octree<TestObject> loose(bounds, 8, 2.f);
+	for(int i = 0; i < 100; ++i) {
+		Vector2 p(i * 10 - 500, 3);
+		tight.insert(i, AlignedBox2(p, p + Vector2(2, 2)));
+		loose.insert(i, AlignedBox2(p, p + Vector2(2, 2)));
+	}
+
+	for(Octree<TestObject>* tree: { &tight, &loose }) {
+		int first = -1;
+		tree->resetStats();
+		tree->raycast(Vector2(-600, 4), Vector2(1, 0), 2000, Vector2(0, 0),
+		              [&first](TestObject& obj, float& tMax) {
+			float t;
+			if(raycast(obj.box, Vector2(-600, 4), Vector2(1, 0), tMax, &t)) {
+				first = obj.id;
+				tMax  = t;
+			}
+			return false;
+		});
+		ASSERT_EQ(0, first);
+		ASSERT_LT(tree->nItemsTested(), 10);
+	}
+}
+
+TEST(BroadphaseTest, Nearest) {
+	std::vector<AlignedBox2> boxes = randomBoxes(500);
+	std::mt19937 rng(1357);
+	std::uniform_real_distribution<float> pos(-550, 550);
+	const unsigned k = 5;
+
+	for(TestBroadphaseUP& bp: makeBroadphases()) {
+		for(unsigned i = 0; i < boxes.size(); ++i)
+			bp->insert(TestObject(i, boxes[i]));
+
+		for(unsigned q = 0; q < 100; ++q) {
+			Vector2 p(pos(rng), pos(rng));
+
+			std::vector<float> expected;
+			for(const AlignedBox2& box: boxes)
+				expected.push_back(distance(box, p));
+			std::sort(expected.begin(), expected.end());
+			expected.resize(k);
+
+			// Keep the k best distances, and prune with the k-th one.
+			std::vector<float> found;
+			bp->nearest(p, 2000, [&found, &p, k](TestObject& obj, float& dMax) {
+				found.insert(std::upper_bound(found.begin(), found.end(), distance(obj.box, p)),
+				             distance(obj.box, p));
+				if(found.size() > k)
+					found.pop_back();
+				if(found.size() == k)
+					dMax = found.back();
+				return false;
+			});
+			ASSERT_EQ(expected, found);
+		}
+	}
+}
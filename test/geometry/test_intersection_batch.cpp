@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lair/geometry/intersection.h>
+
+
+using namespace lair;
+
+
+// Integer coordinates give many touching shapes, to check that the batch
+// kernels and the scalar functions agree on the boundaries.
+static float randomCoord(std::mt19937& rng) {
+	return float(std::uniform_int_distribution<int>(-20, 20)(rng)) / 2;
+}
+
+static std::vector<AlignedBox2> randomBoxes(std::mt19937& rng, unsigned count) {
+	std::vector<AlignedBox2> boxes;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(randomCoord(rng), randomCoord(rng));
+		Vector2 s(std::abs(randomCoord(rng)), std::abs(randomCoord(rng)));
+		boxes.emplace_back(p, p + s);
+	}
+	return boxes;
+}
+
+static std::vector<Sphere2> randomSpheres(std::mt19937& rng, unsigned count) {
+	std::vector<Sphere2> spheres;
+	for(unsigned i = 0; i < count; ++i) {
+		spheres.emplace_back(Vector2(randomCoord(rng), randomCoord(rng)),
+		                     std::abs(randomCoord(rng)));
+	}
+	return spheres;
+}
+
+
+TEST(IntersectionBatchTest, AlignedBoxes) {
+	std::mt19937 rng(42);
+
+	// Sizes that are not a multiple of the SIMD width exercise the tail.
+	for(unsigned count: { 0u, 1u, 3u, 8u, 13u, 100u }) {
+		std::vector<AlignedBox2> boxes = randomBoxes(rng, count);
+		AlignedBox2Batch batch;
+		for(const AlignedBox2& box: boxes)
+			batch.push_back(box);
+		ASSERT_EQ(count, batch.size());
+
+		std::vector<unsigned> hits(count);
+		std::vector<unsigned> scalarHits(count);
+		for(const AlignedBox2& query: randomBoxes(rng, 50)) {
+			std::vector<unsigned> expected;
+			for(unsigned i = 0; i < count; ++i) {
+				if(intersect(query, boxes[i]))
+					expected.push_back(i);
+			}
+
+			unsigned nHits = intersect(query, batch, hits.data());
+			ASSERT_EQ(expected, std::vector<unsigned>(hits.begin(), hits.begin() + nHits));
+
+			unsigned nScalarHits = intersectScalar(query, batch, scalarHits.data());
+			ASSERT_EQ(expected, std::vector<unsigned>(scalarHits.begin(),
+			                                          scalarHits.begin() + nScalarHits));
+		}
+	}
+}
+
+TEST(IntersectionBatchTest, Spheres) {
+	std::mt19937 rng(42);
+
+	for(unsigned count: { 0u, 1u, 3u, 8u, 13u, 100u }) {
+		std::vector<Sphere2> spheres = randomSpheres(rng, count);
+		Sphere2Batch batch;
+		for(const Sphere2& sphere: spheres)
+			batch.push_back(sphere);
+		ASSERT_EQ(count, batch.size());
+
+		std::vector<unsigned> hits(count);
+		std::vector<unsigned> scalarHits(count);
+		for(const Sphere2& query: randomSpheres(rng, 50)) {
+			std::vector<unsigned> expected;
+			for(unsigned i = 0; i < count; ++i) {
+				if(intersect(query, spheres[i]))
+					expected.push_back(i);
+			}
+
+			unsigned nHits = intersect(query, batch, hits.data());
+			ASSERT_EQ(expected, std::vector<unsigned>(hits.begin(), hits.begin() + nHits));
+
+			unsigned nScalarHits = intersectScalar(query, batch, scalarHits.data());
+			ASSERT_EQ(expected, std::vector<unsigned>(scalarHits.begin(),
+			                                          scalarHits.begin() + nScalarHits));
+		}
+	}
+}
+
+TEST(IntersectionBatchTest, Clear) {
+	AlignedBox2Batch boxes;
+	boxes.push_back(AlignedBox2(Vector2(0, 0), Vector2(1, 1)));
+	boxes.clear();
+	ASSERT_EQ(0, boxes.size());
+
+	Sphere2Batch spheres;
+	spheres.push_back(Sphere2(Vector2(0, 0), 1));
+	spheres.clear();
+	ASSERT_EQ(0, spheres.size());
+}
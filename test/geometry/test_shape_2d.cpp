@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include <lair/geometry/shape_2d.h>
+
+
+using namespace lair;
+
+TEST(Shape2DTest, InlineStorage) {
+	// The largest shape is stored inline, next to the type tag.
+	ASSERT_LE(sizeof(Shape2D), sizeof(OrientedBox2) + 2 * sizeof(void*));
+}
+
+TEST(Shape2DTest, CopyAndMove) {
+	Shape2D sphere(Sphere2(Vector2(1, 2), 3));
+	Shape2D box(AlignedBox2(Vector2(0, 0), Vector2(4, 5)));
+
+	Shape2D copy(sphere);
+	ASSERT_TRUE(copy.isSphere());
+	ASSERT_EQ(Vector2(1, 2), copy.asSphere().center());
+	ASSERT_EQ(3, copy.asSphere().radius());
+
+	copy = box;
+	ASSERT_TRUE(copy.isAlignedBox());
+	ASSERT_EQ(Vector2(4, 5), copy.asAlignedBox().max());
+
+	Shape2D moved(std::move(copy));
+	ASSERT_TRUE(moved.isAlignedBox());
+	ASSERT_FALSE(copy.isValid());
+
+	moved.swap(sphere);
+	ASSERT_TRUE(moved.isSphere());
+	ASSERT_TRUE(sphere.isAlignedBox());
+
+	Shape2DVector shapes(4, moved);
+	shapes.push_back(sphere);
+	ASSERT_TRUE(shapes[3].isSphere());
+	ASSERT_TRUE(shapes[4].isAlignedBox());
+}
+
+TEST(Shape2DTest, TransformedAndIntersect) {
+	Matrix3 trans;
+	trans << 1, 0, 10,
+	         0, 1, 20,
+	         0, 0,  1;
+
+	Shape2D sphere = Shape2D(Sphere2(Vector2(0, 0), 1)).transformed(trans);
+	ASSERT_TRUE(sphere.isSphere());
+	ASSERT_EQ(Vector2(10, 20), sphere.asSphere().center());
+
+	Shape2D box = Shape2D(AlignedBox2(Vector2(0, 0), Vector2(2, 2))).transformed(trans);
+	ASSERT_TRUE(box.isAlignedBox());
+	ASSERT_EQ(Vector2(10, 20), box.asAlignedBox().min());
+
+	ASSERT_TRUE(sphere.intersect(box));
+	ASSERT_TRUE(box.intersect(sphere));
+	ASSERT_FALSE(sphere.intersect(Shape2D(Sphere2(Vector2(0, 0), 1))));
+	ASSERT_EQ(AlignedBox2(Vector2(9, 19), Vector2(11, 21)).min(),
+	          sphere.boundingBox().min());
+}
+
+TEST(Shape2DTest, Raycast) {
+	Shape2D sphere(Sphere2(Vector2(10, 0), 2));
+	Shape2D box(AlignedBox2(Vector2(10, -1), Vector2(12, 1)));
+	Shape2D obox(OrientedBox2(Vector2(10, 0), Vector2(2, 2)));
+
+	float t;
+	ASSERT_TRUE(sphere.raycast(Vector2(0, 0), Vector2(1, 0), 100, &t));
+	ASSERT_FLOAT_EQ(8, t);
+	ASSERT_TRUE(box.raycast(Vector2(0, 0), Vector2(2, 0), 100, &t));
+	ASSERT_FLOAT_EQ(5, t);
+	ASSERT_TRUE(obox.raycast(Vector2(0, 0), Vector2(1, 0), 100, &t));
+	ASSERT_FLOAT_EQ(9, t);
+
+	// Too short, pointing away, and starting inside.
+	ASSERT_FALSE(sphere.raycast(Vector2(0, 0), Vector2(1, 0), 7));
+	ASSERT_FALSE(box.raycast(Vector2(0, 0), Vector2(-1, 0), 100));
+	ASSERT_FALSE(obox.raycast(Vector2(0, 5), Vector2(1, 0), 100));
+	ASSERT_TRUE(sphere.raycast(Vector2(10, 1), Vector2(1, 0), 100, &t));
+	ASSERT_EQ(0, t);
+}
+
+TEST(Shape2DTest, Sweep) {
+	Shape2D sphere(Sphere2(Vector2(0, 0), 1));
+	Shape2D box(AlignedBox2(Vector2(-1, -1), Vector2(1, 1)));
+	Shape2D wall(AlignedBox2(Vector2(10, -10), Vector2(10.5, 10)));
+	Shape2D target(Sphere2(Vector2(10, 0), 2));
+
+	float t;
+	ASSERT_TRUE(sphere.sweep(Vector2(20, 0), wall, 1, &t));
+	ASSERT_FLOAT_EQ(0.45f, t);
+	ASSERT_TRUE(sphere.sweep(Vector2(20, 0), target, 1, &t));
+	ASSERT_FLOAT_EQ(0.35f, t);
+	ASSERT_TRUE(box.sweep(Vector2(20, 0), wall, 1, &t));
+	ASSERT_FLOAT_EQ(0.45f, t);
+	ASSERT_TRUE(wall.sweep(Vector2(-20, 0), box, 1, &t));
+	ASSERT_FLOAT_EQ(0.45f, t);
+	ASSERT_FALSE(sphere.sweep(Vector2(5, 0), wall, 1));
+
+	// Passing near the corner of a box: the bounding box of the sphere would
+	// hit it, the sphere does not.
+	Shape2D corner(AlignedBox2(Vector2(10, 10), Vector2(12, 12)));
+	ASSERT_TRUE(Shape2D(AlignedBox2(Vector2(-1, -4.7f), Vector2(1, -2.7f)))
+	            .sweep(Vector2(20, 20), corner, 1));
+	ASSERT_FALSE(Shape2D(Sphere2(Vector2(0, -3.7f), 1)).sweep(Vector2(20, 20), corner, 1));
+	ASSERT_TRUE(sphere.sweep(Vector2(20, 20), corner, 1, &t));
+	ASSERT_NEAR((10 - 1 / std::sqrt(2.f)) / 20, t, 1e-5);
+
+	// Oriented boxes go through the sampled path.
+	Shape2D obox(OrientedBox2(Vector2(0, 0), Vector2(2, 2), Eigen::Rotation2Df(0.3f).matrix()));
+	ASSERT_TRUE(obox.sweep(Vector2(20, 0), wall, 1, &t));
+	Matrix3 trans = Matrix3::Identity();
+	trans(0, 2) = 20 * t;
+	ASSERT_TRUE(obox.transformed(trans).intersect(wall));
+	trans(0, 2) = 20 * t - 0.01f;
+	ASSERT_FALSE(obox.transformed(trans).intersect(wall));
+	ASSERT_FALSE(obox.sweep(Vector2(0, 20), wall, 1));
+}
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <lair/geometry/static_octree.h>
+
+
+using namespace lair;
+
+
+struct StaticObject {
+	typedef float Scalar;
+	enum {
+		Dim = 2,
+	};
+
+	StaticObject(unsigned id, const AlignedBox2& box)
+	    : id(id), box(box) {}
+
+	const AlignedBox2& boundingBox() const { return box; }
+
+	unsigned    id;
+	AlignedBox2 box;
+};
+
+typedef StaticOctree<StaticObject> Tree;
+typedef std::set<unsigned> IdSet;
+
+
+static std::vector<StaticObject> randomObjects(unsigned count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-500, 450);
+	std::uniform_real_distribution<float> size(0, 1);
+
+	std::vector<StaticObject> objects;
+	for(unsigned i = 0; i < count; ++i) {
+		Vector2 p(pos(rng), pos(rng));
+		float s = (i % 50 == 0)? 400 * size(rng): 30 * size(rng);
+		objects.emplace_back(i, AlignedBox2(p, p + Vector2(s, s * size(rng))));
+	}
+	return objects;
+}
+
+
+TEST(StaticOctreeTest, Build) {
+	std::vector<StaticObject> objects = randomObjects(1000);
+	Tree tree(16, 4);
+	tree.build(objects.begin(), objects.end());
+	ASSERT_EQ(objects.size(), tree.size());
+	ASSERT_LT(1, tree.nNodes());
+
+	// Every object is stored once.
+	IdSet ids;
+	for(unsigned i = 0; i < tree.size(); ++i)
+		ids.insert(tree.object(i).id);
+	ASSERT_EQ(objects.size(), ids.size());
+
+	AlignedBox2 bounds;
+	for(const StaticObject& obj: objects)
+		bounds.extend(obj.box);
+	ASSERT_EQ(bounds.min(), tree.bounds().min());
+	ASSERT_EQ(bounds.max(), tree.bounds().max());
+
+	tree.build(objects.begin(), objects.begin());
+	ASSERT_EQ(0, tree.size());
+	ASSERT_FALSE(tree.hitTest(bounds, [](const StaticObject&) { return true; }));
+
+	// Identical objects can not be split, but must still be found.
+	std::vector<StaticObject> same(100, StaticObject(0, AlignedBox2(Vector2(1, 1), Vector2(2, 2))));
+	tree.build(same.begin(), same.end());
+	unsigned count = 0;
+	tree.hitTest(AlignedBox2(Vector2(0, 0), Vector2(1, 1)),
+	             [&count](const StaticObject&) { ++count; return false; });
+	ASSERT_EQ(100, count);
+}
+
+TEST(StaticOctreeTest, HitTest) {
+	std::vector<StaticObject> objects = randomObjects(1000);
+	Tree tree;
+	tree.build(objects.begin(), objects.end());
+
+	for(unsigned q = 0; q < objects.size(); q += 7) {
+		const AlignedBox2& query = objects[q].box;
+		IdSet expected;
+		for(const StaticObject& obj: objects) {
+			if(query.intersects(obj.box))
+				expected.insert(obj.id);
+		}
+
+		IdSet ids;
+		tree.hitTest(query, [&ids](const StaticObject& obj) {
+			EXPECT_TRUE(ids.insert(obj.id).second);
+			return false;
+		});
+		ASSERT_EQ(expected, ids);
+	}
+
+	// Queries skip most of the objects.
+	ASSERT_LT(tree.avgItemsTestedPerQuery(), objects.size() / 10);
+}
+
+TEST(StaticOctreeTest, RaycastAndNearest) {
+	std::vector<StaticObject> objects = randomObjects(1000);
+	Tree tree;
+	tree.build(objects.begin(), objects.end());
+
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> pos(-550, 550);
+	std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+	for(unsigned r = 0; r < 100; ++r) {
+		Vector2 origin(pos(rng), pos(rng));
+		float   a = angle(rng);
+		Vector2 dir(std::cos(a), std::sin(a));
+
+		float closest = 5000;
+		for(const StaticObject& obj: objects) {
+			float t;
+			if(raycast(obj.box, origin, dir, closest, &t))
+				closest = std::min(closest, t);
+		}
+
+		float first = 5000;
+		tree.raycast(origin, dir, 5000, Vector2(0, 0), [&](const StaticObject& obj, float& tMax) {
+			float t;
+			if(raycast(obj.box, origin, dir, tMax, &t) && t < first) {
+				first = t;
+				tMax  = t;
+			}
+			return false;
+		});
+		ASSERT_EQ(closest, first);
+
+		float nearest = 5000;
+		for(const StaticObject& obj: objects)
+			nearest = std::min(nearest, distance(obj.box, origin));
+
+		float found = 5000;
+		tree.nearest(origin, 5000, [&](const StaticObject& obj, float& dMax) {
+			found = std::min(found, distance(obj.box, origin));
+			dMax  = found;
+			return false;
+		});
+		ASSERT_EQ(nearest, found);
+	}
+}
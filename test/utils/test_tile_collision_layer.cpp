@@ -0,0 +1,141 @@
+/*
+ *  Copyright (C) 2015 Simon Boyé
+ *
+ *  This file is part of lair.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include <lair/ldl/ldl_parser.h>
+
+#include <lair/utils/tile_map.h>
+#include <lair/utils/tile_collision_layer.h>
+
+
+using namespace lair;
+
+
+static const char* testMap =
+        "tilesets = [ { h_tiles = 3, v_tiles = 1, image = 'tiles.png', tile_flags = [ 0, 1, 4 ] } ]\n"
+        "tile_layers = [ {\n"
+        "	offset = Vector(0, 0)\n"
+        "	size = Vector(4, 3)\n"
+        "	tile_size = Vector(10, 10)\n"
+        "	tiles = [ 0, 0, 0, 0,\n"
+        "	          2, 0, 0, 2,\n"
+        "	          2, 2, 2, 2147483650 ]\n"
+        "} ]\n";
+
+static void loadMap(TileMap& tileMap) {
+	std::istringstream in(testMap);
+	ErrorList errors;
+	LdlParser parser(&in, "test_map", &errors, LdlParser::CTX_MAP);
+	ASSERT_TRUE(tileMap.setFromLdl(parser));
+}
+
+
+TEST(TileCollisionLayerTest, FromTileMap) {
+	TileMap tileMap;
+	loadMap(tileMap);
+	ASSERT_EQ(0, tileMap.tileFlags(0));
+	ASSERT_EQ(0, tileMap.tileFlags(1));
+	ASSERT_EQ(1, tileMap.tileFlags(2));
+	ASSERT_EQ(4, tileMap.tileFlags(3));
+	ASSERT_EQ(1, tileMap.tileFlags(2 | TileMap::HFLIP_FLAG));
+	ASSERT_EQ(0, tileMap.tileFlags(42));
+
+	TileCollisionLayer layer(tileMap, 0);
+	ASSERT_EQ(Vector2i(4, 3), layer.sizeInTiles());
+	ASSERT_EQ(0, layer.flags(0, 0));
+	ASSERT_EQ(1, layer.flags(0, 1));
+	ASSERT_EQ(1, layer.flags(3, 2));
+	ASSERT_EQ(0, layer.flags(-1, 2));
+	ASSERT_EQ(0, layer.flags(4, 2));
+
+	// Rows go down from the top of the layer.
+	ASSERT_EQ(Vector2(0, 20),  layer.tileBox(0, 0).min());
+	ASSERT_EQ(Vector2(40, 10), layer.tileBox(3, 2).max());
+}
+
+TEST(TileCollisionLayerTest, HitTest) {
+	TileMap tileMap;
+	loadMap(tileMap);
+	TileCollisionLayer layer(tileMap, 0);
+
+	ASSERT_TRUE (layer.hitTest(AlignedBox2(Vector2(5, 15),  Vector2(6, 16))));
+	ASSERT_FALSE(layer.hitTest(AlignedBox2(Vector2(15, 15), Vector2(16, 16))));
+	ASSERT_FALSE(layer.hitTest(AlignedBox2(Vector2(5, 15),  Vector2(6, 16)), 0x02));
+	ASSERT_FALSE(layer.hitTest(AlignedBox2(Vector2(-50, 15), Vector2(-40, 16))));
+	ASSERT_TRUE (layer.hitTest(AlignedBox2(Vector2(-1e9, -1e9), Vector2(1e9, 1e9))));
+
+	unsigned count = 0;
+	layer.hitTest(AlignedBox2(Vector2(1, 1), Vector2(39, 19)), 0x01,
+	              [&count](int, int) { ++count; return false; });
+	ASSERT_EQ(6, count);
+}
+
+TEST(TileCollisionLayerTest, Sweep) {
+	TileMap tileMap;
+	loadMap(tileMap);
+	TileCollisionLayer layer(tileMap, 0);
+
+	float    t;
+	Vector2i tile;
+	AlignedBox2 box(Vector2(14, 11), Vector2(16, 13));
+	ASSERT_TRUE(layer.sweep(box, Vector2(20, 0), 0x01, &t, &tile));
+	ASSERT_NEAR(0.7, t, 1e-3);
+	ASSERT_EQ(Vector2i(3, 1), tile);
+
+	ASSERT_TRUE(layer.sweep(box, Vector2(-20, 0), 0x01, &t, &tile));
+	ASSERT_NEAR(0.2, t, 1e-3);
+	ASSERT_EQ(Vector2i(0, 1), tile);
+
+	ASSERT_TRUE(layer.sweep(AlignedBox2(Vector2(12, 15), Vector2(14, 17)),
+	                        Vector2(0, -20), 0x01, &t, &tile));
+	ASSERT_NEAR(0.25, t, 1e-3);
+	ASSERT_EQ(Vector2i(1, 2), tile);
+
+	// Sliding on the floor, and moving fast through the wall.
+	ASSERT_FALSE(layer.sweep(AlignedBox2(Vector2(12, 10), Vector2(14, 12)), Vector2(10, 0)));
+	ASSERT_TRUE(layer.sweep(AlignedBox2(Vector2(-9, 15), Vector2(-8, 16)), Vector2(1000, 0),
+	                        0x01, &t, &tile));
+	ASSERT_EQ(Vector2i(0, 1), tile);
+	ASSERT_FALSE(layer.sweep(box, Vector2(0, 20)));
+}
+
+TEST(TileCollisionLayerTest, MergedBoxes) {
+	TileMap tileMap;
+	loadMap(tileMap);
+	TileCollisionLayer layer(tileMap, 0);
+
+	// The two pillars, and the floor.
+	ASSERT_EQ(3, layer.mergedBoxes().size());
+	ASSERT_EQ(AlignedBox2(Vector2(0, 0), Vector2(40, 10)).max(),
+	          layer.mergedBoxes()[2].box.max());
+
+	// Extending the pillar on the left merges it with the new tile.
+	layer.setFlags(0, 0, 1);
+	ASSERT_EQ(3, layer.mergedBoxes().size());
+	ASSERT_EQ(Vector2(0, 10), layer.mergedBoxes()[0].box.min());
+	ASSERT_EQ(Vector2(10, 30), layer.mergedBoxes()[0].box.max());
+
+	layer.setFlags(1, 0, 2);
+	ASSERT_EQ(4, layer.mergedBoxes().size());
+}